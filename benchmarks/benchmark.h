@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include "common/types.h"
+
+// runs a step of a benchmark until at least the given number of seconds has passed, and returns
+// how many units per second were processed. each step returns how many units it processed
+template <typename Step>
+double MeasureThroughput(Step step, double seconds = 1.0) {
+    auto start = std::chrono::steady_clock::now();
+    u64 units = 0;
+    double elapsed = 0;
+
+    while (elapsed < seconds) {
+        units += step();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    return units / elapsed;
+}
+
+void RunMFIFOBenchmark();
+void RunPageBenchmark();
+void RunQueueBenchmark();
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include <cstdio>
+#include <cstring>
+#include "benchmark.h"
+
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static constexpr Benchmark benchmarks[] = {
+    {"mfifo", RunMFIFOBenchmark},
+    {"page", RunPageBenchmark},
+    {"queue", RunQueueBenchmark},
+};
+
+// runs every benchmark, or only the ones named on the command line
+int main(int argc, char** argv) {
+    for (const Benchmark& benchmark : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected |= std::strcmp(argv[i], benchmark.name) == 0;
+        }
+
+        if (selected) {
+            benchmark.run();
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include <cstring>
+#include <memory>
+#include "core/system.h"
+#include "benchmark.h"
+
+// each packet is a cnt dmatag followed by a gif packet which writes prim through a+d
+static constexpr int PACKET_WRITES = 15;
+static constexpr int PACKET_QUADWORDS = PACKET_WRITES + 2;
+
+// as many packets as fit in the scratchpad, which spr from copies into the ring in one go
+static constexpr int PACKETS = 0x4000 / (PACKET_QUADWORDS * 16);
+static constexpr int QUADWORDS = PACKETS * PACKET_QUADWORDS;
+
+static constexpr u32 RING_OFFSET = 0x10000;
+static constexpr u32 RING_SIZE = 0x10000;
+
+static void WritePackets(u8* scratchpad) {
+    for (int i = 0; i < PACKETS; i++) {
+        u64* packet = reinterpret_cast<u64*>(scratchpad + (i * PACKET_QUADWORDS * 16));
+        packet[0] = (PACKET_QUADWORDS - 1) | (1ull << 28);
+        packet[1] = 0;
+        packet[2] = PACKET_WRITES | (1ull << 15) | (1ull << 60);
+        packet[3] = 0xe;
+
+        for (int j = 0; j < PACKET_WRITES; j++) {
+            packet[4 + (j * 2)] = j & 0x7;
+            packet[5 + (j * 2)] = 0;
+        }
+    }
+}
+
+// copies the scratchpad into the ring with spr from, and steps the dmac until the gif
+// has drained all of it
+static u64 StreamPackets(System& system) {
+    auto& dmac = system.ee.dmac;
+    dmac.WriteRegister(0x1000d080, 0);
+    dmac.WriteRegister(0x1000d020, QUADWORDS);
+    dmac.WriteRegister(0x1000d000, 0x100);
+
+    while ((dmac.ReadChannel(0x1000d000) & 0x100) || dmac.ReadChannel(0x1000a030) != dmac.ReadChannel(0x1000d010)) {
+        dmac.Run();
+        system.scheduler.Tick(256);
+        system.scheduler.RunEvents();
+    }
+
+    return QUADWORDS;
+}
+
+// measures how many quadwords per second go from spr from, through the ring and out of
+// the gif when it drains the mfifo
+void RunMFIFOBenchmark() {
+    // the bios isn't needed, so only reset what the dmac and gif use
+    auto system = std::make_unique<System>();
+    system->scheduler.Reset();
+    system->ee.Reset();
+    system->gs_thread.Reset();
+    system->gif.Reset();
+
+    WritePackets(system->ee.scratchpad());
+
+    auto& dmac = system->ee.dmac;
+    dmac.WriteRegister(0x1000e000, 1 | (2 << 2));
+    dmac.WriteRegister(0x1000e040, RING_SIZE - 16);
+    dmac.WriteRegister(0x1000e050, RING_OFFSET);
+
+    // the gif drains the ring in source chain mode, starting where spr from writes to
+    dmac.WriteRegister(0x1000a030, RING_OFFSET);
+    dmac.WriteRegister(0x1000a000, 0x104);
+    dmac.WriteRegister(0x1000d010, RING_OFFSET);
+
+    double quadwords = MeasureThroughput([&system] {
+        return StreamPackets(*system);
+    });
+
+    printf("mfifo: spr from -> gif %.2f million quadwords/s\n", quadwords / 1000000);
+}
\ No newline at end of file
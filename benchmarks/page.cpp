@@ -0,0 +1,58 @@
+#include <vector>
+#include "core/gs/page.h"
+#include "benchmark.h"
+
+// a 640x448 buffer, as most games draw to
+static constexpr u32 BUFFER_WIDTH = 640;
+static constexpr u32 BUFFER_HEIGHT = 448;
+
+// stops the read pixels from being optimised away
+static volatile u32 sink;
+
+// measures reading and then writing every pixel of a buffer in a format, a row at a time
+template <gs::PixelFormat format>
+static void MeasurePage(const char* name, u8* vram) {
+    using Page = gs::Page<format>;
+
+    double reads = MeasureThroughput([vram] {
+        u32 sum = 0;
+        for (u32 y = 0; y < BUFFER_HEIGHT; y++) {
+            for (u32 x = 0; x < BUFFER_WIDTH; x++) {
+                sum += Page::Read(vram, x, y, 0, BUFFER_WIDTH / 64);
+            }
+        }
+
+        sink = sum;
+        return BUFFER_WIDTH * BUFFER_HEIGHT;
+    }, 0.25);
+
+    double writes = MeasureThroughput([vram] {
+        for (u32 y = 0; y < BUFFER_HEIGHT; y++) {
+            for (u32 x = 0; x < BUFFER_WIDTH; x++) {
+                Page::Write(vram, x, y, 0, BUFFER_WIDTH / 64, x ^ y);
+            }
+        }
+
+        return BUFFER_WIDTH * BUFFER_HEIGHT;
+    }, 0.25);
+
+    printf("page: %-8s read %7.1f million pixels/s, write %7.1f million pixels/s\n", name, reads / 1000000, writes / 1000000);
+}
+
+void RunPageBenchmark() {
+    std::vector<u8> vram(gs::VRAM_SIZE);
+
+    MeasurePage<gs::PixelFormat::PSMCT32>("psmct32", vram.data());
+    MeasurePage<gs::PixelFormat::PSMCT24>("psmct24", vram.data());
+    MeasurePage<gs::PixelFormat::PSMCT16>("psmct16", vram.data());
+    MeasurePage<gs::PixelFormat::PSMCT16S>("psmct16s", vram.data());
+    MeasurePage<gs::PixelFormat::PSMT8>("psmt8", vram.data());
+    MeasurePage<gs::PixelFormat::PSMT4>("psmt4", vram.data());
+    MeasurePage<gs::PixelFormat::PSMT8H>("psmt8h", vram.data());
+    MeasurePage<gs::PixelFormat::PSMT4HL>("psmt4hl", vram.data());
+    MeasurePage<gs::PixelFormat::PSMT4HH>("psmt4hh", vram.data());
+    MeasurePage<gs::PixelFormat::PSMZ32>("psmz32", vram.data());
+    MeasurePage<gs::PixelFormat::PSMZ24>("psmz24", vram.data());
+    MeasurePage<gs::PixelFormat::PSMZ16>("psmz16", vram.data());
+    MeasurePage<gs::PixelFormat::PSMZ16S>("psmz16s", vram.data());
+}
\ No newline at end of file
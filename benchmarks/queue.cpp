@@ -0,0 +1,114 @@
+#include "common/queue.h"
+#include "benchmark.h"
+
+namespace old {
+
+// the modulo indexed queue which common::Queue replaced, kept to compare against
+template <typename InnerT, int size>
+class Queue {
+public:
+    template <typename T>
+    void Push(T value) {
+        static_assert(sizeof(T) >= sizeof(InnerT));
+        static_assert(sizeof(T) <= (sizeof(InnerT) * size));
+        int ratio = sizeof(T) / sizeof(InnerT);
+        InnerT* data = reinterpret_cast<InnerT*>(&value);
+
+        for (int i = 0; i < ratio; i++) {
+            buffer[write_index % size] = data[i];
+            write_index = (write_index + 1) % size;
+            length++;
+        }
+    }
+
+    template <typename T>
+    T Pop() {
+        static_assert(sizeof(T) >= sizeof(InnerT));
+        static_assert(sizeof(T) <= (sizeof(InnerT) * size));
+        int ratio = sizeof(T) / sizeof(InnerT);
+        T value;
+        InnerT* data = reinterpret_cast<InnerT*>(&value);
+
+        for (int i = 0; i < ratio; i++) {
+            data[i] = buffer[read_index % size];
+            read_index = (read_index + 1) % size;
+            length--;
+        }
+
+        return value;
+    }
+
+private:
+    int read_index = 0;
+    int write_index = 0;
+    int length = 0;
+
+    std::array<InnerT, size> buffer;
+};
+
+} // namespace old
+
+static constexpr int PAIRS = 1 << 16;
+
+// stops the popped values from being optimised away
+static volatile u32 sink;
+
+// measures a push followed by a pop, and prints how long each pair takes
+template <typename PushPop>
+static void MeasurePushPop(const char* name, PushPop push_pop) {
+    double pairs = MeasureThroughput([&push_pop] {
+        u32 sum = 0;
+        for (int i = 0; i < PAIRS; i++) {
+            sum += push_pop(i);
+        }
+
+        sink = sum;
+        return PAIRS;
+    });
+
+    printf("queue: %s %.1f ns per push and pop\n", name, 1000000000 / pairs);
+}
+
+// the gif fifo is a queue of u32 which quadwords are pushed to and popped from, and the
+// sio2 fifo is a queue of u8 which is used a byte at a time
+void RunQueueBenchmark() {
+    old::Queue<u32, 64> old_words;
+    common::Queue<u32, 64> words;
+    common::Queue<u32, 64, true> concurrent_words;
+    old::Queue<u8, 256> old_bytes;
+    common::Queue<u8, 256> bytes;
+
+    MeasurePushPop("u128 through 64 x u32, old", [&old_words](int i) {
+        u128 value;
+        value.lo = i;
+        value.hi = 0;
+        old_words.Push<u128>(value);
+        return old_words.Pop<u128>().uw[0];
+    });
+
+    MeasurePushPop("u128 through 64 x u32, new", [&words](int i) {
+        u128 value;
+        value.lo = i;
+        value.hi = 0;
+        words.PushValue(value);
+        return words.PopValue<u128>().uw[0];
+    });
+
+    MeasurePushPop("u128 through 64 x u32, new concurrent", [&concurrent_words](int i) {
+        u128 value;
+        value.lo = i;
+        value.hi = 0;
+        concurrent_words.PushValue(value);
+        return concurrent_words.PopValue<u128>().uw[0];
+    });
+
+    MeasurePushPop("u8 through 256 x u8, old", [&old_bytes](int i) {
+        old_bytes.Push<u8>(i);
+        return old_bytes.Pop<u8>();
+    });
+
+    MeasurePushPop("u8 through 256 x u8, new", [&bytes](int i) {
+        bytes.Push(i);
+        return bytes.Pop();
+    });
+}
\ No newline at end of file
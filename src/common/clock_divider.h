@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common/types.h"
+
+namespace common {
+
+// converts cycles of one clock into cycles of a clock running at 1 / ratio of its speed.
+// the remainder is carried into the next call, so no cycles are lost to rounding
+class ClockDivider {
+public:
+    ClockDivider(int ratio) : ratio(ratio) {}
+
+    void Reset() {
+        remainder = 0;
+    }
+
+    int Advance(int cycles) {
+        remainder += cycles;
+        int divided = remainder / ratio;
+        remainder %= ratio;
+        return divided;
+    }
+
+private:
+    int ratio;
+    int remainder = 0;
+};
+
+} // namespace common
\ No newline at end of file
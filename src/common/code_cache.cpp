@@ -0,0 +1,25 @@
+#include <sys/mman.h>
+#include "common/log.h"
+#include "common/code_cache.h"
+
+namespace common {
+
+CodeCache::CodeCache(u32 size) : size(size) {
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        common::Error("[CodeCache] failed to allocate %08x bytes of executable memory", size);
+    }
+
+    base = reinterpret_cast<u8*>(memory);
+    current = base;
+}
+
+CodeCache::~CodeCache() {
+    munmap(base, size);
+}
+
+void CodeCache::Reset() {
+    current = base;
+}
+
+} // namespace common
\ No newline at end of file
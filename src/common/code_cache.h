@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common/types.h"
+
+namespace common {
+
+// a region of executable memory which recompiled code is bump allocated from.
+// individual blocks are never freed, instead the whole cache is cleared once full
+class CodeCache {
+public:
+    CodeCache(u32 size);
+    ~CodeCache();
+
+    void Reset();
+
+    u8* GetCodePointer() { return current; }
+    void CommitCode(u8* end) { current = end; }
+    u32 GetFreeSpace() { return size - (current - base); }
+
+private:
+    u8* base;
+    u8* current;
+    u32 size;
+};
+
+} // namespace common
\ No newline at end of file
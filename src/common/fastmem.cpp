@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <vector>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "common/log.h"
+#include "common/fastmem.h"
+
+namespace common {
+
+SharedMemory::SharedMemory(u32 size) : length(size) {
+    fd = memfd_create("matcha", 0);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        common::Error("[SharedMemory] failed to create %08x bytes of shared memory", size);
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        common::Error("[SharedMemory] failed to map %08x bytes of shared memory", size);
+    }
+
+    pointer = reinterpret_cast<u8*>(memory);
+}
+
+SharedMemory::~SharedMemory() {
+    munmap(pointer, length);
+    close(fd);
+}
+
+FastmemArena::FastmemArena() {
+    void* memory = mmap(nullptr, ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        common::Warn("[FastmemArena] failed to reserve guest address space, fastmem is disabled");
+        base = nullptr;
+        return;
+    }
+
+    base = reinterpret_cast<u8*>(memory);
+}
+
+FastmemArena::~FastmemArena() {
+    if (base) {
+        munmap(base, ARENA_SIZE);
+    }
+}
+
+void FastmemArena::Reset() {
+    if (!base) {
+        return;
+    }
+
+    // replace any views with inaccessible memory again
+    mmap(base, ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+}
+
+void FastmemArena::Map(SharedMemory& memory, VirtualAddress vaddr, u32 size, u32 mask) {
+    if (!base) {
+        return;
+    }
+
+    // map the region in chunks, so that each mirror of the backing memory gets its own view
+    u32 offset = 0;
+    while (offset < size) {
+        u32 memory_offset = (vaddr + offset) & mask;
+        u32 chunk_size = std::min(size - offset, std::min(mask + 1, memory.size()) - memory_offset);
+        void* view = mmap(base + vaddr + offset, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memory.GetFD(), memory_offset);
+        if (view == MAP_FAILED) {
+            common::Error("[FastmemArena] failed to map %08x bytes at %08x", chunk_size, vaddr + offset);
+        }
+
+        offset += chunk_size;
+    }
+}
+
+static std::vector<FaultHandler*> fault_handlers;
+static bool fault_handler_installed = false;
+
+static void HandleSegfault(int signal, siginfo_t* info, void* context) {
+    u8* address = reinterpret_cast<u8*>(info->si_addr);
+    for (auto handler : fault_handlers) {
+        if ((*handler)(address, context)) {
+            return;
+        }
+    }
+
+    // this was a genuine crash, so let the fault happen again without us
+    struct sigaction action = {};
+    action.sa_handler = SIG_DFL;
+    sigaction(signal, &action, nullptr);
+}
+
+void AddFaultHandler(FaultHandler* handler) {
+    fault_handlers.push_back(handler);
+
+    if (!fault_handler_installed) {
+        struct sigaction action = {};
+        action.sa_sigaction = HandleSegfault;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, nullptr);
+        fault_handler_installed = true;
+    }
+}
+
+void RemoveFaultHandler(FaultHandler* handler) {
+    fault_handlers.erase(std::remove(fault_handlers.begin(), fault_handlers.end(), handler), fault_handlers.end());
+}
+
+} // namespace common
\ No newline at end of file
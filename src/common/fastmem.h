@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include "common/types.h"
+
+namespace common {
+
+// memory backed by an anonymous file, so that the same pages can be mapped at several host addresses
+class SharedMemory {
+public:
+    SharedMemory(u32 size);
+    ~SharedMemory();
+
+    u8* data() { return pointer; }
+    u32 size() { return length; }
+    int GetFD() { return fd; }
+
+private:
+    u8* pointer;
+    u32 length;
+    int fd;
+};
+
+// a 4gb host region which mirrors a guest address space, so that a guest access
+// becomes base + address. unmapped addresses fault, so that they can be handled as mmio
+class FastmemArena {
+public:
+    FastmemArena();
+    ~FastmemArena();
+
+    void Reset();
+    void Map(SharedMemory& memory, VirtualAddress base, u32 size, u32 mask);
+
+    // returns nullptr if the address space couldn't be reserved
+    u8* GetBase() { return base; }
+
+private:
+    // padding for 128 bit accesses at the top of the address space
+    static constexpr u64 ARENA_SIZE = 0x100000000 + 0x10000;
+
+    u8* base;
+};
+
+// handlers get the faulting address and the ucontext_t of the signal, and return true if they
+// emulated the access. handlers are tried in the order they were added
+using FaultHandler = std::function<bool(u8* address, void* context)>;
+
+void AddFaultHandler(FaultHandler* handler);
+void RemoveFaultHandler(FaultHandler* handler);
+
+} // namespace common
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <type_traits>
+#include "common/types.h"
+#include "common/log.h"
+
+namespace common {
+
+// dispatches io accesses to the handlers registered for their physical address range.
+// each page either sends every access to one handler, or has a table of handlers per byte
+// for pages which are shared between devices
+struct IOMap {
+    // handlers are plain functions, which are passed the device they were registered with,
+    // so that an access is a single indirect call
+    struct ReadHandler {
+        u32 (*function)(void* device, u32 paddr);
+        void* device;
+    };
+
+    struct WriteHandler {
+        void (*function)(void* device, u32 paddr, u32 value);
+        void* device;
+    };
+
+    IOMap(const char* name) : name(name) {
+        read_pages.resize(PAGE_COUNT);
+        write_pages.resize(PAGE_COUNT);
+
+        // handler 0 is used for any unmapped address
+        read_handlers.push_back({[](void* map, u32 paddr) -> u32 {
+            common::Log("[%s] handle io read %08x", static_cast<IOMap*>(map)->name, paddr);
+            return 0;
+        }, this});
+
+        write_handlers.push_back({[](void* map, u32 paddr, u32 value) {
+            common::Log("[%s] handle io write %08x = %08x", static_cast<IOMap*>(map)->name, paddr, value);
+        }, this});
+
+        tables.emplace_back();
+    }
+
+    // the unmapped handlers point back at the map
+    IOMap(const IOMap&) = delete;
+    IOMap& operator=(const IOMap&) = delete;
+
+    // ranges are [start, end), and override any earlier mappings they overlap. handlers are lambdas
+    // which don't capture anything, and take the device followed by the address and value
+    template <typename Device, typename Read>
+    void MapRead(u32 start, u32 end, Device* device, Read) {
+        static_assert(std::is_empty_v<Read>, "io handlers can't capture anything");
+        read_handlers.push_back({[](void* device, u32 paddr) -> u32 {
+            return Read{}(static_cast<Device*>(device), paddr);
+        }, device});
+
+        MapHandler(read_pages, start, end, read_handlers.size() - 1);
+    }
+
+    template <typename Device, typename Write>
+    void MapWrite(u32 start, u32 end, Device* device, Write) {
+        static_assert(std::is_empty_v<Write>, "io handlers can't capture anything");
+        write_handlers.push_back({[](void* device, u32 paddr, u32 value) {
+            Write{}(static_cast<Device*>(device), paddr, value);
+        }, device});
+
+        MapHandler(write_pages, start, end, write_handlers.size() - 1);
+    }
+
+    template <typename Device, typename Read, typename Write>
+    void Map(u32 start, u32 end, Device* device, Read read, Write write) {
+        MapRead(start, end, device, read);
+        MapWrite(start, end, device, write);
+    }
+
+    // single registers only match their exact address
+    template <typename Device, typename Read>
+    void MapRead(u32 paddr, Device* device, Read read) {
+        MapRead(paddr, paddr + 1, device, read);
+    }
+
+    template <typename Device, typename Write>
+    void MapWrite(u32 paddr, Device* device, Write write) {
+        MapWrite(paddr, paddr + 1, device, write);
+    }
+
+    template <typename Device, typename Read, typename Write>
+    void Map(u32 paddr, Device* device, Read read, Write write) {
+        Map(paddr, paddr + 1, device, read, write);
+    }
+
+    u32 Read(u32 paddr) {
+        ReadHandler& handler = read_handlers[Lookup(read_pages, paddr)];
+        return handler.function(handler.device, paddr);
+    }
+
+    void Write(u32 paddr, u32 value) {
+        WriteHandler& handler = write_handlers[Lookup(write_pages, paddr)];
+        handler.function(handler.device, paddr, value);
+    }
+
+private:
+    static constexpr int PAGE_BITS = 12;
+    static constexpr int PAGE_SIZE = 1 << PAGE_BITS;
+    static constexpr u32 PAGE_MASK = PAGE_SIZE - 1;
+    static constexpr int PAGE_COUNT = 0x20000000 >> PAGE_BITS;
+
+    struct Page {
+        u16 handler = 0;
+
+        // index into tables, or 0 if the whole page uses the same handler
+        u16 table = 0;
+    };
+
+    using Table = std::array<u16, PAGE_SIZE>;
+
+    u16 Lookup(std::vector<Page>& pages, u32 paddr) {
+        Page& page = pages[(paddr & 0x1fffffff) >> PAGE_BITS];
+        if (page.table) {
+            return tables[page.table][paddr & PAGE_MASK];
+        }
+
+        return page.handler;
+    }
+
+    void MapHandler(std::vector<Page>& pages, u32 start, u32 end, u16 handler) {
+        for (u32 base = start & ~PAGE_MASK; base < end; base += PAGE_SIZE) {
+            Page& page = pages[base >> PAGE_BITS];
+            u32 first = std::max(start, base) & PAGE_MASK;
+            u32 last = std::min(end - base, static_cast<u32>(PAGE_SIZE));
+
+            if (first == 0 && last == PAGE_SIZE && !page.table) {
+                page.handler = handler;
+                continue;
+            }
+
+            if (!page.table) {
+                page.table = tables.size();
+                tables.emplace_back();
+                tables.back().fill(page.handler);
+            }
+
+            std::fill(tables[page.table].begin() + first, tables[page.table].begin() + last, handler);
+        }
+    }
+
+    const char* name;
+    std::vector<ReadHandler> read_handlers;
+    std::vector<WriteHandler> write_handlers;
+    std::vector<Page> read_pages;
+    std::vector<Page> write_pages;
+    std::vector<Table> tables;
+};
+
+} // namespace common
\ No newline at end of file
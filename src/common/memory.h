@@ -6,9 +6,9 @@
 namespace common {
 
 template <typename T>
-inline T Read(void* data, int offset = 0) {
+inline T Read(const void* data, int offset = 0) {
     T return_value;
-    std::memcpy(&return_value, (u8*)data + offset, sizeof(T));
+    std::memcpy(&return_value, (const u8*)data + offset, sizeof(T));
     return return_value;
 }
 
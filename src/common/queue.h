@@ -1,68 +1,155 @@
 #pragma once
 
 #include <array>
-#include "common/log.h"
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include "common/types.h"
 
 namespace common {
 
-template <typename InnerT, int size>
+// a fixed size fifo with a power of two capacity. the read and write positions count up forever
+// and are masked when indexing, so a full queue can be told apart from an empty one without
+// keeping a separate length. with concurrent set, the positions are atomic so that a single
+// producer and a single consumer can use the queue from different threads
+template <typename T, u32 capacity, bool concurrent = false>
 class Queue {
 public:
+    static_assert(capacity != 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+
     void Reset() {
-        read_index = 0;
-        write_index = 0;
-        length = 0;
+        Store(read_position, 0);
+        Store(write_position, 0);
     }
 
-    template <typename T>
-    void Push(T value) {
-        static_assert(sizeof(T) >= sizeof(InnerT));
-        static_assert(sizeof(T) <= (sizeof(InnerT) * size));
-        int ratio = sizeof(T) / sizeof(InnerT);
-        InnerT* data = reinterpret_cast<InnerT*>(&value);
-
-        for (int i = 0; i < ratio; i++) {
-            buffer[write_index % size] = data[i];
-            write_index = (write_index + 1) % size;
-            length++;
-        }
+    u32 GetLength() {
+        return Load(write_position) - Load(read_position);
     }
 
-    template <typename T>
-    T Pop() {
-        static_assert(sizeof(T) >= sizeof(InnerT));
-        static_assert(sizeof(T) <= (sizeof(InnerT) * size));
-        int ratio = sizeof(T) / sizeof(InnerT);
-        T value;
-        InnerT* data = reinterpret_cast<InnerT*>(&value);
-
-        for (int i = 0; i < ratio; i++) {
-            data[i] = buffer[read_index % size];
-            read_index = (read_index + 1) % size;
-            length--;
+    u32 GetFree() {
+        return capacity - GetLength();
+    }
+
+    static constexpr u32 GetSize() {
+        return capacity;
+    }
+
+    bool Empty() {
+        return GetLength() == 0;
+    }
+
+    bool Full() {
+        return GetLength() == capacity;
+    }
+
+    // returns false if the queue is full
+    bool Push(T value) {
+        u32 write = Load(write_position);
+        if (write - Load(read_position) == capacity) {
+            return false;
         }
 
+        buffer[write & MASK] = value;
+        Store(write_position, write + 1);
+        return true;
+    }
+
+    // the queue must not be empty
+    T Pop() {
+        u32 read = Load(read_position);
+        T value = buffer[read & MASK];
+        Store(read_position, read + 1);
         return value;
     }
 
-    int GetLength() {
-        return length;
+    // returns the value offset entries from the front without removing it. there must be more than offset entries
+    T& Peek(u32 offset = 0) {
+        return buffer[(Load(read_position) + offset) & MASK];
+    }
+
+    // pushes as many values as there is space for, and returns how many were pushed
+    u32 PushSpan(std::span<const T> values) {
+        u32 write = Load(write_position);
+        u32 free = capacity - (write - Load(read_position));
+        u32 count = std::min<u32>(values.size(), free);
+
+        // copy up to the end of the buffer, then the rest from the start
+        u32 offset = write & MASK;
+        u32 first = std::min(count, capacity - offset);
+        std::memcpy(&buffer[offset], values.data(), first * sizeof(T));
+        std::memcpy(&buffer[0], values.data() + first, (count - first) * sizeof(T));
+
+        Store(write_position, write + count);
+        return count;
     }
 
-    int GetSize() {
-        return size;
+    // pops as many values as are available to fill the span, and returns how many were popped
+    u32 PopSpan(std::span<T> values) {
+        u32 read = Load(read_position);
+        u32 length = Load(write_position) - read;
+        u32 count = std::min<u32>(values.size(), length);
+
+        u32 offset = read & MASK;
+        u32 first = std::min(count, capacity - offset);
+        std::memcpy(values.data(), &buffer[offset], first * sizeof(T));
+        std::memcpy(values.data() + first, &buffer[0], (count - first) * sizeof(T));
+
+        Store(read_position, read + count);
+        return count;
     }
 
-    bool Empty() {
-        return length == 0;
+    // wider values, such as a u128 in a queue of u32, are stored as several consecutive entries.
+    // returns false without pushing anything if there isn't room for all of them
+    template <typename U>
+    bool PushValue(const U& value) {
+        static_assert(sizeof(U) % sizeof(T) == 0 && sizeof(U) <= sizeof(T) * capacity);
+        constexpr u32 count = sizeof(U) / sizeof(T);
+        if (GetFree() < count) {
+            return false;
+        }
+
+        PushSpan(std::span<const T>(reinterpret_cast<const T*>(&value), count));
+        return true;
+    }
+
+    // there must be enough entries in the queue to make up the value
+    template <typename U>
+    U PopValue() {
+        static_assert(sizeof(U) % sizeof(T) == 0 && sizeof(U) <= sizeof(T) * capacity);
+        U value;
+        PopSpan(std::span<T>(reinterpret_cast<T*>(&value), sizeof(U) / sizeof(T)));
+        return value;
     }
 
 private:
-    int read_index = 0;
-    int write_index = 0;
-    int length = 0;
+    using Position = std::conditional_t<concurrent, std::atomic<u32>, u32>;
+
+    // the producer publishes its entries with a release store of the write position, which the consumer
+    // pairs with an acquire load before reading them, and likewise for the read position
+    static u32 Load(const Position& position) {
+        if constexpr (concurrent) {
+            return position.load(std::memory_order_acquire);
+        } else {
+            return position;
+        }
+    }
+
+    static void Store(Position& position, u32 value) {
+        if constexpr (concurrent) {
+            position.store(value, std::memory_order_release);
+        } else {
+            position = value;
+        }
+    }
+
+    static constexpr u32 MASK = capacity - 1;
 
-    std::array<InnerT, size> buffer;
+    std::array<T, capacity> buffer;
+    Position read_position = 0;
+    Position write_position = 0;
 };
 
 } // namespace common
\ No newline at end of file
@@ -0,0 +1,393 @@
+#include "common/log.h"
+#include "common/memory.h"
+#include "common/x64_emitter.h"
+
+namespace common {
+
+static int Index(Reg reg) {
+    return static_cast<int>(reg);
+}
+
+static int Index(XMM reg) {
+    return static_cast<int>(reg);
+}
+
+void X64Emitter::Emit32(u32 value) {
+    common::Write<u32>(code, value);
+    code += 4;
+}
+
+void X64Emitter::Emit64(u64 value) {
+    common::Write<u64>(code, value);
+    code += 8;
+}
+
+void X64Emitter::REX(bool w, int reg, int index, int base, bool force) {
+    u8 rex = 0x40 | (w << 3) | (((reg >> 3) & 0x1) << 2) | (((index >> 3) & 0x1) << 1) | ((base >> 3) & 0x1);
+    if (rex != 0x40 || force) {
+        Emit8(rex);
+    }
+}
+
+void X64Emitter::ModRM(int reg, Reg rm) {
+    Emit8(0xc0 | ((reg & 0x7) << 3) | (Index(rm) & 0x7));
+}
+
+void X64Emitter::ModRM(int reg, Mem rm) {
+    int base = Index(rm.base) & 0x7;
+    bool short_disp = rm.disp >= -128 && rm.disp <= 127;
+
+    // rbp and r13 can't be encoded without a displacement
+    if (rm.disp == 0 && base != 5) {
+        Emit8(((reg & 0x7) << 3) | base);
+        if (base == 4) {
+            Emit8(0x24);
+        }
+    } else if (short_disp) {
+        Emit8(0x40 | ((reg & 0x7) << 3) | base);
+        if (base == 4) {
+            Emit8(0x24);
+        }
+
+        Emit8(static_cast<u8>(rm.disp));
+    } else {
+        Emit8(0x80 | ((reg & 0x7) << 3) | base);
+        if (base == 4) {
+            Emit8(0x24);
+        }
+
+        Emit32(rm.disp);
+    }
+}
+
+void X64Emitter::MOV(int bits, Reg dst, Reg src) {
+    ALU(0x89, bits, src, dst);
+}
+
+void X64Emitter::MOV(int bits, Reg dst, Mem src) {
+    switch (bits) {
+    case 8:
+        REX(false, Index(dst), 0, Index(src.base), Index(dst) >= 4);
+        Emit8(0x8a);
+        ModRM(Index(dst), src);
+        break;
+    case 16:
+        Emit8(0x66);
+        REX(false, Index(dst), 0, Index(src.base));
+        Emit8(0x8b);
+        ModRM(Index(dst), src);
+        break;
+    default:
+        REX(bits == 64, Index(dst), 0, Index(src.base));
+        Emit8(0x8b);
+        ModRM(Index(dst), src);
+        break;
+    }
+}
+
+void X64Emitter::MOV(int bits, Mem dst, Reg src) {
+    switch (bits) {
+    case 8:
+        REX(false, Index(src), 0, Index(dst.base), Index(src) >= 4);
+        Emit8(0x88);
+        ModRM(Index(src), dst);
+        break;
+    case 16:
+        Emit8(0x66);
+        REX(false, Index(src), 0, Index(dst.base));
+        Emit8(0x89);
+        ModRM(Index(src), dst);
+        break;
+    default:
+        REX(bits == 64, Index(src), 0, Index(dst.base));
+        Emit8(0x89);
+        ModRM(Index(src), dst);
+        break;
+    }
+}
+
+void X64Emitter::MOV(int bits, Mem dst, s32 imm) {
+    switch (bits) {
+    case 8:
+        REX(false, 0, 0, Index(dst.base));
+        Emit8(0xc6);
+        ModRM(0, dst);
+        Emit8(static_cast<u8>(imm));
+        break;
+    case 16:
+        common::Error("[X64Emitter] 16 bit immediate stores are not supported");
+        break;
+    default:
+        // 64 bit stores sign extend the 32 bit immediate
+        REX(bits == 64, 0, 0, Index(dst.base));
+        Emit8(0xc7);
+        ModRM(0, dst);
+        Emit32(imm);
+        break;
+    }
+}
+
+void X64Emitter::MOV(Reg dst, u64 imm) {
+    if (imm <= 0xffffffff) {
+        // writing a 32 bit register zero extends into the upper half
+        REX(false, 0, 0, Index(dst));
+        Emit8(0xb8 + (Index(dst) & 0x7));
+        Emit32(imm);
+    } else if (static_cast<s64>(imm) == static_cast<s32>(imm)) {
+        REX(true, 0, 0, Index(dst));
+        Emit8(0xc7);
+        ModRM(0, dst);
+        Emit32(imm);
+    } else {
+        REX(true, 0, 0, Index(dst));
+        Emit8(0xb8 + (Index(dst) & 0x7));
+        Emit64(imm);
+    }
+}
+
+void X64Emitter::MOVSXD(Reg dst, Reg src) {
+    REX(true, Index(dst), 0, Index(src));
+    Emit8(0x63);
+    ModRM(Index(dst), src);
+}
+
+void X64Emitter::MOVZX8(Reg dst, Reg src) {
+    REX(false, Index(dst), 0, Index(src), Index(src) >= 4);
+    Emit8(0x0f);
+    Emit8(0xb6);
+    ModRM(Index(dst), src);
+}
+
+void X64Emitter::MOVSX(int bits, Reg dst, Mem src) {
+    REX(true, Index(dst), 0, Index(src.base));
+    switch (bits) {
+    case 8:
+        Emit8(0x0f);
+        Emit8(0xbe);
+        break;
+    case 16:
+        Emit8(0x0f);
+        Emit8(0xbf);
+        break;
+    default:
+        Emit8(0x63);
+        break;
+    }
+
+    ModRM(Index(dst), src);
+}
+
+void X64Emitter::MOVZX(int bits, Reg dst, Mem src) {
+    REX(false, Index(dst), 0, Index(src.base));
+    switch (bits) {
+    case 8:
+        Emit8(0x0f);
+        Emit8(0xb6);
+        break;
+    case 16:
+        Emit8(0x0f);
+        Emit8(0xb7);
+        break;
+    default:
+        // writing a 32 bit register zero extends into the upper half
+        Emit8(0x8b);
+        break;
+    }
+
+    ModRM(Index(dst), src);
+}
+
+void X64Emitter::TEST(int bits, Reg dst, Reg src) {
+    ALU(0x85, bits, src, dst);
+}
+
+void X64Emitter::NOT(int bits, Reg dst) {
+    REX(bits == 64, 0, 0, Index(dst));
+    Emit8(0xf7);
+    ModRM(2, dst);
+}
+
+void X64Emitter::SETcc(Condition condition, Reg dst) {
+    REX(false, 0, 0, Index(dst), Index(dst) >= 4);
+    Emit8(0x0f);
+    Emit8(0x90 + static_cast<u8>(condition));
+    ModRM(0, dst);
+}
+
+void X64Emitter::PUSH(Reg reg) {
+    REX(false, 0, 0, Index(reg));
+    Emit8(0x50 + (Index(reg) & 0x7));
+}
+
+void X64Emitter::POP(Reg reg) {
+    REX(false, 0, 0, Index(reg));
+    Emit8(0x58 + (Index(reg) & 0x7));
+}
+
+void X64Emitter::RET() {
+    Emit8(0xc3);
+}
+
+void X64Emitter::CALL(const void* function) {
+    s64 distance = reinterpret_cast<const u8*>(function) - (code + 5);
+
+    if (distance >= INT32_MIN && distance <= INT32_MAX) {
+        Emit8(0xe8);
+        Emit32(distance);
+    } else {
+        MOV(Reg::RAX, reinterpret_cast<u64>(function));
+        Emit8(0xff);
+        ModRM(2, Reg::RAX);
+    }
+}
+
+u8* X64Emitter::JMP(const void* target) {
+    Emit8(0xe9);
+    u8* rel32 = code;
+    Emit32(0);
+    SetJumpTarget(rel32, target ? target : code);
+    return rel32;
+}
+
+u8* X64Emitter::Jcc(Condition condition, const void* target) {
+    Emit8(0x0f);
+    Emit8(0x80 + static_cast<u8>(condition));
+    u8* rel32 = code;
+    Emit32(0);
+    SetJumpTarget(rel32, target ? target : code);
+    return rel32;
+}
+
+void X64Emitter::JMP(Reg reg) {
+    REX(false, 0, 0, Index(reg));
+    Emit8(0xff);
+    ModRM(4, reg);
+}
+
+void X64Emitter::SetJumpTarget(u8* rel32, const void* target) {
+    s64 distance = reinterpret_cast<const u8*>(target) - (rel32 + 4);
+    if (distance < INT32_MIN || distance > INT32_MAX) {
+        common::Error("[X64Emitter] jump target is out of range");
+    }
+
+    common::Write<s32>(rel32, distance);
+}
+
+void X64Emitter::MOVDQU(XMM dst, Mem src) {
+    Emit8(0xf3);
+    REX(false, Index(dst), 0, Index(src.base));
+    Emit8(0x0f);
+    Emit8(0x6f);
+    ModRM(Index(dst), src);
+}
+
+void X64Emitter::MOVDQU(Mem dst, XMM src) {
+    Emit8(0xf3);
+    REX(false, Index(src), 0, Index(dst.base));
+    Emit8(0x0f);
+    Emit8(0x7f);
+    ModRM(Index(src), dst);
+}
+
+void X64Emitter::ALU(u8 opcode, int bits, Reg reg, Reg rm) {
+    if (bits == 16) {
+        Emit8(0x66);
+    }
+
+    REX(bits == 64, Index(reg), 0, Index(rm), bits == 8 && (Index(reg) >= 4 || Index(rm) >= 4));
+    Emit8(bits == 8 ? opcode - 1 : opcode);
+    ModRM(Index(reg), rm);
+}
+
+void X64Emitter::ALU(u8 opcode, int bits, Reg reg, Mem rm) {
+    if (bits == 16) {
+        Emit8(0x66);
+    }
+
+    REX(bits == 64, Index(reg), 0, Index(rm.base), bits == 8 && Index(reg) >= 4);
+    Emit8(bits == 8 ? opcode - 1 : opcode);
+    ModRM(Index(reg), rm);
+}
+
+void X64Emitter::ALUImm(int extension, int bits, Reg rm, s32 imm) {
+    bool short_imm = imm >= -128 && imm <= 127;
+
+    if (bits == 16) {
+        Emit8(0x66);
+    }
+
+    REX(bits == 64, 0, 0, Index(rm), bits == 8 && Index(rm) >= 4);
+
+    if (bits == 8) {
+        Emit8(0x80);
+        ModRM(extension, rm);
+        Emit8(static_cast<u8>(imm));
+    } else if (short_imm) {
+        Emit8(0x83);
+        ModRM(extension, rm);
+        Emit8(static_cast<u8>(imm));
+    } else {
+        Emit8(0x81);
+        ModRM(extension, rm);
+
+        if (bits == 16) {
+            Emit8(imm & 0xff);
+            Emit8((imm >> 8) & 0xff);
+        } else {
+            Emit32(imm);
+        }
+    }
+}
+
+void X64Emitter::ALUImm(int extension, int bits, Mem rm, s32 imm) {
+    bool short_imm = imm >= -128 && imm <= 127;
+
+    if (bits == 16) {
+        Emit8(0x66);
+    }
+
+    REX(bits == 64, 0, 0, Index(rm.base));
+
+    if (bits == 8) {
+        Emit8(0x80);
+        ModRM(extension, rm);
+        Emit8(static_cast<u8>(imm));
+    } else if (short_imm) {
+        Emit8(0x83);
+        ModRM(extension, rm);
+        Emit8(static_cast<u8>(imm));
+    } else {
+        Emit8(0x81);
+        ModRM(extension, rm);
+
+        if (bits == 16) {
+            Emit8(imm & 0xff);
+            Emit8((imm >> 8) & 0xff);
+        } else {
+            Emit32(imm);
+        }
+    }
+}
+
+void X64Emitter::Shift(int extension, int bits, Reg rm, u8 imm) {
+    REX(bits == 64, 0, 0, Index(rm));
+    Emit8(0xc1);
+    ModRM(extension, rm);
+    Emit8(imm);
+}
+
+void X64Emitter::ShiftCL(int extension, int bits, Reg rm) {
+    REX(bits == 64, 0, 0, Index(rm));
+    Emit8(0xd3);
+    ModRM(extension, rm);
+}
+
+void X64Emitter::SSE(u8 opcode, XMM dst, XMM src) {
+    Emit8(0x66);
+    REX(false, Index(dst), 0, Index(src));
+    Emit8(0x0f);
+    Emit8(opcode);
+    Emit8(0xc0 | ((Index(dst) & 0x7) << 3) | (Index(src) & 0x7));
+}
+
+} // namespace common
\ No newline at end of file
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "common/types.h"
+
+namespace common {
+
+// a small x86-64 assembler which only covers the encodings needed by our recompilers
+enum class Reg : u8 {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum class XMM : u8 {
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+};
+
+enum class Condition : u8 {
+    Overflow = 0x0,
+    NoOverflow = 0x1,
+    Below = 0x2,
+    AboveEqual = 0x3,
+    Equal = 0x4,
+    NotEqual = 0x5,
+    BelowEqual = 0x6,
+    Above = 0x7,
+    Sign = 0x8,
+    NoSign = 0x9,
+    Less = 0xc,
+    GreaterEqual = 0xd,
+    LessEqual = 0xe,
+    Greater = 0xf,
+};
+
+// a memory operand of the form [base + disp]
+struct Mem {
+    Reg base;
+    s32 disp;
+};
+
+class X64Emitter {
+public:
+    void SetCodePointer(u8* pointer) { code = pointer; }
+    u8* GetCodePointer() { return code; }
+
+    // operand size in bits is given as the first argument where it can vary
+    void MOV(int bits, Reg dst, Reg src);
+    void MOV(int bits, Reg dst, Mem src);
+    void MOV(int bits, Mem dst, Reg src);
+    void MOV(int bits, Mem dst, s32 imm);
+    void MOV(Reg dst, u64 imm);
+    void MOVSXD(Reg dst, Reg src);
+    void MOVZX8(Reg dst, Reg src);
+
+    // loads which extend into a 64 bit register, bits is the size of the memory operand
+    void MOVSX(int bits, Reg dst, Mem src);
+    void MOVZX(int bits, Reg dst, Mem src);
+
+    void ADD(int bits, Reg dst, Reg src) { ALU(0x01, bits, src, dst); }
+    void OR(int bits, Reg dst, Reg src) { ALU(0x09, bits, src, dst); }
+    void AND(int bits, Reg dst, Reg src) { ALU(0x21, bits, src, dst); }
+    void SUB(int bits, Reg dst, Reg src) { ALU(0x29, bits, src, dst); }
+    void XOR(int bits, Reg dst, Reg src) { ALU(0x31, bits, src, dst); }
+    void CMP(int bits, Reg dst, Reg src) { ALU(0x39, bits, src, dst); }
+
+    void ADD(int bits, Reg dst, Mem src) { ALU(0x03, bits, dst, src); }
+    void OR(int bits, Reg dst, Mem src) { ALU(0x0b, bits, dst, src); }
+    void AND(int bits, Reg dst, Mem src) { ALU(0x23, bits, dst, src); }
+    void SUB(int bits, Reg dst, Mem src) { ALU(0x2b, bits, dst, src); }
+    void XOR(int bits, Reg dst, Mem src) { ALU(0x33, bits, dst, src); }
+    void CMP(int bits, Reg dst, Mem src) { ALU(0x3b, bits, dst, src); }
+
+    void ADD(int bits, Reg dst, s32 imm) { ALUImm(0, bits, dst, imm); }
+    void OR(int bits, Reg dst, s32 imm) { ALUImm(1, bits, dst, imm); }
+    void AND(int bits, Reg dst, s32 imm) { ALUImm(4, bits, dst, imm); }
+    void SUB(int bits, Reg dst, s32 imm) { ALUImm(5, bits, dst, imm); }
+    void XOR(int bits, Reg dst, s32 imm) { ALUImm(6, bits, dst, imm); }
+    void CMP(int bits, Reg dst, s32 imm) { ALUImm(7, bits, dst, imm); }
+
+    void ADD(int bits, Mem dst, s32 imm) { ALUImm(0, bits, dst, imm); }
+    void SUB(int bits, Mem dst, s32 imm) { ALUImm(5, bits, dst, imm); }
+    void CMP(int bits, Mem dst, s32 imm) { ALUImm(7, bits, dst, imm); }
+
+    void TEST(int bits, Reg dst, Reg src);
+    void NOT(int bits, Reg dst);
+
+    void SHL(int bits, Reg dst, u8 imm) { Shift(4, bits, dst, imm); }
+    void SHR(int bits, Reg dst, u8 imm) { Shift(5, bits, dst, imm); }
+    void SAR(int bits, Reg dst, u8 imm) { Shift(7, bits, dst, imm); }
+
+    // shifts by cl
+    void SHL(int bits, Reg dst) { ShiftCL(4, bits, dst); }
+    void SHR(int bits, Reg dst) { ShiftCL(5, bits, dst); }
+    void SAR(int bits, Reg dst) { ShiftCL(7, bits, dst); }
+
+    void SETcc(Condition condition, Reg dst);
+
+    void PUSH(Reg reg);
+    void POP(Reg reg);
+    void RET();
+    void CALL(const void* function);
+
+    // jumps return the location of their rel32 so that they can be patched later
+    u8* JMP(const void* target = nullptr);
+    u8* Jcc(Condition condition, const void* target = nullptr);
+    void JMP(Reg reg);
+
+    // patches a previously emitted jump to go to target
+    static void SetJumpTarget(u8* rel32, const void* target);
+    void SetJumpTarget(u8* rel32) { SetJumpTarget(rel32, code); }
+
+    void MOVDQU(XMM dst, Mem src);
+    void MOVDQU(Mem dst, XMM src);
+
+    // packed sse2 integer operations of the form 66 0f <opcode> /r
+    void PADDB(XMM dst, XMM src) { SSE(0xfc, dst, src); }
+    void PADDW(XMM dst, XMM src) { SSE(0xfd, dst, src); }
+    void PADDD(XMM dst, XMM src) { SSE(0xfe, dst, src); }
+    void PSUBB(XMM dst, XMM src) { SSE(0xf8, dst, src); }
+    void PSUBW(XMM dst, XMM src) { SSE(0xf9, dst, src); }
+    void PSUBD(XMM dst, XMM src) { SSE(0xfa, dst, src); }
+    void PADDSB(XMM dst, XMM src) { SSE(0xec, dst, src); }
+    void PADDSW(XMM dst, XMM src) { SSE(0xed, dst, src); }
+    void PSUBSB(XMM dst, XMM src) { SSE(0xe8, dst, src); }
+    void PSUBSW(XMM dst, XMM src) { SSE(0xe9, dst, src); }
+    void PADDUSB(XMM dst, XMM src) { SSE(0xdc, dst, src); }
+    void PADDUSW(XMM dst, XMM src) { SSE(0xdd, dst, src); }
+    void PSUBUSB(XMM dst, XMM src) { SSE(0xd8, dst, src); }
+    void PSUBUSW(XMM dst, XMM src) { SSE(0xd9, dst, src); }
+    void PCMPEQB(XMM dst, XMM src) { SSE(0x74, dst, src); }
+    void PCMPEQW(XMM dst, XMM src) { SSE(0x75, dst, src); }
+    void PCMPEQD(XMM dst, XMM src) { SSE(0x76, dst, src); }
+    void PCMPGTB(XMM dst, XMM src) { SSE(0x64, dst, src); }
+    void PCMPGTW(XMM dst, XMM src) { SSE(0x65, dst, src); }
+    void PCMPGTD(XMM dst, XMM src) { SSE(0x66, dst, src); }
+    void PMAXSW(XMM dst, XMM src) { SSE(0xee, dst, src); }
+    void PMINSW(XMM dst, XMM src) { SSE(0xea, dst, src); }
+    void PAND(XMM dst, XMM src) { SSE(0xdb, dst, src); }
+    void POR(XMM dst, XMM src) { SSE(0xeb, dst, src); }
+    void PXOR(XMM dst, XMM src) { SSE(0xef, dst, src); }
+    void PUNPCKLQDQ(XMM dst, XMM src) { SSE(0x6c, dst, src); }
+    void PUNPCKHQDQ(XMM dst, XMM src) { SSE(0x6d, dst, src); }
+
+private:
+    void Emit8(u8 value) { *code++ = value; }
+    void Emit32(u32 value);
+    void Emit64(u64 value);
+
+    void REX(bool w, int reg, int index, int base, bool force = false);
+    void ModRM(int reg, Reg rm);
+    void ModRM(int reg, Mem rm);
+
+    void ALU(u8 opcode, int bits, Reg reg, Reg rm);
+    void ALU(u8 opcode, int bits, Reg reg, Mem rm);
+    void ALUImm(int extension, int bits, Reg rm, s32 imm);
+    void ALUImm(int extension, int bits, Mem rm, s32 imm);
+    void Shift(int extension, int bits, Reg rm, u8 imm);
+    void ShiftCL(int extension, int bits, Reg rm);
+    void SSE(u8 opcode, XMM dst, XMM src);
+
+    u8* code = nullptr;
+};
+
+} // namespace common
\ No newline at end of file
@@ -38,4 +38,59 @@ void Core::Boot() {
     SetState(CoreState::Idle);
     system.Reset();
     SetState(CoreState::Running);
+}
+
+void Core::SetExecutorType(ee::ExecutorType type) {
+    // the executor can only be switched in between frames
+    bool running = state == CoreState::Running;
+    if (running) {
+        emu_thread.Stop();
+    }
+
+    system.ee.SetExecutorType(type);
+
+    if (running) {
+        emu_thread.Start();
+    }
+}
+
+void Core::SetSyncQuantum(int cycles) {
+    bool running = state == CoreState::Running;
+    if (running) {
+        emu_thread.Stop();
+    }
+
+    system.sync_quantum = cycles;
+
+    if (running) {
+        emu_thread.Start();
+    }
+}
+
+void Core::SetRendererThreads(int count) {
+    bool running = state == CoreState::Running;
+    if (running) {
+        emu_thread.Stop();
+    }
+
+    // the gs thread can still be working through the last frame
+    system.gs_thread.Sync();
+    system.gs.SetRendererThreads(count);
+
+    if (running) {
+        emu_thread.Start();
+    }
+}
+
+void Core::SetGSThread(bool enabled) {
+    bool running = state == CoreState::Running;
+    if (running) {
+        emu_thread.Stop();
+    }
+
+    system.gs_thread.SetEnabled(enabled);
+
+    if (running) {
+        emu_thread.Start();
+    }
 }
\ No newline at end of file
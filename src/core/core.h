@@ -20,6 +20,10 @@ public:
     void RunFrame();
     void SetBootParameters(BootMode boot_mode, std::string path = "");
     void Boot();
+    void SetExecutorType(ee::ExecutorType type);
+    void SetSyncQuantum(int cycles);
+    void SetRendererThreads(int count);
+    void SetGSThread(bool enabled);
 
     System system;
     
@@ -0,0 +1,125 @@
+#include "common/log.h"
+#include "core/ee/cached_interpreter.h"
+#include "core/ee/context.h"
+
+namespace ee {
+
+CachedInterpreter::CachedInterpreter(Context& ctx) : Interpreter(ctx) {
+    page_blocks.resize(Context::PHYSICAL_PAGE_COUNT);
+}
+
+void CachedInterpreter::Reset() {
+    Interpreter::Reset();
+
+    blocks.clear();
+
+    for (auto& page : page_blocks) {
+        page.clear();
+    }
+
+    block_invalidated = false;
+}
+
+void CachedInterpreter::Run(int cycles) {
+    while (cycles > 0) {
+        Block& block = GetBlock(ctx.pc);
+        int length = block.instructions.size();
+        u32 pc = block.start;
+
+        block_invalidated = false;
+
+        for (int i = 0; i < length; i++) {
+            CachedInstruction& cached = block.instructions[i];
+
+            inst = cached.inst;
+            (this->*cached.handler)();
+            ctx.pc += 4;
+            pc += 4;
+
+            if (branch_delay) {
+                if (branch) {
+                    ctx.pc = ctx.npc;
+                    branch_delay = false;
+                    branch = false;
+                } else {
+                    branch = true;
+                }
+            }
+
+            if (ctx.cop0.interrupt_pending) {
+                CheckInterrupts();
+            }
+
+            cycles--;
+
+            // leave the block if control flow diverged (taken branch, exception, skipped likely delay slot),
+            // if the block was freed by a write to its own page or if we ran out of cycles.
+            // the block can't be touched after an invalidation
+            if (block_invalidated || ctx.pc != pc || cycles == 0) {
+                break;
+            }
+        }
+    }
+}
+
+void CachedInterpreter::InvalidatePage(int page) {
+    for (u32 pc : page_blocks[page]) {
+        blocks.erase(pc);
+    }
+
+    page_blocks[page].clear();
+    block_invalidated = true;
+}
+
+CachedInterpreter::Block& CachedInterpreter::GetBlock(u32 pc) {
+    auto it = blocks.find(pc);
+    if (it != blocks.end()) {
+        return it->second;
+    }
+
+    return CompileBlock(pc);
+}
+
+CachedInterpreter::Block& CachedInterpreter::CompileBlock(u32 pc) {
+    Block& block = blocks[pc];
+    u32 addr = pc;
+
+    block.start = pc;
+    block.instructions.reserve(MAX_BLOCK_SIZE + 1);
+
+    for (int i = 0; i < MAX_BLOCK_SIZE; i++) {
+        Instruction instruction = Instruction{ctx.read<u32>(addr)};
+        block.instructions.push_back({decoder.GetHandler(instruction), instruction});
+        addr += 4;
+
+        if (IsBranch(instruction)) {
+            // always keep the delay slot together with its branch
+            Instruction delay_slot = Instruction{ctx.read<u32>(addr)};
+            block.instructions.push_back({decoder.GetHandler(delay_slot), delay_slot});
+            addr += 4;
+            break;
+        }
+
+        if (EndsBlock(instruction) || (addr & 0xfff) == 0) {
+            break;
+        }
+    }
+
+    RegisterBlockPage(pc, pc);
+
+    if (((addr - 4) >> 12) != (pc >> 12)) {
+        RegisterBlockPage(pc, addr - 4);
+    }
+
+    return block;
+}
+
+void CachedInterpreter::RegisterBlockPage(u32 pc, u32 addr) {
+    int page = ctx.MarkCodePage(addr);
+
+    if (page >= 0) {
+        page_blocks[page].push_back(pc);
+    }
+}
+
+} // namespace ee
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include "core/ee/interpreter.h"
+
+namespace ee {
+
+struct Context;
+
+// an interpreter which decodes each basic block once and then replays the
+// already resolved handlers, instead of fetching and decoding every instruction
+struct CachedInterpreter : public Interpreter {
+    CachedInterpreter(Context& ctx);
+
+    void Reset() override;
+    void Run(int cycles) override;
+    void InvalidatePage(int page) override;
+
+private:
+    using Handler = decltype(&Interpreter::illegal_instruction);
+
+    struct CachedInstruction {
+        Handler handler;
+        Instruction inst;
+    };
+
+    struct Block {
+        u32 start;
+        std::vector<CachedInstruction> instructions;
+    };
+
+    Block& GetBlock(u32 pc);
+    Block& CompileBlock(u32 pc);
+    void RegisterBlockPage(u32 pc, u32 addr);
+
+    static constexpr int MAX_BLOCK_SIZE = 64;
+
+    std::unordered_map<u32, Block> blocks;
+    std::vector<std::vector<u32>> page_blocks;
+    bool block_invalidated;
+};
+
+} // namespace ee
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <array>
+#include <cstring>
 #include "common/log.h"
 #include "common/memory.h"
 #include "core/ee/context.h"
@@ -49,8 +50,11 @@ static std::array<std::string, 256> syscall_info = {
     "Deci2Call", "PSMode", "MachineType", "GetMemorySize",
 };
 
-Context::Context(System& system) : dmac(system), timers(intc), intc(*this), system(system), interpreter(*this) {
-    m_rdram = std::make_unique<std::array<u8, 0x2000000>>();
+Context::Context(System& system) : cop0(system.scheduler), dmac(system), timers(intc, system.scheduler), intc(*this), system(system), interpreter(*this), cached_interpreter(*this), jit(*this), io("ee::Context") {
+    MapIO();
+    m_rdram = std::make_unique<common::SharedMemory>(0x2000000);
+    m_scratchpad = std::make_unique<common::SharedMemory>(0x4000);
+    executor = &interpreter;
 }
 
 void Context::Reset() {
@@ -63,8 +67,8 @@ void Context::Reset() {
     lo1 = 0;
     sa = 0;
     
-    m_rdram->fill(0);
-    m_scratchpad.fill(0);
+    std::memset(m_rdram->data(), 0, m_rdram->size());
+    std::memset(m_scratchpad->data(), 0, m_scratchpad->size());
 
     mch_drd = 0;
     rdram_sdevid = 0;
@@ -76,29 +80,41 @@ void Context::Reset() {
     timers.Reset();
     intc.Reset();
     interpreter.Reset();
+    cached_interpreter.Reset();
+    jit.Reset();
 
     // do initial hardcoded mappings
     vtlb.Reset();
-    vtlb.Map(m_rdram->data(), 0x00000000, 0x2000000, 0x1ffffff);
-    vtlb.Map(m_rdram->data(), 0x20000000, 0x2000000, 0x1ffffff);
-    vtlb.Map(m_rdram->data(), 0x30100000, 0x2000000, 0x1ffffff);
-    vtlb.Map(m_scratchpad.data(), 0x70000000, 0x4000, 0x3fff);
-    vtlb.Map(m_rdram->data(), 0x80000000, 0x2000000, 0x1ffffff);
-    vtlb.Map(system.bios->data(), 0x9fc00000, 0x400000, 0x3fffff);
-    vtlb.Map(m_rdram->data(), 0xa0000000, 0x2000000, 0x1ffffff);
-    vtlb.Map(system.bios->data(), 0xbfc00000, 0x400000, 0x3fffff);
+    fastmem.Reset();
+    MapMemory(*m_rdram, 0x00000000, 0x2000000, 0x1ffffff);
+    MapMemory(*m_rdram, 0x20000000, 0x2000000, 0x1ffffff);
+    MapMemory(*m_rdram, 0x30100000, 0x2000000, 0x1ffffff);
+    MapMemory(*m_scratchpad, 0x70000000, 0x4000, 0x3fff);
+    MapMemory(*m_rdram, 0x80000000, 0x2000000, 0x1ffffff);
+    MapMemory(*system.bios, 0x9fc00000, 0x400000, 0x3fffff);
+    MapMemory(*m_rdram, 0xa0000000, 0x2000000, 0x1ffffff);
+    MapMemory(*system.bios, 0xbfc00000, 0x400000, 0x3fffff);
 
     // deci2call tlb region which gets mapped in the bios
     // later when we handle the tlb we can remove this mapping
-    vtlb.Map(m_rdram->data(), 0xffff8000, 0x8000, 0x7ffff);
+    MapMemory(*m_rdram, 0xffff8000, 0x8000, 0x7ffff);
+
+    // build the list of virtual pages mirroring each physical page
+    code_pages.fill(0);
+    page_aliases.assign(PHYSICAL_PAGE_COUNT, {});
+    page_generations.fill(0);
+
+    for (u32 page = 0; page < code_pages.size(); page++) {
+        int physical_page = GetPhysicalPage(page << 12);
+        if (physical_page >= 0) {
+            page_aliases[physical_page].push_back(page);
+        }
+    }
 }
 
 void Context::Run(int cycles) {
-    interpreter.Run(cycles);
-
-    // timers and dmac run at half the speed of the ee (bus speed)
-    timers.Run(cycles / 2);
-    dmac.Run(cycles / 2);
+    executor->Run(cycles);
+    dmac.Run();
 }
 
 template u8 Context::read(VirtualAddress vaddr);
@@ -110,7 +126,7 @@ T Context::read(VirtualAddress vaddr) {
     if (pointer) {
         return common::Read<T>(pointer);
     } else {
-        return ReadIO(vaddr & 0x1fffffff);
+        return io.Read(vaddr & 0x1fffffff);
     }
 }
 
@@ -121,7 +137,7 @@ u64 Context::read<u64>(VirtualAddress vaddr) {
         return common::Read<u64>(pointer);
     } else {
         u32 paddr = vaddr & 0x1fffffff;
-        return (static_cast<u64>(ReadIO(paddr + 4)) << 32) | ReadIO(paddr);
+        return (static_cast<u64>(io.Read(paddr + 4)) << 32) | io.Read(paddr);
     }
 }
 
@@ -134,7 +150,7 @@ u128 Context::read<u128>(VirtualAddress vaddr) {
         u32 paddr = vaddr & 0x1fffffff;
         u128 value;
         for (int i = 0; i < 4; i++) {
-            value.uw[i] = ReadIO(paddr + (i * 4));
+            value.uw[i] = io.Read(paddr + (i * 4));
         }
 
         return value;
@@ -148,9 +164,13 @@ template <typename T>
 void Context::write(VirtualAddress vaddr, T value) {
     auto pointer = vtlb.Lookup<T>(vaddr);
     if (pointer) {
-        return common::Write<T>(pointer, value);
+        common::Write<T>(pointer, value);
+
+        if (code_pages[vaddr >> 12]) {
+            InvalidateCode(vaddr);
+        }
     } else {
-        WriteIO(vaddr & 0x1fffffff, value);
+        io.Write(vaddr & 0x1fffffff, value);
     }
 }
 
@@ -158,11 +178,15 @@ template <>
 void Context::write<u64>(VirtualAddress vaddr, u64 value) {
     auto pointer = vtlb.Lookup<u64>(vaddr);
     if (pointer) {
-        return common::Write<u64>(pointer, value);
+        common::Write<u64>(pointer, value);
+
+        if (code_pages[vaddr >> 12]) {
+            InvalidateCode(vaddr);
+        }
     } else {
         u32 paddr = vaddr & 0x1fffffff;
-        WriteIO(paddr, value & 0xffffffff);
-        WriteIO(paddr + 4, value >> 32);
+        io.Write(paddr, value & 0xffffffff);
+        io.Write(paddr + 4, value >> 32);
     }
 }
 
@@ -170,59 +194,64 @@ template <>
 void Context::write<u128>(VirtualAddress vaddr, u128 value) {
     auto pointer = vtlb.Lookup<u128>(vaddr);
     if (pointer) {
-        return common::Write<u128>(pointer, value);
+        common::Write<u128>(pointer, value);
+
+        if (code_pages[vaddr >> 12]) {
+            InvalidateCode(vaddr);
+        }
     } else {
         u32 paddr = vaddr & 0x1fffffff;
         for (int i = 0; i < 4; i++) {
-            WriteIO(paddr + (i * 4), value.uw[i]);
+            io.Write(paddr + (i * 4), value.uw[i]);
         }
     }
 }
 
-u32 Context::ReadIO(u32 paddr) {
-    if (paddr >= 0x10000000 && paddr < 0x10001840) {
-        return timers.ReadRegister(paddr);
-    } else if (paddr >= 0x12000000 && paddr < 0x12001084) {
-        return system.gs.ReadRegisterPrivileged(paddr);
-    } else if (paddr >= 0x10008000 && paddr < 0x1000e000) {
-        return dmac.ReadChannel(paddr);
-    } else if (paddr >= 0x10003000 && paddr < 0x100030a4) {
-        return system.gif.ReadRegister(paddr);
-    }
+void Context::MapMemory(common::SharedMemory& memory, VirtualAddress base, u32 size, u32 mask) {
+    vtlb.Map(memory.data(), base, size, mask);
+    fastmem.Map(memory, base, size, mask);
+}
 
-    switch (paddr) {
-    case 0x10002010:
-        return system.ipu.ReadControl();
-    case 0x1000E000:
-        return dmac.ReadControl();
-    case 0x1000E010:
-        return dmac.ReadInterruptStatus();
-    case 0x1000E020:
-        return dmac.ReadPriorityControl();
-    case 0x1000E030:
-        return dmac.ReadPriorityControl();
-    case 0x1000F000:
-        return intc.ReadStat();
-    case 0x1000F010:
-        return intc.ReadMask();
-    case 0x1000F130:
+void Context::MapIO() {
+    timers.RegisterIO(io);
+    system.gs_thread.RegisterIO(io);
+    system.gif.RegisterIO(io);
+    dmac.RegisterIO(io);
+    system.vu0.RegisterIO(io, 0x11000000, 0x11004000, 0x1000);
+    system.vu1.RegisterIO(io, 0x11008000, 0x1100c000, 0x4000);
+    system.ipu.RegisterIO(io);
+    system.vif0.RegisterIO(io, 0);
+    system.vif1.RegisterIO(io, 1);
+    intc.RegisterIO(io);
+
+    io.MapRead(0x1000f130, this, [](Context*, u32) -> u32 {
         return 0;
-    case 0x1000F200:
-        return system.sif.ReadMSCOM();
-    case 0x1000F210:
-        return system.sif.ReadSMCOM();
-    case 0x1000F220:
-        return system.sif.ReadMSFLAG();
-    case 0x1000F230:
-        return system.sif.ReadSMFLAG();
-    case 0x1000f430:
+    });
+
+    io.MapWrite(0x1000f180, this, [](Context*, u32, u32 value) {
+        // kputchar
+        common::LogNoNewline("%c", value);
+    });
+
+    system.sif.RegisterEEIO(io);
+
+    // rdram initialisation
+    io.Map(0x1000f430, this, [](Context*, u32) -> u32 {
         return 0;
-    case 0x1000F440:
-        if (!((mch_ricm >> 6) & 0xF)) {
-            switch ((mch_ricm >> 16) & 0xFFF) {
+    }, [](Context* ctx, u32, u32 value) {
+        if ((((value >> 16) & 0xFFF) == 0x21) && (((value >> 6) & 0xF) == 1) && (((ctx->mch_drd >> 7) & 1) == 0)) {
+            ctx->rdram_sdevid = 0;
+        }
+
+        ctx->mch_ricm = value & ~0x80000000;
+    });
+
+    io.Map(0x1000f440, this, [](Context* ctx, u32) -> u32 {
+        if (!((ctx->mch_ricm >> 6) & 0xF)) {
+            switch ((ctx->mch_ricm >> 16) & 0xFFF) {
             case 0x21:
-                if (rdram_sdevid < 2) {
-                    rdram_sdevid++;
+                if (ctx->rdram_sdevid < 2) {
+                    ctx->rdram_sdevid++;
                     return 0x1F;
                 }
                 return 0;
@@ -231,112 +260,192 @@ u32 Context::ReadIO(u32 paddr) {
             case 0x24:
                 return 0x0090;
             case 0x40:
-                return mch_ricm & 0x1F;
+                return ctx->mch_ricm & 0x1F;
             }
         }
 
+        return 0;
+    }, [](Context* ctx, u32, u32 value) {
+        ctx->mch_drd = value;
+    });
+}
+
+void Context::SetExecutorType(ExecutorType type) {
+    if (type == executor_type) {
+        return;
+    }
+
+    // finish any pending branch so that no delay slot state is lost in the switch
+    while (executor->InBranchDelay()) {
+        executor->Run(1);
+    }
+
+    switch (type) {
+    case ExecutorType::Interpreter:
+        executor = &interpreter;
+        break;
+    case ExecutorType::CachedInterpreter:
+        executor = &cached_interpreter;
+        break;
+    case ExecutorType::JIT:
+#if defined(__x86_64__) || defined(_M_X64)
+        executor = &jit;
+#else
+        common::Warn("[ee::Context] the jit is only supported on x86-64, using the cached interpreter instead");
+        executor = &cached_interpreter;
+        type = ExecutorType::CachedInterpreter;
+#endif
         break;
-    case 0x1000f520:
-        return dmac.disabled_status;
-    default:
-        common::Log("[ee::Context] handle io read %08x", paddr);
     }
 
-    return 0;
+    // the dmac watches the pages its cached chains read tags from with the same code pages, and
+    // once a page isn't watched its writes no longer bump its generation. so bump the generation
+    // of every watched page first, which throws away any chain cached from it
+    for (int page = 0; page < PHYSICAL_PAGE_COUNT; page++) {
+        if (!page_aliases[page].empty() && code_pages[page_aliases[page][0]]) {
+            page_generations[page]++;
+        }
+    }
+
+    executor->Reset();
+    code_pages.fill(0);
+    executor_type = type;
 }
 
-void Context::WriteIO(u32 paddr, u32 value) {
-    if (paddr >= 0x10000000 && paddr < 0x10001840) {
-        timers.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x12000000 && paddr < 0x12001084) {
-        system.gs.WriteRegisterPrivileged(paddr, value);
-        return;
-    } else if (paddr >= 0x10008000 && paddr < 0x1000e054) {
-        dmac.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1000f520 && paddr < 0x1000f594) {
-        dmac.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x11000000 && paddr < 0x11001000) {
-        system.vu0.WriteCodeMemory(paddr, value);
-        return;
-    } else if (paddr >= 0x11004000 && paddr < 0x11005000) {
-        system.vu0.WriteDataMemory(paddr, value);
-        return;
-    } else if (paddr >= 0x11008000 && paddr < 0x1100c000) {
-        system.vu1.WriteCodeMemory(paddr, value);
+int Context::GetPhysicalPage(VirtualAddress vaddr) {
+    u8* pointer = vtlb.Lookup<u8>(vaddr);
+    if (pointer >= rdram() && pointer < rdram() + 0x2000000) {
+        return (pointer - rdram()) >> 12;
+    } else if (pointer >= scratchpad() && pointer < scratchpad() + 0x4000) {
+        return (0x2000000 + (pointer - scratchpad())) >> 12;
+    }
+
+    // the bios is read only, so code from it never needs invalidating
+    return -1;
+}
+
+int Context::MarkCodePage(VirtualAddress vaddr) {
+    int page = GetPhysicalPage(vaddr);
+    if (page >= 0) {
+        WatchPhysicalPage(page);
+    }
+
+    return page;
+}
+
+void Context::WatchPhysicalPage(int page) {
+    for (u32 alias : page_aliases[page]) {
+        code_pages[alias] = 1;
+    }
+}
+
+void Context::InvalidateCode(VirtualAddress vaddr) {
+    InvalidatePhysicalPage(GetPhysicalPage(vaddr));
+}
+
+void Context::InvalidatePhysicalPage(int page) {
+    for (u32 alias : page_aliases[page]) {
+        code_pages[alias] = 0;
+    }
+
+    page_generations[page]++;
+
+    executor->InvalidatePage(page);
+}
+
+std::span<u8> Context::GetPhysicalSpan(u32 paddr, u32 size) {
+    struct Region {
+        u32 start;
+        u32 size;
+        u8* data;
+    };
+
+    if (paddr & (1u << 31)) {
+        u32 offset = paddr & 0x3fff;
+        if (offset + size <= 0x4000) {
+            return {scratchpad() + offset, size};
+        }
+
+        return {};
+    }
+
+    const Region regions[] = {
+        {0x00000000, 0x2000000, rdram()},
+        {0x11000000, 0x1000, system.vu0.GetCodeMemory()},
+        {0x11004000, 0x1000, system.vu0.GetDataMemory()},
+        {0x11008000, 0x4000, system.vu1.GetCodeMemory()},
+        {0x1100c000, 0x4000, system.vu1.GetDataMemory()},
+        {0x1c000000, 0x200000, system.iop_ram->data()},
+    };
+
+    paddr &= 0x1fffffff;
+    for (const Region& region : regions) {
+        if (paddr >= region.start && paddr - region.start + size <= region.size) {
+            return {region.data + (paddr - region.start), size};
+        }
+    }
+
+    return {};
+}
+
+void Context::ReadPhysical(u32 paddr, void* data, u32 size) {
+    auto span = GetPhysicalSpan(paddr, size);
+    if (!span.empty()) {
+        std::memcpy(data, span.data(), size);
         return;
-    } else if (paddr >= 0x1100c000 && paddr < 0x11010000) {
-        system.vu1.WriteDataMemory(paddr, value);
+    }
+
+    // mmio, or a range which crosses between regions, is done a word at a time
+    u8* bytes = reinterpret_cast<u8*>(data);
+    for (u32 offset = 0; offset < size; offset += 4) {
+        auto word = GetPhysicalSpan(paddr + offset, 4);
+        u32 value = word.empty() ? io.Read((paddr + offset) & 0x1fffffff) : common::Read<u32>(word.data());
+        std::memcpy(bytes + offset, &value, std::min<u32>(4, size - offset));
+    }
+}
+
+void Context::WritePhysical(u32 paddr, const void* data, u32 size) {
+    auto span = GetPhysicalSpan(paddr, size);
+    if (!span.empty()) {
+        std::memcpy(span.data(), data, size);
+        InvalidatePhysicalRange(paddr, size);
         return;
-    } else if (paddr >= 0x10003000 && paddr < 0x100030a4) {
-        system.gif.WriteRegister(paddr, value);
+    }
+
+    const u8* bytes = reinterpret_cast<const u8*>(data);
+    for (u32 offset = 0; offset < size; offset += 4) {
+        u32 value = 0;
+        std::memcpy(&value, bytes + offset, std::min<u32>(4, size - offset));
+
+        auto word = GetPhysicalSpan(paddr + offset, 4);
+        if (word.empty()) {
+            io.Write((paddr + offset) & 0x1fffffff, value);
+        } else {
+            common::Write<u32>(word.data(), value);
+            InvalidatePhysicalRange(paddr + offset, 4);
+        }
+    }
+}
+
+void Context::InvalidatePhysicalRange(u32 paddr, u32 size) {
+    if (size == 0) {
         return;
-    } else if (paddr >= 0x10006000 && paddr < 0x10006010) {
-        system.gif.WriteRegister(paddr, value);
+    }
+
+    // only rdram and scratchpad pages are watched
+    u32 base;
+    if (paddr & (1u << 31)) {
+        base = 0x2000000 + (paddr & 0x3fff);
+    } else if ((paddr & 0x1fffffff) < 0x2000000) {
+        base = paddr & 0x1fffffff;
+    } else {
         return;
     }
 
-    switch (paddr) {
-    case 0x10002000:
-        system.ipu.WriteCommand(value);
-        break;
-    case 0x10002010:
-        system.ipu.WriteControl(value);
-        break;
-    case 0x10003810:
-        system.vif0.WriteFBRST(value);
-        break;
-    case 0x10003820:
-        system.vif0.WriteERR(value);
-        break;
-    case 0x10003830:
-        system.vif0.WriteMark(value);
-        break;
-    case 0x10003C00:
-        system.vif1.WriteStat(value);
-        break;
-    case 0x10003C10:
-        system.vif1.WriteFBRST(value);
-        break;
-    case 0x1000F000:
-        intc.WriteStat(value);
-        break;
-    case 0x1000F010:
-        intc.WriteMask(value);
-        break;
-    case 0x1000F180:
-        // kputchar
-        common::LogNoNewline("%c", value);
-        break;
-    case 0x1000F200:
-        system.sif.WriteMSCOM(value);
-        break;
-    case 0x1000F220:
-        system.sif.SetMSFLAG(value);
-        break;
-    case 0x1000F230:
-        system.sif.SetSMFLAG(value);
-        break;
-    case 0x1000F240:
-        system.sif.WriteEEControl(value);
-        break;
-    case 0x1000F260:
-        system.sif.WriteBD6(value);
-        break;
-    case 0x1000F430:
-        if ((((value >> 16) & 0xFFF) == 0x21) && (((value >> 6) & 0xF) == 1) && (((mch_drd >> 7) & 1) == 0)) {
-            rdram_sdevid = 0;
+    for (u32 page = base >> 12; page <= (base + size - 1) >> 12; page++) {
+        if (!page_aliases[page].empty() && code_pages[page_aliases[page][0]]) {
+            InvalidatePhysicalPage(page);
         }
-                
-        mch_ricm = value & ~0x80000000;
-        break;
-    case 0x1000F440:
-        mch_drd = value;
-        break;
-    default:
-        common::Log("[ee::Context] handle io write %08x = %08x", paddr, value);
     }
 }
 
@@ -2,15 +2,21 @@
 
 #include <string>
 #include <array>
+#include <vector>
 #include <memory>
+#include <span>
 #include "common/types.h"
 #include "common/virtual_page_table.h"
+#include "common/fastmem.h"
+#include "common/io_map.h"
 #include "core/ee/cop0.h"
 #include "core/ee/cop1.h"
 #include "core/ee/dmac.h"
 #include "core/ee/timers.h"
 #include "core/ee/intc.h"
 #include "core/ee/interpreter.h"
+#include "core/ee/cached_interpreter.h"
+#include "core/ee/jit.h"
 
 struct System;
 
@@ -22,8 +28,16 @@ struct Context {
     void Reset();
     void Run(int cycles);
 
+    void SetExecutorType(ExecutorType type);
+    ExecutorType GetExecutorType() { return executor_type; }
+    bool IsIdle() { return executor->IsIdle(); }
+    u64 GetIdleCycles() { return executor->GetIdleCycles(); }
+
     u8* rdram() { return m_rdram->data(); }
-    u8* scratchpad() { return m_scratchpad.data(); }
+    u8* scratchpad() { return m_scratchpad->data(); }
+
+    // base of the host mirror of the ee address space, or nullptr if fastmem is unavailable
+    u8* GetFastmemBase() { return fastmem.GetBase(); }
 
     // credit goes to DobieStation for the elegant way of accessing 128 bit registers
     template <typename T>
@@ -47,6 +61,34 @@ struct Context {
     void RaiseInterrupt(int signal, bool value);
     std::string GetSyscallInfo(int index);
 
+    // rdram and scratchpad are tracked in 4kb physical pages, so that a write through
+    // any mirror of a page can invalidate code that was cached from it
+    static constexpr int PHYSICAL_PAGE_COUNT = (0x2000000 + 0x4000) >> 12;
+
+    // whether an address is backed by memory rather than io
+    bool IsMemory(VirtualAddress vaddr) { return vtlb.Lookup<u8>(vaddr); }
+
+    int GetPhysicalPage(VirtualAddress vaddr);
+    int MarkCodePage(VirtualAddress vaddr);
+    void InvalidateCode(VirtualAddress vaddr);
+    u8* GetCodePages() { return code_pages.data(); }
+
+    // the physical bus, for dma and other bulk transfers which skip the tlb. like dma addresses,
+    // bit 31 selects scratchpad. spans are only returned for ranges which are contiguous in host
+    // memory, so an empty span means the range has to go through the fallback path instead
+    std::span<u8> GetPhysicalSpan(u32 paddr, u32 size);
+    void ReadPhysical(u32 paddr, void* data, u32 size);
+    void WritePhysical(u32 paddr, const void* data, u32 size);
+
+    // must be called after writing to rdram or scratchpad through a span
+    void InvalidatePhysicalRange(u32 paddr, u32 size);
+
+    // watched pages go through the same write checks as pages with cached code. the first write
+    // to a watched page bumps its generation and stops watching it, so anything derived from the
+    // page can tell whether it's still valid
+    void WatchPhysicalPage(int page);
+    u32 GetPageGeneration(int page) { return page_generations[page]; }
+
     std::array<u8, 512> gpr;
     u32 pc = 0;
     u32 npc = 0;
@@ -65,11 +107,12 @@ struct Context {
     System& system;
 
 private:
-    u32 ReadIO(u32 paddr);
-    void WriteIO(u32 paddr, u32 value);
+    void MapIO();
+    void MapMemory(common::SharedMemory& memory, VirtualAddress base, u32 size, u32 mask);
+    void InvalidatePhysicalPage(int page);
     
-    std::unique_ptr<std::array<u8, 0x2000000>> m_rdram;
-    std::array<u8, 0x4000> m_scratchpad;
+    std::unique_ptr<common::SharedMemory> m_rdram;
+    std::unique_ptr<common::SharedMemory> m_scratchpad;
 
     // rdram initialisation registers
     u32 mch_drd;
@@ -77,7 +120,22 @@ private:
     u32 mch_ricm;
 
     common::VirtualPageTable vtlb;
+
+    // mirrors the mappings in the vtlb, for jitted loads and stores
+    common::FastmemArena fastmem;
+
+    // virtual pages which map a physical page containing cached code
+    std::array<u8, 0x100000> code_pages;
+    std::vector<std::vector<u32>> page_aliases;
+    std::array<u32, PHYSICAL_PAGE_COUNT> page_generations;
+
+    ExecutorType executor_type = ExecutorType::Interpreter;
+    Executor* executor;
     Interpreter interpreter;
+    CachedInterpreter cached_interpreter;
+    JIT jit;
+
+    common::IOMap io;
 };
 
 } // namespace ee
\ No newline at end of file
@@ -27,6 +27,10 @@ enum COP0Regs {
     ErrorEPC = 30,
 };
 
+COP0::COP0(Scheduler& scheduler) : scheduler(scheduler) {
+    scheduler.RegisterEvent(EventType::COP0Compare, &CompareEvent);
+}
+
 void COP0::Reset() {
     for (int i = 0; i < 32; i++) {
         gpr[i] = 0;
@@ -35,13 +39,19 @@ void COP0::Reset() {
     cause.data = 0;
     index = 0;
     gpr[PRId] = 0x2e20;
+    count_time = scheduler.GetCurrentTime();
+    interrupt_pending = false;
+
+    ScheduleCompareEvent();
 }
 
 u32 COP0::GetReg(int reg) {
     switch (reg) {
+    case 9:
+        return GetCount();
     case 13:
         return cause.data;
-    case 9: case 12: case 14: case 15: case 30:
+    case 12: case 14: case 15: case 30:
         return gpr[reg];
     default:
         common::Error("[ee::COP0] handle read r%d", reg);
@@ -63,9 +73,17 @@ void COP0::SetReg(int reg, u32 value) {
         common::Log("[ee::COP0] entrylo1 write %08x", value);
         gpr[reg] = value;
         break;
-    case 5: case 6: 
-    case 9: case 10: case 12: case 16:
+    case 5: case 6: case 10: case 16:
+        gpr[reg] = value;
+        break;
+    case 9:
+        gpr[reg] = value;
+        count_time = scheduler.GetCurrentTime();
+        ScheduleCompareEvent();
+        break;
+    case 12:
         gpr[reg] = value;
+        UpdateInterrupts();
         break;
     case 13:
         // cause can't be written to.
@@ -77,6 +95,8 @@ void COP0::SetReg(int reg, u32 value) {
         // in cause
         cause.timer_pending = false;
         gpr[reg] = value;
+        ScheduleCompareEvent();
+        UpdateInterrupts();
         break;
     case 14:
         // common::Log("[COP0] write EPC %08x", value);
@@ -87,12 +107,43 @@ void COP0::SetReg(int reg, u32 value) {
     }
 }
 
-void COP0::CountUp() {
-    gpr[Count]++;
+void COP0::UpdateInterrupts() {
+    bool ie = gpr[Status] & 0x1;
+    bool exl = (gpr[Status] >> 1) & 0x1;
+    bool erl = (gpr[Status] >> 2) & 0x1;
+    bool int0_enable = (gpr[Status] >> 10) & 0x1;
+    bool int1_enable = (gpr[Status] >> 11) & 0x1;
+    bool timer_enable = (gpr[Status] >> 15) & 0x1;
+    bool eie = (gpr[Status] >> 16) & 0x1;
 
-    if (gpr[Count] == gpr[Compare]) {
-        cause.timer_pending = true;
+    // timer interrupts aren't handled yet, but still let the executor see them
+    // so that they get reported
+    bool pending = (int0_enable && cause.int0_pending) || (int1_enable && cause.int1_pending) || timer_enable;
+    interrupt_pending = ie && eie && !exl && !erl && pending;
+}
+
+u32 COP0::GetCount() {
+    return gpr[Count] + (scheduler.GetCurrentTime() - count_time);
+}
+
+void COP0::ScheduleCompareEvent() {
+    // when count already equals compare the next match is after count wraps around
+    u64 delay = static_cast<u32>(gpr[Compare] - GetCount());
+    if (delay == 0) {
+        delay = 0x100000000;
     }
+
+    scheduler.Cancel(compare_event);
+    compare_event = scheduler.Add(delay, EventType::COP0Compare, this);
+}
+
+void COP0::CompareEvent(void* context, u64) {
+    auto cop0 = reinterpret_cast<COP0*>(context);
+    cop0->cause.timer_pending = true;
+    cop0->UpdateInterrupts();
+
+    // count matches compare again once it wraps around
+    cop0->compare_event = cop0->scheduler.Add(0x100000000, EventType::COP0Compare, cop0);
 }
 
 } // namespace ee
\ No newline at end of file
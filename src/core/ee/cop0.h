@@ -3,17 +3,21 @@
 #include <array>
 #include "common/types.h"
 #include "common/log.h"
+#include "core/scheduler.h"
 
 namespace ee {
 
 class COP0 {
 public:
+    COP0(Scheduler& scheduler);
+
     void Reset();
 
     u32 GetReg(int reg);
     void SetReg(int reg, u32 data);
 
-    void CountUp();
+    // recomputes interrupt_pending, this must be called whenever status or cause change
+    void UpdateInterrupts();
 
     union Cause {
         struct {
@@ -44,11 +48,25 @@ public:
     Cause cause;
     std::array<u32, 32> gpr;
 
+    // set when an enabled interrupt is pending, so the executors
+    // only need to check a single flag after each instruction
+    bool interrupt_pending;
+
 private:
+    // count isn't incremented every cycle, instead it's derived from the scheduler
+    // time relative to when it was last written
+    u32 GetCount();
+    void ScheduleCompareEvent();
+    static void CompareEvent(void* context, u64);
+
     // structure of a tlb entry
     struct Entry {
 
     };
+
+    u64 count_time;
+    EventHandle compare_event;
+    Scheduler& scheduler;
 };
 
 } // namespace ee
\ No newline at end of file
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <array>
+#include <utility>
 #include <cassert>
 #include "common/log.h"
 #include "common/memory.h"
@@ -11,7 +14,9 @@ static const char* channel_names[10] = {
 
 namespace ee {
 
-DMAC::DMAC(System& system) : system(system) {}
+DMAC::DMAC(System& system) : system(system) {
+    system.scheduler.RegisterEvent(EventType::DMACTransferEnd, &EndTransferEvent);
+}
 
 void DMAC::Reset() {
     control = 0;
@@ -31,7 +36,48 @@ void DMAC::Reset() {
         channels[i].saved_tag_address1 = 0;
         channels[i].scratchpad_address = 0;
         channels[i].end_transfer = false;
+        channels[i].busy_until = 0;
+        channels[i].end_pending = false;
+        channels[i].chain_started = false;
+        channels[i].recording = false;
+        system.scheduler.Cancel(channels[i].end_event);
     }
+
+    chain_cache.clear();
+}
+
+void DMAC::RegisterIO(common::IOMap& io) {
+    io.MapRead(0x10008000, 0x1000e000, this, [](DMAC* dmac, u32 paddr) {
+        return dmac->ReadChannel(paddr);
+    });
+
+    io.MapWrite(0x10008000, 0x1000e054, this, [](DMAC* dmac, u32 paddr, u32 value) {
+        dmac->WriteRegister(paddr, value);
+    });
+
+    io.MapWrite(0x1000f520, 0x1000f594, this, [](DMAC* dmac, u32 paddr, u32 value) {
+        dmac->WriteRegister(paddr, value);
+    });
+
+    io.MapRead(0x1000e000, this, [](DMAC* dmac, u32) {
+        return dmac->ReadControl();
+    });
+
+    io.MapRead(0x1000e010, this, [](DMAC* dmac, u32) {
+        return dmac->ReadInterruptStatus();
+    });
+
+    io.MapRead(0x1000e020, this, [](DMAC* dmac, u32) {
+        return dmac->ReadPriorityControl();
+    });
+
+    io.MapRead(0x1000e030, this, [](DMAC* dmac, u32) {
+        return dmac->ReadPriorityControl();
+    });
+
+    io.MapRead(0x1000f520, this, [](DMAC* dmac, u32) {
+        return dmac->disabled_status;
+    });
 }
 
 u32 DMAC::ReadChannel(u32 addr) {
@@ -196,6 +242,11 @@ u32 DMAC::ReadSkipQuadword() {
 void DMAC::CheckInterruptSignal() {
     bool irq = false;
 
+    if ((interrupt_status & (1 << 14)) && (interrupt_status & (1 << 30))) {
+        common::Log("[ee::DMAC] mfifo empty interrupt sent");
+        irq = true;
+    }
+
     for (int i = 0; i < 10; i++) {
         if ((interrupt_status & (1 << i)) && (interrupt_status & (1 << (16 + i)))) {
             common::Log("[ee::DMAC] %s interrupt sent", channel_names[i]);
@@ -208,18 +259,19 @@ void DMAC::CheckInterruptSignal() {
 }
 
 // note:
-// dmac can transfer one quadword (16 bytes / 128 bits) per bus cycle
-void DMAC::Run(int cycles) {
+// dmac can transfer one quadword (16 bytes / 128 bits) per bus cycle.
+// instead of moving a quadword at a time, each channel moves a whole block in one go,
+// and then waits until the bus would have finished with it before doing anything else
+void DMAC::Run() {
     if (!(control & 0x1) || (disabled_status & (1 << 16))) {
         return;
     }
 
-    while (cycles--) {
-        for (int i = 0; i < 10; i++) {
-            auto& channel = channels[i];
-            if (channel.control.busy) {
-                Transfer(i);
-            }
+    u64 now = system.scheduler.GetCurrentTime();
+    for (int i = 0; i < 10; i++) {
+        auto& channel = channels[i];
+        if (channel.control.busy && !channel.end_pending && now >= channel.busy_until) {
+            Transfer(i);
         }
     }
 }
@@ -235,6 +287,9 @@ void DMAC::Transfer(int index) {
     case ChannelType::SIF1:
         do_sif1_transfer();
         break;
+    case ChannelType::FromSPR:
+        do_from_spr_transfer();
+        break;
     case ChannelType::ToSPR:
         do_to_spr_transfer();
         break;
@@ -246,14 +301,50 @@ void DMAC::Transfer(int index) {
 void DMAC::do_gif_transfer() {
     auto& channel = channels[2];
 
-    if (channel.quadword_count) {
-        u128 data = system.ee.read<u128>(channel.address);
+    if (channel.control.mode == Channel::Mode::Normal) {
+        SendGIFBlock();
 
-        system.gif.SendPath3(data);
-        channel.address += 16;
-        channel.quadword_count--;        
-    } else {
-        EndTransfer(2);
+        // the drain caught up with spr from, so wait for it to write the rest of the block
+        if (channel.quadword_count) {
+            return;
+        }
+
+        ScheduleEndTransfer(2);
+        return;
+    }
+
+    DoChainTransfer(2);
+}
+
+void DMAC::SendGIFBlock() {
+    auto& channel = channels[2];
+
+    while (channel.quadword_count) {
+        // in mfifo mode a block can wrap around the end of the ring, so it's sent in two parts
+        u32 quadwords = GetContiguousQuadwords(2, channel.address, channel.quadword_count);
+        if (!quadwords) {
+            break;
+        }
+
+        auto block = system.ee.GetPhysicalSpan(channel.address, quadwords * 16);
+        if (!block.empty()) {
+            system.gif.SendPath3(std::span<const u128>(reinterpret_cast<u128*>(block.data()), quadwords));
+        } else {
+            // the block isn't contiguous in host memory, so copy it out a chunk at a time
+            std::array<u128, 64> chunk;
+            for (u32 i = 0; i < quadwords; i += chunk.size()) {
+                u32 count = std::min<u32>(quadwords - i, chunk.size());
+                for (u32 j = 0; j < count; j++) {
+                    chunk[j] = read_u128(channel.address + ((i + j) * 16));
+                }
+
+                system.gif.SendPath3(std::span<const u128>(chunk.data(), count));
+            }
+        }
+
+        AddBusCost(2, quadwords);
+        channel.address = AdvanceAddress(2, channel.address, quadwords);
+        channel.quadword_count -= quadwords;
     }
 }
 
@@ -261,21 +352,24 @@ void DMAC::do_sif0_transfer() {
     auto& channel = channels[5];
 
     if (channel.quadword_count) {
-        // dmac can only transfer a quadword at a time
-        if (system.sif.GetSIF0FIFOSize() >= 4) {
-            for (int i = 0; i < 4; i++) {
-                u32 data = system.sif.ReadSIF0FIFO();
-
-                common::Log("[ee::DMAC] SIF0 reading data from fifo %08x", data);
-
-                system.ee.write<u32>(channel.address, data);
-                channel.address += 4;
+        // move as many whole quadwords as the iop has put in the fifo so far,
+        // straight from the fifo into memory
+        u32 quadwords = std::min<u32>(channel.quadword_count, system.sif.GetSIF0FIFOSize() / 4);
+        auto block = system.ee.GetPhysicalSpan(channel.address, quadwords * 16);
+        if (!block.empty()) {
+            system.sif.sif0_fifo.PopSpan(std::span<u32>(reinterpret_cast<u32*>(block.data()), quadwords * 4));
+            system.ee.InvalidatePhysicalRange(channel.address, quadwords * 16);
+        } else {
+            for (u32 i = 0; i < quadwords; i++) {
+                write_u128(channel.address + (i * 16), system.sif.sif0_fifo.PopValue<u128>());
             }
-
-            channel.quadword_count--;
         }
+
+        channel.address += quadwords * 16;
+        channel.quadword_count -= quadwords;
+        AddBusCost(5, quadwords);
     } else if (channel.end_transfer) {
-        EndTransfer(5);
+        ScheduleEndTransfer(5);
     } else {
         if (system.sif.GetSIF0FIFOSize() >= 2) {
             // form a dmatag
@@ -289,6 +383,7 @@ void DMAC::do_sif0_transfer() {
             channel.quadword_count = dma_tag & 0xFFFF;
             channel.address = (dma_tag >> 32) & 0xFFFFFFF0;
             channel.tag_address += 16;
+            AddBusCost(5, 1);
 
             // Update upper 16 bits of control with upper 16 bits of dma tag.
             channel.control.dmatag_upper = (dma_tag >> 16) & 0xffff;
@@ -302,23 +397,67 @@ void DMAC::do_sif0_transfer() {
 }
 
 void DMAC::do_sif1_transfer() {
+    DoChainTransfer(6);
+}
+
+void DMAC::SendSIF1Block() {
     auto& channel = channels[6];
+
     if (channel.quadword_count) {
-        // push data to the sif1 fifo
-        u128 data = system.ee.read<u128>(channel.address);
+        // push as many whole quadwords as there is space for in the sif1 fifo.
+        // the rest is pushed once the iop has made space
+        u32 quadwords = std::min<u32>(channel.quadword_count, system.sif.sif1_fifo.GetFree() / 4);
+        auto block = system.ee.GetPhysicalSpan(channel.address, quadwords * 16);
+        if (!block.empty()) {
+            system.sif.sif1_fifo.PushSpan(std::span<const u32>(reinterpret_cast<u32*>(block.data()), quadwords * 4));
+        } else {
+            for (u32 i = 0; i < quadwords; i++) {
+                system.sif.sif1_fifo.PushValue(read_u128(channel.address + (i * 16)));
+            }
+        }
 
-        common::Log("[ee::DMAC] SIF1 Fifo write %016lx%016lx dstat %08x", data.hi, data.lo, interrupt_status);
+        common::Log("[ee::DMAC] SIF1 Fifo write %d quadwords from %08x dstat %08x", quadwords, channel.address, interrupt_status);
 
-        system.sif.write_sif1_fifo(data);
+        AddBusCost(6, quadwords);
+        channel.address += quadwords * 16;
+        channel.quadword_count -= quadwords;
+    }
+}
 
-        // madr and qwc must be updated as the transfer proceeds
-        channel.address += 16;
-        channel.quadword_count--;
-    } else if (channel.end_transfer) {
-        EndTransfer(6);
-    } else {
-        DoSourceChain(6);
+void DMAC::do_from_spr_transfer() {
+    // Scratchpad is considered a peripheral, so if chain mode is enabled
+    // it's destination chain mode.
+    auto& channel = channels[8];
+
+    if (channel.control.mode != Channel::Mode::Normal) {
+        LOG_TODO_NO_ARGS("handle non-normal mode for from spr transfer");
+    }
+
+    // In mfifo mode the destination is the ring buffer, and the channel's
+    // address is where the next data will be written to the ring.
+    if (IsMFIFOEnabled()) {
+        channel.address = WrapMFIFO(channel.address);
     }
+
+    AddBusCost(8, channel.quadword_count);
+
+    while (channel.quadword_count) {
+        // Copy up to where either the scratchpad address or the ring wraps around.
+        u32 scratchpad_address = channel.scratchpad_address & 0x3ff0;
+        u32 quadwords = std::min(channel.quadword_count, (0x4000 - scratchpad_address) / 16);
+        quadwords = GetContiguousQuadwords(8, channel.address, quadwords);
+        u32 size = quadwords * 16;
+
+        auto source = system.ee.GetPhysicalSpan(scratchpad_address | (1u << 31), size);
+        system.ee.WritePhysical(channel.address, source.data(), size);
+
+        // Update channel registers
+        channel.address = AdvanceAddress(8, channel.address, quadwords);
+        channel.scratchpad_address += size;
+        channel.quadword_count -= quadwords;
+    }
+
+    ScheduleEndTransfer(8);
 }
 
 void DMAC::do_to_spr_transfer() {
@@ -338,20 +477,27 @@ void DMAC::do_to_spr_transfer() {
     }
 
     if (channel.quadword_count > 0) {
-        for (u32 i = 0; i < channel.quadword_count; i++) {
-            // Ensure the transfer address is in the physical address range.
-            u128 data = read_u128(channel.address & 0x7fffffff);
+        AddBusCost(9, channel.quadword_count);
 
-            // Select writes to scratchpad.
-            write_u128(channel.scratchpad_address | (1 << 31), data);
+        while (channel.quadword_count) {
+            // Copy up to where the scratchpad address wraps around.
+            u32 scratchpad_address = channel.scratchpad_address & 0x3ff0;
+            u32 quadwords = std::min(channel.quadword_count, (0x4000 - scratchpad_address) / 16);
+            u32 size = quadwords * 16;
+
+            // Ensure the transfer address is in the physical address range,
+            // and select scratchpad as the destination.
+            auto destination = system.ee.GetPhysicalSpan(scratchpad_address | (1u << 31), size);
+            system.ee.ReadPhysical(channel.address & 0x7fffffff, destination.data(), size);
+            system.ee.InvalidatePhysicalRange(scratchpad_address | (1u << 31), size);
 
             // Update channel registers
-            channel.address += 16;
-            channel.scratchpad_address += 16;
-            channel.quadword_count--;
+            channel.address += size;
+            channel.scratchpad_address += size;
+            channel.quadword_count -= quadwords;
         }
 
-        EndTransfer(9);
+        ScheduleEndTransfer(9);
     } else {
         LOG_TODO_NO_ARGS("handle to spr transfer with no quadword count");
     }
@@ -362,6 +508,14 @@ void DMAC::StartTransfer(int index) {
 
     // in normal mode we shouldn't worry about dmatag reading
     channels[index].end_transfer = channels[index].control.mode == Channel::Mode::Normal;
+
+    channels[index].chain_started = false;
+    channels[index].recording = false;
+
+    // a new transfer replaces any which is still waiting to end
+    system.scheduler.Cancel(channels[index].end_event);
+    channels[index].end_pending = false;
+    channels[index].busy_until = system.scheduler.GetCurrentTime();
 }
 
 void DMAC::EndTransfer(int index) {
@@ -376,9 +530,208 @@ void DMAC::EndTransfer(int index) {
     CheckInterruptSignal();
 }
 
+void DMAC::AddBusCost(int index, u32 quadwords) {
+    auto& channel = channels[index];
+    u64 now = system.scheduler.GetCurrentTime();
+    channel.busy_until = std::max(channel.busy_until, now) + (quadwords * EE_CYCLES_PER_QUADWORD);
+}
+
+void DMAC::ScheduleEndTransfer(int index) {
+    auto& channel = channels[index];
+    u64 now = system.scheduler.GetCurrentTime();
+    u64 delay = channel.busy_until > now ? channel.busy_until - now : 0;
+
+    channel.end_pending = true;
+    channel.end_event = system.scheduler.Add(delay, EventType::DMACTransferEnd, this, index);
+}
+
+void DMAC::EndTransferEvent(void* context, u64 index) {
+    auto dmac = reinterpret_cast<DMAC*>(context);
+    dmac->channels[index].end_pending = false;
+    dmac->EndTransfer(index);
+}
+
+void DMAC::DoChainTransfer(int index) {
+    auto& channel = channels[index];
+
+    if (!channel.chain_started) {
+        channel.chain_started = true;
+
+        if (ReplayChain(index)) {
+            return;
+        }
+
+        StartRecording(index);
+    }
+
+    // a chain segment is its dmatag followed by the data it points to.
+    // when draining the mfifo, keep going until the ring is empty
+    bool mfifo = IsMFIFODrain(index);
+
+    do {
+        if (!channel.quadword_count && !channel.end_transfer) {
+            if (mfifo && IsMFIFOEmpty(channel)) {
+                return;
+            }
+
+            DoSourceChain(index);
+            AddBusCost(index, 1);
+        }
+
+        if (channel.quadword_count && channel.recording) {
+            recordings[index].blocks.push_back({channel.address, channel.quadword_count});
+        }
+
+        SendBlock(index);
+
+        // the block couldn't be sent in full, so wait for the destination to make space
+        if (channel.quadword_count) {
+            return;
+        }
+
+        if (channel.end_transfer) {
+            FinishRecording(index);
+            ScheduleEndTransfer(index);
+            return;
+        }
+    } while (mfifo);
+}
+
+void DMAC::SendBlock(int index) {
+    switch (static_cast<ChannelType>(index)) {
+    case ChannelType::GIF:
+        SendGIFBlock();
+        break;
+    case ChannelType::SIF1:
+        SendSIF1Block();
+        break;
+    default:
+        common::Error("[ee::DMAC] %s handle sending a block", channel_names[index]);
+    }
+}
+
+bool DMAC::CanCacheChain(int index) {
+    auto& channel = channels[index];
+
+    // chains are only cached from their first tag, and they can't be replayed from the ring
+    // since its contents are always changing. sif1 can stall part way through a block when
+    // its fifo is full, so only gif chains are cached
+    if (index != static_cast<int>(ChannelType::GIF) || IsMFIFODrain(index)) {
+        return false;
+    }
+
+    return channel.control.mode == Channel::Mode::Chain && !channel.end_transfer && !channel.quadword_count && !channel.control.address_stack_pointer;
+}
+
+bool DMAC::ReplayChain(int index) {
+    auto& channel = channels[index];
+    if (!CanCacheChain(index)) {
+        return false;
+    }
+
+    auto it = chain_cache.find(channel.tag_address);
+    if (it == chain_cache.end()) {
+        return false;
+    }
+
+    CachedChain& chain = it->second;
+    if (chain.dmatag_irq != channel.control.dmatag_irq) {
+        return false;
+    }
+
+    for (auto& page : chain.pages) {
+        if (system.ee.GetPageGeneration(page.index) != page.generation) {
+            chain_cache.erase(it);
+            return false;
+        }
+    }
+
+    for (auto& block : chain.blocks) {
+        channel.address = block.address;
+        channel.quadword_count = block.quadword_count;
+        SendBlock(index);
+    }
+
+    AddBusCost(index, chain.tags);
+
+    channel.address = chain.address;
+    channel.tag_address = chain.tag_address;
+    channel.saved_tag_address0 = chain.saved_tag_address0;
+    channel.saved_tag_address1 = chain.saved_tag_address1;
+    channel.control.address_stack_pointer = chain.address_stack_pointer;
+    channel.control.dmatag_upper = chain.dmatag_upper;
+    channel.end_transfer = true;
+    ScheduleEndTransfer(index);
+    return true;
+}
+
+void DMAC::StartRecording(int index) {
+    auto& channel = channels[index];
+    if (!CanCacheChain(index)) {
+        return;
+    }
+
+    CachedChain& recording = recordings[index];
+    recording.pages.clear();
+    recording.blocks.clear();
+    recording.tags = 0;
+    recording.dmatag_irq = channel.control.dmatag_irq;
+    recording_starts[index] = channel.tag_address;
+    channel.recording = true;
+}
+
+void DMAC::RecordTag(int index) {
+    auto& channel = channels[index];
+
+    // only chains with all of their tags in rdram can be cached
+    u32 addr = channel.tag_address;
+    if ((addr & (1u << 31)) || addr >= 0x2000000) {
+        channel.recording = false;
+        return;
+    }
+
+    CachedChain& recording = recordings[index];
+    int page = addr >> 12;
+    if (recording.pages.empty() || recording.pages.back().index != page) {
+        // this shares the code page watches with the ee executors, which is why switching
+        // executor bumps the generation of every watched page
+        system.ee.WatchPhysicalPage(page);
+        recording.pages.push_back({page, system.ee.GetPageGeneration(page)});
+    }
+
+    recording.tags++;
+}
+
+void DMAC::FinishRecording(int index) {
+    auto& channel = channels[index];
+    if (!channel.recording) {
+        return;
+    }
+
+    channel.recording = false;
+
+    CachedChain& recording = recordings[index];
+    recording.address = channel.address;
+    recording.tag_address = channel.tag_address;
+    recording.saved_tag_address0 = channel.saved_tag_address0;
+    recording.saved_tag_address1 = channel.saved_tag_address1;
+    recording.address_stack_pointer = channel.control.address_stack_pointer;
+    recording.dmatag_upper = channel.control.dmatag_upper;
+
+    if (chain_cache.size() >= MAX_CACHED_CHAINS) {
+        chain_cache.clear();
+    }
+
+    chain_cache[recording_starts[index]] = std::move(recording);
+}
+
 void DMAC::DoSourceChain(int index) {
     auto& channel = channels[index];
-    u128 data = system.ee.read<u128>(channel.tag_address);
+    if (channel.recording) {
+        RecordTag(index);
+    }
+
+    u128 data = read_u128(channel.tag_address);
 
     // TODO: create a union type for dma tag to easily extract fields
     u64 dma_tag = data.lo;
@@ -404,6 +757,12 @@ void DMAC::DoSourceChain(int index) {
         channel.tag_address += 16;
         channel.end_transfer = true;
         break;
+    case 1:
+        // MADR=TADR+16
+        // TADR=MADR+(QWC*16)
+        channel.address = channel.tag_address + 16;
+        channel.tag_address = channel.address + (channel.quadword_count * 16);
+        break;
     case 2:
         // MADR=TADR+16
         // TADR=DMAtag.ADDR
@@ -411,13 +770,70 @@ void DMAC::DoSourceChain(int index) {
         channel.tag_address = addr;
         break;
     case 3:
+    case 4:
         // MADR=DMAtag.ADDR
         // TADR+=16
+        // refs is the same as ref, apart from stall control which isn't handled yet
         channel.address = addr;
         channel.tag_address += 16;
         break;
-    default:
-        common::Error("[ee::DMAC] %s handle DMATag id %d", channel_names[index], id);
+    case 5:
+        // MADR=TADR+16
+        // ASR[ASP]=MADR+(QWC*16)
+        // ASP++
+        // TADR=DMAtag.ADDR
+        channel.address = channel.tag_address + 16;
+
+        switch (channel.control.address_stack_pointer) {
+        case 0:
+            channel.saved_tag_address0 = channel.address + (channel.quadword_count * 16);
+            break;
+        case 1:
+            channel.saved_tag_address1 = channel.address + (channel.quadword_count * 16);
+            break;
+        default:
+            common::Error("[ee::DMAC] %s call with a full address stack", channel_names[index]);
+        }
+
+        channel.control.address_stack_pointer++;
+        channel.tag_address = addr;
+        break;
+    case 6:
+        // MADR=TADR+16
+        // if ASP>0: ASP--, TADR=ASR[ASP]
+        // else: tag_end=true
+        channel.address = channel.tag_address + 16;
+
+        switch (channel.control.address_stack_pointer) {
+        case 0:
+            channel.end_transfer = true;
+            break;
+        case 1:
+            channel.tag_address = channel.saved_tag_address0;
+            channel.control.address_stack_pointer--;
+            break;
+        default:
+            channel.tag_address = channel.saved_tag_address1;
+            channel.control.address_stack_pointer--;
+            break;
+        }
+
+        break;
+    case 7:
+        // MADR=TADR+16
+        // tag_end=true
+        channel.address = channel.tag_address + 16;
+        channel.end_transfer = true;
+        break;
+    }
+
+    // when draining the mfifo, tags and the data following them are in the ring
+    if (IsMFIFODrain(index)) {
+        channel.tag_address = WrapMFIFO(channel.tag_address);
+
+        if (id == 1 || id == 2 || id == 7) {
+            channel.address = WrapMFIFO(channel.address);
+        }
     }
 
     bool irq = (dma_tag >> 31) & 0x1;
@@ -426,22 +842,81 @@ void DMAC::DoSourceChain(int index) {
     }
 }
 
-u128 DMAC::read_u128(u32 addr) {
-    if (addr < 0x2000000) {
-        return common::Read<u128>(system.ee.rdram(), addr);
+bool DMAC::IsMFIFOEnabled() {
+    // d_ctrl.mfd selects which channel drains the ring. 1 is reserved
+    return ((control >> 2) & 0x3) >= 2;
+}
+
+bool DMAC::IsMFIFODrain(int index) {
+    switch ((control >> 2) & 0x3) {
+    case 2:
+        return index == static_cast<int>(ChannelType::GIF);
+    case 3:
+        return index == static_cast<int>(ChannelType::VIF1);
+    default:
+        return false;
+    }
+}
+
+bool DMAC::IsMFIFOEmpty(Channel& channel) {
+    // the drain has caught up with where spr from is writing to
+    if (channel.tag_address != WrapMFIFO(channels[8].address)) {
+        return false;
+    }
+
+    if (!(interrupt_status & (1 << 14))) {
+        common::Log("[ee::DMAC] mfifo empty");
+        interrupt_status |= (1 << 14);
+        CheckInterruptSignal();
     }
 
-    LOG_TODO("handle dma 128-bit read with address %08x", addr);
+    return true;
 }
 
-void DMAC::write_u128(u32 addr, u128 data) {
-    if ((addr & (1 << 31)) || (addr & 0x07000000) == 0x07000000) {
-        u32 masked_addr = addr & 0x3ff0;
-        common::Write<u128>(system.ee.scratchpad(), data, masked_addr);
-        return;
+u32 DMAC::WrapMFIFO(u32 addr) {
+    return ringbuffer_offset | (addr & ringbuffer_size);
+}
+
+bool DMAC::InMFIFO(u32 addr) {
+    return (addr & ~ringbuffer_size) == ringbuffer_offset;
+}
+
+u32 DMAC::GetContiguousQuadwords(int index, u32 addr, u32 quadwords) {
+    bool ring = (index == static_cast<int>(ChannelType::FromSPR) && IsMFIFOEnabled()) || IsMFIFODrain(index);
+    if (!ring || !InMFIFO(addr)) {
+        return quadwords;
     }
 
-    LOG_TODO("handle dma 128-bit write with address %08x", addr);
+    u32 ring_end = ringbuffer_offset + ringbuffer_size + 16;
+    quadwords = std::min(quadwords, (ring_end - addr) / 16);
+
+    // the drain can't read past where spr from has written up to, so it stalls there
+    // until more data is written to the ring
+    if (IsMFIFODrain(index)) {
+        u32 written = (WrapMFIFO(channels[8].address) - addr) & ringbuffer_size;
+        quadwords = std::min(quadwords, written / 16);
+    }
+
+    return quadwords;
+}
+
+u32 DMAC::AdvanceAddress(int index, u32 addr, u32 quadwords) {
+    bool ring = (index == static_cast<int>(ChannelType::FromSPR) && IsMFIFOEnabled()) || IsMFIFODrain(index);
+    if (ring && InMFIFO(addr)) {
+        return WrapMFIFO(addr + (quadwords * 16));
+    }
+
+    return addr + (quadwords * 16);
+}
+
+u128 DMAC::read_u128(u32 addr) {
+    u128 data;
+    system.ee.ReadPhysical(addr, &data, 16);
+    return data;
+}
+
+void DMAC::write_u128(u32 addr, u128 data) {
+    system.ee.WritePhysical(addr, &data, 16);
 }
 
 } // namespace ee
\ No newline at end of file
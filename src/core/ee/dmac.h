@@ -1,6 +1,10 @@
 #pragma once
 
+#include <unordered_map>
+#include <vector>
 #include "common/types.h"
+#include "common/io_map.h"
+#include "core/scheduler.h"
 
 struct System;
 
@@ -11,7 +15,8 @@ public:
     DMAC(System& system);
 
     void Reset();
-    void Run(int cycles);
+    void RegisterIO(common::IOMap& io);
+    void Run();
 
     void WriteRegister(u32 addr, u32 data);
 
@@ -28,14 +33,22 @@ public:
     void do_gif_transfer();
     void do_sif0_transfer();
     void do_sif1_transfer();
+    void do_from_spr_transfer();
     void do_to_spr_transfer();
 
     void StartTransfer(int index);
     void EndTransfer(int index);
+
+    // transfers are done in bursts, with the end of the transfer
+    // scheduled for when the bus would have finished moving the data
+    void AddBusCost(int index, u32 quadwords);
+    void ScheduleEndTransfer(int index);
+    static void EndTransferEvent(void* context, u64 index);
     
     int GetChannelIndex(u32 addr);
     void CheckInterruptSignal();
 
+    void DoChainTransfer(int index);
     void DoSourceChain(int index);
 
     u32 control;
@@ -47,11 +60,23 @@ public:
     u32 disabled_status;
 
 private:
-    // TODO: dmac specifies transfer addresses as physical addresses, skipping the TLB.
-    // We should replace all ee memory accesses with a specific function
+    // dmac specifies transfer addresses as physical addresses, skipping the TLB
     u128 read_u128(u32 addr);
     void write_u128(u32 addr, u128 data);
 
+    void SendBlock(int index);
+    void SendGIFBlock();
+    void SendSIF1Block();
+
+    bool CanCacheChain(int index);
+    bool ReplayChain(int index);
+    void StartRecording(int index);
+    void RecordTag(int index);
+    void FinishRecording(int index);
+
+    // dmac can transfer one quadword per bus cycle, and the bus runs at half the speed of the ee
+    static constexpr u64 EE_CYCLES_PER_QUADWORD = 2;
+
     struct Channel {
         enum class Mode : u8 {
             Normal = 0,
@@ -87,8 +112,30 @@ private:
         u32 saved_tag_address1;
         u32 scratchpad_address;
         bool end_transfer;
+
+        // time when the data moved so far would have finished transferring
+        u64 busy_until;
+        bool end_pending;
+        EventHandle end_event;
+
+        // set once the first tag of a chain has been reached, and while the chain is being recorded
+        bool chain_started;
+        bool recording;
     };
 
+    // in mfifo mode spr from writes into a ring buffer in rdram, described by d_rbor and d_rbsr,
+    // and either gif or vif1 drains it in source chain mode
+    bool IsMFIFOEnabled();
+    bool IsMFIFODrain(int index);
+    bool IsMFIFOEmpty(Channel& channel);
+    u32 WrapMFIFO(u32 addr);
+    bool InMFIFO(u32 addr);
+
+    // how many of the quadwords starting at addr can be moved before the ring wraps around,
+    // and the address after moving them
+    u32 GetContiguousQuadwords(int index, u32 addr, u32 quadwords);
+    u32 AdvanceAddress(int index, u32 addr, u32 quadwords);
+
     enum class ChannelType : int {
         VIF0 = 0,
         VIF1 = 1,
@@ -102,7 +149,43 @@ private:
         ToSPR = 9,
     };
 
+    // a source chain which has been walked before, stored as the blocks of data it sent so that
+    // it can be replayed without reading its tags again. it's only valid while the pages holding
+    // its tags haven't been written to
+    struct CachedChain {
+        struct Page {
+            int index;
+            u32 generation;
+        };
+
+        struct Block {
+            u32 address;
+            u32 quadword_count;
+        };
+
+        std::vector<Page> pages;
+        std::vector<Block> blocks;
+        u32 tags;
+        bool dmatag_irq;
+
+        // channel state once the chain has ended
+        u32 address;
+        u32 tag_address;
+        u32 saved_tag_address0;
+        u32 saved_tag_address1;
+        u32 address_stack_pointer;
+        u32 dmatag_upper;
+    };
+
+    static constexpr int MAX_CACHED_CHAINS = 256;
+
     Channel channels[10];
+
+    // cached chains are keyed by the tag address they start from
+    std::unordered_map<u32, CachedChain> chain_cache;
+    CachedChain recordings[10];
+    u32 recording_starts[10];
+
     System& system;
 };
 
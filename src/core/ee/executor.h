@@ -1,5 +1,7 @@
 #pragma once
 
+#include "common/types.h"
+
 namespace ee {
 
 enum class ExceptionType : int {
@@ -23,10 +25,25 @@ enum class ExceptionType : int {
     Debug = 18,
 };
 
+enum class ExecutorType {
+    Interpreter,
+    CachedInterpreter,
+    JIT,
+};
+
 struct Executor {
     virtual ~Executor() = default;
     virtual void Reset() = 0;
     virtual void Run(int cycles) = 0;
+
+    // called when a physical page containing code has been written to
+    virtual void InvalidatePage(int) {}
+
+    virtual bool InBranchDelay() = 0;
+
+    // whether the last slice ended early in an idle loop, and the total cycles skipped that way
+    virtual bool IsIdle() = 0;
+    virtual u64 GetIdleCycles() = 0;
 };
 
 } // namespace ee
\ No newline at end of file
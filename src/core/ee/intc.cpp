@@ -10,6 +10,20 @@ void INTC::Reset() {
     stat = 0;
 }
 
+void INTC::RegisterIO(common::IOMap& io) {
+    io.Map(0x1000f000, this, [](INTC* intc, u32) -> u32 {
+        return intc->ReadStat();
+    }, [](INTC* intc, u32, u32 value) {
+        intc->WriteStat(value);
+    });
+
+    io.Map(0x1000f010, this, [](INTC* intc, u32) -> u32 {
+        return intc->ReadMask();
+    }, [](INTC* intc, u32, u32 value) {
+        intc->WriteMask(value);
+    });
+}
+
 u16 INTC::ReadMask() {
     common::Log("[ee::INTC] read mask %04x", mask);
     return mask;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/log.h"
 
 namespace ee {
@@ -32,6 +33,7 @@ public:
     INTC(Context& ee);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
 
     u16 ReadMask();
     u16 ReadStat();
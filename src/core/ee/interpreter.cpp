@@ -1,4 +1,8 @@
 #include <cassert>
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
 #include "common/types.h"
 #include "common/log.h"
 #include "common/bits.h"
@@ -15,9 +19,18 @@ void Interpreter::Reset() {
     branch_delay = false;
     branch = false;
     inst.data = 0;
+    idle_loops.clear();
+    idle_loop_pc = 0;
+    idle = false;
+    idle_cycles = 0;
 }
 
 void Interpreter::Run(int cycles) {
+    // other components may have changed what an idle loop reads, so it must be seen
+    // to make no progress again in each slice
+    idle_loop_pc = 0;
+    idle = false;
+
     while (cycles--) {
         inst = Instruction{ctx.read<u32>(ctx.pc)};
         
@@ -27,17 +40,242 @@ void Interpreter::Run(int cycles) {
 
         if (branch_delay) {
             if (branch) {
+                u32 branch_pc = ctx.pc - 8;
                 ctx.pc = ctx.npc;
                 branch_delay = false;
                 branch = false;
+
+                // nothing the loop reads can change until the other components run,
+                // so the rest of the slice can be skipped
+                if (ctx.pc <= branch_pc && DetectIdleLoop(branch_pc) && !ctx.cop0.interrupt_pending) {
+                    idle_cycles += cycles;
+                    idle = true;
+                    return;
+                }
             } else {
                 branch = true;
             }
         }
 
-        ctx.cop0.CountUp();
-        CheckInterrupts();
+        if (ctx.cop0.interrupt_pending) {
+            CheckInterrupts();
+        }
+    }
+}
+
+bool Interpreter::DetectIdleLoop(u32 branch_pc) {
+    u32 start = ctx.pc;
+    if (!ctx.system.idle_loop_detection || branch_pc - start >= MAX_IDLE_LOOP_SIZE * 4) {
+        return false;
+    }
+
+    auto it = idle_loops.find(branch_pc);
+    if (it == idle_loops.end() || it->second.start != start) {
+        it = idle_loops.insert_or_assign(branch_pc, AnalyseIdleLoop(start, branch_pc + 4)).first;
+    }
+
+    IdleLoop& loop = it->second;
+    if (!loop.candidate) {
+        return false;
+    }
+
+    // the first iteration in a slice only records the registers to compare against
+    bool unchanged = idle_loop_pc == branch_pc;
+    idle_loop_pc = branch_pc;
+
+    for (int reg = 1; reg < 32; reg++) {
+        if (!(loop.written_regs & (1u << reg))) {
+            continue;
+        }
+
+        u128 value = ctx.GetReg<u128>(reg);
+        if (value.lo != idle_loop_regs[reg].lo || value.hi != idle_loop_regs[reg].hi) {
+            idle_loop_regs[reg] = value;
+            unchanged = false;
+        }
+    }
+
+    // code can be overwritten after it's analysed, such as when modules are loaded over each other,
+    // so only skip a loop which is still the same code
+    if (unchanged && !HasSameCode(loop, branch_pc + 4)) {
+        loop = AnalyseIdleLoop(start, branch_pc + 4);
+        idle_loop_pc = 0;
+        return false;
     }
+
+    // the addresses of loads depend on the registers the loop was entered with, so they're
+    // checked each time instead of when the loop is analysed
+    return unchanged && HasOnlySafeLoads(loop, branch_pc + 4);
+}
+
+bool Interpreter::HasSameCode(const IdleLoop& loop, u32 end) {
+    for (u32 addr = loop.start; addr <= end; addr += 4) {
+        if (ctx.read<u32>(addr) != loop.code[(addr - loop.start) / 4]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// io registers which can be polled without side effects
+static bool IsStatusRegister(u32 paddr) {
+    // timers
+    if (paddr < 0x10002000) {
+        return true;
+    }
+
+    // dma channel control, address and quadword count
+    if (paddr >= 0x10008000 && paddr < 0x1000e000 && (paddr & 0xff) <= 0x20) {
+        return true;
+    }
+
+    switch (paddr) {
+    case 0x10003020: // gif stat
+    case 0x1000e000: // d_ctrl
+    case 0x1000e010: // d_stat
+    case 0x1000e020: // d_pcr
+    case 0x1000f000: // intc stat
+    case 0x1000f010: // intc mask
+    case 0x1000f200: // sif mscom
+    case 0x1000f210: // sif smcom
+    case 0x1000f220: // sif msflg
+    case 0x1000f230: // sif smflg
+    case 0x1000f240: // sif ctrl
+    case 0x12001000: // gs csr
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Interpreter::HasOnlySafeLoads(const IdleLoop& loop, u32 end) {
+    // registers which the loop doesn't write keep the value it was entered with, and registers
+    // set to a constant in the loop, like with lui, are followed until they're next written
+    std::array<bool, 32> known;
+    std::array<u32, 32> values;
+    for (int reg = 0; reg < 32; reg++) {
+        known[reg] = !(loop.written_regs & (1u << reg)) || reg == 0;
+        values[reg] = ctx.GetReg<u32>(reg);
+    }
+
+    for (u32 addr = loop.start; addr <= end; addr += 4) {
+        Instruction inst = Instruction{loop.code[(addr - loop.start) / 4]};
+
+        switch (inst.opcode) {
+        case 0x1e: case 0x20: case 0x21: case 0x23: case 0x24: case 0x25: case 0x27: case 0x37: {
+            u32 vaddr = values[inst.rs] + inst.simm;
+            if (!known[inst.rs] || (!ctx.IsMemory(vaddr) && !IsStatusRegister(vaddr & 0x1fffffff))) {
+                return false;
+            }
+
+            break;
+        }
+        }
+
+        // work out the register the instruction writes, which the analysis already limited to
+        // these forms
+        int dest;
+        switch (inst.opcode) {
+        case 0x00:
+            dest = inst.rd;
+            break;
+        case 0x01: case 0x04: case 0x05: case 0x06: case 0x07:
+        case 0x14: case 0x15: case 0x16: case 0x17:
+            continue;
+        default:
+            dest = inst.rt;
+            break;
+        }
+
+        if (dest == 0) {
+            continue;
+        }
+
+        switch (inst.opcode) {
+        case 0x09: case 0x19:
+            // addiu and daddiu
+            known[dest] = known[inst.rs];
+            values[dest] = values[inst.rs] + inst.simm;
+            break;
+        case 0x0d:
+            // ori
+            known[dest] = known[inst.rs];
+            values[dest] = values[inst.rs] | inst.imm;
+            break;
+        case 0x0f:
+            // lui
+            known[dest] = true;
+            values[dest] = inst.imm << 16;
+            break;
+        default:
+            known[dest] = false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+Interpreter::IdleLoop Interpreter::AnalyseIdleLoop(u32 start, u32 end) {
+    IdleLoop loop = {false, 0, start, {}};
+
+    for (u32 addr = start; addr <= end; addr += 4) {
+        Instruction inst = Instruction{ctx.read<u32>(addr)};
+        loop.code[(addr - start) / 4] = inst.data;
+        int dest = -1;
+
+        switch (inst.opcode) {
+        case 0x00:
+            switch (inst.func) {
+            case 0x00: case 0x02: case 0x03: case 0x04: case 0x06: case 0x07:
+            case 0x0a: case 0x0b: case 0x14: case 0x16: case 0x17:
+            case 0x21: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+            case 0x2a: case 0x2b: case 0x2d: case 0x2f:
+            case 0x38: case 0x3a: case 0x3b: case 0x3c: case 0x3e: case 0x3f:
+                dest = inst.rd;
+                break;
+            case 0x0f:
+                // sync
+                dest = 0;
+                break;
+            }
+
+            break;
+        case 0x01:
+            // bltz, bgez, bltzl and bgezl
+            if (inst.rt <= 0x03) {
+                dest = 0;
+            }
+
+            break;
+        case 0x04: case 0x05: case 0x06: case 0x07:
+        case 0x14: case 0x15: case 0x16: case 0x17: {
+            // branches can't leave the loop
+            u32 target = addr + (inst.simm << 2) + 4;
+            if (target >= start && target <= end) {
+                dest = 0;
+            }
+
+            break;
+        }
+        case 0x09: case 0x0a: case 0x0b: case 0x0c: case 0x0d: case 0x0e: case 0x0f: case 0x19:
+        case 0x1e: case 0x20: case 0x21: case 0x23: case 0x24: case 0x25: case 0x27: case 0x37:
+            // alu instructions with an immediate and loads
+            dest = inst.rt;
+            break;
+        }
+
+        // anything else could store to memory or otherwise make progress
+        if (dest < 0) {
+            return loop;
+        }
+
+        loop.written_regs |= 1u << dest;
+    }
+
+    loop.candidate = true;
+    return loop;
 }
 
 void Interpreter::DoException(u32 target, ExceptionType exception) {
@@ -57,6 +295,8 @@ void Interpreter::DoException(u32 target, ExceptionType exception) {
         ctx.pc = target - 4;
     }
 
+    ctx.cop0.UpdateInterrupts();
+
     branch_delay = false;
     branch = false;
 }
@@ -68,6 +308,8 @@ void Interpreter::RaiseInterrupt(int signal, bool value) {
         // int1 signal
         ctx.cop0.cause.int1_pending = value;
     }
+
+    ctx.cop0.UpdateInterrupts();
 }
 
 void Interpreter::CheckInterrupts() {
@@ -121,6 +363,34 @@ void Interpreter::LogInstruction() {
     common::Log("[ee::Interpreter] %08x %08x %s", ctx.pc, inst.data, DisassembleInstruction(inst, ctx.pc).c_str());
 }
 
+bool Interpreter::IsBranch(Instruction inst) {
+    switch (inst.opcode) {
+    case 0x00:
+        // jr and jalr
+        return inst.func == 0x08 || inst.func == 0x09;
+    case 0x01:
+        // regimm branches
+        return inst.rt < 0x18;
+    case 0x02: case 0x03: case 0x04: case 0x05: case 0x06: case 0x07:
+    case 0x14: case 0x15: case 0x16: case 0x17:
+        return true;
+    case 0x11:
+        // bc1
+        return inst.rs == 0x08;
+    default:
+        return false;
+    }
+}
+
+bool Interpreter::EndsBlock(Instruction inst) {
+    // syscall, break and eret redirect the pc without a delay slot
+    if (inst.opcode == 0x00) {
+        return inst.func == 0x0c || inst.func == 0x0d;
+    }
+
+    return inst.opcode == 0x10 && inst.rs == 0x10 && inst.func == 0x18;
+}
+
 void Interpreter::Branch(bool cond) {
     s32 offset = inst.simm << 2;
 
@@ -271,6 +541,28 @@ void Interpreter::ctc2() {
 }
 
 // MMI instructions
+// mmi instructions operate on the whole 128 bit register
+static __m128i LoadVector(Context& ctx, int reg) {
+    return _mm_loadu_si128(reinterpret_cast<__m128i*>(&ctx.gpr[reg * 16]));
+}
+
+static void StoreVector(Context& ctx, int reg, __m128i value) {
+    if (reg) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&ctx.gpr[reg * 16]), value);
+    }
+}
+
+// picks lanes from a where mask is set and from b otherwise
+static __m128i Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// sse2 only has signed 32 bit compares, so flip the sign bits first
+static __m128i CompareGreaterUnsigned(__m128i a, __m128i b) {
+    __m128i sign = _mm_set1_epi32(0x80000000);
+    return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+}
+
 void Interpreter::divu1() {
     if (ctx.GetReg<u32>(inst.rt)) {
         ctx.lo1 = common::SignExtend<s64, 32>(ctx.GetReg<u32>(inst.rs) / ctx.GetReg<u32>(inst.rt));
@@ -293,7 +585,7 @@ void Interpreter::mult1() {
 }
 
 void Interpreter::por() {
-    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) | ctx.GetReg<u128>(inst.rt));
+    StoreVector(ctx, inst.rd, _mm_or_si128(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::mfhi1() {
@@ -316,36 +608,30 @@ void Interpreter::mtlo1() {
 }
 
 void Interpreter::pcpyld() {
-    u64 lower = ctx.GetReg<u64>(inst.rt);
-    u64 upper = ctx.GetReg<u64>(inst.rs);
-    ctx.SetReg<u64>(inst.rd, lower);
-    ctx.SetReg<u64>(inst.rd, upper, 1);
+    StoreVector(ctx, inst.rd, _mm_unpacklo_epi64(LoadVector(ctx, inst.rt), LoadVector(ctx, inst.rs)));
 }
 
 void Interpreter::pnor() {
-    ctx.SetReg<u128>(inst.rd, ~(ctx.GetReg<u128>(inst.rs) | ctx.GetReg<u128>(inst.rt)));
+    __m128i result = _mm_or_si128(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt));
+    StoreVector(ctx, inst.rd, _mm_xor_si128(result, _mm_set1_epi32(-1)));
 }
 
 void Interpreter::pand() {
-    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) & ctx.GetReg<u128>(inst.rt));
+    StoreVector(ctx, inst.rd, _mm_and_si128(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pxor() {
-    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) ^ ctx.GetReg<u128>(inst.rt));
+    StoreVector(ctx, inst.rd, _mm_xor_si128(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pcpyud() {
-    ctx.SetReg<u64>(inst.rd, ctx.GetReg<u64>(inst.rs, 1));
-    ctx.SetReg<u64>(inst.rd, ctx.GetReg<u64>(inst.rt, 1), 1);
+    StoreVector(ctx, inst.rd, _mm_unpackhi_epi64(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pcpyh() {
-    u16 lower = ctx.GetReg<u16>(inst.rt);
-    u16 upper = ctx.GetReg<u16>(inst.rt, 4);
-    for (int i = 0; i < 4; i++) {
-        ctx.SetReg<u16>(inst.rd, lower, i);
-        ctx.SetReg<u16>(inst.rd, upper, 4 + i);
-    }
+    // broadcast halfword 0 and 4 across their doublewords
+    __m128i result = _mm_shufflelo_epi16(LoadVector(ctx, inst.rt), 0);
+    StoreVector(ctx, inst.rd, _mm_shufflehi_epi16(result, 0));
 }
 
 void Interpreter::div1() {
@@ -409,306 +695,178 @@ void Interpreter::multu1() {
 }
 
 void Interpreter::pabsh() {
-    for (int i = 0; i < 8; i++) {
-        s16 signed_data = ctx.GetReg<s16>(inst.rt, i);
-        u16 data = ctx.GetReg<u16>(inst.rt, i);
-        if (data == 0x8000) {
-            ctx.SetReg<u16>(inst.rd, 0x7fff, i);
-        } else if (signed_data < 0) {
-            ctx.SetReg<u16>(inst.rd, -signed_data, i);
-        } else {
-            ctx.SetReg<u16>(inst.rd, data, i);
-        }
-    }
+    // the saturating negate turns -0x8000 into 0x7fff
+    __m128i data = LoadVector(ctx, inst.rt);
+    StoreVector(ctx, inst.rd, _mm_max_epi16(data, _mm_subs_epi16(_mm_setzero_si128(), data)));
 }
 
 void Interpreter::pabsw() {
-    for (int i = 0; i < 4; i++) {
-        s32 signed_data = ctx.GetReg<s32>(inst.rt, i);
-        u32 data = ctx.GetReg<u32>(inst.rt, i);
-        if (data == 0x80000000) {
-            ctx.SetReg<u32>(inst.rd, 0x7fffffff, i);
-        } else if (signed_data < 0) {
-            ctx.SetReg<u32>(inst.rd, -signed_data, i);
-        } else {
-            ctx.SetReg<u32>(inst.rd, data, i);
-        }
-    }
+    __m128i data = LoadVector(ctx, inst.rt);
+    __m128i sign = _mm_srai_epi32(data, 31);
+    __m128i result = _mm_sub_epi32(_mm_xor_si128(data, sign), sign);
+
+    // only -0x80000000 is still negative after this, so saturate it to 0x7fffffff
+    StoreVector(ctx, inst.rd, _mm_add_epi32(result, _mm_srai_epi32(result, 31)));
 }
 
 void Interpreter::paddb() {
-    for (int i = 0; i < 16; i++) {
-        ctx.SetReg<s8>(inst.rd, ctx.GetReg<s8>(inst.rs, i) + ctx.GetReg<s8>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_add_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::paddh() {
-    for (int i = 0; i < 8; i++) {
-        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) + ctx.GetReg<s16>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_add_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::paddsb() {
-    for (int i = 0; i < 16; i++) {
-        s16 result = static_cast<s16>(ctx.GetReg<s8>(inst.rs, i)) + static_cast<s16>(ctx.GetReg<s8>(inst.rt, i));
-        if (result > 0x7f) {
-            result = 0x7f;
-        } else if (result < -0x80) {
-            result = -0x80;
-        }
-        ctx.SetReg<s8>(inst.rd, result & 0xff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_adds_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::paddsh() {
-    for (int i = 0; i < 8; i++) {
-        s32 result = static_cast<s32>(ctx.GetReg<s16>(inst.rs, i)) + static_cast<s32>(ctx.GetReg<s16>(inst.rt, i));
-        if (result > 0x7fff) {
-            result = 0x7fff;
-        } else if (result < -0x8000) {
-            result = -0x8000;
-        }
-        ctx.SetReg<s16>(inst.rd, result & 0xffff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_adds_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::paddsw() {
-    for (int i = 0; i < 4; i++) {
-        s64 result = static_cast<s64>(ctx.GetReg<s32>(inst.rs, i)) + static_cast<s64>(ctx.GetReg<s32>(inst.rt, i));
-        if (result > 0x7fffffff) {
-            result = 0x7fffffff;
-        } else if (result < static_cast<s32>(0x80000000)) {
-            result = static_cast<s32>(0x80000000);
-        }
-        ctx.SetReg<s32>(inst.rd, static_cast<s32>(result), i);
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+    __m128i result = _mm_add_epi32(a, b);
+
+    // sse has no saturating 32 bit add, so detect signed overflow and clamp
+    // towards the sign of the first operand
+    __m128i overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, result), _mm_xor_si128(b, result)), 31);
+    __m128i saturated = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7fffffff));
+    StoreVector(ctx, inst.rd, Select(overflow, saturated, result));
 }
 
 void Interpreter::paddub() {
-    for (int i = 0; i < 16; i++) {
-        u16 result = static_cast<u16>(ctx.GetReg<u8>(inst.rs, i)) + static_cast<u16>(ctx.GetReg<u8>(inst.rt, i));
-        if (result > 0xff) {
-            result = 0xff;
-        }
-        ctx.SetReg<u8>(inst.rd, result & 0xff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_adds_epu8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::padduh() {
-    for (int i = 0; i < 8; i++) {
-        u32 result = static_cast<u32>(ctx.GetReg<u16>(inst.rs, i)) + static_cast<u32>(ctx.GetReg<u16>(inst.rt, i));
-        if (result > 0xffff) {
-            result = 0xffff;
-        }
-        ctx.SetReg<u16>(inst.rd, result & 0xffff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_adds_epu16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::padduw() {
-    for (int i = 0; i < 4; i++) {
-        u64 result = static_cast<u64>(ctx.GetReg<u32>(inst.rs, i)) + static_cast<u64>(ctx.GetReg<u32>(inst.rt, i));
-        if (result > 0xffffffff) {
-            result = 0xffffffff;
-        }
-        ctx.SetReg<u32>(inst.rd, result & 0xffffffff, i);
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i result = _mm_add_epi32(a, LoadVector(ctx, inst.rt));
+
+    // the sum wrapped if it is below either operand
+    __m128i carry = CompareGreaterUnsigned(a, result);
+    StoreVector(ctx, inst.rd, _mm_or_si128(result, carry));
 }
 
 void Interpreter::paddw() {
-    for (int i = 0; i < 4; i++) {
-        ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i) + ctx.GetReg<s32>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_add_epi32(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::padsbh() {
-    for (int i = 0; i < 4; i++) {
-        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) - ctx.GetReg<s16>(inst.rt, i), i);
-        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i + 4) + ctx.GetReg<s16>(inst.rt, i + 4), i + 4);
-    }
+    // the lower 4 halfwords are subtracted and the upper 4 are added
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+    __m128i difference = _mm_sub_epi16(a, b);
+    __m128i sum = _mm_add_epi16(a, b);
+    StoreVector(ctx, inst.rd, _mm_unpackhi_epi64(_mm_unpacklo_epi64(difference, difference), sum));
 }
 
 void Interpreter::pmaxh() {
-    for (int i = 0; i < 8; i++) {
-        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
-            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i), i);
-        } else {
-            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rt, i), i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_max_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pmaxw() {
-    for (int i = 0; i < 4; i++) {
-        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
-            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i), i);
-        } else {
-            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rt, i), i);
-        }
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+
+#if defined(__SSE4_1__)
+    StoreVector(ctx, inst.rd, _mm_max_epi32(a, b));
+#else
+    StoreVector(ctx, inst.rd, Select(_mm_cmpgt_epi32(a, b), a, b));
+#endif
 }
 
 void Interpreter::pminh() {
-    for (int i = 0; i < 8; i++) {
-        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
-            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rt, i), i);
-        } else {
-            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i), i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_min_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pminw() {
-    for (int i = 0; i < 4; i++) {
-        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
-            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rt, i), i);
-        } else {
-            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i), i);
-        }
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+
+#if defined(__SSE4_1__)
+    StoreVector(ctx, inst.rd, _mm_min_epi32(a, b));
+#else
+    StoreVector(ctx, inst.rd, Select(_mm_cmpgt_epi32(a, b), b, a));
+#endif
 }
 
 void Interpreter::psubb() {
-    for (int i = 0; i < 16; i++) {
-        ctx.SetReg<s8>(inst.rd, ctx.GetReg<s8>(inst.rs, i) - ctx.GetReg<s8>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_sub_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubh() {
-    for (int i = 0; i < 8; i++) {
-        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) - ctx.GetReg<s16>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_sub_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubsb() {
-    for (int i = 0; i < 16; i++) {
-        s16 result = static_cast<s16>(ctx.GetReg<s8>(inst.rs, i)) - static_cast<s16>(ctx.GetReg<s8>(inst.rt, i));
-        if (result > 0x7f) {
-            result = 0x7f;
-        } else if (result < -0x80) {
-            result = -0x80;
-        }
-        ctx.SetReg<s8>(inst.rd, result & 0xff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_subs_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubsh() {
-    for (int i = 0; i < 8; i++) {
-        s32 result = static_cast<s32>(ctx.GetReg<s16>(inst.rs, i)) - static_cast<s32>(ctx.GetReg<s16>(inst.rt, i));
-        if (result > 0x7fff) {
-            result = 0x7fff;
-        } else if (result < -0x8000) {
-            result = -0x8000;
-        }
-        ctx.SetReg<s16>(inst.rd, result & 0xffff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_subs_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubsw() {
-    for (int i = 0; i < 4; i++) {
-        s64 result = static_cast<s64>(ctx.GetReg<s32>(inst.rs, i)) - static_cast<s64>(ctx.GetReg<s32>(inst.rt, i));
-        if (result > 0x7fffffff) {
-            result = 0x7fffffff;
-        } else if (result < static_cast<s32>(0x80000000)) {
-            result = static_cast<s32>(0x80000000);
-        }
-        ctx.SetReg<s32>(inst.rd, static_cast<s32>(result), i);
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+    __m128i result = _mm_sub_epi32(a, b);
+
+    // signed overflow can only happen when the operands have different signs
+    __m128i overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, result)), 31);
+    __m128i saturated = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7fffffff));
+    StoreVector(ctx, inst.rd, Select(overflow, saturated, result));
 }
 
 void Interpreter::psubub() {
-    for (int i = 0; i < 16; i++) {
-        u16 result = static_cast<u16>(ctx.GetReg<u8>(inst.rs, i)) - static_cast<u16>(ctx.GetReg<u8>(inst.rt, i));
-        if (result > 0xff) {
-            result = 0;
-        }
-        ctx.SetReg<u8>(inst.rd, result & 0xff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_subs_epu8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubuh() {
-    for (int i = 0; i < 8; i++) {
-        u32 result = static_cast<u32>(ctx.GetReg<u16>(inst.rs, i)) - static_cast<u32>(ctx.GetReg<u16>(inst.rt, i));
-        if (result > 0xffff) {
-            result = 0;
-        }
-        ctx.SetReg<u16>(inst.rd, result & 0xffff, i);
-    }
+    StoreVector(ctx, inst.rd, _mm_subs_epu16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::psubuw() {
-    for (int i = 0; i < 4; i++) {
-        u64 result = static_cast<u64>(ctx.GetReg<u32>(inst.rs, i)) - static_cast<u64>(ctx.GetReg<u32>(inst.rt, i));
-        if (result > 0xffffffff) {
-            result = 0;
-        }
-        ctx.SetReg<u32>(inst.rd, result & 0xffffffff, i);
-    }
+    __m128i a = LoadVector(ctx, inst.rs);
+    __m128i b = LoadVector(ctx, inst.rt);
+
+    // lanes which would borrow are clamped to 0
+    __m128i borrow = CompareGreaterUnsigned(b, a);
+    StoreVector(ctx, inst.rd, _mm_andnot_si128(borrow, _mm_sub_epi32(a, b)));
 }
 
 void Interpreter::psubw() {
-    for (int i = 0; i < 4; i++) {
-        ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i) - ctx.GetReg<s32>(inst.rt, i), i);
-    }
+    StoreVector(ctx, inst.rd, _mm_sub_epi32(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pceqb() {
-    for (int i = 0; i < 16; i++) {
-        if (ctx.GetReg<u8>(inst.rs, i) == ctx.GetReg<u8>(inst.rt, i)) {
-            ctx.SetReg<u8>(inst.rd, 0xff, i);
-        } else {
-            ctx.SetReg<u8>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpeq_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pceqh() {
-    for (int i = 0; i < 8; i++) {
-        if (ctx.GetReg<u16>(inst.rs, i) == ctx.GetReg<u16>(inst.rt, i)) {
-            ctx.SetReg<u16>(inst.rd, 0xffff, i);
-        } else {
-            ctx.SetReg<u16>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpeq_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pceqw() {
-    for (int i = 0; i < 4; i++) {
-        if (ctx.GetReg<u32>(inst.rs, i) == ctx.GetReg<u32>(inst.rt, i)) {
-            ctx.SetReg<u32>(inst.rd, 0xffffffff, i);
-        } else {
-            ctx.SetReg<u32>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpeq_epi32(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pcgtb() {
-    for (int i = 0; i < 16; i++) {
-        if (ctx.GetReg<s8>(inst.rs, i) > ctx.GetReg<s8>(inst.rt, i)) {
-            ctx.SetReg<u8>(inst.rd, 0xff, i);
-        } else {
-            ctx.SetReg<u8>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpgt_epi8(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pcgth() {
-    for (int i = 0; i < 8; i++) {
-        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
-            ctx.SetReg<u16>(inst.rd, 0xffff, i);
-        } else {
-            ctx.SetReg<u16>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpgt_epi16(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 void Interpreter::pcgtw() {
-    for (int i = 0; i < 4; i++) {
-        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
-            ctx.SetReg<u32>(inst.rd, 0xffffffff, i);
-        } else {
-            ctx.SetReg<u32>(inst.rd, 0, i);
-        }
-    }
+    StoreVector(ctx, inst.rd, _mm_cmpgt_epi32(LoadVector(ctx, inst.rs), LoadVector(ctx, inst.rt)));
 }
 
 // primary instructions
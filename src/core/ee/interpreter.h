@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <string>
+#include <unordered_map>
 #include "core/ee/decoder.h"
 #include "core/ee/executor.h"
 
@@ -10,8 +13,8 @@ struct Context;
 struct Interpreter : public Executor {
     Interpreter(Context& ctx);
 
-    void Reset();
-    void Run(int cycles);
+    void Reset() override;
+    void Run(int cycles) override;
 
     void DoException(u32 target, ExceptionType exception);
     void RaiseInterrupt(int signal, bool value);
@@ -20,6 +23,9 @@ struct Interpreter : public Executor {
     void LogState();
     std::string GetSyscallInfo(int index);
     void LogInstruction();
+    bool InBranchDelay() override { return branch_delay; }
+    bool IsIdle() override { return idle; }
+    u64 GetIdleCycles() override { return idle_cycles; }
 
     // TODO: separate instruction handlers into separate files for organisation
     void mfc0();
@@ -198,14 +204,46 @@ struct Interpreter : public Executor {
     void illegal_instruction();
     void stub_instruction();
 
-private:
+protected:
     void Branch(bool cond);
     void BranchLikely(bool cond);
     void Jump(u32 target);
 
+    // used by the block based executors to find where basic blocks end
+    static bool IsBranch(Instruction inst);
+    static bool EndsBlock(Instruction inst);
+
+    static constexpr int MAX_IDLE_LOOP_SIZE = 16;
+
+    // a short backward loop which makes no progress once the registers it writes stop changing
+    struct IdleLoop {
+        bool candidate;
+        u32 written_regs;
+
+        // the instructions the loop was analysed from, including the delay slot
+        u32 start;
+        std::array<u32, MAX_IDLE_LOOP_SIZE + 1> code;
+    };
+
+    bool DetectIdleLoop(u32 branch_pc);
+    IdleLoop AnalyseIdleLoop(u32 start, u32 end);
+
+    // whether a loop is still made up of the instructions it was analysed from
+    bool HasSameCode(const IdleLoop& loop, u32 end);
+
+    // whether every load in a loop reads memory or a status register, rather than
+    // something like a fifo which changes when it's read
+    bool HasOnlySafeLoads(const IdleLoop& loop, u32 end);
+
     bool branch_delay;
     bool branch;
 
+    std::unordered_map<u32, IdleLoop> idle_loops;
+    u32 idle_loop_pc;
+    std::array<u128, 32> idle_loop_regs;
+    bool idle;
+    u64 idle_cycles;
+
     Decoder<Interpreter> decoder;
     Instruction inst;
     Context& ctx;
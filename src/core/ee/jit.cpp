@@ -0,0 +1,1056 @@
+#include <ucontext.h>
+#include "common/log.h"
+#include "core/ee/jit.h"
+#include "core/ee/context.h"
+
+namespace ee {
+
+using namespace common;
+
+static bool IsLikelyBranch(Instruction inst) {
+    switch (inst.opcode) {
+    case 0x01:
+        // bltzl, bgezl, bltzall and bgezall
+        return (inst.rt & 0xf) == 0x02 || (inst.rt & 0xf) == 0x03;
+    case 0x11:
+        // bc1fl and bc1tl
+        return inst.rs == 0x08 && (inst.rt == 0x02 || inst.rt == 0x03);
+    case 0x14: case 0x15: case 0x16: case 0x17:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool IsStore(Instruction inst) {
+    return (inst.opcode >= 0x28 && inst.opcode <= 0x2f) || inst.opcode == 0x1f || inst.opcode == 0x39 || inst.opcode == 0x3f;
+}
+
+JIT::JIT(Context& ctx) : Interpreter(ctx), code_cache(CODE_CACHE_SIZE) {
+    page_blocks.resize(Context::PHYSICAL_PAGE_COUNT);
+    fastmem_base = ctx.GetFastmemBase();
+    fault_handler = [this](u8*, void* context) {
+        return HandleFault(context);
+    };
+
+    if (fastmem_base) {
+        common::AddFaultHandler(&fault_handler);
+    }
+}
+
+JIT::~JIT() {
+    if (fastmem_base) {
+        common::RemoveFaultHandler(&fault_handler);
+    }
+}
+
+void JIT::Reset() {
+    Interpreter::Reset();
+    slowmem_pcs.clear();
+    Flush();
+
+    cycles_left = 0;
+    block_invalidated = false;
+}
+
+void JIT::Run(int cycles) {
+    // blocks always run to completion, so any cycles we overshot by are taken from the next slice
+    cycles_left += cycles;
+    link_site = nullptr;
+
+    while (cycles_left > 0) {
+        Block& block = GetBlock(ctx.pc);
+
+        // the previous block ended with a static jump to this block, so patch
+        // it to jump here directly next time
+        if (link_site) {
+            X64Emitter::SetJumpTarget(link_site, block.code);
+            block.incoming_links.push_back(link_site);
+            link_site = nullptr;
+        }
+
+        block_invalidated = false;
+        enter(this, block.code);
+
+        // the block which requested the link may have been freed
+        if (block_invalidated) {
+            link_site = nullptr;
+        }
+    }
+}
+
+void JIT::InvalidatePage(int page) {
+    for (u32 pc : page_blocks[page]) {
+        auto it = blocks.find(pc);
+        if (it != blocks.end()) {
+            FreeBlock(it);
+        }
+    }
+
+    page_blocks[page].clear();
+    block_invalidated = true;
+}
+
+JIT::Block& JIT::GetBlock(u32 pc) {
+    auto it = blocks.find(pc);
+    if (it != blocks.end()) {
+        return it->second;
+    }
+
+    return CompileBlock(pc);
+}
+
+JIT::Block& JIT::CompileBlock(u32 pc) {
+    if (code_cache.GetFreeSpace() < MIN_FREE_SPACE) {
+        Flush();
+    }
+
+    std::vector<Instruction> instructions;
+    u32 addr = pc;
+    bool has_branch = false;
+
+    for (int i = 0; i < MAX_BLOCK_SIZE; i++) {
+        Instruction instruction = Instruction{ctx.read<u32>(addr)};
+        instructions.push_back(instruction);
+        addr += 4;
+
+        if (IsBranch(instruction)) {
+            // always keep the delay slot together with its branch
+            instructions.push_back(Instruction{ctx.read<u32>(addr)});
+            addr += 4;
+            has_branch = true;
+            break;
+        }
+
+        if (EndsBlock(instruction) || (addr & 0xfff) == 0) {
+            break;
+        }
+    }
+
+    u32 end = addr;
+    int length = instructions.size();
+
+    Block& block = blocks[pc];
+    block.code = code_cache.GetCodePointer();
+    block.incoming_links.clear();
+
+    emitter.SetCodePointer(block.code);
+    early_exits.clear();
+    likely_skips.clear();
+    fastmem_sites.clear();
+    block_pc = pc;
+
+    for (int i = 0; i < length; i++) {
+        EmitInstruction(instructions[i], pc + i * 4, i, has_branch && i == length - 1);
+    }
+
+    if (has_branch) {
+        Instruction branch_inst = instructions[length - 2];
+
+        // the delay slot has been executed, so now take the branch if it was taken
+        emitter.MOV(8, Reg::RAX, Member(&branch_delay));
+        emitter.TEST(8, Reg::RAX, Reg::RAX);
+        u8* not_taken = emitter.Jcc(Condition::Equal);
+
+        emitter.MOV(8, Member(&branch_delay), 0);
+        emitter.MOV(8, Member(&branch), 0);
+        EmitMove(Member(&ctx.pc), Member(&ctx.npc));
+        EmitUpdateCycles(length);
+
+        // register jumps can go anywhere, so they always return to the dispatcher
+        if (branch_inst.opcode == 0x00) {
+            emitter.JMP(exit_block);
+        } else {
+            EmitLinkedExit();
+        }
+
+        emitter.SetJumpTarget(not_taken);
+        emitter.MOV(32, Member(&ctx.pc), end);
+        EmitUpdateCycles(length);
+        EmitLinkedExit();
+
+        // a likely branch which wasn't taken skips over its delay slot
+        if (!likely_skips.empty()) {
+            for (u8* jump : likely_skips) {
+                emitter.SetJumpTarget(jump);
+            }
+
+            emitter.MOV(32, Member(&ctx.pc), end);
+            EmitUpdateCycles(length - 1);
+            EmitLinkedExit();
+        }
+    } else {
+        emitter.MOV(32, Member(&ctx.pc), end);
+        EmitUpdateCycles(length);
+        EmitLinkedExit();
+    }
+
+    for (EarlyExit& early_exit : early_exits) {
+        EmitEarlyExit(early_exit);
+    }
+
+    for (u8* site : fastmem_sites) {
+        EmitSlowmem(site);
+    }
+
+    code_cache.CommitCode(emitter.GetCodePointer());
+
+    RegisterBlockPage(pc, pc);
+
+    if (((end - 4) >> 12) != (pc >> 12)) {
+        RegisterBlockPage(pc, end - 4);
+    }
+
+    return block;
+}
+
+void JIT::RegisterBlockPage(u32 pc, u32 addr) {
+    int page = ctx.MarkCodePage(addr);
+
+    if (page >= 0) {
+        page_blocks[page].push_back(pc);
+    }
+}
+
+void JIT::Flush() {
+    blocks.clear();
+
+    for (auto& page : page_blocks) {
+        page.clear();
+    }
+
+    fallbacks.clear();
+    fastmem_accesses.clear();
+    code_cache.Reset();
+    EmitDispatcher();
+    link_site = nullptr;
+}
+
+void JIT::EmitDispatcher() {
+    emitter.SetCodePointer(code_cache.GetCodePointer());
+
+    // rbx holds the jit pointer for the whole time we are in recompiled code.
+    // three pushes also keep the stack 16 byte aligned for calls out of blocks
+    enter = reinterpret_cast<Entry>(emitter.GetCodePointer());
+    emitter.PUSH(Reg::RBX);
+    emitter.PUSH(Reg::RBP);
+    emitter.PUSH(Reg::R12);
+    emitter.MOV(64, Reg::RBX, Reg::RDI);
+    emitter.MOV(64, Reg::R12, Member(&fastmem_base));
+    emitter.JMP(Reg::RSI);
+
+    exit_block = emitter.GetCodePointer();
+    emitter.POP(Reg::R12);
+    emitter.POP(Reg::RBP);
+    emitter.POP(Reg::RBX);
+    emitter.RET();
+
+    code_cache.CommitCode(emitter.GetCodePointer());
+}
+
+void JIT::EmitInstruction(Instruction inst, u32 addr, int index, bool delay_slot) {
+    if (!EmitNative(inst, addr) && !EmitFastmem(inst, addr, index, delay_slot)) {
+        EmitFallback(inst, addr, index, delay_slot);
+    }
+}
+
+bool JIT::EmitNative(Instruction inst, u32 addr) {
+    int rd = inst.rd;
+    int rt = inst.rt;
+    int rs = inst.rs;
+
+    switch (inst.opcode) {
+    case 0x00:
+        switch (inst.func) {
+        case 0x00: case 0x02: case 0x03:
+            // sll, srl and sra
+            if (rd) {
+                emitter.MOV(32, Reg::RAX, GPR(rt));
+
+                if (inst.func == 0x00) {
+                    emitter.SHL(32, Reg::RAX, inst.imm5);
+                } else if (inst.func == 0x02) {
+                    emitter.SHR(32, Reg::RAX, inst.imm5);
+                } else {
+                    emitter.SAR(32, Reg::RAX, inst.imm5);
+                }
+
+                emitter.MOVSXD(Reg::RAX, Reg::RAX);
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x04: case 0x06: case 0x07:
+            // sllv, srlv and srav. x86 masks 32 bit shift amounts by 0x1f like the ee
+            if (rd) {
+                emitter.MOV(32, Reg::RCX, GPR(rs));
+                emitter.MOV(32, Reg::RAX, GPR(rt));
+
+                if (inst.func == 0x04) {
+                    emitter.SHL(32, Reg::RAX);
+                } else if (inst.func == 0x06) {
+                    emitter.SHR(32, Reg::RAX);
+                } else {
+                    emitter.SAR(32, Reg::RAX);
+                }
+
+                emitter.MOVSXD(Reg::RAX, Reg::RAX);
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x08: case 0x09:
+            // jr and jalr
+            emitter.MOV(32, Reg::RAX, GPR(rs));
+            emitter.MOV(32, Member(&ctx.npc), Reg::RAX);
+            emitter.MOV(8, Member(&branch_delay), 1);
+
+            if (inst.func == 0x09 && rd) {
+                emitter.MOV(Reg::RAX, addr + 8);
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x0a: case 0x0b: {
+            // movz and movn
+            if (rd) {
+                emitter.MOV(64, Reg::RAX, GPR(rt));
+                emitter.TEST(64, Reg::RAX, Reg::RAX);
+                u8* skip = emitter.Jcc(inst.func == 0x0a ? Condition::NotEqual : Condition::Equal);
+                EmitMove(GPR(rd), GPR(rs));
+                emitter.SetJumpTarget(skip);
+            }
+
+            return true;
+        }
+        case 0x10:
+            // mfhi
+            if (rd) {
+                EmitMove(GPR(rd), Member(&ctx.hi));
+            }
+
+            return true;
+        case 0x11:
+            // mthi
+            EmitMove(Member(&ctx.hi), GPR(rs));
+            return true;
+        case 0x12:
+            // mflo
+            if (rd) {
+                EmitMove(GPR(rd), Member(&ctx.lo));
+            }
+
+            return true;
+        case 0x13:
+            // mtlo
+            EmitMove(Member(&ctx.lo), GPR(rs));
+            return true;
+        case 0x14: case 0x16: case 0x17:
+            // dsllv, dsrlv and dsrav
+            if (rd) {
+                emitter.MOV(32, Reg::RCX, GPR(rs));
+                emitter.MOV(64, Reg::RAX, GPR(rt));
+
+                if (inst.func == 0x14) {
+                    emitter.SHL(64, Reg::RAX);
+                } else if (inst.func == 0x16) {
+                    emitter.SHR(64, Reg::RAX);
+                } else {
+                    emitter.SAR(64, Reg::RAX);
+                }
+
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x21: case 0x23:
+            // addu and subu
+            if (rd) {
+                emitter.MOV(32, Reg::RAX, GPR(rs));
+
+                if (inst.func == 0x21) {
+                    emitter.ADD(32, Reg::RAX, GPR(rt));
+                } else {
+                    emitter.SUB(32, Reg::RAX, GPR(rt));
+                }
+
+                emitter.MOVSXD(Reg::RAX, Reg::RAX);
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x24: case 0x25: case 0x26: case 0x27: case 0x2d: case 0x2f:
+            // and, or, xor, nor, daddu and dsubu
+            if (rd) {
+                emitter.MOV(64, Reg::RAX, GPR(rs));
+
+                switch (inst.func) {
+                case 0x24:
+                    emitter.AND(64, Reg::RAX, GPR(rt));
+                    break;
+                case 0x25:
+                    emitter.OR(64, Reg::RAX, GPR(rt));
+                    break;
+                case 0x26:
+                    emitter.XOR(64, Reg::RAX, GPR(rt));
+                    break;
+                case 0x27:
+                    emitter.OR(64, Reg::RAX, GPR(rt));
+                    emitter.NOT(64, Reg::RAX);
+                    break;
+                case 0x2d:
+                    emitter.ADD(64, Reg::RAX, GPR(rt));
+                    break;
+                case 0x2f:
+                    emitter.SUB(64, Reg::RAX, GPR(rt));
+                    break;
+                }
+
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x2a: case 0x2b:
+            // slt and sltu
+            if (rd) {
+                emitter.MOV(64, Reg::RAX, GPR(rs));
+                emitter.CMP(64, Reg::RAX, GPR(rt));
+                emitter.SETcc(inst.func == 0x2a ? Condition::Less : Condition::Below, Reg::RAX);
+                emitter.MOVZX8(Reg::RAX, Reg::RAX);
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        case 0x38: case 0x3a: case 0x3b: case 0x3c: case 0x3e: case 0x3f:
+            // dsll, dsrl, dsra, dsll32, dsrl32 and dsra32
+            if (rd) {
+                u8 shift = inst.imm5 + (inst.func >= 0x3c ? 32 : 0);
+                emitter.MOV(64, Reg::RAX, GPR(rt));
+
+                if ((inst.func & 0x3) == 0x0) {
+                    emitter.SHL(64, Reg::RAX, shift);
+                } else if ((inst.func & 0x3) == 0x2) {
+                    emitter.SHR(64, Reg::RAX, shift);
+                } else {
+                    emitter.SAR(64, Reg::RAX, shift);
+                }
+
+                emitter.MOV(64, GPR(rd), Reg::RAX);
+            }
+
+            return true;
+        }
+
+        return false;
+    case 0x01:
+        // bltz, bgez, bltzl and bgezl
+        switch (rt) {
+        case 0x00: case 0x01: case 0x02: case 0x03:
+            emitter.CMP(64, GPR(rs), 0);
+            EmitBranch(inst, addr, rt & 0x1 ? Condition::Less : Condition::GreaterEqual, rt >= 0x02);
+            return true;
+        }
+
+        return false;
+    case 0x02: case 0x03:
+        // j and jal
+        if (inst.opcode == 0x03) {
+            emitter.MOV(Reg::RAX, addr + 8);
+            emitter.MOV(64, GPR(31), Reg::RAX);
+        }
+
+        EmitJump(((addr + 4) & 0xf0000000) + (inst.offset << 2));
+        return true;
+    case 0x04: case 0x05: case 0x14: case 0x15:
+        // beq, bne, beql and bnel
+        emitter.MOV(64, Reg::RAX, GPR(rs));
+        emitter.CMP(64, Reg::RAX, GPR(rt));
+        EmitBranch(inst, addr, inst.opcode & 0x1 ? Condition::Equal : Condition::NotEqual, inst.opcode >= 0x14);
+        return true;
+    case 0x06: case 0x07: case 0x16: case 0x17:
+        // blez, bgtz, blezl and bgtzl
+        emitter.CMP(64, GPR(rs), 0);
+        EmitBranch(inst, addr, inst.opcode & 0x1 ? Condition::LessEqual : Condition::Greater, inst.opcode >= 0x16);
+        return true;
+    case 0x09:
+        // addiu
+        if (rt) {
+            emitter.MOV(32, Reg::RAX, GPR(rs));
+            emitter.ADD(32, Reg::RAX, inst.simm);
+            emitter.MOVSXD(Reg::RAX, Reg::RAX);
+            emitter.MOV(64, GPR(rt), Reg::RAX);
+        }
+
+        return true;
+    case 0x0a: case 0x0b:
+        // slti and sltiu both compare against the sign extended immediate
+        if (rt) {
+            emitter.MOV(64, Reg::RAX, GPR(rs));
+            emitter.CMP(64, Reg::RAX, inst.simm);
+            emitter.SETcc(inst.opcode == 0x0a ? Condition::Less : Condition::Below, Reg::RAX);
+            emitter.MOVZX8(Reg::RAX, Reg::RAX);
+            emitter.MOV(64, GPR(rt), Reg::RAX);
+        }
+
+        return true;
+    case 0x0c: case 0x0d: case 0x0e:
+        // andi, ori and xori zero extend the immediate
+        if (rt) {
+            emitter.MOV(64, Reg::RAX, GPR(rs));
+
+            if (inst.opcode == 0x0c) {
+                emitter.AND(64, Reg::RAX, inst.imm);
+            } else if (inst.opcode == 0x0d) {
+                emitter.OR(64, Reg::RAX, inst.imm);
+            } else {
+                emitter.XOR(64, Reg::RAX, inst.imm);
+            }
+
+            emitter.MOV(64, GPR(rt), Reg::RAX);
+        }
+
+        return true;
+    case 0x0f:
+        // lui
+        if (rt) {
+            emitter.MOV(64, GPR(rt), static_cast<s32>(inst.imm << 16));
+        }
+
+        return true;
+    case 0x11:
+        // fpu.s instructions only need the instruction word, so call into cop1 directly
+        if (rs != 0x10) {
+            return false;
+        }
+
+        switch (inst.func) {
+        case 0x00:
+            EmitCOP1(inst, &COP1Op<&COP1::add_s>);
+            return true;
+        case 0x01:
+            EmitCOP1(inst, &COP1Op<&COP1::sub_s>);
+            return true;
+        case 0x05:
+            EmitCOP1(inst, &COP1Op<&COP1::abs_s>);
+            return true;
+        case 0x06:
+            EmitCOP1(inst, &COP1Op<&COP1::mov_s>);
+            return true;
+        case 0x07:
+            EmitCOP1(inst, &COP1Op<&COP1::neg_s>);
+            return true;
+        case 0x18:
+            EmitCOP1(inst, &COP1Op<&COP1::adda_s>);
+            return true;
+        case 0x19:
+            EmitCOP1(inst, &COP1Op<&COP1::suba_s>);
+            return true;
+        case 0x1c:
+            EmitCOP1(inst, &COP1Op<&COP1::madd_s>);
+            return true;
+        case 0x28:
+            EmitCOP1(inst, &COP1Op<&COP1::max_s>);
+            return true;
+        case 0x29:
+            EmitCOP1(inst, &COP1Op<&COP1::min_s>);
+            return true;
+        case 0x30:
+            EmitCOP1(inst, &COP1CompareFalse);
+            return true;
+        case 0x32:
+            EmitCOP1(inst, &COP1Op<&COP1::c_eq_s>);
+            return true;
+        case 0x34:
+            EmitCOP1(inst, &COP1Op<&COP1::c_lt_s>);
+            return true;
+        case 0x36:
+            EmitCOP1(inst, &COP1Op<&COP1::c_le_s>);
+            return true;
+        }
+
+        return false;
+    case 0x1c:
+        // mmi instructions map onto sse2 where the lane behaviour is identical
+        if (inst.func == 0x08) {
+            switch (inst.imm5) {
+            case 0x00:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDD);
+                return true;
+            case 0x01:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBD);
+                return true;
+            case 0x02:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPGTD);
+                return true;
+            case 0x04:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDW);
+                return true;
+            case 0x05:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBW);
+                return true;
+            case 0x06:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPGTW);
+                return true;
+            case 0x07:
+                EmitSSE(rd, rs, rt, &X64Emitter::PMAXSW);
+                return true;
+            case 0x08:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDB);
+                return true;
+            case 0x09:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBB);
+                return true;
+            case 0x0a:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPGTB);
+                return true;
+            case 0x14:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDSW);
+                return true;
+            case 0x15:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBSW);
+                return true;
+            case 0x18:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDSB);
+                return true;
+            case 0x19:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBSB);
+                return true;
+            }
+        } else if (inst.func == 0x28) {
+            switch (inst.imm5) {
+            case 0x02:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPEQD);
+                return true;
+            case 0x06:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPEQW);
+                return true;
+            case 0x07:
+                EmitSSE(rd, rs, rt, &X64Emitter::PMINSW);
+                return true;
+            case 0x0a:
+                EmitSSE(rd, rs, rt, &X64Emitter::PCMPEQB);
+                return true;
+            case 0x14:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDUSW);
+                return true;
+            case 0x15:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBUSW);
+                return true;
+            case 0x18:
+                EmitSSE(rd, rs, rt, &X64Emitter::PADDUSB);
+                return true;
+            case 0x19:
+                EmitSSE(rd, rs, rt, &X64Emitter::PSUBUSB);
+                return true;
+            }
+        } else if (inst.func == 0x09) {
+            switch (inst.imm5) {
+            case 0x0e:
+                // pcpyld
+                EmitSSE(rd, rt, rs, &X64Emitter::PUNPCKLQDQ);
+                return true;
+            case 0x12:
+                EmitSSE(rd, rs, rt, &X64Emitter::PAND);
+                return true;
+            case 0x13:
+                EmitSSE(rd, rs, rt, &X64Emitter::PXOR);
+                return true;
+            }
+        } else if (inst.func == 0x29) {
+            switch (inst.imm5) {
+            case 0x0e:
+                // pcpyud
+                EmitSSE(rd, rs, rt, &X64Emitter::PUNPCKHQDQ);
+                return true;
+            case 0x12:
+                EmitSSE(rd, rs, rt, &X64Emitter::POR);
+                return true;
+            case 0x13:
+                // pnor
+                if (rd) {
+                    emitter.MOVDQU(XMM::XMM0, GPR(rs));
+                    emitter.MOVDQU(XMM::XMM1, GPR(rt));
+                    emitter.POR(XMM::XMM0, XMM::XMM1);
+                    emitter.PCMPEQD(XMM::XMM1, XMM::XMM1);
+                    emitter.PXOR(XMM::XMM0, XMM::XMM1);
+                    emitter.MOVDQU(GPR(rd), XMM::XMM0);
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    return false;
+}
+
+bool JIT::EmitFastmem(Instruction inst, u32 addr, int index, bool delay_slot) {
+    if (!fastmem_base || slowmem_pcs.count(addr)) {
+        return false;
+    }
+
+    FastmemAccess access = {addr, block_pc, 0, false, false, 0, nullptr};
+
+    switch (inst.opcode) {
+    case 0x1e: case 0x1f:
+        // lq and sq
+        access.bits = 128;
+        access.store = inst.opcode == 0x1f;
+        break;
+    case 0x20: case 0x24: case 0x28:
+        // lb, lbu and sb
+        access.bits = 8;
+        access.sign_extend = inst.opcode == 0x20;
+        access.store = inst.opcode == 0x28;
+        break;
+    case 0x21: case 0x25: case 0x29:
+        // lh, lhu and sh
+        access.bits = 16;
+        access.sign_extend = inst.opcode == 0x21;
+        access.store = inst.opcode == 0x29;
+        break;
+    case 0x23: case 0x27: case 0x2b:
+        // lw, lwu and sw
+        access.bits = 32;
+        access.sign_extend = inst.opcode == 0x23;
+        access.store = inst.opcode == 0x2b;
+        break;
+    case 0x37: case 0x3f:
+        // ld and sd
+        access.bits = 64;
+        access.store = inst.opcode == 0x3f;
+        break;
+    default:
+        return false;
+    }
+
+    emitter.MOV(32, Reg::RCX, GPR(inst.rs));
+    if (inst.simm) {
+        emitter.ADD(32, Reg::RCX, inst.simm);
+    }
+
+    if (access.bits == 128) {
+        emitter.AND(32, Reg::RCX, ~0xf);
+    }
+
+    // keep the guest address around for checking the code pages after a store
+    emitter.MOV(32, Reg::RDX, Reg::RCX);
+    emitter.ADD(64, Reg::RCX, Reg::R12);
+
+    Mem host = Mem{Reg::RCX, 0};
+
+    if (access.store) {
+        if (access.bits == 128) {
+            emitter.MOVDQU(XMM::XMM0, GPR(inst.rt));
+        } else {
+            emitter.MOV(access.bits, Reg::RAX, GPR(inst.rt));
+        }
+    }
+
+    u8* site = emitter.GetCodePointer();
+
+    if (access.store) {
+        if (access.bits == 128) {
+            emitter.MOVDQU(host, XMM::XMM0);
+        } else {
+            emitter.MOV(access.bits, host, Reg::RAX);
+        }
+    } else if (access.bits == 128) {
+        emitter.MOVDQU(XMM::XMM0, host);
+    } else if (access.bits == 64) {
+        emitter.MOV(64, Reg::RAX, host);
+    } else if (access.sign_extend) {
+        emitter.MOVSX(access.bits, Reg::RAX, host);
+    } else {
+        emitter.MOVZX(access.bits, Reg::RAX, host);
+    }
+
+    access.length = emitter.GetCodePointer() - site;
+    fastmem_accesses[site] = access;
+    fastmem_sites.push_back(site);
+
+    if (!access.store) {
+        // the load still happens for a zero destination, since it may have side effects
+        if (inst.rt && access.bits == 128) {
+            emitter.MOVDQU(GPR(inst.rt), XMM::XMM0);
+        } else if (inst.rt) {
+            emitter.MOV(64, GPR(inst.rt), Reg::RAX);
+        }
+
+        return true;
+    }
+
+    emitter.MOV(32, Reg::RAX, Reg::RDX);
+    emitter.SHR(32, Reg::RAX, 12);
+    emitter.MOV(Reg::RSI, reinterpret_cast<u64>(ctx.GetCodePages()));
+    emitter.ADD(64, Reg::RAX, Reg::RSI);
+    emitter.CMP(8, Mem{Reg::RAX, 0}, 0);
+    u8* no_code = emitter.Jcc(Condition::Equal);
+    emitter.MOV(64, Reg::RDI, Reg::RBX);
+    emitter.MOV(32, Reg::RSI, Reg::RDX);
+    emitter.CALL(reinterpret_cast<const void*>(&HandleCodeWrite));
+    emitter.SetJumpTarget(no_code);
+
+    // an mmio store may have started a dma which overwrote code, so this is checked either way
+    emitter.CMP(8, Member(&block_invalidated), 0);
+    early_exits.push_back({emitter.Jcc(Condition::NotEqual), addr + 4, index + 1, delay_slot, false});
+    return true;
+}
+
+void JIT::EmitFallback(Instruction inst, u32 addr, int index, bool delay_slot) {
+    // the deque never moves its elements, so the generated code can point at them
+    CachedInstruction& cached = fallbacks.emplace_back(CachedInstruction{decoder.GetHandler(inst), inst});
+
+    emitter.MOV(32, Member(&ctx.pc), addr);
+    emitter.MOV(64, Reg::RDI, Reg::RBX);
+    emitter.MOV(Reg::RSI, reinterpret_cast<u64>(&cached));
+    emitter.CALL(reinterpret_cast<const void*>(&Interpret));
+
+    if (IsStore(inst)) {
+        // the store may have freed this block, so leave straight away if anything was invalidated
+        emitter.CMP(8, Member(&block_invalidated), 0);
+        early_exits.push_back({emitter.Jcc(Condition::NotEqual), addr + 4, index + 1, delay_slot, false});
+    } else if (EndsBlock(inst)) {
+        emitter.CMP(32, Member(&ctx.pc), addr);
+        early_exits.push_back({emitter.Jcc(Condition::NotEqual), 0, index + 1, delay_slot, true});
+    } else if (IsLikelyBranch(inst)) {
+        // a not taken likely branch has already stepped the pc over its delay slot
+        emitter.CMP(32, Member(&ctx.pc), addr);
+        likely_skips.push_back(emitter.Jcc(Condition::NotEqual));
+    }
+}
+
+void JIT::EmitBranch(Instruction inst, u32 addr, Condition skip_condition, bool likely) {
+    u8* skip = emitter.Jcc(skip_condition);
+
+    emitter.MOV(32, Member(&ctx.npc), addr + (inst.simm << 2) + 4);
+    emitter.MOV(8, Member(&branch_delay), 1);
+
+    if (likely) {
+        likely_skips.push_back(skip);
+    } else {
+        emitter.SetJumpTarget(skip);
+    }
+}
+
+void JIT::EmitJump(u32 target) {
+    emitter.MOV(32, Member(&ctx.npc), target);
+    emitter.MOV(8, Member(&branch_delay), 1);
+}
+
+void JIT::EmitMove(Mem dst, Mem src) {
+    emitter.MOV(64, Reg::RAX, src);
+    emitter.MOV(64, dst, Reg::RAX);
+}
+
+void JIT::EmitSSE(int rd, int rs, int rt, SSEOp op) {
+    if (rd == 0) {
+        return;
+    }
+
+    emitter.MOVDQU(XMM::XMM0, GPR(rs));
+    emitter.MOVDQU(XMM::XMM1, GPR(rt));
+    (emitter.*op)(XMM::XMM0, XMM::XMM1);
+    emitter.MOVDQU(GPR(rd), XMM::XMM0);
+}
+
+void JIT::EmitCOP1(Instruction inst, void (*function)(COP1* cop1, u32 data)) {
+    emitter.MOV(Reg::RDI, reinterpret_cast<u64>(&ctx.cop1));
+    emitter.MOV(Reg::RSI, inst.data);
+    emitter.CALL(reinterpret_cast<const void*>(function));
+}
+
+void JIT::EmitUpdateCycles(int cycles) {
+    // al is left set if an interrupt redirected the pc
+    emitter.SUB(32, Member(&cycles_left), cycles);
+    emitter.XOR(32, Reg::RAX, Reg::RAX);
+    emitter.CMP(8, Member(&ctx.cop0.interrupt_pending), 0);
+    u8* no_interrupt = emitter.Jcc(Condition::Equal);
+    emitter.MOV(64, Reg::RDI, Reg::RBX);
+    emitter.CALL(reinterpret_cast<const void*>(&HandleInterrupts));
+    emitter.SetJumpTarget(no_interrupt);
+}
+
+void JIT::EmitLinkedExit() {
+    // return to the dispatcher if an interrupt redirected the pc or we're out of cycles.
+    // otherwise the jump initially goes to a stub which asks the dispatcher to link it
+    emitter.TEST(8, Reg::RAX, Reg::RAX);
+    emitter.Jcc(Condition::NotEqual, exit_block);
+    emitter.CMP(32, Member(&cycles_left), 0);
+    emitter.Jcc(Condition::LessEqual, exit_block);
+
+    u8* site = emitter.JMP();
+    emitter.MOV(Reg::RAX, reinterpret_cast<u64>(site));
+    emitter.MOV(64, Member(&link_site), Reg::RAX);
+    emitter.JMP(exit_block);
+}
+
+void JIT::EmitEarlyExit(EarlyExit& early_exit) {
+    emitter.SetJumpTarget(early_exit.jump);
+
+    if (early_exit.redirected) {
+        // exceptions set the pc to 4 before the handler
+        emitter.ADD(32, Member(&ctx.pc), 4);
+    } else {
+        emitter.MOV(32, Member(&ctx.pc), early_exit.pc);
+    }
+
+    if (early_exit.delay_slot) {
+        emitter.MOV(8, Reg::RAX, Member(&branch_delay));
+        emitter.TEST(8, Reg::RAX, Reg::RAX);
+        u8* not_taken = emitter.Jcc(Condition::Equal);
+        emitter.MOV(8, Member(&branch_delay), 0);
+        emitter.MOV(8, Member(&branch), 0);
+        EmitMove(Member(&ctx.pc), Member(&ctx.npc));
+        emitter.SetJumpTarget(not_taken);
+    }
+
+    EmitUpdateCycles(early_exit.cycles);
+    emitter.JMP(exit_block);
+}
+
+void JIT::EmitSlowmem(u8* site) {
+    FastmemAccess& access = fastmem_accesses[site];
+    access.slow_path = emitter.GetCodePointer();
+
+    // rdx still holds the guest address, and rax or xmm0 the value to store
+    emitter.MOV(32, Member(&slowmem_vaddr), Reg::RDX);
+    if (access.store && access.bits == 128) {
+        emitter.MOVDQU(Member(&slowmem_value), XMM::XMM0);
+    } else if (access.store) {
+        emitter.MOV(64, Member(&slowmem_value), Reg::RAX);
+    }
+
+    emitter.MOV(64, Reg::RDI, Reg::RBX);
+    emitter.MOV(Reg::RSI, reinterpret_cast<u64>(&access));
+    emitter.CALL(reinterpret_cast<const void*>(&SlowmemAccess));
+
+    if (access.store) {
+        emitter.MOV(32, Reg::RDX, Member(&slowmem_vaddr));
+    } else if (access.bits == 128) {
+        emitter.MOVDQU(XMM::XMM0, Member(&slowmem_value));
+    } else {
+        emitter.MOV(64, Reg::RAX, Member(&slowmem_value));
+    }
+
+    emitter.JMP(site + access.length);
+}
+
+void JIT::FreeBlock(std::unordered_map<u32, Block>::iterator it) {
+    // point any jumps into this block back at their link stubs
+    for (u8* site : it->second.incoming_links) {
+        X64Emitter::SetJumpTarget(site, site + 4);
+    }
+
+    blocks.erase(it);
+}
+
+bool JIT::HandleFault(void* context) {
+#if defined(__linux__) && defined(__x86_64__)
+    // this runs inside the signal handler, so the access itself is left to the slow path,
+    // which runs on the normal stack once the handler returns
+    auto uc = reinterpret_cast<ucontext_t*>(context);
+    auto rip = reinterpret_cast<u8*>(uc->uc_mcontext.gregs[REG_RIP]);
+    auto it = fastmem_accesses.find(rip);
+    if (it == fastmem_accesses.end()) {
+        return false;
+    }
+
+    uc->uc_mcontext.gregs[REG_RIP] = reinterpret_cast<greg_t>(it->second.slow_path);
+    return true;
+#else
+    return false;
+#endif
+}
+
+Mem JIT::GPR(int reg, int offset) {
+    return Member(&ctx.gpr[reg * 16 + offset]);
+}
+
+Mem JIT::Member(void* field) {
+    s64 offset = reinterpret_cast<u8*>(field) - reinterpret_cast<u8*>(this);
+    if (offset < INT32_MIN || offset > INT32_MAX) {
+        common::Error("[ee::JIT] field is out of range of the jit pointer");
+    }
+
+    return Mem{Reg::RBX, static_cast<s32>(offset)};
+}
+
+void JIT::Interpret(JIT* jit, const CachedInstruction* cached) {
+    jit->inst = cached->inst;
+    (jit->*cached->handler)();
+}
+
+bool JIT::HandleInterrupts(JIT* jit) {
+    u32 pc = jit->ctx.pc;
+    jit->CheckInterrupts();
+    return jit->ctx.pc != pc;
+}
+
+void JIT::HandleCodeWrite(JIT* jit, u32 vaddr) {
+    jit->ctx.InvalidateCode(vaddr);
+}
+
+void JIT::SlowmemAccess(JIT* jit, FastmemAccess* access) {
+    Context& ctx = jit->ctx;
+    u32 vaddr = jit->slowmem_vaddr;
+    u128& value = jit->slowmem_value;
+
+    if (access->store) {
+        switch (access->bits) {
+        case 8:
+            ctx.write<u8>(vaddr, value.lo);
+            break;
+        case 16:
+            ctx.write<u16>(vaddr, value.lo);
+            break;
+        case 32:
+            ctx.write<u32>(vaddr, value.lo);
+            break;
+        case 64:
+            ctx.write<u64>(vaddr, value.lo);
+            break;
+        case 128:
+            ctx.write<u128>(vaddr, value);
+            break;
+        }
+    } else {
+        switch (access->bits) {
+        case 8:
+            value.lo = access->sign_extend ? static_cast<s8>(ctx.read<u8>(vaddr)) : ctx.read<u8>(vaddr);
+            break;
+        case 16:
+            value.lo = access->sign_extend ? static_cast<s16>(ctx.read<u16>(vaddr)) : ctx.read<u16>(vaddr);
+            break;
+        case 32:
+            // widened first, since the conditional would otherwise convert it back to u32
+            value.lo = access->sign_extend ? static_cast<s64>(static_cast<s32>(ctx.read<u32>(vaddr))) : ctx.read<u32>(vaddr);
+            break;
+        case 64:
+            value.lo = ctx.read<u64>(vaddr);
+            break;
+        case 128:
+            value = ctx.read<u128>(vaddr);
+            break;
+        }
+    }
+
+    // this access goes to mmio, so it will take the slow path once its block is recompiled.
+    // the block is still allowed to finish, since its code is only reclaimed on a flush
+    jit->slowmem_pcs.insert(access->pc);
+
+    auto block = jit->blocks.find(access->block_pc);
+    if (block != jit->blocks.end()) {
+        jit->FreeBlock(block);
+    }
+
+    jit->block_invalidated = true;
+}
+
+void JIT::COP1CompareFalse(COP1* cop1, u32) {
+    cop1->c_f_s();
+}
+
+} // namespace ee
\ No newline at end of file
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "common/code_cache.h"
+#include "common/fastmem.h"
+#include "common/x64_emitter.h"
+#include "core/ee/cop1.h"
+#include "core/ee/interpreter.h"
+
+namespace ee {
+
+struct Context;
+
+// recompiles ee basic blocks into x86-64 code. instructions without a native
+// translation call the interpreter handler which was resolved at compile time
+struct JIT : public Interpreter {
+    JIT(Context& ctx);
+    ~JIT();
+
+    void Reset() override;
+    void Run(int cycles) override;
+    void InvalidatePage(int page) override;
+
+private:
+    using Handler = decltype(&Interpreter::illegal_instruction);
+    using Entry = void (*)(JIT* jit, const u8* code);
+    using SSEOp = void (common::X64Emitter::*)(common::XMM, common::XMM);
+
+    struct CachedInstruction {
+        Handler handler;
+        Instruction inst;
+    };
+
+    struct Block {
+        u8* code;
+
+        // jumps in other blocks which are linked directly to this block
+        std::vector<u8*> incoming_links;
+    };
+
+    // jumps to paths which leave the block early, these get emitted after the block body
+    struct EarlyExit {
+        u8* jump;
+        u32 pc;
+        int cycles;
+        bool delay_slot;
+        bool redirected;
+    };
+
+    // a load or store into the fastmem arena which faults if the address isn't backed by memory
+    struct FastmemAccess {
+        u32 pc;
+        u32 block_pc;
+        int bits;
+        bool sign_extend;
+        bool store;
+        int length;
+
+        // out of line code which makes the access through the context instead
+        u8* slow_path;
+    };
+
+    Block& GetBlock(u32 pc);
+    Block& CompileBlock(u32 pc);
+    void RegisterBlockPage(u32 pc, u32 addr);
+    void Flush();
+    void EmitDispatcher();
+
+    void EmitInstruction(Instruction inst, u32 addr, int index, bool delay_slot);
+    bool EmitNative(Instruction inst, u32 addr);
+    bool EmitFastmem(Instruction inst, u32 addr, int index, bool delay_slot);
+    void EmitFallback(Instruction inst, u32 addr, int index, bool delay_slot);
+    void EmitBranch(Instruction inst, u32 addr, common::Condition skip_condition, bool likely);
+    void EmitJump(u32 target);
+    void EmitMove(common::Mem dst, common::Mem src);
+    void EmitSSE(int rd, int rs, int rt, SSEOp op);
+    void EmitCOP1(Instruction inst, void (*function)(COP1* cop1, u32 data));
+    void EmitUpdateCycles(int cycles);
+    void EmitLinkedExit();
+    void EmitEarlyExit(EarlyExit& early_exit);
+    void EmitSlowmem(u8* site);
+    void FreeBlock(std::unordered_map<u32, Block>::iterator it);
+    bool HandleFault(void* context);
+
+    common::Mem GPR(int reg, int offset = 0);
+    common::Mem Member(void* field);
+
+    static void Interpret(JIT* jit, const CachedInstruction* cached);
+    static bool HandleInterrupts(JIT* jit);
+    static void HandleCodeWrite(JIT* jit, u32 vaddr);
+    static void SlowmemAccess(JIT* jit, FastmemAccess* access);
+
+    template <void (COP1::*op)(Instruction)>
+    static void COP1Op(COP1* cop1, u32 data) {
+        (cop1->*op)(Instruction{data});
+    }
+
+    static void COP1CompareFalse(COP1* cop1, u32 data);
+
+    static constexpr u32 CODE_CACHE_SIZE = 32 * 1024 * 1024;
+    static constexpr u32 MIN_FREE_SPACE = 64 * 1024;
+    static constexpr int MAX_BLOCK_SIZE = 64;
+
+    common::CodeCache code_cache;
+    common::X64Emitter emitter;
+    Entry enter;
+    u8* exit_block;
+
+    std::unordered_map<u32, Block> blocks;
+    std::vector<std::vector<u32>> page_blocks;
+    std::deque<CachedInstruction> fallbacks;
+
+    // r12 holds the fastmem base inside blocks. the fault handler only moves an access which
+    // faults onto its slow path, which emulates it and makes the instruction use the interpreter
+    // from then on. the address and value are passed through here
+    u8* fastmem_base;
+    std::unordered_map<u8*, FastmemAccess> fastmem_accesses;
+    std::unordered_set<u32> slowmem_pcs;
+    common::FaultHandler fault_handler;
+    u32 slowmem_vaddr;
+    u128 slowmem_value;
+
+    // state only used while compiling a block
+    std::vector<EarlyExit> early_exits;
+    std::vector<u8*> likely_skips;
+    std::vector<u8*> fastmem_sites;
+    u32 block_pc;
+
+    int cycles_left;
+    u8* link_site;
+    bool block_invalidated;
+};
+
+} // namespace ee
\ No newline at end of file
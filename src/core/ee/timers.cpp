@@ -1,38 +1,49 @@
+#include <algorithm>
 #include "common/log.h"
 #include "core/ee/timers.h"
 
 namespace ee {
 
-Timers::Timers(INTC& intc) : intc(intc) {}
+Timers::Timers(INTC& intc, Scheduler& scheduler) : intc(intc), scheduler(scheduler) {
+    scheduler.RegisterEvent(EventType::EETimer, &TimerEvent);
+}
 
 void Timers::Reset() {
     for (int i = 0; i < 4; i++) {
+        scheduler.Cancel(channels[i].event);
+
         channels[i].counter = 0;
         channels[i].control = 0;
         channels[i].compare = 0;
         channels[i].hold = 0;
-        channels[i].cycles = 0;
-        channels[i].cycles_per_tick = 0;
+        channels[i].cycles_per_tick = BUS_CYCLE;
+        channels[i].base_time = scheduler.GetCurrentTime();
     }
 }
 
-void Timers::Run(int cycles) {
-    for (int i = 0; i < 4; i++) {
-        if (channels[i].control & (1 << 7)) {
-            channels[i].cycles += cycles;
-            Increment(i);
-        }
-    }
+void Timers::RegisterIO(common::IOMap& io) {
+    io.Map(0x10000000, 0x10001840, this, [](Timers* timers, u32 paddr) {
+        return timers->ReadRegister(paddr);
+    }, [](Timers* timers, u32 paddr, u32 value) {
+        timers->WriteRegister(paddr, value);
+    });
 }
 
 u32 Timers::ReadRegister(u32 addr) {
     int index = (addr >> 11) & 0x3;
 
     switch (addr & 0xFF) {
+    case 0x00:
+        Sync(index);
+        return channels[index].counter;
     case 0x10:
         return channels[index].control;
     case 0x14:
         return 0;
+    case 0x20:
+        return channels[index].compare;
+    case 0x30:
+        return channels[index].hold;
     default:
         common::Error("[Timers] handle %02x", addr & 0xFF);
     }
@@ -43,47 +54,46 @@ u32 Timers::ReadRegister(u32 addr) {
 void Timers::WriteRegister(u32 addr, u32 data) {
     int index = (addr >> 11) & 0x3;
 
+    // bring the counter up to date with the old settings before changing them
+    Sync(index);
+
     switch (addr & 0xFF) {
     case 0x00:
         common::Log("[Timer] T%d TN_COUNT write %04x", index, data);
-        channels[index].counter = data;
+        channels[index].counter = data & 0xFFFF;
+        channels[index].base_time = scheduler.GetCurrentTime();
         break;
     case 0x4:
         break;
     case 0x10:
         common::Log("[Timer] T%d TN_MODE write %04x", index, data);
-        channels[index].control = data;
+        channels[index].control = (channels[index].control & 0xC00) | (data & 0x3FF);
 
         // writing 1 to bit 10 or 11 clears them
-        if (data & (1 << 10)) {
-            channels[index].control &= ~(1 << 10);
-        }
-
-        if (data & (1 << 11)) {
-            channels[index].control &= ~(1 << 11);
-        }
+        channels[index].control &= ~(data & 0xC00);
 
-        // update how many timer cycles are required to increment the corresponding channel
+        // update how many ee cycles are required to increment the corresponding channel
         // counter by 1
         switch (channels[index].control & 0x3) {
         case 0:
             // bus clock
-            channels[index].cycles_per_tick = 1;
+            channels[index].cycles_per_tick = BUS_CYCLE;
             break;
         case 1:
             // bus clock / 16
-            channels[index].cycles_per_tick = 16;
+            channels[index].cycles_per_tick = BUS_CYCLE * 16;
             break;
         case 2:
             // bus block / 256
-            channels[index].cycles_per_tick = 256;
+            channels[index].cycles_per_tick = BUS_CYCLE * 256;
             break;
         case 3:
             // hblank
-            channels[index].cycles_per_tick = 9370;
+            channels[index].cycles_per_tick = BUS_CYCLE * 9370;
             break;
         }
 
+        channels[index].base_time = scheduler.GetCurrentTime();
         break;
     case 0x14:
         break;
@@ -98,6 +108,8 @@ void Timers::WriteRegister(u32 addr, u32 data) {
     default:
         common::Error("[Timer] handle address %08x", addr);
     }
+
+    ScheduleEvent(index);
 }
 
 u32 Timers::ReadChannel(u32 addr) {
@@ -111,55 +123,133 @@ u32 Timers::ReadChannel(u32 addr) {
     return 0;
 }
 
-void Timers::Increment(int index) {
-    // if enough ticks have passed then we can increment the timer counter by 1
-    if (channels[index].cycles >= channels[index].cycles_per_tick) {
-        channels[index].cycles -= channels[index].cycles_per_tick;
-    } else {
-        // don't do any further calculations as
-        // counter wouldn't have changed
+void Timers::Sync(int index) {
+    Channel& channel = channels[index];
+    u64 now = scheduler.GetCurrentTime();
+
+    if (!(channel.control & (1 << 7))) {
+        // counter is stopped
+        channel.base_time = now;
         return;
     }
 
-    channels[index].counter++;
+    // any partial tick is carried over by only moving the base time forward by whole ticks
+    u64 ticks = (now - channel.base_time) / channel.cycles_per_tick;
+    channel.base_time += ticks * channel.cycles_per_tick;
+    Advance(channel, ticks);
+}
 
-    if (channels[index].counter == channels[index].compare) {
-        if (channels[index].control & (1 << 6)) {
-            channels[index].counter = 0;
-        }
+void Timers::Advance(Channel& channel, u64 ticks) {
+    u64 counter = channel.counter + ticks;
+
+    if ((channel.control & (1 << 6)) && channel.compare != 0) {
+        // the counter goes back to 0 when it reaches compare. if it's
+        // already past compare then it has to overflow first
+        if (channel.counter >= channel.compare) {
+            if (counter <= 0xFFFF) {
+                channel.counter = counter;
+                return;
+            }
 
-        if (channels[index].control & (1 << 8)) {
-            common::Error("handle timer interrupt with compare");
+            counter -= 0x10000;
         }
+
+        channel.counter = counter % channel.compare;
+    } else {
+        channel.counter = counter & 0xFFFF;
+    }
+}
+
+u64 Timers::TicksUntilCompare(Channel& channel) {
+    if (channel.counter < channel.compare) {
+        return channel.compare - channel.counter;
     }
 
-    if (channels[index].counter > 0xFFFF) {
-        channels[index].counter = 0;
-
-        // timer interrupts are edge triggered,
-        // meaning they can only be requested
-        // if either interrupt bit goes from 0 to 1
-        if ((channels[index].control & (1 << 9)) && !(channels[index].control & (1 << 11))) {
-            // set the overflow interrupt flag and request a timer interrupt
-            channels[index].control |= (1 << 11);
-            
-            common::Log("[Timer] T%d request overflow interrupt", index);
-
-            switch (index) {
-            case 0:
-                intc.RequestInterrupt(InterruptSource::Timer0);
-                break;
-            case 1:
-                intc.RequestInterrupt(InterruptSource::Timer1);
-                break;
-            case 2:
-                intc.RequestInterrupt(InterruptSource::Timer2);
-                break;
-            case 3:
-                intc.RequestInterrupt(InterruptSource::Timer3);
-                break;
-            }
-        }
+    return 0x10000 - channel.counter + channel.compare;
+}
+
+u64 Timers::TicksUntilOverflow(Channel& channel) {
+    if ((channel.control & (1 << 6)) && channel.counter < channel.compare) {
+        // counter resets before it can overflow
+        return NEVER;
+    }
+
+    return 0x10000 - channel.counter;
+}
+
+void Timers::ScheduleEvent(int index) {
+    Channel& channel = channels[index];
+    scheduler.Cancel(channel.event);
+
+    bool compare_interrupt = channel.control & (1 << 8);
+    bool overflow_interrupt = channel.control & (1 << 9);
+    if (!(channel.control & (1 << 7)) || (!compare_interrupt && !overflow_interrupt)) {
+        return;
+    }
+
+    u64 ticks = NEVER;
+    if (compare_interrupt) {
+        ticks = TicksUntilCompare(channel);
+    }
+
+    if (overflow_interrupt) {
+        ticks = std::min(ticks, TicksUntilOverflow(channel));
+    }
+
+    // with only the overflow interrupt enabled, the counter can go back to 0 at compare before it ever overflows
+    if (ticks == NEVER) {
+        return;
+    }
+
+    // base time is at most one partial tick behind the current time after a sync.
+    // the delay saturates so that it can never wrap around into the past
+    u64 cycles = ticks > MAX_DELAY / channel.cycles_per_tick ? MAX_DELAY : ticks * channel.cycles_per_tick;
+    u64 delay = cycles - (scheduler.GetCurrentTime() - channel.base_time);
+    channel.event = scheduler.Add(delay, EventType::EETimer, this, index);
+}
+
+void Timers::TimerEvent(void* context, u64 index) {
+    auto timers = reinterpret_cast<Timers*>(context);
+    Channel& channel = timers->channels[index];
+
+    // work out which of the two conditions has been reached before the counter moves past them
+    u64 ticks = (timers->scheduler.GetCurrentTime() - channel.base_time) / channel.cycles_per_tick;
+    bool compare = timers->TicksUntilCompare(channel) <= ticks;
+    bool overflow = timers->TicksUntilOverflow(channel) <= ticks;
+    timers->Sync(index);
+
+    // timer interrupts are edge triggered,
+    // meaning they can only be requested
+    // if either interrupt bit goes from 0 to 1
+    if (compare && (channel.control & (1 << 8)) && !(channel.control & (1 << 10))) {
+        channel.control |= (1 << 10);
+        common::Log("[Timer] T%d request compare interrupt", index);
+        timers->RequestInterrupt(index);
+    }
+
+    if (overflow && (channel.control & (1 << 9)) && !(channel.control & (1 << 11))) {
+        channel.control |= (1 << 11);
+        common::Log("[Timer] T%d request overflow interrupt", index);
+        timers->RequestInterrupt(index);
+    }
+
+    timers->ScheduleEvent(index);
+}
+
+void Timers::RequestInterrupt(int index) {
+    switch (index) {
+    case 0:
+        intc.RequestInterrupt(InterruptSource::Timer0);
+        break;
+    case 1:
+        intc.RequestInterrupt(InterruptSource::Timer1);
+        break;
+    case 2:
+        intc.RequestInterrupt(InterruptSource::Timer2);
+        break;
+    case 3:
+        intc.RequestInterrupt(InterruptSource::Timer3);
+        break;
     }
 }
 
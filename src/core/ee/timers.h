@@ -1,36 +1,60 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/log.h"
 #include "core/ee/intc.h"
+#include "core/scheduler.h"
 
 namespace ee {
 
 class Timers {
 public:
-    Timers(INTC& intc);
+    Timers(INTC& intc, Scheduler& scheduler);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
     u32 ReadRegister(u32 addr);
     void WriteRegister(u32 addr, u32 data);
     
     u32 ReadChannel(u32 addr);
-
-    void Increment(int index);
-    void Run(int cycles);
     
 private:
     struct Channel {
+        // value of the counter at base_time
         u32 counter;
         u16 control;
         u16 compare;
         u16 hold;
-        int cycles;
-        int cycles_per_tick;
+
+        // ee cycles per counter increment
+        u64 cycles_per_tick;
+        u64 base_time;
+        EventHandle event;
     };
 
+    // counters aren't incremented every cycle, instead they're brought up to date
+    // from the scheduler time whenever they're accessed, and the next compare or
+    // overflow interrupt is scheduled as an event
+    void Sync(int index);
+    void Advance(Channel& channel, u64 ticks);
+    u64 TicksUntilCompare(Channel& channel);
+    u64 TicksUntilOverflow(Channel& channel);
+    void ScheduleEvent(int index);
+    static void TimerEvent(void* context, u64 index);
+    void RequestInterrupt(int index);
+
+    static constexpr u64 NEVER = 0xffffffffffffffff;
+
+    // far enough away that adding it to the current time can't wrap
+    static constexpr u64 MAX_DELAY = 1ull << 62;
+
+    // the timers are clocked by the bus, which runs at half the speed of the ee
+    static constexpr u64 BUS_CYCLE = 2;
+
     Channel channels[4];
     INTC& intc;
+    Scheduler& scheduler;
 };
 
 } // namespace ee
\ No newline at end of file
@@ -44,14 +44,8 @@ void ELFLoader::LoadHeader() {
         ProgramHeader program_header;
         memcpy(&program_header, &elf[header_offset], sizeof(ProgramHeader));
         
-        // now copy the segment into the EEBus word by word
-        for (u32 program_offset = program_header.offset; program_offset < (program_header.offset + program_header.filesz); program_offset += 4) {
-            u32 data = 0;
-            memcpy(&data, &elf[program_offset], 4);
-
-            system.ee.write<u32>(program_header.paddr, data);
-            program_header.paddr += 4;
-        }
+        // now copy the segment onto the physical bus in one go
+        system.ee.WritePhysical(program_header.paddr & 0x1fffffff, &elf[program_header.offset], program_header.filesz);
     }
 
     common::Log("[ELFLoader] entrypoint: %08x", header.entry);
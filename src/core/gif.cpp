@@ -1,8 +1,10 @@
+#include <algorithm>
+#include <emmintrin.h>
 #include "common/log.h"
 #include "core/gif.h"
 #include "core/system.h"
 
-GIF::GIF(gs::Context& gs) : gs(gs) {}
+GIF::GIF(gs::Thread& gs) : gs(gs) {}
 
 void GIF::Reset() {
     ctrl = 0;
@@ -17,6 +19,25 @@ void GIF::Reset() {
     current_tag.reglist = 0;
     current_tag.reglist_offset = 0;
     current_tag.transfers_left = 0;
+    current_tag.q = 0x3f800000;
+    current_tag.vertex_list = false;
+    write_count = 0;
+    vertex_state.rgbaq = 0;
+    vertex_state.st = 0;
+    vertex_state.uv = 0;
+    vertex_batch.count = 0;
+}
+
+void GIF::RegisterIO(common::IOMap& io) {
+    io.Map(0x10003000, 0x100030a4, this, [](GIF* gif, u32 paddr) {
+        return gif->ReadRegister(paddr);
+    }, [](GIF* gif, u32 paddr, u32 value) {
+        gif->WriteRegister(paddr, value);
+    });
+
+    io.MapWrite(0x10006000, 0x10006010, this, [](GIF* gif, u32 paddr, u32 value) {
+        gif->WriteRegister(paddr, value);
+    });
 }
 
 void GIF::SystemReset() {
@@ -24,12 +45,9 @@ void GIF::SystemReset() {
 }
 
 void GIF::Run(int cycles) {
-    while (!fifo.Empty() && cycles--) {
-        if (current_tag.transfers_left) {
-            ProcessTag();
-        } else {
-            StartTransfer();
-        }
+    while (fifo.GetLength() >= 4 && cycles--) {
+        u128 data = fifo.PopValue<u128>();
+        ProcessPacket(std::span<const u128>(&data, 1));
     }
 }
 
@@ -67,36 +85,119 @@ void GIF::WriteRegister(u32 addr, u32 value) {
 }
 
 void GIF::WriteFIFO(u32 value) {
-    fifo.Push<u32>(value);
+    fifo.Push(value);
     // common::Log("[GIF] push to fifo %08x", value);
-    if (fifo.GetLength() == fifo.GetSize()) {
+    if (fifo.Full()) {
         common::Error("[GIF] no more space left in fifo");
     }
 }
 
-void GIF::SendPath3(u128 value) {
-    // common::Log("[GIF] send path3 %016lx%016lx format %d", value.hi, value.lo);
-    fifo.Push<u128>(value);
+void GIF::SendPath3(std::span<const u128> data) {
+    // anything already in the fifo has to be processed first to keep the data in order
+    Run(fifo.GetLength() / 4);
+    ProcessPacket(data);
+}
+
+void GIF::ProcessPacket(std::span<const u128> data) {
+    while (!data.empty()) {
+        if (!current_tag.transfers_left) {
+            StartTransfer(data[0]);
+            data = data.subspan(1);
+            continue;
+        }
+
+        u32 used = 0;
+        switch (current_tag.format) {
+        case 0:
+            used = ProcessPacked(data);
+            break;
+        case 1:
+            used = ProcessRegList(data);
+            break;
+        case 2:
+        case 3:
+            used = ProcessImage(data);
+            break;
+        }
+
+        data = data.subspan(used);
+
+        // giftags can change gs state directly, so the writes from this one have to land first
+        FlushWrites();
+    }
+}
+
+u32 GIF::ProcessPacked(std::span<const u128> data) {
+    u32 count = std::min<u32>(data.size(), current_tag.transfers_left);
+    u32 i = 0;
+
+    while (i < count) {
+        // whole loops of a register list that only holds vertex attributes are unpacked straight into a vertex batch
+        if (current_tag.vertex_list && current_tag.reglist_offset == 0 && (count - i) >= current_tag.nregs) {
+            u32 loops = (count - i) / current_tag.nregs;
+            UnpackVertices(&data[i], loops);
+            i += loops * current_tag.nregs;
+            continue;
+        }
+
+        ProcessPackedRegister(data[i]);
+        i++;
+    }
+
+    current_tag.transfers_left -= count;
+    return count;
 }
 
-void GIF::ProcessPacked(u128 data) {
+void GIF::ProcessPackedRegister(const u128& data) {
     u8 reg = (current_tag.reglist >> (current_tag.reglist_offset * 4)) & 0xf;
 
     switch (reg) {
     case 0x0:
-        gs.WriteRegister(0x00, data.uw[0] & 0x7ff);
+        AddWrite(0x00, data.uw[0] & 0x7ff);
         break;
     case 0x1:
-        common::Log("[GIF] write rgbaq");
+        AddWrite(0x01, DecodeRGBAQ(data, current_tag.q));
+        break;
+    case 0x2:
+        // q is kept by the gif until the next rgbaq
+        AddWrite(0x02, data.lo);
+        current_tag.q = data.uw[2];
+        break;
+    case 0x3:
+        AddWrite(0x03, DecodeUV(data));
+        break;
+    case 0x4:
+        // the adc bit disables the drawing kick
+        AddWrite((data.uw[3] & 0x8000) ? 0x0c : 0x04, DecodeXYZF(data));
+        break;
+    case 0x5:
+        AddWrite((data.uw[3] & 0x8000) ? 0x0d : 0x05, DecodeXYZ(data));
+        break;
+    case 0x6:
+    case 0x7:
+    case 0x8:
+    case 0x9:
+        // tex0 and clamp are written as is
+        AddWrite(reg, data.lo);
         break;
     case 0xa:
-        common::Log("[GIF] write fog");
+        AddWrite(0x0a, static_cast<u64>((data.uw[3] >> 4) & 0xff) << 56);
+        break;
+    case 0xb:
+        common::Log("[GIF] write to reserved register in packed mode");
+        break;
+    case 0xc:
+        AddWrite(0x0c, DecodeXYZF(data));
+        break;
+    case 0xd:
+        AddWrite(0x0d, DecodeXYZ(data));
         break;
     case 0xe:
-        gs.WriteRegister(data.hi & 0xFF, data.lo);
+        AddWrite(data.hi & 0xff, data.lo);
+        break;
+    case 0xf:
+        // nop
         break;
-    default:
-        common::Error("[GIF] handle register %02x", reg);
     }
 
     current_tag.reglist_offset++;
@@ -106,14 +207,211 @@ void GIF::ProcessPacked(u128 data) {
     }
 }
 
-void GIF::ProcessImage(u128 data) {
-    gs.WriteHWReg(data.lo);
-    gs.WriteHWReg(data.hi);
+void GIF::UnpackVertices(const u128* data, u32 loops) {
+    // anything written to the gs so far has to land before these vertices are kicked
+    FlushWrites();
+
+    vertex_batch.count = 0;
+
+    // the most common register lists get their own unrolled loop
+    u64 pattern = current_tag.nregs == 16 ? current_tag.reglist : current_tag.reglist & ((1ull << (current_tag.nregs * 4)) - 1);
+
+    if (current_tag.nregs == 3 && pattern == 0x512) {
+        UnpackVertexLoops<0x2, 0x1, 0x5>(data, loops);
+    } else if (current_tag.nregs == 3 && pattern == 0x412) {
+        UnpackVertexLoops<0x2, 0x1, 0x4>(data, loops);
+    } else if (current_tag.nregs == 3 && pattern == 0x513) {
+        UnpackVertexLoops<0x3, 0x1, 0x5>(data, loops);
+    } else if (current_tag.nregs == 2 && pattern == 0x51) {
+        UnpackVertexLoops<0x1, 0x5>(data, loops);
+    } else if (current_tag.nregs == 2 && pattern == 0x41) {
+        UnpackVertexLoops<0x1, 0x4>(data, loops);
+    } else {
+        for (u32 i = 0; i < loops * current_tag.nregs; i++) {
+            switch ((current_tag.reglist >> ((i % current_tag.nregs) * 4)) & 0xf) {
+            case 0x1:
+                UnpackVertexRegister<0x1>(data[i]);
+                break;
+            case 0x2:
+                UnpackVertexRegister<0x2>(data[i]);
+                break;
+            case 0x3:
+                UnpackVertexRegister<0x3>(data[i]);
+                break;
+            case 0x4:
+                UnpackVertexRegister<0x4>(data[i]);
+                break;
+            case 0x5:
+                UnpackVertexRegister<0x5>(data[i]);
+                break;
+            case 0xc:
+                UnpackVertexRegister<0xc>(data[i]);
+                break;
+            case 0xd:
+                UnpackVertexRegister<0xd>(data[i]);
+                break;
+            }
+        }
+    }
+
+    FlushVertices();
+}
+
+template <u8... regs>
+void GIF::UnpackVertexLoops(const u128* data, u32 loops) {
+    for (u32 i = 0; i < loops; i++) {
+        int offset = 0;
+        (UnpackVertexRegister<regs>(data[offset++]), ...);
+        data += sizeof...(regs);
+    }
+}
+
+template <u8 reg>
+void GIF::UnpackVertexRegister(const u128& data) {
+    if constexpr (reg == 0x1) {
+        vertex_state.rgbaq = DecodeRGBAQ(data, current_tag.q);
+    } else if constexpr (reg == 0x2) {
+        vertex_state.st = data.lo;
+        current_tag.q = data.uw[2];
+    } else if constexpr (reg == 0x3) {
+        vertex_state.uv = DecodeUV(data);
+    } else if constexpr (reg == 0x4 || reg == 0xc) {
+        u64 value = DecodeXYZF(data);
+        bool draw = reg == 0x4 && !(data.uw[3] & 0x8000);
+        AddVertex(value, (value >> 32) & 0xffffff, gs::VertexBatch::Fog | (draw ? gs::VertexBatch::Draw : 0));
+    } else if constexpr (reg == 0x5 || reg == 0xd) {
+        u64 value = DecodeXYZ(data);
+        bool draw = reg == 0x5 && !(data.uw[3] & 0x8000);
+        AddVertex(value, value >> 32, draw ? gs::VertexBatch::Draw : 0);
+    }
+}
+
+void GIF::AddVertex(u64 xyz, u32 z, u8 flags) {
+    if (vertex_batch.count == gs::VertexBatch::MAX_VERTICES) {
+        FlushVertices();
+    }
+
+    int index = vertex_batch.count++;
+    vertex_batch.x[index] = xyz & 0xffff;
+    vertex_batch.y[index] = (xyz >> 16) & 0xffff;
+    vertex_batch.z[index] = z;
+    vertex_batch.fog[index] = xyz >> 56;
+    vertex_batch.flags[index] = flags;
+    vertex_batch.rgbaq[index] = vertex_state.rgbaq;
+    vertex_batch.st[index] = vertex_state.st;
+    vertex_batch.uv[index] = vertex_state.uv;
+}
+
+void GIF::FlushVertices() {
+    vertex_batch.final_rgbaq = vertex_state.rgbaq;
+    vertex_batch.final_st = vertex_state.st;
+    vertex_batch.final_uv = vertex_state.uv;
+    gs.WriteVertices(vertex_batch);
+    vertex_batch.count = 0;
+}
+
+bool GIF::IsVertexRegister(u8 reg) {
+    // rgbaq, st, uv, xyzf2, xyz2, xyzf3 and xyz3
+    return (0x303e >> reg) & 0x1;
+}
+
+u64 GIF::DecodeRGBAQ(const u128& data, u32 q) {
+    // each colour component is in the low byte of its own word, so
+    // mask them and pack the words down to bytes
+    __m128i colour = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&data)), _mm_set1_epi32(0xff));
+    colour = _mm_packs_epi32(colour, colour);
+    colour = _mm_packus_epi16(colour, colour);
+    return static_cast<u32>(_mm_cvtsi128_si32(colour)) | (static_cast<u64>(q) << 32);
+}
+
+u64 GIF::DecodeUV(const u128& data) {
+    // u and v are 14 bits in the low halves of the first 2 words
+    __m128i uv = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&data)), _mm_set1_epi32(0x3fff));
+    return static_cast<u32>(_mm_cvtsi128_si32(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 1, 2, 0))));
+}
+
+u64 GIF::DecodeXYZF(const u128& data) {
+    __m128i xyzf = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data));
+    u64 xy = static_cast<u32>(_mm_cvtsi128_si32(_mm_shufflelo_epi16(xyzf, _MM_SHUFFLE(3, 1, 2, 0))));
+
+    // z and f are stored 4 bits up in their words
+    u64 z = (data.uw[2] >> 4) & 0xffffff;
+    u64 f = (data.uw[3] >> 4) & 0xff;
+    return xy | (z << 32) | (f << 56);
+}
+
+u64 GIF::DecodeXYZ(const u128& data) {
+    __m128i xyz = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data));
+    u64 xy = static_cast<u32>(_mm_cvtsi128_si32(_mm_shufflelo_epi16(xyz, _MM_SHUFFLE(3, 1, 2, 0))));
+    return xy | (static_cast<u64>(data.uw[2]) << 32);
+}
+
+u32 GIF::ProcessRegList(std::span<const u128> data) {
+    u32 count = 0;
+
+    // each quadword holds 2 register values. if there are an odd number of registers
+    // then the upper half of the last quadword is padding
+    while (current_tag.transfers_left && count < data.size()) {
+        for (int half = 0; half < 2 && current_tag.transfers_left; half++) {
+            u8 reg = (current_tag.reglist >> (current_tag.reglist_offset * 4)) & 0xf;
+            u64 value = half ? data[count].hi : data[count].lo;
+
+            // there is no a+d in reglist mode, and registers 0xb, 0xe and 0xf aren't written
+            if (reg != 0xb && reg < 0xe) {
+                AddWrite(reg, value);
+            }
+
+            current_tag.reglist_offset++;
+
+            if (current_tag.reglist_offset == current_tag.nregs) {
+                current_tag.reglist_offset = 0;
+            }
+
+            current_tag.transfers_left--;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+u32 GIF::ProcessImage(std::span<const u128> data) {
+    u32 count = std::min<u32>(data.size(), current_tag.transfers_left);
+    gs.WriteHWReg(std::span<const u64>(reinterpret_cast<const u64*>(data.data()), count * 2));
+    current_tag.transfers_left -= count;
+    return count;
+}
+
+void GIF::AddWrite(u8 addr, u64 value) {
+    if (write_count == MAX_WRITES) {
+        FlushWrites();
+    }
+
+    writes[write_count++] = {addr, value};
+
+    switch (addr) {
+    case 0x01:
+        vertex_state.rgbaq = value;
+        break;
+    case 0x02:
+        vertex_state.st = value;
+        break;
+    case 0x03:
+        vertex_state.uv = value;
+        break;
+    }
+}
+
+void GIF::FlushWrites() {
+    if (write_count) {
+        gs.WriteRegisters(std::span<const gs::RegisterWrite>(writes.data(), write_count));
+        write_count = 0;
+    }
 }
 
-void GIF::StartTransfer() {
-    // read a new giftag from the fifo
-    u128 data = fifo.Pop<u128>();
+void GIF::StartTransfer(u128 data) {
+    // data is a new giftag
     current_tag.nloop = data.lo & 0x7fff;
     current_tag.eop = (data.lo >> 15) & 0x1;
     current_tag.prim = (data.lo >> 46) & 0x1;
@@ -122,6 +420,7 @@ void GIF::StartTransfer() {
     current_tag.nregs = (data.lo >> 60) & 0xf;
     current_tag.reglist = data.hi;
     current_tag.reglist_offset = 0;
+    current_tag.q = 0x3f800000;
 
     // common::Log("[GIF] start transfer %016lx%016lx format %d", data.hi, data.lo, current_tag.format);
 
@@ -129,37 +428,25 @@ void GIF::StartTransfer() {
         current_tag.nregs = 16;
     }
 
-    if (current_tag.prim) {
-        gs.prim.data = current_tag.prim_data;
+    // vertex batches are only used when every register in the list is a vertex attribute
+    current_tag.vertex_list = current_tag.format == 0;
+    for (u32 i = 0; i < current_tag.nregs; i++) {
+        if (!IsVertexRegister((current_tag.reglist >> (i * 4)) & 0xf)) {
+            current_tag.vertex_list = false;
+        }
     }
 
-    gs.rgbaq.q = 1.0f;
+    gs.WriteTagAttributes(current_tag.prim, current_tag.prim_data);
+    vertex_state.rgbaq = (vertex_state.rgbaq & 0xffffffff) | (static_cast<u64>(0x3f800000) << 32);
 
     switch (current_tag.format) {
     case 0:
+    case 1:
         current_tag.transfers_left = current_tag.nloop * current_tag.nregs;
         break;
     case 2:
+    case 3:
         current_tag.transfers_left = current_tag.nloop;
         break;
-    default:
-        common::Error("[GIF] handle giftag format start of transfer %d", current_tag.format);
-    }
-}
-
-void GIF::ProcessTag() {
-    u128 data = fifo.Pop<u128>();
-    // common::Log("[GIF] receive giftag in transfer %016lx%016lx", data.hi, data.lo);
-    switch (current_tag.format) {
-    case 0:
-        ProcessPacked(data);
-        break;
-    case 2:
-        ProcessImage(data);
-        break;
-    default:
-        common::Error("[GIF] handle giftag in transfer format %d", current_tag.format);
     }
-
-    current_tag.transfers_left--;
 }
\ No newline at end of file
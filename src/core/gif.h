@@ -1,9 +1,12 @@
 #pragma once
 
+#include <array>
+#include <span>
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/log.h"
 #include "common/queue.h"
-#include "core/gs/context.h"
+#include "core/gs/thread.h"
 
 // the gif, also known as the graphical interface, is a component of the ps2
 // which allows textures and geometry to be sent to the gs for rasterization.
@@ -13,9 +16,10 @@
 // PATH2: data is transferred via the vif1
 // PATH3: data is transferred using the ee via dmac
 struct GIF {
-    GIF(gs::Context& gs);
+    GIF(gs::Thread& gs);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
     void SystemReset();
     void Run(int cycles);
 
@@ -24,13 +28,45 @@ struct GIF {
 
     void WriteFIFO(u32 value);
 
-    void SendPath3(u128 value);
-    void ProcessPacked(u128 data);
-    void ProcessImage(u128 data);
+    // sends a whole block of quadwords from a dma burst, which are parsed straight
+    // from the dma source instead of going through the fifo
+    void SendPath3(std::span<const u128> data);
 
 private:
-    void StartTransfer();
-    void ProcessTag();
+    // parses every giftag and its data in the span. the data for a giftag
+    // can be split across several calls, in which case it carries on from where it left off
+    void ProcessPacket(std::span<const u128> data);
+    void StartTransfer(u128 data);
+
+    // these consume as many quadwords of the current giftag's data as are available,
+    // and return how many were used
+    u32 ProcessPacked(std::span<const u128> data);
+    u32 ProcessRegList(std::span<const u128> data);
+    u32 ProcessImage(std::span<const u128> data);
+
+    void ProcessPackedRegister(const u128& data);
+
+    void AddWrite(u8 addr, u64 value);
+    void FlushWrites();
+
+    // unpacks whole loops of packed vertex attributes into vertex batches
+    void UnpackVertices(const u128* data, u32 loops);
+
+    template <u8... regs>
+    void UnpackVertexLoops(const u128* data, u32 loops);
+
+    template <u8 reg>
+    void UnpackVertexRegister(const u128& data);
+
+    void AddVertex(u64 xyz, u32 z, u8 flags);
+    void FlushVertices();
+
+    // these convert packed register data to the layout of the gs register
+    static bool IsVertexRegister(u8 reg);
+    static u64 DecodeRGBAQ(const u128& data, u32 q);
+    static u64 DecodeUV(const u128& data);
+    static u64 DecodeXYZF(const u128& data);
+    static u64 DecodeXYZ(const u128& data);
 
     u8 ctrl;
     u32 stat;
@@ -47,8 +83,35 @@ private:
         u32 nregs;
         u64 reglist;
         u32 reglist_offset;
-        int transfers_left;
+
+        // the q value from the last packed st write, as bits of a float.
+        // this is used by packed rgbaq writes
+        u32 q;
+
+        // whether every register in the list is a vertex attribute
+        bool vertex_list;
+
+        // the number of quadwords left for packed and image,
+        // or the number of registers left for reglist
+        u32 transfers_left;
     } current_tag;
 
-    gs::Context& gs;
+    // register writes are decoded into a batch, which is handed to the gs
+    // once it fills up or the end of the data is reached
+    static constexpr int MAX_WRITES = 64;
+
+    std::array<gs::RegisterWrite, MAX_WRITES> writes;
+    int write_count;
+
+    // the attributes each unpacked vertex is kicked with. every write to these registers goes through
+    // the gif, so they're tracked here rather than read back from the gs, which could still be behind
+    struct VertexState {
+        u64 rgbaq;
+        u64 st;
+        u64 uv;
+    } vertex_state;
+
+    gs::VertexBatch vertex_batch;
+
+    gs::Thread& gs;
 };
\ No newline at end of file
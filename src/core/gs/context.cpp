@@ -1,13 +1,18 @@
+#include <algorithm>
 #include <cassert>
+#include <emmintrin.h>
+#include "common/bits.h"
 #include "common/log.h"
 #include "core/gs/context.h"
+#include "core/gs/swizzle.h"
 #include "core/system.h"
 
 namespace gs {
 
-Context::Context(System& system) : system(system) {}
+Context::Context(System& system) : vram(), rasterizer(vram.data()), system(system) {}
 
 void Context::Reset() {
+    rasterizer.Flush();
     csr.data = 0;
 
     // vertex queue is initially empty
@@ -25,9 +30,6 @@ void Context::Reset() {
     display2.data = 0;
     bgcolour = 0;
     prim.data = 0;
-    frame.fill(0);
-    xyoffset.fill(0);
-    scissor.fill(0);
     rgbaq.data = 0;
     bitbltbuf.data = 0;
     trxpos.data = 0;
@@ -39,31 +41,38 @@ void Context::Reset() {
     st = 0;
     uv = 0;
     scanmsk = 0;
-    tex0.fill(0);
-    clamp.fill(0);
     tex1.fill(0);
     tex2.fill(0);
-    texclut = 0;
     miptbp1.fill(0);
     miptbp2.fill(0);
-    texa = 0;
+    texclut.data = 0;
+    texa.data = 0;
     fogcol = 0;
     texflush = 0;
-    alpha.fill(0);
-    test.fill(0);
     pabe = 0;
     dimx = 0;
     dthe = 0;
     colclamp = 0;
     fba.fill(0);
-    zbuf.fill(0);
 
-    pixels_transferred = 0;
-    
-    for (int i = 0; i < 512; i++) {
-        vram[i].Reset();
+    for (int i = 0; i < 2; i++) {
+        frame[i].data = 0;
+        xyoffset[i].data = 0;
+        scissor[i].data = 0;
+        tex0[i].data = 0;
+        clamp[i].data = 0;
+        alpha[i].data = 0;
+        test[i].data = 0;
+        zbuf[i].data = 0;
     }
 
+    transfer_x = 0;
+    transfer_y = 0;
+    transfer_carry_size = 0;
+    
+    vram.fill(0);
+    rasterizer.InvalidateAllTextures();
+
     for (int y = 0; y < 480; y++) {
         for (int x = 0; x < 640; x++) {
             framebuffer[y][x] = 0;
@@ -88,6 +97,9 @@ void Context::SystemReset() {
 }
 
 void Context::RenderCRTC() {
+    // the frame has to be finished before it's scanned out
+    rasterizer.Flush();
+
     int width = GetCRTCWidth();
     int height = GetCRTCHeight();
     int dx = 0;
@@ -106,12 +118,24 @@ void Context::RenderCRTC() {
             assert(pmode.en2 && !pmode.en1);
             int coord_x = x + dispfb2.dbx;
             int coord_y = y + dispfb2.dby;
-            u32 pixel = GetCRTCPixel(dispfb2.fbp * 2048 * 4, coord_x, coord_y, dispfb2.fbw * 64, static_cast<PixelFormat>(dispfb2.psm));
+            u32 pixel = GetCRTCPixel(dispfb2.fbp * 32, coord_x, coord_y, dispfb2.fbw, static_cast<PixelFormat>(dispfb2.psm));
             framebuffer[coord_y][coord_x] = pixel;
         }
     }
 }
 
+void Context::SetRendererThreads(int count) {
+    rasterizer.SetThreadCount(count);
+}
+
+int Context::GetRendererThreads() {
+    return rasterizer.GetThreadCount();
+}
+
+TextureCache::Stats Context::GetTextureCacheStats() {
+    return rasterizer.GetTextureCacheStats();
+}
+
 Framebuffer Context::GetFramebuffer() {
     return {
         .data = reinterpret_cast<u8*>(&framebuffer),
@@ -218,6 +242,9 @@ void Context::WriteRegister(u32 addr, u64 value) {
     case 0x00:
         prim.data = value;
         common::Log("[gs::Context] primitive type is now %d", prim.prim);
+
+        // starting a new primitive throws away any vertices from the last one
+        vertex_queue.Reset();
         break;
     case 0x01:
         rgbaq.data = value;
@@ -246,19 +273,20 @@ void Context::WriteRegister(u32 addr, u64 value) {
         DrawingKick();
         break;
     case 0x06:
-        tex0[0] = value;
+        tex0[0].data = value;
         break;
     case 0x07:
-        tex0[1] = value;
+        tex0[1].data = value;
         break;
     case 0x08:
-        clamp[0] = value;
+        clamp[0].data = value;
         break;
     case 0x09:
-        clamp[1] = value;
+        clamp[1].data = value;
         break;
     case 0x0a:
         fog = value;
+        current_vertex.fog = value >> 56;
         break;
     case 0x0c:
         common::Log("[gs::Context] xyzf3 write %016llx", value);
@@ -288,10 +316,10 @@ void Context::WriteRegister(u32 addr, u64 value) {
         tex2[1] = value;
         break;
     case 0x18:
-        xyoffset[0] = value;
+        xyoffset[0].data = value;
         break;
     case 0x19:
-        xyoffset[1] = value;
+        xyoffset[1].data = value;
         break;
     case 0x1a:
         prmodecont = value;
@@ -301,7 +329,7 @@ void Context::WriteRegister(u32 addr, u64 value) {
         prmode = value;
         break;
     case 0x1c:
-        texclut = value;
+        texclut.data = value;
         break;
     case 0x22:
         scanmsk = value;
@@ -319,7 +347,7 @@ void Context::WriteRegister(u32 addr, u64 value) {
         miptbp2[1] = value;
         break;
     case 0x3b:
-        texa = value;
+        texa.data = value;
         break;
     case 0x3d:
         fogcol = value;
@@ -328,16 +356,16 @@ void Context::WriteRegister(u32 addr, u64 value) {
         texflush = value;
         break;
     case 0x40:
-        scissor[0] = value;
+        scissor[0].data = value;
         break;
     case 0x41:
-        scissor[1] = value;
+        scissor[1].data = value;
         break;
     case 0x42:
-        alpha[0] = value;
+        alpha[0].data = value;
         break;
     case 0x43:
-        alpha[1] = value;
+        alpha[1].data = value;
         break;
     case 0x44:
         dimx = value;
@@ -349,10 +377,10 @@ void Context::WriteRegister(u32 addr, u64 value) {
         colclamp = value;
         break;
     case 0x47:
-        test[0] = value;
+        test[0].data = value;
         break;
     case 0x48:
-        test[1] = value;
+        test[1].data = value;
         break;
     case 0x49:
         pabe = value;
@@ -364,16 +392,16 @@ void Context::WriteRegister(u32 addr, u64 value) {
         fba[1] = value;
         break;
     case 0x4c:
-        frame[0] = value;
+        frame[0].data = value;
         break;
     case 0x4d:
-        frame[1] = value;
+        frame[1].data = value;
         break;
     case 0x4e:
-        zbuf[0] = value;
+        zbuf[0].data = value;
         break;
     case 0x4f:
-        zbuf[1] = value;
+        zbuf[1].data = value;
         break;
     case 0x50:
         bitbltbuf.data = value;
@@ -386,6 +414,9 @@ void Context::WriteRegister(u32 addr, u64 value) {
         break;
     case 0x53:
         trxdir = value;
+        transfer_x = 0;
+        transfer_y = 0;
+        transfer_carry_size = 0;
         break;
     case 0x54:
         WriteHWReg(value);
@@ -395,62 +426,300 @@ void Context::WriteRegister(u32 addr, u64 value) {
     }
 }
 
-void Context::WriteHWReg(u64 value) {
+void Context::WriteRegisters(std::span<const RegisterWrite> writes) {
+    for (const RegisterWrite& write : writes) {
+        WriteRegister(write.addr, write.value);
+    }
+}
+
+void Context::WriteVertices(const VertexBatch& batch) {
+    for (int i = 0; i < batch.count; i++) {
+        rgbaq.data = batch.rgbaq[i];
+        st = batch.st[i];
+        uv = batch.uv[i];
+        current_vertex.x = batch.x[i];
+        current_vertex.y = batch.y[i];
+        current_vertex.z = batch.z[i];
+
+        if (batch.flags[i] & VertexBatch::Fog) {
+            current_vertex.fog = batch.fog[i];
+        }
+
+        VertexKick();
+
+        if (batch.flags[i] & VertexBatch::Draw) {
+            DrawingKick();
+        }
+    }
+
+    rgbaq.data = batch.final_rgbaq;
+    st = batch.final_st;
+    uv = batch.final_uv;
+}
+
+void Context::WriteHWReg(std::span<const u64> data) {
     assert(trxdir == 0);
 
-    // (in bytes)
-    u32 dst_base = bitbltbuf.dst_base * 64 * 4;
+    // primitives drawn before the transfer mustn't land on top of it
+    rasterizer.Flush();
+
+    const u8* bytes = reinterpret_cast<const u8*>(data.data());
+    u32 size = data.size() * 8;
+    u32 first_row = transfer_y;
+
+    switch (static_cast<PixelFormat>(bitbltbuf.dst_format)) {
+    case PixelFormat::PSMCT32:
+        UploadImage<PixelFormat::PSMCT32>(bytes, size);
+        break;
+    case PixelFormat::PSMCT24:
+        UploadImage<PixelFormat::PSMCT24>(bytes, size);
+        break;
+    case PixelFormat::PSMCT16:
+        UploadImage<PixelFormat::PSMCT16>(bytes, size);
+        break;
+    case PixelFormat::PSMCT16S:
+        UploadImage<PixelFormat::PSMCT16S>(bytes, size);
+        break;
+    case PixelFormat::PSMT8:
+        UploadImage<PixelFormat::PSMT8>(bytes, size);
+        break;
+    case PixelFormat::PSMT4:
+        UploadImage<PixelFormat::PSMT4>(bytes, size);
+        break;
+    case PixelFormat::PSMT8H:
+        UploadImage<PixelFormat::PSMT8H>(bytes, size);
+        break;
+    case PixelFormat::PSMT4HL:
+        UploadImage<PixelFormat::PSMT4HL>(bytes, size);
+        break;
+    case PixelFormat::PSMT4HH:
+        UploadImage<PixelFormat::PSMT4HH>(bytes, size);
+        break;
+    case PixelFormat::PSMZ32:
+        UploadImage<PixelFormat::PSMZ32>(bytes, size);
+        break;
+    case PixelFormat::PSMZ24:
+        UploadImage<PixelFormat::PSMZ24>(bytes, size);
+        break;
+    case PixelFormat::PSMZ16:
+        UploadImage<PixelFormat::PSMZ16>(bytes, size);
+        break;
+    case PixelFormat::PSMZ16S:
+        UploadImage<PixelFormat::PSMZ16S>(bytes, size);
+        break;
+    default:
+        common::Error("[gs::Context] handle destination format %d", bitbltbuf.dst_format);
+    }
 
-    // (in pixels)
-    u32 dst_width = bitbltbuf.dst_width * 64;
+    // throw away textures decoded from the rows which were written to. the transfer wraps
+    // around at 2048 in each direction, in which case every row or column could have been written
+    u32 last_row = trxdir == 3 ? std::max<u32>(trxreg.height, 1) - 1 : transfer_y;
+    int x0 = trxpos.dst_x;
+    int x1 = x0 + trxreg.width - 1;
+    int y0 = (trxpos.dst_y + first_row) & 0x7ff;
+    int y1 = y0 + (last_row - first_row);
+    if (x1 >= 2048) {
+        x0 = 0;
+        x1 = 2047;
+    }
 
-    int pixels_to_transfer = GetPixelsToTransfer(static_cast<PixelFormat>(bitbltbuf.dst_format));
-    for (int i = 0; i < pixels_to_transfer; i++) {
-        int x = (pixels_transferred % trxreg.width) + trxpos.dst_x;
-        int y = (pixels_transferred / trxreg.width) + trxpos.dst_y;
-        // common::Log("[gs::Context] x %d y %d", x, y);
+    if (y1 >= 2048) {
+        y0 = 0;
+        y1 = 2047;
+    }
+
+    rasterizer.InvalidateTextures(static_cast<PixelFormat>(bitbltbuf.dst_format), bitbltbuf.dst_base, bitbltbuf.dst_width, x0, y0, x1, y1);
+}
+
+void Context::WriteTagAttributes(bool write_prim, u32 prim_data) {
+    if (write_prim) {
+        prim.data = prim_data;
+    }
+
+    rgbaq.q = 1.0f;
+}
+
+void Context::WriteHWReg(u64 value) {
+    WriteHWReg(std::span<const u64>(&value, 1));
+}
 
-        if (x >= 2048) {
-            common::Error("[gs::Context] handle x >= 2048");
+template <PixelFormat format>
+void Context::UploadImage(const u8* data, u32 size) {
+    constexpr int bits = GetPixelBits(format);
+    constexpr u32 block_width = Page<format>::BLOCK_WIDTH;
+
+    if constexpr (bits == 24) {
+        // finish off a pixel that was split between writes
+        while (transfer_carry_size && size && trxdir != 3) {
+            transfer_carry[transfer_carry_size++] = *data++;
+            size--;
+
+            if (transfer_carry_size == 3) {
+                u32 value = transfer_carry[0] | (transfer_carry[1] << 8) | (transfer_carry[2] << 16);
+                UploadPixel<format>((trxpos.dst_x + transfer_x) & 0x7ff, (trxpos.dst_y + transfer_y) & 0x7ff, value);
+                transfer_carry_size = 0;
+                AdvanceTransfer(1);
+            }
         }
+    }
+
+    u32 pixels = (size * 8) / bits;
+    u32 index = 0;
+
+    while (index < pixels && trxdir != 3) {
+        int x = (trxpos.dst_x + transfer_x) & 0x7ff;
+        int y = (trxpos.dst_y + transfer_y) & 0x7ff;
 
-        if (y >= 2048) {
-            common::Error("[gs::Context] handle y >= 2048");
+        // block rows of 4 bit pixels also have to start on a whole byte of the image data
+        bool aligned = (x % block_width) == 0 && (bits != 4 || (index & 0x1) == 0);
+
+        if (aligned && (trxreg.width - transfer_x) >= block_width && (pixels - index) >= block_width && (x + block_width) <= 2048) {
+            UploadBlockRow<format>(x, y, data + ((index * bits) / 8));
+            index += block_width;
+            AdvanceTransfer(block_width);
+            continue;
         }
 
-        switch (static_cast<PixelFormat>(bitbltbuf.dst_format)) {
-        case PixelFormat::PSMCT32:
-            WritePSMCT32Pixel(dst_base, x, y, dst_width, (value >> (32 * i)) & 0xffffffff);
-            break;
-        default:
-            common::Error("[gs::Context] handle destination format %d", bitbltbuf.dst_format);
+        u32 value = 0;
+        if constexpr (bits == 32) {
+            value = common::Read<u32>(data + (index * 4));
+        } else if constexpr (bits == 24) {
+            const u8* pixel = data + (index * 3);
+            value = pixel[0] | (pixel[1] << 8) | (pixel[2] << 16);
+        } else if constexpr (bits == 16) {
+            value = common::Read<u16>(data + (index * 2));
+        } else if constexpr (bits == 8) {
+            value = data[index];
+        } else {
+            value = (data[index / 2] >> ((index & 0x1) * 4)) & 0xf;
         }
 
-        pixels_transferred++;
+        UploadPixel<format>(x, y, value);
+        index++;
+        AdvanceTransfer(1);
     }
 
-    if (pixels_transferred >= (trxreg.width * trxreg.height)) {
-        common::Log("[gs::Context] end of gif->vram transfer");
-        pixels_transferred = 0;
-        trxdir = 3;
+    if constexpr (bits == 24) {
+        // keep any bytes of a pixel which didn't fully arrive
+        if (trxdir != 3) {
+            for (u32 i = pixels * 3; i < size; i++) {
+                transfer_carry[transfer_carry_size++] = data[i];
+            }
+        }
     }
 }
 
-int Context::GetPixelsToTransfer(PixelFormat format) {
-    switch (format) {
-    case PixelFormat::PSMCT32:
-        return 2;
-    default:
-        common::Error("[gs::Context] handle destination format %d", static_cast<int>(format));
+template <PixelFormat format>
+void Context::UploadBlockRow(int x, int y, const u8* data) {
+    using Layout = Page<format>;
+    u32 address = Layout::GetAddress(x, y, bitbltbuf.dst_base, bitbltbuf.dst_width);
+
+    if constexpr (Layout::BITS == 32) {
+        // a row of 8 pixels is stored as pairs of pixels 16 bytes apart
+        u8* row = vram.data() + (address * 4);
+        __m128i low;
+        __m128i high;
+
+        // the bits of each word which are written by this format
+        u32 mask = 0xffffffff;
+
+        if constexpr (format == PixelFormat::PSMCT32 || format == PixelFormat::PSMZ32) {
+            low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        } else if constexpr (format == PixelFormat::PSMT8H) {
+            // widen each byte to the top of a word
+            __m128i zero = _mm_setzero_si128();
+            __m128i halfwords = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)), zero);
+            low = _mm_slli_epi32(_mm_unpacklo_epi16(halfwords, zero), 24);
+            high = _mm_slli_epi32(_mm_unpackhi_epi16(halfwords, zero), 24);
+            mask = 0xff000000;
+        } else {
+            alignas(16) u32 pixels[8];
+            for (int i = 0; i < 8; i++) {
+                if constexpr (format == PixelFormat::PSMCT24 || format == PixelFormat::PSMZ24) {
+                    pixels[i] = data[i * 3] | (data[(i * 3) + 1] << 8) | (data[(i * 3) + 2] << 16);
+                    mask = 0x00ffffff;
+                } else if constexpr (format == PixelFormat::PSMT4HL) {
+                    pixels[i] = ((data[i / 2] >> ((i & 0x1) * 4)) & 0xf) << 24;
+                    mask = 0x0f000000;
+                } else {
+                    pixels[i] = ((data[i / 2] >> ((i & 0x1) * 4)) & 0xf) << 28;
+                    mask = 0xf0000000;
+                }
+            }
+
+            low = _mm_load_si128(reinterpret_cast<const __m128i*>(&pixels[0]));
+            high = _mm_load_si128(reinterpret_cast<const __m128i*>(&pixels[4]));
+        }
+
+        if (mask != 0xffffffff) {
+            // keep the bits of each word which belong to other formats
+            __m128i keep = _mm_set1_epi32(~mask);
+            __m128i old_low = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<__m128i*>(row)), _mm_loadl_epi64(reinterpret_cast<__m128i*>(row + 16)));
+            __m128i old_high = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<__m128i*>(row + 32)), _mm_loadl_epi64(reinterpret_cast<__m128i*>(row + 48)));
+            low = _mm_or_si128(_mm_and_si128(old_low, keep), low);
+            high = _mm_or_si128(_mm_and_si128(old_high, keep), high);
+        }
+
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), low);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 16), _mm_srli_si128(low, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 32), high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 48), _mm_srli_si128(high, 8));
+    } else if constexpr (Layout::BITS == 16) {
+        // a row of 16 pixels interleaves the first 8 pixels with the last 8, in groups of 4 halfwords 16 bytes apart
+        u8* row = vram.data() + (address * 2);
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        __m128i low = _mm_unpacklo_epi16(first, second);
+        __m128i high = _mm_unpackhi_epi16(first, second);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), low);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 16), _mm_srli_si128(low, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 32), high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 48), _mm_srli_si128(high, 8));
+    } else if constexpr (Layout::BITS == 8) {
+        // rows of 8 bit pixels are spread out across the block, so each pixel is looked up within the block
+        u8* block = vram.data() + (address & ~0xff);
+        const int* columns = column_table8[y & 0xf];
+        for (int i = 0; i < 16; i++) {
+            block[columns[i]] = data[i];
+        }
+    } else {
+        u32 block = address & ~0x1ff;
+        const int* columns = column_table4[y & 0xf];
+        for (int i = 0; i < 32; i++) {
+            u32 nibble = block + columns[i];
+            u8 value = (data[i / 2] >> ((i & 0x1) * 4)) & 0xf;
+            int shift = (nibble & 0x1) * 4;
+            vram[nibble / 2] = (vram[nibble / 2] & ~(0xf << shift)) | (value << shift);
+        }
     }
+}
 
-    return 0;
+template <PixelFormat format>
+void Context::UploadPixel(int x, int y, u32 value) {
+    Page<format>::Write(vram.data(), x, y, bitbltbuf.dst_base, bitbltbuf.dst_width, value);
+}
+
+void Context::AdvanceTransfer(u32 pixels) {
+    transfer_x += pixels;
+
+    if (transfer_x >= trxreg.width) {
+        transfer_x = 0;
+        transfer_y++;
+    }
+
+    if (transfer_y >= trxreg.height) {
+        common::Log("[gs::Context] end of gif->vram transfer");
+        transfer_x = 0;
+        transfer_y = 0;
+        trxdir = 3;
+    }
 }
 
 u32 Context::GetCRTCPixel(u32 base, int x, int y, u32 width, PixelFormat format) {
     switch (format) {
     case PixelFormat::PSMCT32:
-        return ReadPSMCT32Pixel(base, x, y, width);
+        return Page<PixelFormat::PSMCT32>::Read(vram.data(), x, y, base, width);
     default:
         common::Error("[gs::Context] handle crtc pixel format %d", static_cast<int>(format));
     }
@@ -482,42 +751,197 @@ int Context::GetCRTCHeight() {
     return 0;
 }
 
-u32 Context::ReadPSMCT32Pixel(u32 base, int x, int y, u32 width) {
-    // base is a byte address, and pages are stored as units of 8192 bytes sequentially,
-    // so / 8192 will give us the current page
-    int page = base / 8192;
-    int width_in_pages = width / 64;
+void Context::VertexKick() {
+    current_vertex.r = rgbaq.r;
+    current_vertex.g = rgbaq.g;
+    current_vertex.b = rgbaq.b;
+    current_vertex.a = rgbaq.a;
+    current_vertex.q = rgbaq.q;
+
+    u32 s = st;
+    u32 t = st >> 32;
+    current_vertex.s = common::BitCast<f32>(s);
+    current_vertex.t = common::BitCast<f32>(t);
+    current_vertex.u = uv & 0x3fff;
+    current_vertex.v = (uv >> 16) & 0x3fff;
+
+    if (vertex_queue.Full()) {
+        vertex_queue.Pop();
+    }
 
-    // add the horizontal increment from x to page
-    page += (x / 64) % width_in_pages;
+    vertex_queue.Push(current_vertex);
+}
 
-    // add the vertical increment from y to page
-    page += (y / 32) * width_in_pages;
+void Context::DrawingKick() {
+    static constexpr int vertex_counts[8] = {1, 2, 2, 3, 3, 3, 2, 0};
+    int count = vertex_counts[prim.prim];
+    int length = vertex_queue.GetLength();
+    if (count == 0 || length < count) {
+        return;
+    }
 
-    return vram[page].ReadPSMCT32Pixel(x, y);
-}
+    PRIM attributes = GetPrimitiveAttributes();
+    DrawState state = GetDrawState(attributes);
+    std::array<Rasterizer::Vertex, 3> vertices;
+    for (int i = 0; i < count; i++) {
+        vertices[i] = GetRasterizerVertex(vertex_queue.Peek(length - count + i), attributes);
+    }
 
-void Context::WritePSMCT32Pixel(u32 base, int x, int y, u32 width, u32 value) {
-    // base is a byte address, and pages are stored as units of 8192 bytes sequentially,
-    // so / 8192 will give us the current page
-    int page = base / 8192;
-    int width_in_pages = width / 64;
+    switch (prim.prim) {
+    case PrimitiveType::Point:
+        rasterizer.DrawPoint(state, vertices[0]);
+        vertex_queue.Reset();
+        break;
+    case PrimitiveType::Line:
+        rasterizer.DrawLine(state, vertices[0], vertices[1]);
+        vertex_queue.Reset();
+        break;
+    case PrimitiveType::LineStrip:
+        rasterizer.DrawLine(state, vertices[0], vertices[1]);
+        vertex_queue.Pop();
+        break;
+    case PrimitiveType::Triangle:
+        rasterizer.DrawTriangle(state, vertices[0], vertices[1], vertices[2]);
+        vertex_queue.Reset();
+        break;
+    case PrimitiveType::TriangleStrip:
+        rasterizer.DrawTriangle(state, vertices[0], vertices[1], vertices[2]);
+        vertex_queue.Pop();
+        break;
+    case PrimitiveType::TriangleFan: {
+        rasterizer.DrawTriangle(state, vertices[0], vertices[1], vertices[2]);
 
-    // add the horizontal increment from x to page
-    page += (x / 64) % width_in_pages;
+        // the first vertex is shared by every triangle in the fan
+        Vertex first = vertex_queue.Peek(length - count);
+        Vertex last = vertex_queue.Peek(length - 1);
+        vertex_queue.Reset();
+        vertex_queue.Push(first);
+        vertex_queue.Push(last);
+        break;
+    }
+    case PrimitiveType::Sprite:
+        rasterizer.DrawSprite(state, vertices[0], vertices[1]);
+        vertex_queue.Reset();
+        break;
+    }
+}
 
-    // add the vertical increment from y to page
-    page += (y / 32) * width_in_pages;
+Context::PRIM Context::GetPrimitiveAttributes() {
+    if (prmodecont & 0x1) {
+        return prim;
+    }
 
-    vram[page].WritePSMCT32Pixel(x, y, value);
+    PRIM attributes;
+    attributes.data = prmode;
+    attributes.prim = prim.prim;
+    return attributes;
 }
 
-void Context::VertexKick() {
-    common::Log("[gs::Context] do vertex kick for primitive %d", prim.prim);
+DrawState Context::GetDrawState(const PRIM& attributes) {
+    const FRAME& frame_register = frame[attributes.ctxt];
+    const ZBUF& zbuf_register = zbuf[attributes.ctxt];
+    const SCISSOR& scissor_register = scissor[attributes.ctxt];
+    const TEST& test_register = test[attributes.ctxt];
+
+    DrawState state;
+    state.frame_format = static_cast<PixelFormat>(frame_register.psm);
+    state.frame_base = frame_register.fbp * 32;
+    state.frame_width = frame_register.fbw;
+    state.frame_mask = frame_register.fbmsk;
+    state.z_format = static_cast<PixelFormat>(0x30 | zbuf_register.psm);
+    state.z_base = zbuf_register.zbp * 32;
+    state.z_test = test_register.zte;
+    state.z_method = static_cast<ZTest>(test_register.ztst);
+    state.z_mask = zbuf_register.zmsk;
+    state.scissor_x0 = scissor_register.scax0;
+    state.scissor_y0 = scissor_register.scay0;
+    state.scissor_x1 = scissor_register.scax1;
+    state.scissor_y1 = scissor_register.scay1;
+    state.gouraud = attributes.iip;
+
+    state.texture_mapping = attributes.tme;
+    if (state.texture_mapping) {
+        const TEX0& tex0_register = tex0[attributes.ctxt];
+        const CLAMP& clamp_register = clamp[attributes.ctxt];
+        TextureState& texture = state.texture;
+
+        // textures are at most 1024x1024
+        texture.format = static_cast<PixelFormat>(tex0_register.psm);
+        texture.base = tex0_register.tbp0;
+        texture.width = tex0_register.tbw;
+        texture.width_log2 = std::min<int>(tex0_register.tw, 10);
+        texture.height_log2 = std::min<int>(tex0_register.th, 10);
+        texture.uv = attributes.fst;
+        texture.function = static_cast<TextureFunction>(tex0_register.tfx);
+        texture.alpha = tex0_register.tcc;
+        texture.clut_format = static_cast<PixelFormat>(tex0_register.cpsm);
+        texture.clut_base = tex0_register.cbp;
+        texture.clut_line = tex0_register.csm;
+        texture.clut_width = texclut.cbw;
+        texture.clut_x = texclut.cou * 16;
+        texture.clut_y = texclut.cov;
+        texture.clut_offset = tex0_register.csa * 16;
+        texture.wrap_u = static_cast<WrapMode>(clamp_register.wms);
+        texture.wrap_v = static_cast<WrapMode>(clamp_register.wmt);
+        texture.min_u = clamp_register.minu;
+        texture.max_u = clamp_register.maxu;
+        texture.min_v = clamp_register.minv;
+        texture.max_v = clamp_register.maxv;
+        texture.alpha0 = texa.ta0;
+        texture.alpha1 = texa.ta1;
+        texture.transparent_black = texa.aem;
+    }
+
+    state.fog = attributes.fge;
+    state.fog_colour = fogcol & 0xffffff;
+
+    state.alpha_test = test_register.ate;
+    state.alpha_method = static_cast<AlphaTest>(test_register.atst);
+    state.alpha_reference = test_register.aref;
+    state.alpha_fail = static_cast<AlphaFail>(test_register.afail);
+    state.destination_alpha_test = test_register.date;
+    state.destination_alpha_mode = test_register.datm;
+
+    const ALPHA& alpha_register = alpha[attributes.ctxt];
+    state.blend = attributes.abe;
+    state.blend_a = alpha_register.a;
+    state.blend_b = alpha_register.b;
+    state.blend_c = alpha_register.c;
+    state.blend_d = alpha_register.d;
+    state.blend_fix = alpha_register.fix;
+    state.blend_alpha_only = pabe & 0x1;
+    state.frame_alpha = fba[attributes.ctxt] & 0x1;
+
+    // each entry of the dither matrix is a signed 3 bit value, in 4 bits
+    state.dither = dthe & 0x1;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            state.dither_matrix[y][x] = common::SignExtend<s32, 3>((dimx >> ((y * 16) + (x * 4))) & 0x7);
+        }
+    }
+
+    state.colour_clamp = colclamp & 0x1;
+    return state;
 }
 
-void Context::DrawingKick() {
-    common::Log("[gs::Context] do drawing kick for primitive %d", prim.prim);
+Rasterizer::Vertex Context::GetRasterizerVertex(const Vertex& vertex, const PRIM& attributes) {
+    const XYOFFSET& offset = xyoffset[attributes.ctxt];
+
+    Rasterizer::Vertex result;
+    result.x = static_cast<s32>(vertex.x) - static_cast<s32>(offset.ofx);
+    result.y = static_cast<s32>(vertex.y) - static_cast<s32>(offset.ofy);
+    result.z = vertex.z;
+    result.r = vertex.r;
+    result.g = vertex.g;
+    result.b = vertex.b;
+    result.a = vertex.a;
+    result.fog = vertex.fog;
+    result.u = vertex.u;
+    result.v = vertex.v;
+    result.s = vertex.s;
+    result.t = vertex.t;
+    result.q = vertex.q;
+    return result;
 }
 
 } // namespace gs
\ No newline at end of file
@@ -2,9 +2,11 @@
 
 #include <array>
 #include <memory>
+#include <span>
 #include "common/queue.h"
 #include "common/types.h"
 #include "core/gs/page.h"
+#include "core/gs/rasterizer.h"
 
 struct System;
 
@@ -40,6 +42,42 @@ namespace gs {
 // drawing kick is done when writes to specific gs registers are done. this will cause all
 // the vertices in the vertex queue to be combined together to draw a primitive
 
+// a register write decoded from a gif packet. the gif hands these to the gs in batches
+struct RegisterWrite {
+    u8 addr;
+    u64 value;
+};
+
+// vertices decoded from packed gif data, stored as a structure of arrays. each vertex
+// keeps the rgbaq, st and uv it was kicked with, so the gs can go through all of them in one go
+struct VertexBatch {
+    static constexpr int MAX_VERTICES = 64;
+
+    enum Flags : u8 {
+        // the vertex was written to xyz2 or xyzf2, rather than xyz3 or xyzf3
+        Draw = 1 << 0,
+
+        // the vertex was written to xyzf2 or xyzf3, so it has its own fog coefficient
+        Fog = 1 << 1,
+    };
+
+    int count;
+    std::array<u16, MAX_VERTICES> x;
+    std::array<u16, MAX_VERTICES> y;
+    std::array<u32, MAX_VERTICES> z;
+    std::array<u8, MAX_VERTICES> fog;
+    std::array<u8, MAX_VERTICES> flags;
+    std::array<u64, MAX_VERTICES> rgbaq;
+    std::array<u64, MAX_VERTICES> st;
+    std::array<u64, MAX_VERTICES> uv;
+
+    // the register values after the whole batch, which can differ from the last
+    // vertex if the register list writes more attributes after its last xyz
+    u64 final_rgbaq;
+    u64 final_st;
+    u64 final_uv;
+};
+
 struct Framebuffer {
     u8* data;
     int width;
@@ -53,13 +91,26 @@ public:
     u32 ReadRegisterPrivileged(u32 addr);
     void WriteRegisterPrivileged(u32 addr, u32 value);
     void WriteRegister(u32 addr, u64 value);
+    void WriteRegisters(std::span<const RegisterWrite> writes);
+    void WriteVertices(const VertexBatch& batch);
     void WriteHWReg(u64 value);
+    void WriteHWReg(std::span<const u64> data);
+
+    // a giftag sets prim when its pre bit is set, and always resets q to 1
+    void WriteTagAttributes(bool write_prim, u32 prim_data);
 
     void RenderCRTC();
 
     void Reset();
     void SystemReset();
 
+    // primitives are drawn on this many threads
+    void SetRendererThreads(int count);
+    int GetRendererThreads();
+
+    // can be read while the gs thread is running
+    TextureCache::Stats GetTextureCacheStats();
+
     Framebuffer GetFramebuffer();
 
     union RGBAQ {
@@ -191,6 +242,148 @@ public:
         u32 data;
     };
 
+    union FRAME {
+        struct {
+            u32 fbp : 9;
+            u32 : 7;
+            u32 fbw : 6;
+            u32 : 2;
+            u32 psm : 6;
+            u32 : 2;
+            u32 fbmsk : 32;
+        };
+
+        u64 data;
+    };
+
+    union ZBUF {
+        struct {
+            u32 zbp : 9;
+            u32 : 15;
+            u32 psm : 4;
+            u32 : 4;
+            bool zmsk : 1;
+            u32 : 31;
+        };
+
+        u64 data;
+    };
+
+    union XYOFFSET {
+        struct {
+            u32 ofx : 16;
+            u32 : 16;
+            u32 ofy : 16;
+            u32 : 16;
+        };
+
+        u64 data;
+    };
+
+    union SCISSOR {
+        struct {
+            u32 scax0 : 11;
+            u32 : 5;
+            u32 scax1 : 11;
+            u32 : 5;
+            u32 scay0 : 11;
+            u32 : 5;
+            u32 scay1 : 11;
+            u32 : 5;
+        };
+
+        u64 data;
+    };
+
+    union TEST {
+        struct {
+            bool ate : 1;
+            u32 atst : 3;
+            u32 aref : 8;
+            u32 afail : 2;
+            bool date : 1;
+            bool datm : 1;
+            bool zte : 1;
+            u32 ztst : 2;
+            u32 : 13;
+            u32 : 32;
+        };
+
+        u64 data;
+    };
+
+    union TEX0 {
+        struct {
+            u32 tbp0 : 14;
+            u32 tbw : 6;
+            u32 psm : 6;
+            u32 tw : 4;
+            u64 th : 4;
+            bool tcc : 1;
+            u32 tfx : 2;
+            u32 cbp : 14;
+            u32 cpsm : 4;
+            bool csm : 1;
+            u32 csa : 5;
+            u32 cld : 3;
+        };
+
+        u64 data;
+    };
+
+    union CLAMP {
+        struct {
+            u32 wms : 2;
+            u32 wmt : 2;
+            u32 minu : 10;
+            u32 maxu : 10;
+            u64 minv : 10;
+            u32 maxv : 10;
+            u32 : 20;
+        };
+
+        u64 data;
+    };
+
+    union ALPHA {
+        struct {
+            u32 a : 2;
+            u32 b : 2;
+            u32 c : 2;
+            u32 d : 2;
+            u32 : 24;
+            u8 fix : 8;
+            u32 : 24;
+        };
+
+        u64 data;
+    };
+
+    union TEXA {
+        struct {
+            u8 ta0 : 8;
+            u32 : 7;
+            bool aem : 1;
+            u32 : 16;
+            u8 ta1 : 8;
+            u32 : 24;
+        };
+
+        u64 data;
+    };
+
+    union TEXCLUT {
+        struct {
+            u32 cbw : 6;
+            u32 cou : 6;
+            u32 cov : 10;
+            u32 : 10;
+            u32 : 32;
+        };
+
+        u64 data;
+    };
+
     union CSR {
         struct {
             bool signal : 1;
@@ -228,9 +421,9 @@ public:
     DISPLAY display2;
     u32 bgcolour;
     PRIM prim;
-    std::array<u64, 2> frame;
-    std::array<u64, 2> xyoffset;
-    std::array<u64, 2> scissor;
+    std::array<FRAME, 2> frame;
+    std::array<XYOFFSET, 2> xyoffset;
+    std::array<SCISSOR, 2> scissor;
     RGBAQ rgbaq;
     BITBLTBUF bitbltbuf;
     TRXPOS trxpos;
@@ -242,42 +435,26 @@ public:
     u64 st;
     u64 uv;
     u64 scanmsk;
-    std::array<u64, 2> tex0;
-    std::array<u64, 2> clamp;
+    std::array<TEX0, 2> tex0;
+    std::array<CLAMP, 2> clamp;
     std::array<u64, 2> tex1;
     std::array<u64, 2> tex2;
-    u64 texclut;
+    TEXCLUT texclut;
     std::array<u64, 2> miptbp1;
     std::array<u64, 2> miptbp2;
-    u64 texa;
+    TEXA texa;
     u64 fogcol;
     u64 texflush;
-    std::array<u64, 2> alpha;
-    std::array<u64, 2> test;
+    std::array<ALPHA, 2> alpha;
+    std::array<TEST, 2> test;
     u64 pabe;
     u64 dimx;
     u64 dthe;
     u64 colclamp;
     std::array<u64, 2> fba;
-    std::array<u64, 2> zbuf;
+    std::array<ZBUF, 2> zbuf;
 
 private:
-    enum class PixelFormat : int {
-        PSMCT32 = 0x00,
-        PSMCT24 = 0x01,
-        PSMCT16 = 0x02,
-        PSMCT16S = 0x0A,
-        PSMCT8 = 0x13,
-        PSMCT4 = 0x14,
-        PSMCT8H = 0x1b,
-        PSMCT4HL = 0x24,
-        PSMCT4HH = 0x2c,
-        PSMZ32 = 0x30,
-        PSMZ24 = 0x31,
-        PSMZ16 = 0x32,
-        PSMZ16S = 0x3a,
-    };
-
     struct Vertex {
         // these are fixed point integers,
         // with 12 bits for integer and 4 bits for decimal
@@ -294,24 +471,77 @@ private:
         f32 q;
 
         u8 fog;
+
+        // texture coordinates, from st and uv
+        f32 s;
+        f32 t;
+        u16 u;
+        u16 v;
     };
 
-    int GetPixelsToTransfer(PixelFormat format);
+    // the size of each pixel in image data, which for psmct24, psmt8h and psmt4h is smaller than in vram
+    static constexpr int GetPixelBits(PixelFormat format) {
+        switch (format) {
+        case PixelFormat::PSMCT32:
+        case PixelFormat::PSMZ32:
+            return 32;
+        case PixelFormat::PSMCT24:
+        case PixelFormat::PSMZ24:
+            return 24;
+        case PixelFormat::PSMCT16:
+        case PixelFormat::PSMCT16S:
+        case PixelFormat::PSMZ16:
+        case PixelFormat::PSMZ16S:
+            return 16;
+        case PixelFormat::PSMT8:
+        case PixelFormat::PSMT8H:
+            return 8;
+        default:
+            return 4;
+        }
+    }
+
+    // host to local transfers. the image data is written a whole block row at a time
+    // where possible, and a pixel at a time at the edges of the rectangle
+    template <PixelFormat format>
+    void UploadImage(const u8* data, u32 size);
+
+    template <PixelFormat format>
+    void UploadBlockRow(int x, int y, const u8* data);
+
+    template <PixelFormat format>
+    void UploadPixel(int x, int y, u32 value);
+
+    void AdvanceTransfer(u32 pixels);
+
     u32 GetCRTCPixel(u32 base, int x, int y, u32 width, PixelFormat format);
     int GetCRTCWidth();
     int GetCRTCHeight();
-    u32 ReadPSMCT32Pixel(u32 base, int x, int y, u32 width);
-    void WritePSMCT32Pixel(u32 base, int x, int y, u32 width, u32 value);
 
     void VertexKick();
     void DrawingKick();
 
-    int pixels_transferred;
+    // the attributes of a primitive come from either prim or prmode, depending on prmodecont
+    PRIM GetPrimitiveAttributes();
+    DrawState GetDrawState(const PRIM& attributes);
+    Rasterizer::Vertex GetRasterizerVertex(const Vertex& vertex, const PRIM& attributes);
+
+    // position within the transfer rectangle
+    u32 transfer_x;
+    u32 transfer_y;
+
+    // the start of a 24 bit pixel that was split between 2 hwreg writes
+    std::array<u8, 3> transfer_carry;
+    int transfer_carry_size;
     
-    std::array<Page, 512> vram;
+    std::array<u8, VRAM_SIZE> vram;
+    Rasterizer rasterizer;
     u32 framebuffer[480][640];
     Vertex current_vertex;
-    common::Queue<Vertex, 3> vertex_queue;
+
+    // only the last 3 vertices are needed to draw a primitive, but the queue capacity has to be a power of two.
+    // vertices stay in the queue after a drawing kick when the next primitive of a strip or fan shares them
+    common::Queue<Vertex, 4> vertex_queue;
     System& system;
 };
 
@@ -1,66 +1,164 @@
 #pragma once
 
+#include <array>
 #include "common/types.h"
 #include "common/memory.h"
-#include "common/log.h"
+#include "core/gs/swizzle.h"
 
 namespace gs {
 
+enum class PixelFormat : int {
+    PSMCT32 = 0x00,
+    PSMCT24 = 0x01,
+    PSMCT16 = 0x02,
+    PSMCT16S = 0x0A,
+    PSMT8 = 0x13,
+    PSMT4 = 0x14,
+    PSMT8H = 0x1b,
+    PSMT4HL = 0x24,
+    PSMT4HH = 0x2c,
+    PSMZ32 = 0x30,
+    PSMZ24 = 0x31,
+    PSMZ16 = 0x32,
+    PSMZ16S = 0x3a,
+};
+
+constexpr u32 VRAM_SIZE = 0x400000;
+
+// describes how the pixels of a storage format are laid out in a page. the position of every pixel
+// within a page is worked out at compile time, so finding a pixel in vram only needs the page
+// number and a single table load
+template <PixelFormat format>
 struct Page {
-    void Reset() {
-        for (int block = 0; block < 32; block++) {
-            for (int pixel = 0; pixel < 256; pixel++) {
-                blocks[block][pixel] = 0;
-            }
-        }
+    static constexpr bool IS_32BIT = format == PixelFormat::PSMCT32 || format == PixelFormat::PSMCT24 || format == PixelFormat::PSMT8H ||
+        format == PixelFormat::PSMT4HL || format == PixelFormat::PSMT4HH || format == PixelFormat::PSMZ32 || format == PixelFormat::PSMZ24;
+    static constexpr bool IS_16BIT = format == PixelFormat::PSMCT16 || format == PixelFormat::PSMCT16S || format == PixelFormat::PSMZ16 ||
+        format == PixelFormat::PSMZ16S;
+
+    // the size of each pixel in memory. psmct24 and the psmt8h and psmt4h formats use part of a 32 bit pixel
+    static constexpr int BITS = IS_32BIT ? 32 : IS_16BIT ? 16 : format == PixelFormat::PSMT8 ? 8 : 4;
+
+    static constexpr int WIDTH = BITS == 32 || BITS == 16 ? 64 : 128;
+    static constexpr int HEIGHT = BITS == 32 ? 32 : BITS == 4 ? 128 : 64;
+    static constexpr int BLOCK_WIDTH = BITS == 32 ? 8 : BITS == 4 ? 32 : 16;
+    static constexpr int BLOCK_HEIGHT = BITS == 32 || BITS == 16 ? 8 : 16;
+
+    // every block is 256 bytes, and addresses are in units of the pixel size
+    static constexpr u32 BLOCK_UNITS = 2048 / BITS;
+    static constexpr u32 ADDRESS_MASK = ((VRAM_SIZE * 8) / BITS) - 1;
+
+    // returns the address of a pixel in units of the pixel size, where base is in units of blocks
+    // and width is in units of 64 pixels. base doesn't have to be aligned to a page
+    static u32 GetAddress(u32 x, u32 y, u32 base, u32 width) {
+        return (GetPageAddress(x, y, base, width) + GetOffset(x, y)) & ADDRESS_MASK;
     }
 
-    u32 ReadPSMCT32Pixel(int x, int y) {
-        return common::Read<u32>(GetPSMCT32Pointer(x, y));
+    // returns the address of the start of the page containing a pixel, which still needs to be masked
+    // once an offset is added
+    static u32 GetPageAddress(u32 x, u32 y, u32 base, u32 width) {
+        u32 page = ((y / HEIGHT) * ((width * 64) / WIDTH)) + (x / WIDTH);
+        return (base * BLOCK_UNITS) + (page * 32 * BLOCK_UNITS);
     }
 
-    void WritePSMCT32Pixel(int x, int y, u32 value) {
-        common::Write<u32>(GetPSMCT32Pointer(x, y), value);
+    static u32 GetOffset(u32 x, u32 y) {
+        return offsets[((y % HEIGHT) * WIDTH) + (x % WIDTH)];
     }
 
-private:
-    u8* GetPSMCT32Pointer(int x, int y) {
-        // get block coordinates
-        int block_x = (x / 8) % 8;
-        int block_y = (y / 8) % 4;
+    static u32 Read(const u8* vram, u32 x, u32 y, u32 base, u32 width) {
+        u32 address = GetAddress(x, y, base, width);
+
+        if constexpr (format == PixelFormat::PSMCT32 || format == PixelFormat::PSMZ32) {
+            return common::Read<u32>(vram, address * 4);
+        } else if constexpr (format == PixelFormat::PSMCT24 || format == PixelFormat::PSMZ24) {
+            return common::Read<u32>(vram, address * 4) & 0xffffff;
+        } else if constexpr (format == PixelFormat::PSMT8H) {
+            return vram[(address * 4) + 3];
+        } else if constexpr (format == PixelFormat::PSMT4HL) {
+            return vram[(address * 4) + 3] & 0xf;
+        } else if constexpr (format == PixelFormat::PSMT4HH) {
+            return vram[(address * 4) + 3] >> 4;
+        } else if constexpr (BITS == 16) {
+            return common::Read<u16>(vram, address * 2);
+        } else if constexpr (BITS == 8) {
+            return vram[address];
+        } else {
+            return (vram[address / 2] >> ((address & 0x1) * 4)) & 0xf;
+        }
+    }
 
-        constexpr static int block_configuration[4][8] = {
-            {0, 1, 4, 5, 16, 17, 20, 21},
-            {2, 3, 6, 7, 18, 19, 22, 23},
-            {8, 9, 12, 13, 24, 25, 28, 29},
-            {10, 11, 14, 15, 26, 27, 30, 31},
-        };
+    static void Write(u8* vram, u32 x, u32 y, u32 base, u32 width, u32 value) {
+        u32 address = GetAddress(x, y, base, width);
 
-        // get the block to write to based on configuration within page
-        int block = block_configuration[block_y][block_x];
+        if constexpr (format == PixelFormat::PSMCT32 || format == PixelFormat::PSMZ32) {
+            common::Write<u32>(vram, value, address * 4);
+        } else if constexpr (format == PixelFormat::PSMCT24 || format == PixelFormat::PSMZ24) {
+            u32 old = common::Read<u32>(vram, address * 4);
+            common::Write<u32>(vram, (old & 0xff000000) | (value & 0xffffff), address * 4);
+        } else if constexpr (format == PixelFormat::PSMT8H) {
+            vram[(address * 4) + 3] = value;
+        } else if constexpr (format == PixelFormat::PSMT4HL) {
+            u8& pixel = vram[(address * 4) + 3];
+            pixel = (pixel & 0xf0) | (value & 0xf);
+        } else if constexpr (format == PixelFormat::PSMT4HH) {
+            u8& pixel = vram[(address * 4) + 3];
+            pixel = (pixel & 0x0f) | (value << 4);
+        } else if constexpr (BITS == 16) {
+            common::Write<u16>(vram, value, address * 2);
+        } else if constexpr (BITS == 8) {
+            vram[address] = value;
+        } else {
+            int shift = (address & 0x1) * 4;
+            vram[address / 2] = (vram[address / 2] & ~(0xf << shift)) | ((value & 0xf) << shift);
+        }
+    }
 
-        constexpr static int pixel_configuration[2][8] = {
-            {0, 1, 4, 5, 8, 9, 12, 13},
-            {2, 3, 6, 7, 10, 11, 14, 15},
-        };
+    static constexpr int GetBlock(int block_x, int block_y) {
+        switch (format) {
+        case PixelFormat::PSMCT16:
+        case PixelFormat::PSMT4:
+            return block_table16[block_y][block_x];
+        case PixelFormat::PSMCT16S:
+            return block_table16s[block_y][block_x];
+        case PixelFormat::PSMZ32:
+        case PixelFormat::PSMZ24:
+            return block_table32z[block_y][block_x];
+        case PixelFormat::PSMZ16:
+            return block_table16z[block_y][block_x];
+        case PixelFormat::PSMZ16S:
+            return block_table16sz[block_y][block_x];
+        default:
+            return block_table32[block_y][block_x];
+        }
+    }
 
-        // find which column we want to write to
-        int column = (y / 2) % 4;
+    static constexpr int GetColumn(int x, int y) {
+        if constexpr (BITS == 32) {
+            return column_table32[y][x];
+        } else if constexpr (BITS == 16) {
+            return column_table16[y][x];
+        } else if constexpr (BITS == 8) {
+            return column_table8[y][x];
+        } else {
+            return column_table4[y][x];
+        }
+    }
 
-        // get pixel coordinates
-        int pixel_x = x % 8;
-        int pixel_y = y % 2;
+    static constexpr std::array<u16, WIDTH * HEIGHT> GenerateOffsets() {
+        std::array<u16, WIDTH * HEIGHT> table{};
 
-        int pixel = pixel_configuration[pixel_y][pixel_x];
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                int block = GetBlock(x / BLOCK_WIDTH, y / BLOCK_HEIGHT);
+                int column = GetColumn(x % BLOCK_WIDTH, y % BLOCK_HEIGHT);
+                table[(y * WIDTH) + x] = (block * BLOCK_UNITS) + column;
+            }
+        }
 
-        // each pixel is 32 bits, and each column is 16 pixels
-        // hence each column is 64 bytes
-        int offset = (column * 64) + (pixel * 4);
-        return &blocks[block][offset];
+        return table;
     }
 
-    // each page contains 32 blocks, with each block being 256 bytes
-    u8 blocks[32][256];
+    // the offset of each pixel from the start of the page, in units of the pixel size
+    static constexpr std::array<u16, WIDTH * HEIGHT> offsets = GenerateOffsets();
 };
 
 } // namespace gs
\ No newline at end of file
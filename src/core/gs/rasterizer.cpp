@@ -0,0 +1,1683 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "common/log.h"
+#include "common/memory.h"
+#include "core/gs/rasterizer.h"
+
+namespace gs {
+
+// 8 lanes of 32 bit integers, which is one avx2 register, or a pair of sse registers otherwise.
+// every path computes the same thing lane by lane, so the results don't depend on the host
+#if defined(__AVX2__)
+struct Vector {
+    __m256i value;
+};
+
+static Vector Set(s32 value) {
+    return {_mm256_set1_epi32(value)};
+}
+
+static Vector Load(const s32* data) {
+    return {_mm256_load_si256(reinterpret_cast<const __m256i*>(data))};
+}
+
+static void Store(s32* data, Vector a) {
+    _mm256_store_si256(reinterpret_cast<__m256i*>(data), a.value);
+}
+
+static Vector Add(Vector a, Vector b) {
+    return {_mm256_add_epi32(a.value, b.value)};
+}
+
+static Vector Sub(Vector a, Vector b) {
+    return {_mm256_sub_epi32(a.value, b.value)};
+}
+
+// multiplies lanes which fit in a signed 16 bit value, where every lane of b isn't negative
+static Vector Multiply(Vector a, Vector b) {
+    return {_mm256_madd_epi16(a.value, b.value)};
+}
+
+static Vector And(Vector a, Vector b) {
+    return {_mm256_and_si256(a.value, b.value)};
+}
+
+// returns a & ~b
+static Vector AndNot(Vector a, Vector b) {
+    return {_mm256_andnot_si256(b.value, a.value)};
+}
+
+static Vector Or(Vector a, Vector b) {
+    return {_mm256_or_si256(a.value, b.value)};
+}
+
+static Vector Xor(Vector a, Vector b) {
+    return {_mm256_xor_si256(a.value, b.value)};
+}
+
+static Vector CompareEqual(Vector a, Vector b) {
+    return {_mm256_cmpeq_epi32(a.value, b.value)};
+}
+
+static Vector CompareGreater(Vector a, Vector b) {
+    return {_mm256_cmpgt_epi32(a.value, b.value)};
+}
+
+static Vector Min(Vector a, Vector b) {
+    return {_mm256_min_epi32(a.value, b.value)};
+}
+
+static Vector Max(Vector a, Vector b) {
+    return {_mm256_max_epi32(a.value, b.value)};
+}
+
+template <int shift>
+static Vector ShiftLeft(Vector a) {
+    return {_mm256_slli_epi32(a.value, shift)};
+}
+
+template <int shift>
+static Vector ShiftRight(Vector a) {
+    return {_mm256_srai_epi32(a.value, shift)};
+}
+
+template <int shift>
+static Vector ShiftRightLogical(Vector a) {
+    return {_mm256_srli_epi32(a.value, shift)};
+}
+
+// returns a bit for each lane with the top bit set
+static int MoveMask(Vector a) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(a.value));
+}
+
+static Vector Combine(__m128i low, __m128i high) {
+    return {_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1)};
+}
+
+static __m128i GetLow(Vector a) {
+    return _mm256_castsi256_si128(a.value);
+}
+
+static __m128i GetHigh(Vector a) {
+    return _mm256_extracti128_si256(a.value, 1);
+}
+
+// reads data[index] for each lane
+static Vector Gather(const u32* data, Vector index) {
+    return {_mm256_i32gather_epi32(reinterpret_cast<const int*>(data), index.value, 4)};
+}
+#else
+struct Vector {
+    __m128i low;
+    __m128i high;
+};
+
+static Vector Set(s32 value) {
+    __m128i a = _mm_set1_epi32(value);
+    return {a, a};
+}
+
+static Vector Load(const s32* data) {
+    return {_mm_load_si128(reinterpret_cast<const __m128i*>(data)), _mm_load_si128(reinterpret_cast<const __m128i*>(data + 4))};
+}
+
+static void Store(s32* data, Vector a) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(data), a.low);
+    _mm_store_si128(reinterpret_cast<__m128i*>(data + 4), a.high);
+}
+
+static Vector Add(Vector a, Vector b) {
+    return {_mm_add_epi32(a.low, b.low), _mm_add_epi32(a.high, b.high)};
+}
+
+static Vector Sub(Vector a, Vector b) {
+    return {_mm_sub_epi32(a.low, b.low), _mm_sub_epi32(a.high, b.high)};
+}
+
+// multiplies lanes which fit in a signed 16 bit value, where every lane of b isn't negative
+static Vector Multiply(Vector a, Vector b) {
+    return {_mm_madd_epi16(a.low, b.low), _mm_madd_epi16(a.high, b.high)};
+}
+
+static Vector And(Vector a, Vector b) {
+    return {_mm_and_si128(a.low, b.low), _mm_and_si128(a.high, b.high)};
+}
+
+// returns a & ~b
+static Vector AndNot(Vector a, Vector b) {
+    return {_mm_andnot_si128(b.low, a.low), _mm_andnot_si128(b.high, a.high)};
+}
+
+static Vector Or(Vector a, Vector b) {
+    return {_mm_or_si128(a.low, b.low), _mm_or_si128(a.high, b.high)};
+}
+
+static Vector Xor(Vector a, Vector b) {
+    return {_mm_xor_si128(a.low, b.low), _mm_xor_si128(a.high, b.high)};
+}
+
+static Vector CompareEqual(Vector a, Vector b) {
+    return {_mm_cmpeq_epi32(a.low, b.low), _mm_cmpeq_epi32(a.high, b.high)};
+}
+
+static Vector CompareGreater(Vector a, Vector b) {
+    return {_mm_cmpgt_epi32(a.low, b.low), _mm_cmpgt_epi32(a.high, b.high)};
+}
+
+#if defined(__SSE4_1__)
+static Vector Min(Vector a, Vector b) {
+    return {_mm_min_epi32(a.low, b.low), _mm_min_epi32(a.high, b.high)};
+}
+
+static Vector Max(Vector a, Vector b) {
+    return {_mm_max_epi32(a.low, b.low), _mm_max_epi32(a.high, b.high)};
+}
+#else
+static __m128i Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static Vector Min(Vector a, Vector b) {
+    return {Select(_mm_cmpgt_epi32(a.low, b.low), b.low, a.low), Select(_mm_cmpgt_epi32(a.high, b.high), b.high, a.high)};
+}
+
+static Vector Max(Vector a, Vector b) {
+    return {Select(_mm_cmpgt_epi32(a.low, b.low), a.low, b.low), Select(_mm_cmpgt_epi32(a.high, b.high), a.high, b.high)};
+}
+#endif
+
+template <int shift>
+static Vector ShiftLeft(Vector a) {
+    return {_mm_slli_epi32(a.low, shift), _mm_slli_epi32(a.high, shift)};
+}
+
+template <int shift>
+static Vector ShiftRight(Vector a) {
+    return {_mm_srai_epi32(a.low, shift), _mm_srai_epi32(a.high, shift)};
+}
+
+template <int shift>
+static Vector ShiftRightLogical(Vector a) {
+    return {_mm_srli_epi32(a.low, shift), _mm_srli_epi32(a.high, shift)};
+}
+
+// returns a bit for each lane with the top bit set
+static int MoveMask(Vector a) {
+    return _mm_movemask_ps(_mm_castsi128_ps(a.low)) | (_mm_movemask_ps(_mm_castsi128_ps(a.high)) << 4);
+}
+
+static Vector Combine(__m128i low, __m128i high) {
+    return {low, high};
+}
+
+static __m128i GetLow(Vector a) {
+    return a.low;
+}
+
+static __m128i GetHigh(Vector a) {
+    return a.high;
+}
+
+// reads data[index] for each lane
+static Vector Gather(const u32* data, Vector index) {
+    alignas(32) s32 indices[8];
+    alignas(32) s32 values[8];
+    Store(indices, index);
+    for (int i = 0; i < 8; i++) {
+        values[i] = data[indices[i]];
+    }
+
+    return Load(values);
+}
+#endif
+
+// picks a in lanes where mask is set, and b otherwise
+static Vector Select(Vector mask, Vector a, Vector b) {
+    return Or(And(mask, a), AndNot(b, mask));
+}
+
+alignas(32) static constexpr s32 lane_index[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+// 8 lanes of 64 bit floats, which texture coordinates are worked out in. like the integer lanes,
+// this is a pair of avx registers, or 4 sse registers otherwise
+#if defined(__AVX2__)
+struct Coordinates {
+    __m256d low;
+    __m256d high;
+};
+
+static Coordinates SetCoordinates(f64 value) {
+    __m256d a = _mm256_set1_pd(value);
+    return {a, a};
+}
+
+// returns offset plus the index of each lane
+static Coordinates GetLaneOffsets(f64 offset) {
+    __m256d a = _mm256_set1_pd(offset);
+    return {_mm256_add_pd(a, _mm256_setr_pd(0, 1, 2, 3)), _mm256_add_pd(a, _mm256_setr_pd(4, 5, 6, 7))};
+}
+
+static Coordinates Add(Coordinates a, Coordinates b) {
+    return {_mm256_add_pd(a.low, b.low), _mm256_add_pd(a.high, b.high)};
+}
+
+static Coordinates Multiply(Coordinates a, Coordinates b) {
+    return {_mm256_mul_pd(a.low, b.low), _mm256_mul_pd(a.high, b.high)};
+}
+
+static Coordinates Divide(Coordinates a, Coordinates b) {
+    return {_mm256_div_pd(a.low, b.low), _mm256_div_pd(a.high, b.high)};
+}
+
+// max returns its second operand when either is nan, so nan ends up at min
+static Coordinates Clamp(Coordinates a, f64 min, f64 max) {
+    __m256d low = _mm256_set1_pd(min);
+    __m256d high = _mm256_set1_pd(max);
+    return {_mm256_min_pd(_mm256_max_pd(a.low, low), high), _mm256_min_pd(_mm256_max_pd(a.high, low), high)};
+}
+
+// rounds each lane down, where every lane fits in 32 bits
+static Vector Floor(Coordinates a) {
+    return Combine(_mm256_cvttpd_epi32(_mm256_floor_pd(a.low)), _mm256_cvttpd_epi32(_mm256_floor_pd(a.high)));
+}
+#else
+struct Coordinates {
+    __m128d lanes[4];
+};
+
+static Coordinates SetCoordinates(f64 value) {
+    __m128d a = _mm_set1_pd(value);
+    return {{a, a, a, a}};
+}
+
+// returns offset plus the index of each lane
+static Coordinates GetLaneOffsets(f64 offset) {
+    __m128d a = _mm_set1_pd(offset);
+    return {{_mm_add_pd(a, _mm_setr_pd(0, 1)), _mm_add_pd(a, _mm_setr_pd(2, 3)), _mm_add_pd(a, _mm_setr_pd(4, 5)), _mm_add_pd(a, _mm_setr_pd(6, 7))}};
+}
+
+static Coordinates Add(Coordinates a, Coordinates b) {
+    for (int i = 0; i < 4; i++) {
+        a.lanes[i] = _mm_add_pd(a.lanes[i], b.lanes[i]);
+    }
+
+    return a;
+}
+
+static Coordinates Multiply(Coordinates a, Coordinates b) {
+    for (int i = 0; i < 4; i++) {
+        a.lanes[i] = _mm_mul_pd(a.lanes[i], b.lanes[i]);
+    }
+
+    return a;
+}
+
+static Coordinates Divide(Coordinates a, Coordinates b) {
+    for (int i = 0; i < 4; i++) {
+        a.lanes[i] = _mm_div_pd(a.lanes[i], b.lanes[i]);
+    }
+
+    return a;
+}
+
+// max returns its second operand when either is nan, so nan ends up at min
+static Coordinates Clamp(Coordinates a, f64 min, f64 max) {
+    for (int i = 0; i < 4; i++) {
+        a.lanes[i] = _mm_min_pd(_mm_max_pd(a.lanes[i], _mm_set1_pd(min)), _mm_set1_pd(max));
+    }
+
+    return a;
+}
+
+// rounds each lane down, where every lane fits in 32 bits
+static __m128i Floor(__m128d a) {
+#if defined(__SSE4_1__)
+    return _mm_cvttpd_epi32(_mm_floor_pd(a));
+#else
+    // truncating rounds negative values up, so take 1 off where that happened
+    __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+    return _mm_cvttpd_epi32(_mm_sub_pd(truncated, _mm_and_pd(_mm_cmpgt_pd(truncated, a), _mm_set1_pd(1.0))));
+#endif
+}
+
+static Vector Floor(Coordinates a) {
+    __m128i low = _mm_unpacklo_epi64(Floor(a.lanes[0]), Floor(a.lanes[1]));
+    __m128i high = _mm_unpacklo_epi64(Floor(a.lanes[2]), Floor(a.lanes[3]));
+    return Combine(low, high);
+}
+#endif
+
+// edge functions are clamped to this before being split into lanes. the offset of any lane from
+// the first is much smaller, so the sign of every lane stays the same
+constexpr s64 EDGE_LIMIT = 1 << 30;
+
+// colours are only clamped enough to not overflow, as pixels outside the primitive can be way off
+constexpr s64 COLOUR_LIMIT = 1 << 28;
+
+template <PixelFormat format>
+static constexpr u32 GetZMax() {
+    if constexpr (format == PixelFormat::PSMZ32) {
+        return 0xffffffff;
+    } else if constexpr (format == PixelFormat::PSMZ24) {
+        return 0xffffff;
+    } else {
+        return 0xffff;
+    }
+}
+
+// reads a group of 8 pixels, starting at an x coordinate which is a multiple of 8
+template <PixelFormat format>
+static Vector ReadPixels(const u8* vram, u32 base, u32 width, int x, int y) {
+    using Layout = Page<format>;
+
+    if constexpr (Layout::BITS == 32) {
+        // the group is 4 pairs of pixels, 16 bytes apart
+        const u8* row = vram + (Layout::GetAddress(x, y, base, width) * 4);
+        __m128i low = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + 16)));
+        __m128i high = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + 32)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + 48)));
+        return Combine(low, high);
+    } else {
+        alignas(32) s32 pixels[8];
+        u32 page = Layout::GetPageAddress(x, y, base, width);
+        for (int i = 0; i < 8; i++) {
+            u32 address = (page + Layout::GetOffset(x + i, y)) & Layout::ADDRESS_MASK;
+            pixels[i] = common::Read<u16>(vram, address * 2);
+        }
+
+        return Load(pixels);
+    }
+}
+
+// only the bits set in each lane of bits are written
+template <PixelFormat format>
+static void WritePixels(u8* vram, u32 base, u32 width, int x, int y, Vector value, Vector bits) {
+    using Layout = Page<format>;
+
+    if constexpr (Layout::BITS == 32) {
+        u8* row = vram + (Layout::GetAddress(x, y, base, width) * 4);
+        Vector old = ReadPixels<format>(vram, base, width, x, y);
+        Vector result = Or(And(value, bits), AndNot(old, bits));
+        __m128i low = GetLow(result);
+        __m128i high = GetHigh(result);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row), low);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 16), _mm_srli_si128(low, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 32), high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(row + 48), _mm_srli_si128(high, 8));
+    } else {
+        alignas(32) s32 values[8];
+        alignas(32) s32 masks[8];
+        Store(values, value);
+        Store(masks, bits);
+
+        u32 page = Layout::GetPageAddress(x, y, base, width);
+        for (int i = 0; i < 8; i++) {
+            if (masks[i] == 0) {
+                continue;
+            }
+
+            u32 address = ((page + Layout::GetOffset(x + i, y)) & Layout::ADDRESS_MASK) * 2;
+            u16 old = common::Read<u16>(vram, address);
+            common::Write<u16>(vram, (values[i] & masks[i]) | (old & ~masks[i]), address);
+        }
+    }
+}
+
+// converts rgba8888 colours to how they're stored in the frame buffer
+template <PixelFormat format>
+static Vector ConvertColour(Vector colour) {
+    if constexpr (Page<format>::BITS == 32) {
+        return colour;
+    } else {
+        Vector r = And(ShiftRightLogical<3>(colour), Set(0x1f));
+        Vector g = And(ShiftRightLogical<6>(colour), Set(0x3e0));
+        Vector b = And(ShiftRightLogical<9>(colour), Set(0x7c00));
+        Vector a = And(ShiftRightLogical<16>(colour), Set(0x8000));
+        return Or(Or(r, g), Or(b, a));
+    }
+}
+
+// returns the bits of each frame buffer pixel which can be written
+template <PixelFormat format>
+static u32 GetFrameBits(u32 frame_mask) {
+    if constexpr (format == PixelFormat::PSMCT32) {
+        return ~frame_mask;
+    } else if constexpr (format == PixelFormat::PSMCT24) {
+        return ~frame_mask & 0xffffff;
+    } else {
+        // the 16 bit formats keep the top bits of each channel
+        u32 mask = ((frame_mask >> 3) & 0x1f) | ((frame_mask >> 6) & 0x3e0) | ((frame_mask >> 9) & 0x7c00) | ((frame_mask >> 16) & 0x8000);
+        return ~mask & 0xffff;
+    }
+}
+
+static Vector GetChannel(s64 value, Vector offsets) {
+    // the lanes are in 12 fractional bits, which leaves plenty of room for the offsets
+    Vector channel = Add(Set(std::clamp(value >> 4, -COLOUR_LIMIT, COLOUR_LIMIT)), offsets);
+    return Min(Max(ShiftRight<12>(channel), Set(0)), Set(0xff));
+}
+
+// converts frame buffer pixels back to rgba8888. psmct24 has no alpha, so it reads as 0x80
+template <PixelFormat format>
+static Vector UnpackColour(Vector value) {
+    if constexpr (format == PixelFormat::PSMCT32) {
+        return value;
+    } else if constexpr (format == PixelFormat::PSMCT24) {
+        return Or(And(value, Set(0xffffff)), Set(0x80000000));
+    } else {
+        Vector r = ShiftLeft<3>(And(value, Set(0x1f)));
+        Vector g = ShiftLeft<6>(And(value, Set(0x3e0)));
+        Vector b = ShiftLeft<9>(And(value, Set(0x7c00)));
+        Vector a = ShiftLeft<16>(And(value, Set(0x8000)));
+        return Or(Or(r, g), Or(b, a));
+    }
+}
+
+// the stages of the pixel pipeline which a row function can leave out
+enum Feature : u32 {
+    TEXTURE = 1 << 0,
+    FOG = 1 << 1,
+    ALPHA_TEST = 1 << 2,
+    DESTINATION_ALPHA_TEST = 1 << 3,
+    BLEND = 1 << 4,
+    DITHER = 1 << 5,
+    DEPTH_TEST = 1 << 6,
+    DEPTH_WRITE = 1 << 7,
+
+    // the key is worked out from the state as the row is drawn, and every stage is run with the
+    // ones which are disabled masked off
+    GENERIC = 1u << 31,
+};
+
+// the rest of the key picks how each stage works. fields of stages which are disabled are left
+// as 0, so that states which draw the same share a key
+enum KeyField : int {
+    DEPTH_GREATER = 8,
+    TEXTURE_FUNCTION = 9,
+    TEXTURE_ALPHA = 11,
+    ALPHA_METHOD = 12,
+    ALPHA_FAIL = 15,
+    DESTINATION_ALPHA_MODE = 17,
+    BLEND_A = 18,
+    BLEND_B = 20,
+    BLEND_C = 22,
+    BLEND_D = 24,
+    BLEND_ALPHA_ONLY = 26,
+    COLOUR_CLAMP = 27,
+    FRAME_ALPHA = 28,
+};
+
+static constexpr u32 GetField(u32 key, KeyField field, int bits) {
+    return (key >> field) & ((1 << bits) - 1);
+}
+
+// whether a row function for a key has to run the given stages
+static constexpr bool HasStage(u32 key, u32 stages) {
+    return key == GENERIC || (key & stages);
+}
+
+static u32 GetRowKey(const DrawState& state) {
+    u32 key = 0;
+    if (state.texture_mapping) {
+        key |= TEXTURE | (static_cast<u32>(state.texture.function) << TEXTURE_FUNCTION) | (static_cast<u32>(state.texture.alpha) << TEXTURE_ALPHA);
+    }
+
+    if (state.fog) {
+        key |= FOG;
+    }
+
+    if (state.alpha_test && state.alpha_method != AlphaTest::Always) {
+        key |= ALPHA_TEST | (static_cast<u32>(state.alpha_method) << ALPHA_METHOD) | (static_cast<u32>(state.alpha_fail) << ALPHA_FAIL);
+    }
+
+    if (state.destination_alpha_test) {
+        key |= DESTINATION_ALPHA_TEST | (static_cast<u32>(state.destination_alpha_mode) << DESTINATION_ALPHA_MODE);
+    }
+
+    if (state.blend) {
+        // the reserved selections pick the same as the last ones
+        key |= BLEND | (std::min(state.blend_a, 2) << BLEND_A) | (std::min(state.blend_b, 2) << BLEND_B) | (std::min(state.blend_c, 2) << BLEND_C) | (std::min(state.blend_d, 2) << BLEND_D);
+        key |= static_cast<u32>(state.blend_alpha_only) << BLEND_ALPHA_ONLY;
+    }
+
+    // only the 16 bit formats are dithered
+    if (state.dither && (static_cast<int>(state.frame_format) & 0x2)) {
+        key |= DITHER;
+    }
+
+    // colours can only go out of range once blended or dithered
+    if (state.colour_clamp && (key & (BLEND | DITHER))) {
+        key |= 1 << COLOUR_CLAMP;
+    }
+
+    if (state.z_test && state.z_method != ZTest::Always) {
+        key |= DEPTH_TEST | (static_cast<u32>(state.z_method == ZTest::Greater) << DEPTH_GREATER);
+    }
+
+    if (state.z_test && !state.z_mask) {
+        key |= DEPTH_WRITE;
+    }
+
+    if (state.frame_alpha) {
+        key |= 1 << FRAME_ALPHA;
+    }
+
+    return key;
+}
+
+// a lane with every bit set when value is true, so that choices can be made without branching.
+// when value is known at compile time, whatever the mask is used for folds away
+static Vector GetMask(bool value) {
+    return Set(value ? -1 : 0);
+}
+
+// wraps a texel as (clamp(value, low, high) & mask) | bits, which covers every wrap mode
+struct Wrap {
+    Vector low;
+    Vector high;
+    Vector mask;
+    Vector bits;
+};
+
+static Wrap GetWrap(WrapMode mode, int size_log2, int min, int max) {
+    int size = 1 << size_log2;
+
+    switch (mode) {
+    case WrapMode::Repeat:
+        return {Set(-(1 << 20)), Set(1 << 20), Set(size - 1), Set(0)};
+    case WrapMode::Clamp:
+        return {Set(0), Set(size - 1), Set(-1), Set(0)};
+    case WrapMode::RegionClamp:
+        return {Set(min), Set(max), Set(-1), Set(0)};
+    case WrapMode::RegionRepeat:
+        return {Set(-(1 << 20)), Set(1 << 20), Set(min), Set(max)};
+    }
+
+    return {Set(0), Set(0), Set(0), Set(0)};
+}
+
+static Vector WrapTexel(Vector value, const Wrap& wrap) {
+    return Or(And(Min(Max(value, wrap.low), wrap.high), wrap.mask), wrap.bits);
+}
+
+// modulating by this leaves the colour as it is, so the generic row function samples it when
+// texture mapping is off
+static constexpr u32 NEUTRAL_TEXEL = 0x80808080;
+
+// how a row turns texture coordinates into texels
+struct Sampler {
+    const u32* data;
+
+    // texture coordinates are multiplied by the size of the texture, or by 1 for uv
+    f64 scale_u;
+    f64 scale_v;
+
+    Wrap wrap_u;
+    Wrap wrap_v;
+
+    // the part of the texture which was decoded
+    Vector x;
+    Vector y;
+    Vector width;
+};
+
+static Sampler GetSampler(const TextureState& texture, bool enabled) {
+    if (!enabled) {
+        Wrap zero = {Set(0), Set(0), Set(0), Set(0)};
+        return {&NEUTRAL_TEXEL, 0, 0, zero, zero, Set(0), Set(0), Set(0)};
+    }
+
+    TextureCache::Area area = TextureCache::GetArea(texture);
+    Sampler sampler;
+    sampler.data = texture.data;
+    sampler.scale_u = texture.uv ? 1.0 : static_cast<f64>(1 << texture.width_log2);
+    sampler.scale_v = texture.uv ? 1.0 : static_cast<f64>(1 << texture.height_log2);
+    sampler.wrap_u = GetWrap(texture.wrap_u, texture.width_log2, texture.min_u, texture.max_u);
+    sampler.wrap_v = GetWrap(texture.wrap_v, texture.height_log2, texture.min_v, texture.max_v);
+    sampler.x = Set(area.x);
+    sampler.y = Set(area.y);
+    sampler.width = Set(area.width);
+    return sampler;
+}
+
+// converts texture coordinates to texels. q can be 0, so anything out of range, including nan,
+// is pinned to a value which every wrap mode can handle
+static Vector ToTexels(Coordinates value) {
+    return Floor(Clamp(value, -0x1p20, 0x1p20));
+}
+
+// samples the texel for each lane. coordinates are worked out from the origin of the row rather
+// than stepped, so they don't depend on where the row was split between tiles. uv coordinates
+// have a q of exactly 1 and a scale of 1, so the divide leaves them as they are
+static Vector GetTexels(const Sampler& sampler, const Rasterizer::Row& row, int x) {
+    Coordinates offset = GetLaneOffsets(x - row.origin);
+    Coordinates s = Add(SetCoordinates(row.texture[0]), Multiply(SetCoordinates(row.texture_dx[0]), offset));
+    Coordinates t = Add(SetCoordinates(row.texture[1]), Multiply(SetCoordinates(row.texture_dx[1]), offset));
+    Coordinates q = Add(SetCoordinates(row.texture[2]), Multiply(SetCoordinates(row.texture_dx[2]), offset));
+
+    Vector u = WrapTexel(ToTexels(Multiply(Divide(s, q), SetCoordinates(sampler.scale_u))), sampler.wrap_u);
+    Vector v = WrapTexel(ToTexels(Multiply(Divide(t, q), SetCoordinates(sampler.scale_v))), sampler.wrap_v);
+
+    // the decoded area is at most 1024x1024, so the multiply fits
+    Vector index = Add(Multiply(Sub(v, sampler.y), sampler.width), Sub(u, sampler.x));
+    return Gather(sampler.data, index);
+}
+
+// which comparisons of alpha against the reference pass, for each alpha test method
+struct AlphaTestMasks {
+    Vector less;
+    Vector equal;
+    Vector greater;
+};
+
+static AlphaTestMasks GetAlphaTest(bool enabled, AlphaTest method) {
+    // bit 0 passes below the reference, bit 1 at it and bit 2 above it
+    static constexpr u8 passes[8] = {0x0, 0x7, 0x1, 0x3, 0x2, 0x6, 0x4, 0x5};
+    u8 pass = enabled ? passes[static_cast<int>(method)] : 0x7;
+    return {GetMask(pass & 0x1), GetMask(pass & 0x2), GetMask(pass & 0x4)};
+}
+
+// returns the lanes which pass the alpha test
+static Vector TestAlpha(Vector alpha, Vector reference, const AlphaTestMasks& test) {
+    Vector less = And(CompareGreater(reference, alpha), test.less);
+    Vector equal = And(CompareEqual(alpha, reference), test.equal);
+    Vector greater = And(CompareGreater(alpha, reference), test.greater);
+    return Or(Or(less, equal), greater);
+}
+
+static Vector ModulateChannel(Vector texel, Vector colour) {
+    return Min(ShiftRight<7>(Multiply(texel, colour)), Set(0xff));
+}
+
+static Vector FogChannel(Vector colour, Vector fog, Vector fog_colour) {
+    return ShiftRight<8>(Add(Multiply(colour, fog), Multiply(fog_colour, Sub(Set(0xff), fog))));
+}
+
+// a blend selection picks the source, the destination or 0
+struct BlendSelect {
+    Vector source;
+    Vector destination;
+};
+
+static BlendSelect GetBlendSelect(u32 select) {
+    return {GetMask(select == 0), GetMask(select == 1)};
+}
+
+static Vector Pick(Vector source, Vector destination, const BlendSelect& select) {
+    return Or(And(source, select.source), And(destination, select.destination));
+}
+
+// a, b and d pick between the source colour, the destination colour and 0
+static Vector BlendChannel(Vector source, Vector destination, Vector c, const std::array<BlendSelect, 3>& select) {
+    Vector a = Pick(source, destination, select[0]);
+    Vector b = Pick(source, destination, select[1]);
+    Vector d = Pick(source, destination, select[2]);
+    return Add(ShiftRight<7>(Multiply(Sub(a, b), c)), d);
+}
+
+// with a fixed key, every stage of the pipeline which isn't needed is compiled out and every
+// choice within the rest folds to a constant. the generic row function makes the same choices
+// with masks worked out before the row, so neither has branches between groups of pixels other
+// than skipping groups with nothing to draw
+template <PixelFormat frame_format, PixelFormat z_format, u32 row_key>
+static void DrawRow(u8* vram, const DrawState& state, const Rasterizer::Row& row) {
+    const u32 key = row_key == GENERIC ? GetRowKey(state) : row_key;
+    alignas(32) s32 lanes[8];
+
+    // how much each lane is offset from the first
+    std::array<Vector, 3> edge_offsets;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 8; j++) {
+            lanes[j] = j * row.edges_dx[i];
+        }
+
+        edge_offsets[i] = Load(lanes);
+    }
+
+    std::array<Vector, 4> colour_offsets;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++) {
+            lanes[j] = (j * row.colour_dx[i]) >> 4;
+        }
+
+        colour_offsets[i] = Load(lanes);
+    }
+
+    std::array<s64, 8> z_offsets;
+    for (int i = 0; i < 8; i++) {
+        z_offsets[i] = i * row.z_dx;
+    }
+
+    Vector fog_offsets = Set(0);
+    if constexpr (HasStage(row_key, FOG)) {
+        for (int j = 0; j < 8; j++) {
+            lanes[j] = (j * row.fog_dx) >> 4;
+        }
+
+        fog_offsets = Load(lanes);
+    }
+
+    // the dither matrix repeats every 4 pixels, and each group of 8 starts on a multiple of 4
+    Vector dither = Set(0);
+    if (key & DITHER) {
+        for (int j = 0; j < 8; j++) {
+            lanes[j] = state.dither_matrix[row.y & 0x3][j & 0x3];
+        }
+
+        dither = Load(lanes);
+    }
+
+    Sampler sampler = {};
+    if constexpr (HasStage(row_key, TEXTURE)) {
+        sampler = GetSampler(state.texture, key & TEXTURE);
+    }
+
+    // decal replaces the colour, highlight adds the alpha of the primitive onto the modulated
+    // colour, and the texture alpha is only used with tcc
+    TextureFunction function = static_cast<TextureFunction>(GetField(key, TEXTURE_FUNCTION, 2));
+    bool texture_alpha = GetField(key, TEXTURE_ALPHA, 1);
+    Vector decal = GetMask(function == TextureFunction::Decal);
+    Vector highlight = GetMask(function == TextureFunction::Highlight || function == TextureFunction::Highlight2);
+    Vector modulate_alpha = GetMask(texture_alpha && function == TextureFunction::Modulate);
+    Vector add_alpha = GetMask(texture_alpha && function == TextureFunction::Highlight);
+    Vector replace_alpha = GetMask(texture_alpha && (function == TextureFunction::Decal || function == TextureFunction::Highlight2));
+
+    // pixels which fail the alpha test can still write to the frame buffer, the z buffer, or only
+    // the colour of the frame buffer
+    AlphaFail alpha_fail = static_cast<AlphaFail>(GetField(key, ALPHA_FAIL, 2));
+    AlphaTestMasks alpha_test = GetAlphaTest(key & ALPHA_TEST, static_cast<AlphaTest>(GetField(key, ALPHA_METHOD, 3)));
+    Vector frame_on_fail = GetMask(alpha_fail == AlphaFail::FrameOnly || alpha_fail == AlphaFail::RGBOnly);
+    Vector z_on_fail = GetMask(alpha_fail == AlphaFail::ZOnly);
+    Vector rgb_on_fail = GetMask(alpha_fail == AlphaFail::RGBOnly);
+
+    Vector destination_alpha_mode = GetMask(GetField(key, DESTINATION_ALPHA_MODE, 1));
+    Vector destination_alpha_off = GetMask(!(key & DESTINATION_ALPHA_TEST));
+    Vector z_equal = GetMask(!GetField(key, DEPTH_GREATER, 1));
+    Vector z_test_off = GetMask(!(key & DEPTH_TEST));
+    Vector z_write = GetMask(key & DEPTH_WRITE);
+    Vector fog_on = GetMask(key & FOG);
+
+    // c picks the source alpha, the destination alpha or the fixed alpha, which is folded into
+    // a constant that is 0 unless it's picked
+    std::array<BlendSelect, 3> blend_select = {GetBlendSelect(GetField(key, BLEND_A, 2)), GetBlendSelect(GetField(key, BLEND_B, 2)), GetBlendSelect(GetField(key, BLEND_D, 2))};
+    BlendSelect blend_c = GetBlendSelect(GetField(key, BLEND_C, 2));
+    Vector blend_fix = Set(GetField(key, BLEND_C, 2) == 2 ? state.blend_fix : 0);
+    Vector blend_on = GetMask(key & BLEND);
+    Vector blend_always = GetMask(!GetField(key, BLEND_ALPHA_ONLY, 1));
+
+    // without colour clamping the bottom 8 bits are kept
+    bool colour_clamp = GetField(key, COLOUR_CLAMP, 1);
+    Vector colour_low = Set(colour_clamp ? 0 : std::numeric_limits<s32>::min());
+    Vector colour_high = Set(colour_clamp ? 0xff : std::numeric_limits<s32>::max());
+    Vector frame_alpha = Set(GetField(key, FRAME_ALPHA, 1) ? 0x80000000 : 0);
+
+    Vector frame_bits = Set(GetFrameBits<frame_format>(state.frame_mask));
+    Vector alpha_bits = ConvertColour<frame_format>(Set(0xff000000));
+    Vector alpha_top = ConvertColour<frame_format>(Set(0x80000000));
+    Vector z_bits = Set(GetZMax<z_format>());
+    Vector sign = Set(0x80000000);
+    Vector zero = Set(0);
+    Vector colour_max = Set(0xff);
+    Vector alpha_reference = Set(state.alpha_reference);
+    std::array<Vector, 3> fog_colour = {Set(state.fog_colour & 0xff), Set((state.fog_colour >> 8) & 0xff), Set((state.fog_colour >> 16) & 0xff)};
+
+    Vector first = Set(row.x0 - 1);
+    Vector last = Set(row.x1 + 1);
+    int start = row.x0 & ~0x7;
+    s64 offset = start - row.origin;
+
+    std::array<s64, 3> edges;
+    for (int i = 0; i < 3; i++) {
+        edges[i] = row.edges[i] + (row.edges_dx[i] * offset);
+    }
+
+    std::array<s64, 4> colour;
+    for (int i = 0; i < 4; i++) {
+        colour[i] = row.colour[i] + (row.colour_dx[i] * offset);
+    }
+
+    s64 z = row.z + (row.z_dx * offset);
+    s64 fog = row.fog + (row.fog_dx * offset);
+
+    for (int x = start; x <= row.x1; x += 8) {
+        Vector lane_x = Add(Set(x), Load(lane_index));
+        Vector mask = And(CompareGreater(lane_x, first), CompareGreater(last, lane_x));
+
+        for (int i = 0; i < 3; i++) {
+            // only lanes where the edge function isn't negative are covered
+            Vector edge = Add(Set(std::clamp(edges[i], -EDGE_LIMIT, EDGE_LIMIT)), edge_offsets[i]);
+            mask = AndNot(mask, ShiftRight<31>(edge));
+            edges[i] += row.edges_dx[i] * 8;
+        }
+
+        if (MoveMask(mask) != 0) {
+            Vector destination = Set(0);
+            if constexpr (HasStage(row_key, DESTINATION_ALPHA_TEST | BLEND)) {
+                destination = ReadPixels<frame_format>(vram, state.frame_base, state.frame_width, x, row.y);
+            }
+
+            if constexpr (HasStage(row_key, DESTINATION_ALPHA_TEST)) {
+                Vector clear = CompareEqual(And(destination, alpha_top), zero);
+                mask = And(mask, Or(Xor(clear, destination_alpha_mode), destination_alpha_off));
+            }
+
+            Vector depth = Set(0);
+            if constexpr (HasStage(row_key, DEPTH_TEST | DEPTH_WRITE)) {
+                for (int i = 0; i < 8; i++) {
+                    lanes[i] = std::clamp<s64>((z + z_offsets[i]) >> 16, 0, GetZMax<z_format>());
+                }
+
+                depth = Load(lanes);
+            }
+
+            if constexpr (HasStage(row_key, DEPTH_TEST)) {
+                // compare as unsigned by flipping the sign bits
+                Vector old = Xor(And(ReadPixels<z_format>(vram, state.z_base, state.frame_width, x, row.y), z_bits), sign);
+                Vector current = Xor(depth, sign);
+                Vector pass = Or(CompareGreater(current, old), And(CompareEqual(current, old), z_equal));
+                mask = And(mask, Or(pass, z_test_off));
+            }
+
+            if (MoveMask(mask) != 0) {
+                Vector r = GetChannel(colour[0], colour_offsets[0]);
+                Vector g = GetChannel(colour[1], colour_offsets[1]);
+                Vector b = GetChannel(colour[2], colour_offsets[2]);
+                Vector a = GetChannel(colour[3], colour_offsets[3]);
+
+                if constexpr (HasStage(row_key, TEXTURE)) {
+                    Vector texel = GetTexels(sampler, row, x);
+                    Vector texel_r = And(texel, colour_max);
+                    Vector texel_g = And(ShiftRightLogical<8>(texel), colour_max);
+                    Vector texel_b = And(ShiftRightLogical<16>(texel), colour_max);
+                    Vector texel_a = ShiftRightLogical<24>(texel);
+
+                    Vector highlight_alpha = And(a, highlight);
+                    r = Select(decal, texel_r, Min(Add(ShiftRight<7>(Multiply(texel_r, r)), highlight_alpha), colour_max));
+                    g = Select(decal, texel_g, Min(Add(ShiftRight<7>(Multiply(texel_g, g)), highlight_alpha), colour_max));
+                    b = Select(decal, texel_b, Min(Add(ShiftRight<7>(Multiply(texel_b, b)), highlight_alpha), colour_max));
+
+                    Vector added_alpha = Select(add_alpha, Min(Add(texel_a, a), colour_max), Select(replace_alpha, texel_a, a));
+                    a = Select(modulate_alpha, ModulateChannel(texel_a, a), added_alpha);
+                }
+
+                if constexpr (HasStage(row_key, FOG)) {
+                    Vector f = GetChannel(fog, fog_offsets);
+                    r = Select(fog_on, FogChannel(r, f, fog_colour[0]), r);
+                    g = Select(fog_on, FogChannel(g, f, fog_colour[1]), g);
+                    b = Select(fog_on, FogChannel(b, f, fog_colour[2]), b);
+                }
+
+                // which lanes write to the frame and z buffers, and which only write the colour of the frame buffer
+                Vector frame_lanes = mask;
+                Vector z_lanes = mask;
+                Vector rgb_lanes = zero;
+                if constexpr (HasStage(row_key, ALPHA_TEST)) {
+                    Vector pass = TestAlpha(a, alpha_reference, alpha_test);
+                    frame_lanes = And(mask, Or(pass, frame_on_fail));
+                    z_lanes = And(mask, Or(pass, z_on_fail));
+                    rgb_lanes = AndNot(rgb_on_fail, pass);
+                }
+
+                if constexpr (HasStage(row_key, BLEND)) {
+                    Vector unpacked = UnpackColour<frame_format>(destination);
+                    Vector destination_r = And(unpacked, colour_max);
+                    Vector destination_g = And(ShiftRightLogical<8>(unpacked), colour_max);
+                    Vector destination_b = And(ShiftRightLogical<16>(unpacked), colour_max);
+                    Vector destination_a = ShiftRightLogical<24>(unpacked);
+                    Vector c = Or(Pick(a, destination_a, blend_c), blend_fix);
+
+                    // with pabe, pixels without the top bit of their alpha set keep their source colour
+                    Vector blended = And(blend_on, Or(CompareGreater(a, Set(0x7f)), blend_always));
+                    r = Select(blended, BlendChannel(r, destination_r, c, blend_select), r);
+                    g = Select(blended, BlendChannel(g, destination_g, c, blend_select), g);
+                    b = Select(blended, BlendChannel(b, destination_b, c, blend_select), b);
+                }
+
+                if constexpr (HasStage(row_key, DITHER)) {
+                    r = Add(r, dither);
+                    g = Add(g, dither);
+                    b = Add(b, dither);
+                }
+
+                if constexpr (HasStage(row_key, BLEND | DITHER)) {
+                    r = And(Min(Max(r, colour_low), colour_high), colour_max);
+                    g = And(Min(Max(g, colour_low), colour_high), colour_max);
+                    b = And(Min(Max(b, colour_low), colour_high), colour_max);
+                }
+
+                Vector rgba = Or(Or(Or(r, ShiftLeft<8>(g)), Or(ShiftLeft<16>(b), ShiftLeft<24>(a))), frame_alpha);
+
+                if (MoveMask(frame_lanes) != 0) {
+                    Vector bits = AndNot(And(frame_lanes, frame_bits), And(rgb_lanes, alpha_bits));
+                    WritePixels<frame_format>(vram, state.frame_base, state.frame_width, x, row.y, ConvertColour<frame_format>(rgba), bits);
+                }
+
+                if constexpr (HasStage(row_key, DEPTH_WRITE)) {
+                    z_lanes = And(z_lanes, z_write);
+                    if (MoveMask(z_lanes) != 0) {
+                        WritePixels<z_format>(vram, state.z_base, state.frame_width, x, row.y, depth, And(z_lanes, z_bits));
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            colour[i] += row.colour_dx[i] * 8;
+        }
+
+        z += row.z_dx * 8;
+        fog += row.fog_dx * 8;
+    }
+}
+
+// the settings games most often pair with each structure
+constexpr u32 OPAQUE_Z = DEPTH_TEST | DEPTH_WRITE;
+constexpr u32 BLENDED_Z = DEPTH_TEST;
+constexpr u32 MODULATE = TEXTURE | (1 << TEXTURE_ALPHA);
+constexpr u32 DECAL = TEXTURE | (static_cast<u32>(TextureFunction::Decal) << TEXTURE_FUNCTION) | (1 << TEXTURE_ALPHA);
+constexpr u32 ALPHA_GEQUAL = ALPHA_TEST | (static_cast<u32>(AlphaTest::GreaterEqual) << ALPHA_METHOD);
+
+// (source - destination) * source alpha + destination, and source * source alpha + destination
+constexpr u32 ALPHA_BLEND = BLEND | (1 << BLEND_B) | (1 << BLEND_D) | (1 << COLOUR_CLAMP);
+constexpr u32 ADDITIVE_BLEND = BLEND | (2 << BLEND_B) | (1 << BLEND_D) | (1 << COLOUR_CLAMP);
+
+// the keys games use most get their own row functions, and the rest share the generic one
+static constexpr u32 specialised_keys[] = {
+    0, OPAQUE_Z,
+    ALPHA_BLEND, ALPHA_BLEND | BLENDED_Z, ADDITIVE_BLEND, ADDITIVE_BLEND | BLENDED_Z,
+
+    MODULATE, MODULATE | OPAQUE_Z, DECAL, DECAL | OPAQUE_Z,
+    MODULATE | ALPHA_BLEND, MODULATE | ALPHA_BLEND | BLENDED_Z, MODULATE | ADDITIVE_BLEND, MODULATE | ADDITIVE_BLEND | BLENDED_Z,
+    DECAL | ALPHA_BLEND, DECAL | ALPHA_BLEND | BLENDED_Z, DECAL | ADDITIVE_BLEND, DECAL | ADDITIVE_BLEND | BLENDED_Z,
+
+    MODULATE | ALPHA_GEQUAL, MODULATE | ALPHA_GEQUAL | OPAQUE_Z, DECAL | ALPHA_GEQUAL, DECAL | ALPHA_GEQUAL | OPAQUE_Z,
+    MODULATE | ALPHA_GEQUAL | ALPHA_BLEND, MODULATE | ALPHA_GEQUAL | ALPHA_BLEND | BLENDED_Z,
+    MODULATE | ALPHA_GEQUAL | ADDITIVE_BLEND, MODULATE | ALPHA_GEQUAL | ADDITIVE_BLEND | BLENDED_Z,
+    DECAL | ALPHA_GEQUAL | ALPHA_BLEND, DECAL | ALPHA_GEQUAL | ALPHA_BLEND | BLENDED_Z,
+    DECAL | ALPHA_GEQUAL | ADDITIVE_BLEND, DECAL | ALPHA_GEQUAL | ADDITIVE_BLEND | BLENDED_Z,
+
+    MODULATE | FOG, MODULATE | FOG | OPAQUE_Z, DECAL | FOG, DECAL | FOG | OPAQUE_Z,
+    MODULATE | FOG | ALPHA_GEQUAL, MODULATE | FOG | ALPHA_GEQUAL | OPAQUE_Z, DECAL | FOG | ALPHA_GEQUAL, DECAL | FOG | ALPHA_GEQUAL | OPAQUE_Z,
+};
+
+template <PixelFormat frame_format, PixelFormat z_format, u32 key>
+static bool SelectKey(u32 wanted, Rasterizer::RowFunction& function) {
+    // keys which leave the z buffer alone are only ever asked for with psmz32
+    if constexpr (z_format == PixelFormat::PSMZ32 || (key & (DEPTH_TEST | DEPTH_WRITE))) {
+        if (wanted == key) {
+            function = DrawRow<frame_format, z_format, key>;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <PixelFormat frame_format, PixelFormat z_format, size_t... index>
+static Rasterizer::RowFunction SelectKeys(u32 key, std::index_sequence<index...>) {
+    Rasterizer::RowFunction function = DrawRow<frame_format, z_format, GENERIC>;
+    (SelectKey<frame_format, z_format, specialised_keys[index]>(key, function) || ...);
+    return function;
+}
+
+template <PixelFormat frame_format>
+static Rasterizer::RowFunction SelectRowFunction(PixelFormat z_format, u32 key) {
+    constexpr auto keys = std::make_index_sequence<std::size(specialised_keys)>();
+
+    switch (z_format) {
+    case PixelFormat::PSMZ32:
+        return SelectKeys<frame_format, PixelFormat::PSMZ32>(key, keys);
+    case PixelFormat::PSMZ24:
+        return SelectKeys<frame_format, PixelFormat::PSMZ24>(key, keys);
+    case PixelFormat::PSMZ16:
+        return SelectKeys<frame_format, PixelFormat::PSMZ16>(key, keys);
+    case PixelFormat::PSMZ16S:
+        return SelectKeys<frame_format, PixelFormat::PSMZ16S>(key, keys);
+    default:
+        common::Error("[gs::Rasterizer] handle z format %02x", static_cast<int>(z_format));
+    }
+
+    return nullptr;
+}
+
+static s64 DivideFloor(s64 a, s64 b) {
+    return (a / b) - ((a % b) != 0 && ((a < 0) != (b < 0)));
+}
+
+// converts to 16.16 fixed point, keeping values for pixels far outside the primitive in range
+static s64 ToFixed(f64 value) {
+    return std::llround(std::clamp(value * 65536.0, -0x1p62, 0x1p62));
+}
+
+// the end of the byte range of a buffer from its base down to row y. pages are 8kb, and the 32 bit
+// formats have 64x32 pages and the 16 bit formats 64x64. the 8 and 4 bit formats have pages which
+// are wider and taller still, so treating them as 32 bit overestimates the range
+static u32 GetBufferEnd(PixelFormat format, u32 base, u32 width, int y) {
+    bool is_16bit = format == PixelFormat::PSMCT16 || format == PixelFormat::PSMCT16S || format == PixelFormat::PSMZ16 || format == PixelFormat::PSMZ16S;
+    u32 page_height = is_16bit ? 64 : 32;
+
+    return (base * 256) + (((y / page_height) + 1) * std::max<u32>(width, 1) * 8192);
+}
+
+// uv is in texels, and stq is left for the row function to divide per pixel
+static std::array<f64, 3> GetTextureCoordinates(const DrawState& state, const Rasterizer::Vertex& vertex) {
+    if (state.texture.uv) {
+        return {vertex.u / 16.0, vertex.v / 16.0, 1.0};
+    }
+
+    return {vertex.s, vertex.t, vertex.q};
+}
+
+Rasterizer::Rasterizer(u8* vram) : vram(vram), texture_cache(vram), next_tile(0) {}
+
+Rasterizer::~Rasterizer() {
+    StopWorkers();
+}
+
+void Rasterizer::SetThreadCount(int count) {
+    Flush();
+    StopWorkers();
+
+    thread_count = std::clamp(count, 1, 64);
+    if (thread_count > 1) {
+        primitives.reserve(MAX_PRIMITIVES);
+        StartWorkers(thread_count - 1);
+    }
+}
+
+int Rasterizer::GetThreadCount() {
+    return thread_count;
+}
+
+void Rasterizer::Flush() {
+    if (primitives.empty()) {
+        return;
+    }
+
+    next_tile = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        pending_workers = workers.size();
+    }
+
+    start_condition.notify_all();
+    DrawTiles();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_condition.wait(lock, [this] { return pending_workers == 0; });
+    }
+
+    for (int tile : active_tiles) {
+        bins[tile].clear();
+    }
+
+    active_tiles.clear();
+    primitives.clear();
+    pending_pages.reset();
+    texture_cache.Release();
+}
+
+void Rasterizer::InvalidateTextures(PixelFormat format, u32 base, u32 width, int x0, int y0, int x1, int y1) {
+    texture_cache.Invalidate(TextureCache::GetPages(format, base, width, x0, y0, x1, y1));
+}
+
+void Rasterizer::InvalidateAllTextures() {
+    texture_cache.InvalidateAll();
+}
+
+TextureCache::Stats Rasterizer::GetTextureCacheStats() {
+    return texture_cache.GetStats();
+}
+
+void Rasterizer::DrawPoint(const DrawState& state, const Vertex& v0) {
+    RowFunction function = GetRowFunction(state);
+    if (!function) {
+        return;
+    }
+
+    // pixels are sampled at their top left corner, and a point covers the pixel nearest to it
+    int x = (v0.x + 7) >> 4;
+    int y = (v0.y + 7) >> 4;
+    DrawRectangle(state, function, x, y, x, y, v0, v0);
+}
+
+void Rasterizer::DrawLine(const DrawState& state, const Vertex& v0, const Vertex& v1) {
+    RowFunction function = GetRowFunction(state);
+    if (!function) {
+        return;
+    }
+
+    // step one pixel at a time along the major axis, leaving out the last pixel so that
+    // connected lines don't draw their shared vertex twice
+    s32 dx = v1.x - v0.x;
+    s32 dy = v1.y - v0.y;
+    bool x_major = std::abs(dx) >= std::abs(dy);
+    int start = x_major ? (v0.x + 7) >> 4 : (v0.y + 7) >> 4;
+    int end = x_major ? (v1.x + 7) >> 4 : (v1.y + 7) >> 4;
+    int step = start < end ? 1 : -1;
+
+    for (int i = start; i != end; i += step) {
+        f64 t = x_major ? static_cast<f64>((i * 16) - v0.x) / dx : static_cast<f64>((i * 16) - v0.y) / dy;
+        t = std::clamp(t, 0.0, 1.0);
+
+        Vertex pixel = v1;
+        pixel.z = static_cast<u32>(std::llround(v0.z + (t * (static_cast<f64>(v1.z) - v0.z))));
+
+        pixel.fog = static_cast<u8>(v0.fog + (t * (v1.fog - v0.fog)));
+
+        if (state.gouraud) {
+            pixel.r = static_cast<u8>(v0.r + (t * (v1.r - v0.r)));
+            pixel.g = static_cast<u8>(v0.g + (t * (v1.g - v0.g)));
+            pixel.b = static_cast<u8>(v0.b + (t * (v1.b - v0.b)));
+            pixel.a = static_cast<u8>(v0.a + (t * (v1.a - v0.a)));
+        }
+
+        if (state.texture_mapping) {
+            pixel.u = static_cast<u16>(v0.u + (t * (v1.u - v0.u)));
+            pixel.v = static_cast<u16>(v0.v + (t * (v1.v - v0.v)));
+            pixel.s = v0.s + (t * (v1.s - v0.s));
+            pixel.t = v0.t + (t * (v1.t - v0.t));
+            pixel.q = v0.q + (t * (v1.q - v0.q));
+        }
+
+        int x = x_major ? i : (static_cast<s32>(std::llround(v0.x + (t * dx))) + 7) >> 4;
+        int y = x_major ? (static_cast<s32>(std::llround(v0.y + (t * dy))) + 7) >> 4 : i;
+        DrawRectangle(state, function, x, y, x, y, pixel, pixel);
+    }
+}
+
+void Rasterizer::DrawTriangle(const DrawState& state, const Vertex& v0, const Vertex& v1, const Vertex& v2) {
+    RowFunction function = GetRowFunction(state);
+    if (!function) {
+        return;
+    }
+
+    // order the vertices so that the interior is on the positive side of every edge
+    std::array<const Vertex*, 3> vertices = {&v0, &v1, &v2};
+    s64 area = (static_cast<s64>(v1.x - v0.x) * (v2.y - v0.y)) - (static_cast<s64>(v2.x - v0.x) * (v1.y - v0.y));
+    if (area == 0) {
+        return;
+    }
+
+    if (area < 0) {
+        std::swap(vertices[1], vertices[2]);
+        area = -area;
+    }
+
+    const Vertex& a = *vertices[0];
+    const Vertex& b = *vertices[1];
+    const Vertex& c = *vertices[2];
+
+    // a pixel is covered if its top left corner is inside the triangle
+    Primitive primitive;
+    primitive.state = state;
+    primitive.function = function;
+    primitive.x0 = std::max((std::min({a.x, b.x, c.x}) + 15) >> 4, state.scissor_x0);
+    primitive.y0 = std::max((std::min({a.y, b.y, c.y}) + 15) >> 4, state.scissor_y0);
+    primitive.x1 = std::min(std::max({a.x, b.x, c.x}) >> 4, state.scissor_x1);
+    primitive.y1 = std::min(std::max({a.y, b.y, c.y}) >> 4, state.scissor_y1);
+    primitive.rectangle = false;
+    if (primitive.x0 > primitive.x1 || primitive.y0 > primitive.y1) {
+        return;
+    }
+
+    // edge i goes from vertex i to the next vertex. pixels exactly on an edge are only covered
+    // if it's a top or left edge, so edges which aren't have their functions lowered by 1
+    for (int i = 0; i < 3; i++) {
+        const Vertex& from = *vertices[i];
+        const Vertex& to = *vertices[(i + 1) % 3];
+        primitive.edge_x[i] = to.x - from.x;
+        primitive.edge_y[i] = to.y - from.y;
+        primitive.from_x[i] = from.x;
+        primitive.from_y[i] = from.y;
+
+        bool top_left = primitive.edge_y[i] < 0 || (primitive.edge_y[i] == 0 && primitive.edge_x[i] > 0);
+        primitive.edge_bias[i] = top_left ? 0 : 1;
+    }
+
+    // attributes change linearly across the triangle, by these amounts per 12.4 unit
+    f64 bx = b.x - a.x;
+    f64 by = b.y - a.y;
+    f64 cx = c.x - a.x;
+    f64 cy = c.y - a.y;
+    auto get_gradients = [&](f64 value_a, f64 value_b, f64 value_c) {
+        f64 db = value_b - value_a;
+        f64 dc = value_c - value_a;
+        return std::array<f64, 2>{((db * cy) - (dc * by)) / area, ((dc * bx) - (db * cx)) / area};
+    };
+
+    primitive.origin_x = a.x;
+    primitive.origin_y = a.y;
+
+    // with flat shading every pixel gets the colour of the last vertex
+    primitive.colour = {static_cast<f64>(v2.r), static_cast<f64>(v2.g), static_cast<f64>(v2.b), static_cast<f64>(v2.a)};
+    primitive.colour_gradients = {};
+    if (state.gouraud) {
+        primitive.colour = {static_cast<f64>(a.r), static_cast<f64>(a.g), static_cast<f64>(a.b), static_cast<f64>(a.a)};
+        primitive.colour_gradients[0] = get_gradients(a.r, b.r, c.r);
+        primitive.colour_gradients[1] = get_gradients(a.g, b.g, c.g);
+        primitive.colour_gradients[2] = get_gradients(a.b, b.b, c.b);
+        primitive.colour_gradients[3] = get_gradients(a.a, b.a, c.a);
+    }
+
+    primitive.z = a.z;
+    primitive.z_gradients = get_gradients(a.z, b.z, c.z);
+    primitive.fog = a.fog;
+    primitive.fog_gradients = get_gradients(a.fog, b.fog, c.fog);
+
+    primitive.texture = {};
+    primitive.texture_gradients = {};
+    if (state.texture_mapping) {
+        std::array<f64, 3> texture_a = GetTextureCoordinates(state, a);
+        std::array<f64, 3> texture_b = GetTextureCoordinates(state, b);
+        std::array<f64, 3> texture_c = GetTextureCoordinates(state, c);
+        primitive.texture = texture_a;
+
+        for (int i = 0; i < 3; i++) {
+            primitive.texture_gradients[i] = get_gradients(texture_a[i], texture_b[i], texture_c[i]);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        primitive.colour_dx[i] = ToFixed(primitive.colour_gradients[i][0] * 16);
+    }
+
+    primitive.z_dx = ToFixed(primitive.z_gradients[0] * 16);
+    primitive.fog_dx = ToFixed(primitive.fog_gradients[0] * 16);
+    Submit(primitive);
+}
+
+void Rasterizer::DrawSprite(const DrawState& state, const Vertex& v0, const Vertex& v1) {
+    RowFunction function = GetRowFunction(state);
+    if (!function) {
+        return;
+    }
+
+    // the right and bottom edges aren't included
+    int x0 = (std::min(v0.x, v1.x) + 15) >> 4;
+    int y0 = (std::min(v0.y, v1.y) + 15) >> 4;
+    int x1 = (std::max(v0.x, v1.x) - 1) >> 4;
+    int y1 = (std::max(v0.y, v1.y) - 1) >> 4;
+    DrawRectangle(state, function, x0, y0, x1, y1, v0, v1);
+}
+
+Rasterizer::RowFunction Rasterizer::GetRowFunction(const DrawState& state) {
+    // nothing is drawn when the z test never passes
+    if (state.z_test && state.z_method == ZTest::Never) {
+        return nullptr;
+    }
+
+    // or when pixels which fail the alpha test are thrown away, and it never passes
+    if (state.alpha_test && state.alpha_method == AlphaTest::Never && state.alpha_fail == AlphaFail::Keep) {
+        return nullptr;
+    }
+
+    // the z buffer isn't touched without the z test or z writes, so its format doesn't matter
+    u32 key = GetRowKey(state);
+    PixelFormat z_format = (key & (DEPTH_TEST | DEPTH_WRITE)) ? state.z_format : PixelFormat::PSMZ32;
+    u64 cache_key = static_cast<u64>(state.frame_format) | (static_cast<u64>(z_format) << 8) | (static_cast<u64>(key) << 16);
+
+    auto cached = row_functions.find(cache_key);
+    if (cached != row_functions.end()) {
+        return cached->second;
+    }
+
+    RowFunction function = nullptr;
+    switch (state.frame_format) {
+    case PixelFormat::PSMCT32:
+        function = SelectRowFunction<PixelFormat::PSMCT32>(z_format, key);
+        break;
+    case PixelFormat::PSMCT24:
+        function = SelectRowFunction<PixelFormat::PSMCT24>(z_format, key);
+        break;
+    case PixelFormat::PSMCT16:
+        function = SelectRowFunction<PixelFormat::PSMCT16>(z_format, key);
+        break;
+    case PixelFormat::PSMCT16S:
+        function = SelectRowFunction<PixelFormat::PSMCT16S>(z_format, key);
+        break;
+    default:
+        common::Error("[gs::Rasterizer] handle frame format %02x", static_cast<int>(state.frame_format));
+    }
+
+    row_functions[cache_key] = function;
+    return function;
+}
+
+void Rasterizer::DrawRectangle(const DrawState& state, RowFunction function, int x0, int y0, int x1, int y1, const Vertex& v0, const Vertex& v1) {
+    Primitive primitive;
+    primitive.state = state;
+    primitive.function = function;
+    primitive.x0 = std::max(x0, state.scissor_x0);
+    primitive.y0 = std::max(y0, state.scissor_y0);
+    primitive.x1 = std::min(x1, state.scissor_x1);
+    primitive.y1 = std::min(y1, state.scissor_y1);
+    primitive.rectangle = true;
+    if (primitive.x0 > primitive.x1 || primitive.y0 > primitive.y1) {
+        return;
+    }
+
+    primitive.origin_x = v0.x;
+    primitive.origin_y = v0.y;
+    primitive.colour = {static_cast<f64>(v1.r), static_cast<f64>(v1.g), static_cast<f64>(v1.b), static_cast<f64>(v1.a)};
+    primitive.colour_gradients = {};
+    primitive.z = v1.z;
+    primitive.z_gradients = {};
+    primitive.fog = v1.fog;
+    primitive.fog_gradients = {};
+
+    primitive.texture = {};
+    primitive.texture_gradients = {};
+    if (state.texture_mapping) {
+        // s or u goes across the rectangle and t or v goes down it, while q is the same throughout
+        std::array<f64, 3> texture_0 = GetTextureCoordinates(state, v0);
+        std::array<f64, 3> texture_1 = GetTextureCoordinates(state, v1);
+        f64 dx = v1.x - v0.x;
+        f64 dy = v1.y - v0.y;
+        primitive.texture = {texture_0[0], texture_0[1], texture_1[2]};
+        primitive.texture_gradients[0][0] = dx != 0 ? (texture_1[0] - texture_0[0]) / dx : 0;
+        primitive.texture_gradients[1][1] = dy != 0 ? (texture_1[1] - texture_0[1]) / dy : 0;
+    }
+
+    primitive.colour_dx.fill(0);
+    primitive.z_dx = 0;
+    primitive.fog_dx = 0;
+    Submit(primitive);
+}
+
+void Rasterizer::DrawPrimitive(const Primitive& primitive, int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, primitive.x0);
+    y0 = std::max(y0, primitive.y0);
+    x1 = std::min(x1, primitive.x1);
+    y1 = std::min(y1, primitive.y1);
+    if (x0 > x1) {
+        return;
+    }
+
+    Row row;
+    if (primitive.rectangle) {
+        row.origin = primitive.x0 & ~0x7;
+        row.edges.fill(0);
+        row.edges_dx.fill(0);
+    }
+
+    for (int y = y0; y <= y1; y++) {
+        if (primitive.rectangle) {
+            row.y = y;
+            row.x0 = x0;
+            row.x1 = x1;
+            GetRowAttributes(primitive, y, row);
+        } else {
+            if (!GetTriangleRow(primitive, y, row)) {
+                continue;
+            }
+
+            row.x0 = std::max(row.x0, x0);
+            row.x1 = std::min(row.x1, x1);
+            if (row.x0 > row.x1) {
+                continue;
+            }
+        }
+
+        primitive.function(vram, primitive.state, row);
+    }
+}
+
+bool Rasterizer::GetTriangleRow(const Primitive& primitive, int y, Row& row) {
+    // narrow down the row to where each edge function crosses 0, so that groups
+    // which are entirely outside the triangle aren't visited
+    s64 first = primitive.x0;
+    s64 last = primitive.x1;
+
+    for (int i = 0; i < 3; i++) {
+        s64 edge = (primitive.edge_x[i] * ((y * 16) - primitive.from_y[i])) - (primitive.edge_y[i] * ((primitive.x0 * 16) - primitive.from_x[i])) - primitive.edge_bias[i];
+        s64 dx = -primitive.edge_y[i] * 16;
+
+        if (dx > 0) {
+            first = std::max(first, primitive.x0 + DivideFloor(-edge + dx - 1, dx));
+        } else if (dx < 0) {
+            last = std::min(last, primitive.x0 + DivideFloor(edge, -dx));
+        } else if (edge < 0) {
+            return false;
+        }
+    }
+
+    if (first > last) {
+        return false;
+    }
+
+    row.y = y;
+    row.x0 = first;
+    row.x1 = last;
+    row.origin = row.x0 & ~0x7;
+
+    int origin_x = row.origin * 16;
+    for (int i = 0; i < 3; i++) {
+        row.edges[i] = (primitive.edge_x[i] * ((y * 16) - primitive.from_y[i])) - (primitive.edge_y[i] * (origin_x - primitive.from_x[i])) - primitive.edge_bias[i];
+        row.edges_dx[i] = -primitive.edge_y[i] * 16;
+    }
+
+    GetRowAttributes(primitive, y, row);
+    return true;
+}
+
+void Rasterizer::GetRowAttributes(const Primitive& primitive, int y, Row& row) {
+    f64 fx = (row.origin * 16) - primitive.origin_x;
+    f64 fy = (y * 16) - primitive.origin_y;
+    for (int i = 0; i < 4; i++) {
+        row.colour[i] = ToFixed(primitive.colour[i] + (primitive.colour_gradients[i][0] * fx) + (primitive.colour_gradients[i][1] * fy));
+    }
+
+    row.colour_dx = primitive.colour_dx;
+    row.z = ToFixed(primitive.z + (primitive.z_gradients[0] * fx) + (primitive.z_gradients[1] * fy));
+    row.z_dx = primitive.z_dx;
+    row.fog = ToFixed(primitive.fog + (primitive.fog_gradients[0] * fx) + (primitive.fog_gradients[1] * fy));
+    row.fog_dx = primitive.fog_dx;
+
+    for (int i = 0; i < 3; i++) {
+        row.texture[i] = primitive.texture[i] + (primitive.texture_gradients[i][0] * fx) + (primitive.texture_gradients[i][1] * fy);
+        row.texture_dx[i] = primitive.texture_gradients[i][0] * 16;
+    }
+}
+
+void Rasterizer::Submit(Primitive& primitive) {
+    if (primitive.state.texture_mapping) {
+        primitive.state.texture.data = GetTexture(primitive.state.texture);
+    }
+
+    // textures decoded from anywhere the primitive draws are out of date. they're only thrown away once
+    // the primitive has been drawn or binned, so that a primitive can still sample its own frame buffer
+    const DrawState& state = primitive.state;
+    TextureCache::PageMask pages = TextureCache::GetPages(state.frame_format, state.frame_base, state.frame_width, primitive.x0, primitive.y0, primitive.x1, primitive.y1);
+    if (state.z_test && !state.z_mask) {
+        pages |= TextureCache::GetPages(state.z_format, state.z_base, state.frame_width, primitive.x0, primitive.y0, primitive.x1, primitive.y1);
+    }
+
+    if (thread_count == 1) {
+        DrawPrimitive(primitive, primitive.x0, primitive.y0, primitive.x1, primitive.y1);
+        texture_cache.Invalidate(pages);
+        return;
+    }
+
+    if (!CanBin(primitive)) {
+        // draw it on its own, once everything before it has been drawn
+        Flush();
+        DrawPrimitive(primitive, primitive.x0, primitive.y0, primitive.x1, primitive.y1);
+        texture_cache.Invalidate(pages);
+        return;
+    }
+
+    if (!primitives.empty() && !SameBuffers(primitives[0].state, primitive.state)) {
+        Flush();
+    }
+
+    u32 index = primitives.size();
+    primitives.push_back(primitive);
+
+    for (int tile_y = primitive.y0 / TILE_HEIGHT; tile_y <= primitive.y1 / TILE_HEIGHT; tile_y++) {
+        for (int tile_x = primitive.x0 / TILE_WIDTH; tile_x <= primitive.x1 / TILE_WIDTH; tile_x++) {
+            if (!Overlaps(primitive, tile_x, tile_y)) {
+                continue;
+            }
+
+            int tile = (tile_y * TILES_X) + tile_x;
+            if (bins[tile].empty()) {
+                active_tiles.push_back(tile);
+            }
+
+            bins[tile].push_back(index);
+        }
+    }
+
+    texture_cache.Invalidate(pages);
+    pending_pages |= pages;
+
+    if (primitives.size() >= MAX_PRIMITIVES) {
+        Flush();
+    }
+}
+
+const u32* Rasterizer::GetTexture(const TextureState& texture) {
+    // with nothing waiting to be drawn, no primitive can still be using a texture which was thrown away
+    if (primitives.empty()) {
+        texture_cache.Release();
+    }
+
+    if (const u32* data = texture_cache.Find(texture)) {
+        return data;
+    }
+
+    // primitives which draw over the texture have to be drawn before it's decoded
+    if ((TextureCache::GetTexturePages(texture) & pending_pages).any()) {
+        Flush();
+    }
+
+    return texture_cache.Decode(texture);
+}
+
+bool Rasterizer::CanBin(const Primitive& primitive) {
+    const DrawState& state = primitive.state;
+    if (primitive.x0 < 0 || primitive.y0 < 0 || primitive.x1 >= 2048 || primitive.y1 >= 2048) {
+        return false;
+    }
+
+    // past the width of the buffer, pixels wrap around onto the next row of pages
+    if (primitive.x1 >= static_cast<int>(state.frame_width * 64)) {
+        return false;
+    }
+
+    u32 frame_start = state.frame_base * 256;
+    u32 frame_end = GetBufferEnd(state.frame_format, state.frame_base, state.frame_width, primitive.y1);
+    if (frame_end > VRAM_SIZE) {
+        return false;
+    }
+
+    u32 z_start = state.z_base * 256;
+    u32 z_end = GetBufferEnd(state.z_format, state.z_base, state.frame_width, primitive.y1);
+    if (state.z_test && (z_end > VRAM_SIZE || (frame_start < z_end && z_start < frame_end))) {
+        return false;
+    }
+
+    return true;
+}
+
+bool Rasterizer::SameBuffers(const DrawState& a, const DrawState& b) {
+    return a.frame_format == b.frame_format && a.frame_base == b.frame_base && a.frame_width == b.frame_width &&
+        a.z_test == b.z_test && a.z_format == b.z_format && a.z_base == b.z_base;
+}
+
+bool Rasterizer::Overlaps(const Primitive& primitive, int tile_x, int tile_y) {
+    if (primitive.rectangle) {
+        return true;
+    }
+
+    // the tile is outside the triangle if even its corner furthest inside an edge is outside it
+    int x0 = tile_x * TILE_WIDTH;
+    int y0 = tile_y * TILE_HEIGHT;
+    int x1 = x0 + TILE_WIDTH - 1;
+    int y1 = y0 + TILE_HEIGHT - 1;
+
+    for (int i = 0; i < 3; i++) {
+        s64 x = primitive.edge_y[i] < 0 ? x1 : x0;
+        s64 y = primitive.edge_x[i] > 0 ? y1 : y0;
+        s64 edge = (primitive.edge_x[i] * ((y * 16) - primitive.from_y[i])) - (primitive.edge_y[i] * ((x * 16) - primitive.from_x[i])) - primitive.edge_bias[i];
+        if (edge < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Rasterizer::StartWorkers(int count) {
+    for (int i = 0; i < count; i++) {
+        workers.emplace_back(&Rasterizer::RunWorker, this, generation);
+    }
+}
+
+void Rasterizer::StopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    start_condition.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+    stopping = false;
+}
+
+void Rasterizer::RunWorker(u64 seen) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+
+            seen = generation;
+        }
+
+        DrawTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending_workers == 0) {
+                done_condition.notify_one();
+            }
+        }
+    }
+}
+
+void Rasterizer::DrawTiles() {
+    int i;
+    while ((i = next_tile++) < static_cast<int>(active_tiles.size())) {
+        int tile = active_tiles[i];
+        int x0 = (tile % TILES_X) * TILE_WIDTH;
+        int y0 = (tile / TILES_X) * TILE_HEIGHT;
+
+        for (u32 index : bins[tile]) {
+            DrawPrimitive(primitives[index], x0, y0, x0 + TILE_WIDTH - 1, y0 + TILE_HEIGHT - 1);
+        }
+    }
+}
+
+} // namespace gs
\ No newline at end of file
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "common/types.h"
+#include "core/gs/page.h"
+#include "core/gs/texture_cache.h"
+
+namespace gs {
+
+enum class ZTest : int {
+    Never = 0,
+    Always = 1,
+    GreaterEqual = 2,
+    Greater = 3,
+};
+
+enum class AlphaTest : int {
+    Never = 0,
+    Always = 1,
+    Less = 2,
+    LessEqual = 3,
+    Equal = 4,
+    GreaterEqual = 5,
+    Greater = 6,
+    NotEqual = 7,
+};
+
+// what happens to pixels which fail the alpha test
+enum class AlphaFail : int {
+    Keep = 0,
+    FrameOnly = 1,
+    ZOnly = 2,
+    RGBOnly = 3,
+};
+
+enum class TextureFunction : int {
+    Modulate = 0,
+    Decal = 1,
+    Highlight = 2,
+    Highlight2 = 3,
+};
+
+enum class WrapMode : int {
+    Repeat = 0,
+    Clamp = 1,
+    RegionClamp = 2,
+    RegionRepeat = 3,
+};
+
+// the texture registers selected by the primitive
+struct TextureState {
+    // the base is in units of blocks and the width is in units of 64 texels
+    PixelFormat format;
+    u32 base;
+    u32 width;
+    int width_log2;
+    int height_log2;
+
+    // texture coordinates come from uv in texels, rather than from stq
+    bool uv;
+
+    TextureFunction function;
+
+    // use the alpha of the texture, rather than the alpha of the primitive
+    bool alpha;
+
+    // the clut is read straight from vram when the texture is decoded, rather than through a clut buffer.
+    // with csm2 the clut is a single line of a psmct16 buffer, starting at (clut_x, clut_y). with csm1,
+    // 4 bit textures start from entry clut_offset of the clut, which comes from csa
+    PixelFormat clut_format;
+    u32 clut_base;
+    bool clut_line;
+    u32 clut_width;
+    int clut_x;
+    int clut_y;
+    u32 clut_offset;
+
+    WrapMode wrap_u;
+    WrapMode wrap_v;
+    int min_u;
+    int max_u;
+    int min_v;
+    int max_v;
+
+    // the alpha given to texels in formats without a full alpha channel. with transparent_black
+    // set, texels with an rgb of 0 get an alpha of 0 instead of alpha0
+    u8 alpha0;
+    u8 alpha1;
+    bool transparent_black;
+
+    // the texture decoded by the texture cache, which is filled in by the rasterizer
+    const u32* data;
+};
+
+// the registers which affect how a primitive is drawn, decoded from the drawing environment
+// selected by the primitive
+struct DrawState {
+    // the frame and z buffers share the same width, in units of 64 pixels. bases are in units of blocks
+    PixelFormat frame_format;
+    u32 frame_base;
+    u32 frame_width;
+
+    // bits of each frame buffer pixel which are left untouched
+    u32 frame_mask;
+
+    PixelFormat z_format;
+    u32 z_base;
+    bool z_test;
+    ZTest z_method;
+
+    // don't update the z buffer
+    bool z_mask;
+
+    // the area pixels can be drawn to, inclusive
+    int scissor_x0;
+    int scissor_y0;
+    int scissor_x1;
+    int scissor_y1;
+
+    // interpolate colours across the primitive, rather than using the colour of the last vertex
+    bool gouraud;
+
+    bool texture_mapping;
+    TextureState texture;
+
+    bool fog;
+    u32 fog_colour;
+
+    bool alpha_test;
+    AlphaTest alpha_method;
+    u8 alpha_reference;
+    AlphaFail alpha_fail;
+
+    // only draw pixels where the top bit of the destination alpha matches destination_alpha_mode
+    bool destination_alpha_test;
+    bool destination_alpha_mode;
+
+    // colours are blended as ((a - b) * c >> 7) + d, where a, b and d pick the source colour, the
+    // destination colour or 0, and c picks the source alpha, the destination alpha or blend_fix
+    bool blend;
+    int blend_a;
+    int blend_b;
+    int blend_c;
+    int blend_d;
+    u8 blend_fix;
+
+    // only blend pixels with the top bit of their source alpha set
+    bool blend_alpha_only;
+
+    // set the top bit of the alpha of every pixel written to the frame buffer
+    bool frame_alpha;
+
+    // added to the colour of each pixel by its position in a 4x4 grid
+    bool dither;
+    std::array<std::array<s8, 4>, 4> dither_matrix;
+
+    // clamp colours to 0 to 255, rather than wrapping them
+    bool colour_clamp;
+};
+
+// draws primitives into vram. triangles are drawn with edge functions, where each row is walked
+// 8 pixels at a time and the coverage, colour and depth of all 8 are worked out together.
+// with more than one thread, primitives are set up straight away but only sorted into 64x32 tiles,
+// and the tiles are drawn in parallel once flushed. each tile draws its primitives in order, and
+// nothing about a pixel depends on which tile it's drawn in, so the result is the same as drawing
+// every primitive on a single thread
+class Rasterizer {
+public:
+    // x and y are 12.4 fixed point window coordinates, with xyoffset already subtracted.
+    // u and v are 10.4 fixed point texel coordinates
+    struct Vertex {
+        s32 x;
+        s32 y;
+        u32 z;
+        u8 r;
+        u8 g;
+        u8 b;
+        u8 a;
+        u8 fog;
+        u16 u;
+        u16 v;
+        f32 s;
+        f32 t;
+        f32 q;
+    };
+
+    Rasterizer(u8* vram);
+    ~Rasterizer();
+
+    // with 1 thread primitives are drawn immediately on the calling thread, otherwise the calling
+    // thread draws tiles alongside count - 1 workers
+    void SetThreadCount(int count);
+    int GetThreadCount();
+
+    // waits for every primitive so far to be drawn. this has to be done before vram is read or
+    // written by anything other than the rasterizer
+    void Flush();
+
+    // throws away textures decoded from a rectangle of a buffer, inclusive, for when vram is written
+    // by anything other than the rasterizer
+    void InvalidateTextures(PixelFormat format, u32 base, u32 width, int x0, int y0, int x1, int y1);
+    void InvalidateAllTextures();
+
+    TextureCache::Stats GetTextureCacheStats();
+
+    void DrawPoint(const DrawState& state, const Vertex& v0);
+    void DrawLine(const DrawState& state, const Vertex& v0, const Vertex& v1);
+    void DrawTriangle(const DrawState& state, const Vertex& v0, const Vertex& v1, const Vertex& v2);
+    void DrawSprite(const DrawState& state, const Vertex& v0, const Vertex& v1);
+
+    // a run of pixels on one row, along with how to work out what to draw in each of them.
+    // every value is given at origin, and changes by the matching _dx value for each pixel to the right
+    struct Row {
+        int y;
+
+        // the first and last pixel that can be drawn to, inclusive
+        int x0;
+        int x1;
+
+        // a multiple of 8 at or before x0. this only depends on the primitive, so clipping a row
+        // to a tile doesn't change the values of any pixel
+        int origin;
+
+        // a pixel is only covered if every edge function is at least 0
+        std::array<s64, 3> edges;
+        std::array<s64, 3> edges_dx;
+
+        // rgba, z and fog in 16.16 fixed point
+        std::array<s64, 4> colour;
+        std::array<s64, 4> colour_dx;
+        s64 z;
+        s64 z_dx;
+        s64 fog;
+        s64 fog_dx;
+
+        // s, t and q, or u and v in texels with q as 1
+        std::array<f64, 3> texture;
+        std::array<f64, 3> texture_dx;
+    };
+
+    using RowFunction = void (*)(u8* vram, const DrawState& state, const Row& row);
+
+private:
+    static constexpr int TILE_WIDTH = 64;
+    static constexpr int TILE_HEIGHT = 32;
+    static constexpr int TILES_X = 2048 / TILE_WIDTH;
+    static constexpr int TILES_Y = 2048 / TILE_HEIGHT;
+
+    // how many primitives are binned before they're drawn anyway
+    static constexpr int MAX_PRIMITIVES = 4096;
+
+    // a primitive after setup, which can be drawn one piece at a time
+    struct Primitive {
+        DrawState state;
+        RowFunction function;
+
+        // the pixels which can be covered, inclusive
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+
+        // sprites and single pixels cover every pixel in the rectangle, and don't use the edges
+        bool rectangle;
+
+        // edge i goes from (from_x, from_y), and the interior is where every edge function is at least 0
+        std::array<s64, 3> edge_x;
+        std::array<s64, 3> edge_y;
+        std::array<s64, 3> edge_bias;
+        std::array<s64, 3> from_x;
+        std::array<s64, 3> from_y;
+
+        // attributes at (origin_x, origin_y) and how much they change per 12.4 unit
+        f64 origin_x;
+        f64 origin_y;
+        std::array<f64, 4> colour;
+        std::array<std::array<f64, 2>, 4> colour_gradients;
+        f64 z;
+        std::array<f64, 2> z_gradients;
+        f64 fog;
+        std::array<f64, 2> fog_gradients;
+        std::array<f64, 3> texture;
+        std::array<std::array<f64, 2>, 3> texture_gradients;
+        std::array<s64, 4> colour_dx;
+        s64 z_dx;
+        s64 fog_dx;
+    };
+
+    // picks a row function which only has the stages of the pixel pipeline that the state needs.
+    // functions are cached by a key packed from the fields which decide the choice
+    RowFunction GetRowFunction(const DrawState& state);
+
+    // fills the part of a rectangle inside the scissor area with the colour and depth of v1. texture
+    // coordinates change linearly from v0 to v1
+    void DrawRectangle(const DrawState& state, RowFunction function, int x0, int y0, int x1, int y1, const Vertex& v0, const Vertex& v1);
+
+    // draws the part of a primitive inside a rectangle, inclusive
+    void DrawPrimitive(const Primitive& primitive, int x0, int y0, int x1, int y1);
+    bool GetTriangleRow(const Primitive& primitive, int y, Row& row);
+
+    // fills in the attributes of a row at its origin
+    static void GetRowAttributes(const Primitive& primitive, int y, Row& row);
+
+    void Submit(Primitive& primitive);
+
+    // finds the decoded texture for a primitive, decoding it if it isn't cached
+    const u32* GetTexture(const TextureState& texture);
+
+    // whether a primitive can be drawn a tile at a time, which needs every pixel it can touch in the
+    // frame and z buffers to be somewhere different in vram. textures are sampled from a decoded copy,
+    // so they can overlap either buffer
+    static bool CanBin(const Primitive& primitive);
+
+    // primitives are only binned together when they draw to the same buffers
+    static bool SameBuffers(const DrawState& a, const DrawState& b);
+
+    static bool Overlaps(const Primitive& primitive, int tile_x, int tile_y);
+
+    void StartWorkers(int count);
+    void StopWorkers();
+    void RunWorker(u64 seen);
+    void DrawTiles();
+
+    u8* vram;
+    int thread_count = 1;
+
+    std::unordered_map<u64, RowFunction> row_functions;
+
+    TextureCache texture_cache;
+
+    // pages written by primitives which are binned but not yet drawn
+    TextureCache::PageMask pending_pages;
+
+    std::vector<Primitive> primitives;
+    std::array<std::vector<u32>, TILES_X * TILES_Y> bins;
+
+    // the tiles with anything binned in them, which are handed out to threads in order
+    std::vector<int> active_tiles;
+    std::atomic<int> next_tile;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+    u64 generation = 0;
+    int pending_workers = 0;
+    bool stopping = false;
+};
+
+} // namespace gs
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <array>
+#include "common/log.h"
+#include "core/gs/rasterizer.h"
+#include "core/gs/texture_cache.h"
+
+namespace gs {
+
+static constexpr bool IsPaletted(PixelFormat format) {
+    return format == PixelFormat::PSMT8 || format == PixelFormat::PSMT4 || format == PixelFormat::PSMT8H ||
+        format == PixelFormat::PSMT4HL || format == PixelFormat::PSMT4HH;
+}
+
+static void GetPageSize(PixelFormat format, int& width, int& height) {
+    switch (format) {
+    case PixelFormat::PSMCT16:
+    case PixelFormat::PSMCT16S:
+    case PixelFormat::PSMZ16:
+    case PixelFormat::PSMZ16S:
+        width = Page<PixelFormat::PSMCT16>::WIDTH;
+        height = Page<PixelFormat::PSMCT16>::HEIGHT;
+        break;
+    case PixelFormat::PSMT8:
+        width = Page<PixelFormat::PSMT8>::WIDTH;
+        height = Page<PixelFormat::PSMT8>::HEIGHT;
+        break;
+    case PixelFormat::PSMT4:
+        width = Page<PixelFormat::PSMT4>::WIDTH;
+        height = Page<PixelFormat::PSMT4>::HEIGHT;
+        break;
+    default:
+        width = Page<PixelFormat::PSMCT32>::WIDTH;
+        height = Page<PixelFormat::PSMCT32>::HEIGHT;
+        break;
+    }
+}
+
+// the alpha of a texel in a format without a full alpha channel
+static u32 GetTexelAlpha(u32 rgb, u8 alpha, const TextureState& texture) {
+    return (texture.transparent_black && rgb == 0) ? 0 : alpha;
+}
+
+static u32 ExpandTexel16(u32 value, const TextureState& texture) {
+    u32 rgb = ((value & 0x1f) << 3) | ((value & 0x3e0) << 6) | ((value & 0x7c00) << 9);
+    u32 alpha = (value & 0x8000) ? texture.alpha1 : GetTexelAlpha(rgb, texture.alpha0, texture);
+    return rgb | (alpha << 24);
+}
+
+// with csm1 the clut is a 16x16 image, where bits 3 and 4 of the index are swapped. 4 bit textures
+// use the 8x2 block of it which csa selects, and 16 bit cluts have room for a second 16x16 image below
+template <int bits>
+static u32 ReadClut(const u8* vram, const TextureState& texture, u32 index) {
+    if (texture.clut_line) {
+        u32 value = Page<PixelFormat::PSMCT16>::Read(vram, texture.clut_x + index, texture.clut_y, texture.clut_base, texture.clut_width);
+        return ExpandTexel16(value, texture);
+    }
+
+    if constexpr (bits == 4) {
+        index = (index + texture.clut_offset) & (texture.clut_format == PixelFormat::PSMCT32 ? 0xff : 0x1ff);
+    }
+
+    index = (index & 0x1e7) | ((index & 0x8) << 1) | ((index & 0x10) >> 1);
+    int x = index & 0xf;
+    int y = index >> 4;
+
+    switch (texture.clut_format) {
+    case PixelFormat::PSMCT32:
+        return Page<PixelFormat::PSMCT32>::Read(vram, x, y, texture.clut_base, 1);
+    case PixelFormat::PSMCT16:
+        return ExpandTexel16(Page<PixelFormat::PSMCT16>::Read(vram, x, y, texture.clut_base, 1), texture);
+    case PixelFormat::PSMCT16S:
+        return ExpandTexel16(Page<PixelFormat::PSMCT16S>::Read(vram, x, y, texture.clut_base, 1), texture);
+    default:
+        common::Error("[gs::TextureCache] handle clut format %02x", static_cast<int>(texture.clut_format));
+    }
+
+    return 0;
+}
+
+// the clut is decoded once up front, so each texel only needs an index into it
+template <PixelFormat format>
+static void DecodeTexture(const u8* vram, const TextureState& texture, u32* texels, const TextureCache::Area& area) {
+    std::array<u32, 256> clut;
+    if constexpr (format == PixelFormat::PSMT8 || format == PixelFormat::PSMT8H) {
+        for (u32 i = 0; i < 256; i++) {
+            clut[i] = ReadClut<8>(vram, texture, i);
+        }
+    } else if constexpr (IsPaletted(format)) {
+        for (u32 i = 0; i < 16; i++) {
+            clut[i] = ReadClut<4>(vram, texture, i);
+        }
+    }
+
+    for (int y = 0; y < area.height; y++) {
+        u32* row = texels + (y * area.width);
+        for (int x = 0; x < area.width; x++) {
+            u32 value = Page<format>::Read(vram, area.x + x, area.y + y, texture.base, texture.width);
+
+            if constexpr (format == PixelFormat::PSMCT32) {
+                row[x] = value;
+            } else if constexpr (format == PixelFormat::PSMCT24) {
+                row[x] = value | (GetTexelAlpha(value, texture.alpha0, texture) << 24);
+            } else if constexpr (Page<format>::BITS == 16) {
+                row[x] = ExpandTexel16(value, texture);
+            } else {
+                row[x] = clut[value];
+            }
+        }
+    }
+}
+
+TextureCache::TextureCache(const u8* vram) : vram(vram) {}
+
+const u32* TextureCache::Find(const TextureState& texture) {
+    auto it = entries.find(GetKey(texture));
+    if (it == entries.end()) {
+        return nullptr;
+    }
+
+    hits.fetch_add(1, std::memory_order_relaxed);
+    lru.splice(lru.begin(), lru, it->second->lru_position);
+    return it->second->texels.data();
+}
+
+const u32* TextureCache::Decode(const TextureState& texture) {
+    misses.fetch_add(1, std::memory_order_relaxed);
+
+    Area area = GetArea(texture);
+    auto entry = std::make_unique<Entry>();
+    entry->texels.resize(area.width * area.height);
+    entry->pages = GetTexturePages(texture);
+
+    u32* texels = entry->texels.data();
+    switch (texture.format) {
+    case PixelFormat::PSMCT32:
+        DecodeTexture<PixelFormat::PSMCT32>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMCT24:
+        DecodeTexture<PixelFormat::PSMCT24>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMCT16:
+        DecodeTexture<PixelFormat::PSMCT16>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMCT16S:
+        DecodeTexture<PixelFormat::PSMCT16S>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMT8:
+        DecodeTexture<PixelFormat::PSMT8>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMT4:
+        DecodeTexture<PixelFormat::PSMT4>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMT8H:
+        DecodeTexture<PixelFormat::PSMT8H>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMT4HL:
+        DecodeTexture<PixelFormat::PSMT4HL>(vram, texture, texels, area);
+        break;
+    case PixelFormat::PSMT4HH:
+        DecodeTexture<PixelFormat::PSMT4HH>(vram, texture, texels, area);
+        break;
+    default:
+        common::Error("[gs::TextureCache] handle texture format %02x", static_cast<int>(texture.format));
+    }
+
+    Key key = GetKey(texture);
+    cached_texels += entry->texels.size();
+    cached_pages |= entry->pages;
+    lru.push_front(key);
+    entry->lru_position = lru.begin();
+    entries[key] = std::move(entry);
+
+    // make room by evicting the textures which haven't been used for longest, other than this one
+    while (cached_texels > MAX_TEXELS && entries.size() > 1) {
+        Retire(entries.find(lru.back()));
+    }
+
+    return texels;
+}
+
+void TextureCache::Invalidate(const PageMask& pages) {
+    if ((pages & cached_pages).none()) {
+        return;
+    }
+
+    cached_pages.reset();
+    for (auto it = entries.begin(); it != entries.end();) {
+        if ((it->second->pages & pages).any()) {
+            invalidations.fetch_add(1, std::memory_order_relaxed);
+            it = Retire(it);
+        } else {
+            cached_pages |= it->second->pages;
+            it++;
+        }
+    }
+}
+
+void TextureCache::InvalidateAll() {
+    invalidations.fetch_add(entries.size(), std::memory_order_relaxed);
+    for (auto it = entries.begin(); it != entries.end();) {
+        it = Retire(it);
+    }
+
+    cached_pages.reset();
+}
+
+void TextureCache::Release() {
+    retired.clear();
+}
+
+TextureCache::Stats TextureCache::GetStats() {
+    return {hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed), invalidations.load(std::memory_order_relaxed)};
+}
+
+// the first texel the wrap mode can reach, and how many follow it
+static void GetTextureRange(WrapMode mode, int size_log2, int min, int max, int& start, int& size) {
+    switch (mode) {
+    case WrapMode::RegionClamp:
+        start = std::min(min, max);
+        size = max - start + 1;
+        break;
+    case WrapMode::RegionRepeat:
+        start = max;
+        size = (min | max) - max + 1;
+        break;
+    default:
+        start = 0;
+        size = 1 << size_log2;
+        break;
+    }
+}
+
+TextureCache::Area TextureCache::GetArea(const TextureState& texture) {
+    Area area;
+    GetTextureRange(texture.wrap_u, texture.width_log2, texture.min_u, texture.max_u, area.x, area.width);
+    GetTextureRange(texture.wrap_v, texture.height_log2, texture.min_v, texture.max_v, area.y, area.height);
+    return area;
+}
+
+TextureCache::PageMask TextureCache::GetTexturePages(const TextureState& texture) {
+    Area area = GetArea(texture);
+    PageMask pages = GetPages(texture.format, texture.base, texture.width, area.x, area.y, area.x + area.width - 1, area.y + area.height - 1);
+    if (!IsPaletted(texture.format)) {
+        return pages;
+    }
+
+    bool is_8bit = texture.format == PixelFormat::PSMT8 || texture.format == PixelFormat::PSMT8H;
+    if (texture.clut_line) {
+        int entries = is_8bit ? 256 : 16;
+        pages |= GetPages(PixelFormat::PSMCT16, texture.clut_base, texture.clut_width, texture.clut_x, texture.clut_y, texture.clut_x + entries - 1, texture.clut_y);
+    } else if (is_8bit) {
+        pages |= GetPages(texture.clut_format, texture.clut_base, 1, 0, 0, 15, 15);
+    } else {
+        // the 8x2 block selected by csa
+        u32 block = (texture.clut_offset / 16) & (texture.clut_format == PixelFormat::PSMCT32 ? 0xf : 0x1f);
+        int x = (block & 0x1) * 8;
+        int y = (block & ~0x1);
+        pages |= GetPages(texture.clut_format, texture.clut_base, 1, x, y, x + 7, y + 1);
+    }
+
+    return pages;
+}
+
+TextureCache::PageMask TextureCache::GetPages(PixelFormat format, u32 base, u32 width, int x0, int y0, int x1, int y1) {
+    int page_width;
+    int page_height;
+    GetPageSize(format, page_width, page_height);
+
+    PageMask pages;
+    u32 row_pages = (width * 64) / page_width;
+    for (int y = y0 / page_height; y <= y1 / page_height; y++) {
+        for (int x = x0 / page_width; x <= x1 / page_width; x++) {
+            // base doesn't have to be aligned to a page, in which case each page of the buffer is split across 2 pages of vram
+            u32 start = (base * 256) + (((y * row_pages) + x) * PAGE_SIZE);
+            pages.set((start / PAGE_SIZE) % pages.size());
+            pages.set(((start + PAGE_SIZE - 1) / PAGE_SIZE) % pages.size());
+        }
+    }
+
+    return pages;
+}
+
+TextureCache::Key TextureCache::GetKey(const TextureState& texture) {
+    Area area = GetArea(texture);
+    Key key;
+    key.texture = texture.base | (static_cast<u64>(texture.width) << 14) | (static_cast<u64>(texture.format) << 20);
+    key.clut = 0;
+    key.area = static_cast<u64>(area.x) | (static_cast<u64>(area.y) << 16) | (static_cast<u64>(area.width) << 32) | (static_cast<u64>(area.height) << 48);
+
+    // texa only changes formats without a full alpha channel
+    if (texture.format != PixelFormat::PSMCT32) {
+        key.texture |= (static_cast<u64>(texture.alpha0) << 48) | (static_cast<u64>(texture.alpha1) << 56);
+        key.clut = texture.transparent_black;
+    }
+
+    if (IsPaletted(texture.format)) {
+        key.clut |= (static_cast<u64>(texture.clut_base) << 1) | (static_cast<u64>(texture.clut_format) << 15) | (static_cast<u64>(texture.clut_line) << 21);
+        if (texture.clut_line) {
+            key.clut |= (static_cast<u64>(texture.clut_width) << 22) | (static_cast<u64>(texture.clut_x) << 28) | (static_cast<u64>(texture.clut_y) << 38);
+        } else {
+            key.clut |= static_cast<u64>(texture.clut_offset) << 22;
+        }
+    }
+
+    return key;
+}
+
+TextureCache::EntryMap::iterator TextureCache::Retire(EntryMap::iterator it) {
+    cached_texels -= it->second->texels.size();
+    lru.erase(it->second->lru_position);
+    retired.push_back(std::move(it->second));
+    return entries.erase(it);
+}
+
+} // namespace gs
\ No newline at end of file
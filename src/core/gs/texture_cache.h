@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "common/types.h"
+#include "core/gs/page.h"
+
+namespace gs {
+
+struct TextureState;
+
+// keeps textures decoded from vram into linear rgba8888, so that drawing doesn't have to find each
+// texel in its page and look it up in the clut. textures are keyed by the registers which change
+// their decoded texels, and are thrown away as soon as any page of vram they were decoded from is written
+class TextureCache {
+public:
+    static constexpr int PAGE_SIZE = 8192;
+    using PageMask = std::bitset<VRAM_SIZE / PAGE_SIZE>;
+
+    struct Stats {
+        u64 hits;
+        u64 misses;
+        u64 invalidations;
+    };
+
+    TextureCache(const u8* vram);
+
+    // the rectangle of texels which a texture is decoded for
+    struct Area {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    // returns the decoded texture, or nullptr if it has to be decoded. decoded textures start at
+    // the corner of their area, and have rows of its width
+    const u32* Find(const TextureState& texture);
+    const u32* Decode(const TextureState& texture);
+
+    // throws away every texture decoded from any of these pages
+    void Invalidate(const PageMask& pages);
+    void InvalidateAll();
+
+    // frees textures which have been thrown away. this can only be done once nothing is being drawn with them
+    void Release();
+
+    Stats GetStats();
+
+    // decoded textures only cover the texels the wrap modes can reach. with the region modes this
+    // is the region, which can be past the size in tex0
+    static Area GetArea(const TextureState& texture);
+
+    // the pages which a texture and its clut are read from
+    static PageMask GetTexturePages(const TextureState& texture);
+
+    // the pages covered by a rectangle of a buffer, inclusive
+    static PageMask GetPages(PixelFormat format, u32 base, u32 width, int x0, int y0, int x1, int y1);
+
+private:
+    // the texture registers, the clut and texa registers for formats which use them, and the area
+    struct Key {
+        u64 texture;
+        u64 clut;
+        u64 area;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return key.texture ^ (key.clut * 0x9e3779b97f4a7c15) ^ (key.area * 0xc2b2ae3d27d4eb4f);
+        }
+    };
+
+    struct Entry {
+        std::vector<u32> texels;
+        PageMask pages;
+        std::list<Key>::iterator lru_position;
+    };
+
+    // textures are evicted, least recently used first, once this many texels are cached
+    static constexpr size_t MAX_TEXELS = 16 * 1024 * 1024;
+
+    using EntryMap = std::unordered_map<Key, std::unique_ptr<Entry>, KeyHash>;
+
+    static Key GetKey(const TextureState& texture);
+
+    // moves an entry out of the cache until Release, returning the entry after it
+    EntryMap::iterator Retire(EntryMap::iterator it);
+
+    const u8* vram;
+    EntryMap entries;
+    std::vector<std::unique_ptr<Entry>> retired;
+
+    // keys of the cached textures, most recently used first
+    std::list<Key> lru;
+
+    // every page that some cached texture was decoded from
+    PageMask cached_pages;
+
+    size_t cached_texels = 0;
+
+    // these are read from other threads
+    std::atomic<u64> hits = 0;
+    std::atomic<u64> misses = 0;
+    std::atomic<u64> invalidations = 0;
+};
+
+} // namespace gs
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cstring>
+#include "core/gs/thread.h"
+
+namespace gs {
+
+Thread::Thread(Context& gs) : gs(gs) {
+    SetEnabled(true);
+}
+
+Thread::~Thread() {
+    Stop();
+}
+
+void Thread::SetEnabled(bool enabled) {
+    if (this->enabled == enabled) {
+        return;
+    }
+
+    if (enabled) {
+        Start();
+    } else {
+        Stop();
+    }
+
+    this->enabled = enabled;
+}
+
+bool Thread::IsEnabled() {
+    return enabled;
+}
+
+void Thread::Sync() {
+    if (!enabled) {
+        return;
+    }
+
+    while (completed.load(std::memory_order_acquire) != submitted) {
+        std::this_thread::yield();
+    }
+}
+
+void Thread::Reset() {
+    Sync();
+    gs.Reset();
+}
+
+void Thread::RegisterIO(common::IOMap& io) {
+    io.Map(0x12000000, 0x12001084, this, [](Thread* thread, u32 paddr) {
+        return thread->ReadRegisterPrivileged(paddr);
+    }, [](Thread* thread, u32 paddr, u32 value) {
+        thread->WriteRegisterPrivileged(paddr, value);
+    });
+}
+
+u32 Thread::ReadRegisterPrivileged(u32 addr) {
+    // finish and signal in csr are set by earlier gs commands, so everything before the read has to run first
+    Sync();
+    return gs.ReadRegisterPrivileged(addr);
+}
+
+void Thread::WriteRegisterPrivileged(u32 addr, u32 value) {
+    if (!enabled) {
+        gs.WriteRegisterPrivileged(addr, value);
+        return;
+    }
+
+    u64 data = (static_cast<u64>(addr) << 32) | value;
+    PushCommand(CommandType::WriteRegisterPrivileged, &data, 1);
+}
+
+void Thread::WriteRegisters(std::span<const RegisterWrite> writes) {
+    if (!enabled) {
+        gs.WriteRegisters(writes);
+        return;
+    }
+
+    static_assert(sizeof(RegisterWrite) == 16);
+    while (!writes.empty()) {
+        std::span<const RegisterWrite> part = writes.first(std::min<size_t>(writes.size(), MAX_COMMAND_SIZE / 2));
+        PushCommand(CommandType::WriteRegisters, part.data(), part.size() * 2);
+        writes = writes.subspan(part.size());
+    }
+}
+
+void Thread::WriteVertices(const VertexBatch& batch) {
+    if (!enabled) {
+        gs.WriteVertices(batch);
+        return;
+    }
+
+    PushCommand(CommandType::WriteVertices, &batch, VERTEX_BATCH_SIZE);
+}
+
+void Thread::WriteHWReg(std::span<const u64> data) {
+    if (!enabled) {
+        gs.WriteHWReg(data);
+        return;
+    }
+
+    // the gs carries on from where the last part of a transfer left off, so large transfers can be split up
+    while (!data.empty()) {
+        std::span<const u64> part = data.first(std::min<size_t>(data.size(), MAX_COMMAND_SIZE));
+        PushCommand(CommandType::WriteHWReg, part.data(), part.size());
+        data = data.subspan(part.size());
+    }
+}
+
+void Thread::WriteTagAttributes(bool write_prim, u32 prim_data) {
+    if (!enabled) {
+        gs.WriteTagAttributes(write_prim, prim_data);
+        return;
+    }
+
+    u64 data = (static_cast<u64>(write_prim) << 32) | prim_data;
+    PushCommand(CommandType::WriteTagAttributes, &data, 1);
+}
+
+void Thread::RenderCRTC() {
+    if (!enabled) {
+        gs.RenderCRTC();
+        return;
+    }
+
+    PushCommand(CommandType::RenderCRTC, nullptr, 0);
+}
+
+void Thread::Start() {
+    commands.Reset();
+    submitted = 0;
+    completed = 0;
+    stopping = false;
+    thread = std::thread(&Thread::Run, this);
+}
+
+void Thread::Stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+
+    // the gs thread finishes any commands left in the ring before it exits
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    condition.notify_one();
+    thread.join();
+}
+
+void Thread::Run() {
+    while (true) {
+        if (commands.Empty()) {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            // the ee checks sleeping after it pushes a command, so either it sees that the gs thread
+            // is about to sleep, or the gs thread sees the command
+            sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            condition.wait(lock, [this] { return stopping || !commands.Empty(); });
+            sleeping = false;
+
+            if (commands.Empty()) {
+                return;
+            }
+        }
+
+        ExecuteCommand();
+        completed.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void Thread::PushCommand(CommandType type, const void* data, u32 size) {
+    // when the ring is full the ee has to wait for the gs to catch up
+    while (commands.GetFree() < size + 1) {
+        std::this_thread::yield();
+    }
+
+    commands.Push(static_cast<u64>(type) | (static_cast<u64>(size) << 8));
+    commands.PushSpan(std::span<const u64>(reinterpret_cast<const u64*>(data), size));
+    submitted++;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping) {
+        std::lock_guard<std::mutex> lock(mutex);
+        condition.notify_one();
+    }
+}
+
+void Thread::ExecuteCommand() {
+    u64 header = commands.Peek();
+    CommandType type = static_cast<CommandType>(header & 0xff);
+    u32 size = header >> 8;
+
+    // the header is published before its data, so wait for the rest of the command
+    while (commands.GetLength() < size + 1) {
+        std::this_thread::yield();
+    }
+
+    commands.Pop();
+    commands.PopSpan(std::span<u64>(command_data.data(), size));
+
+    switch (type) {
+    case CommandType::WriteRegisterPrivileged:
+        gs.WriteRegisterPrivileged(command_data[0] >> 32, command_data[0]);
+        break;
+    case CommandType::WriteRegisters:
+        gs.WriteRegisters(std::span<const RegisterWrite>(reinterpret_cast<const RegisterWrite*>(command_data.data()), size / 2));
+        break;
+    case CommandType::WriteVertices: {
+        VertexBatch batch;
+        std::memcpy(&batch, command_data.data(), sizeof(VertexBatch));
+        gs.WriteVertices(batch);
+        break;
+    }
+    case CommandType::WriteHWReg:
+        gs.WriteHWReg(std::span<const u64>(command_data.data(), size));
+        break;
+    case CommandType::WriteTagAttributes:
+        gs.WriteTagAttributes(command_data[0] >> 32, command_data[0]);
+        break;
+    case CommandType::RenderCRTC:
+        gs.RenderCRTC();
+        break;
+    }
+}
+
+} // namespace gs
\ No newline at end of file
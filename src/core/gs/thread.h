@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
+#include "common/queue.h"
+#include "common/types.h"
+#include "common/io_map.h"
+#include "core/gs/context.h"
+
+namespace gs {
+
+// runs the gs on its own thread. everything sent to the gs is encoded into a single producer,
+// single consumer ring of commands, which the gs thread works through in order while the ee carries on.
+// the ee only waits for the gs to catch up when it needs a result from it, which is a csr read.
+// when disabled, every command goes straight to the gs on the calling thread
+class Thread {
+public:
+    Thread(Context& gs);
+    ~Thread();
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled();
+
+    // waits until the gs has finished every command sent so far
+    void Sync();
+
+    void Reset();
+    void RegisterIO(common::IOMap& io);
+
+    u32 ReadRegisterPrivileged(u32 addr);
+    void WriteRegisterPrivileged(u32 addr, u32 value);
+    void WriteRegisters(std::span<const RegisterWrite> writes);
+    void WriteVertices(const VertexBatch& batch);
+    void WriteHWReg(std::span<const u64> data);
+    void WriteTagAttributes(bool write_prim, u32 prim_data);
+    void RenderCRTC();
+
+private:
+    enum class CommandType : u8 {
+        WriteRegisterPrivileged,
+        WriteRegisters,
+        WriteVertices,
+        WriteHWReg,
+        WriteTagAttributes,
+        RenderCRTC,
+    };
+
+    // every command is a header holding its type and size, followed by size entries of data
+    static constexpr u32 MAX_COMMAND_SIZE = 4096;
+    static constexpr u32 VERTEX_BATCH_SIZE = sizeof(VertexBatch) / 8;
+    static_assert(sizeof(VertexBatch) % 8 == 0 && VERTEX_BATCH_SIZE <= MAX_COMMAND_SIZE);
+
+    void Start();
+    void Stop();
+    void Run();
+
+    void PushCommand(CommandType type, const void* data, u32 size);
+    void ExecuteCommand();
+
+    Context& gs;
+    bool enabled = false;
+
+    common::Queue<u64, 1 << 18, true> commands;
+
+    // how many commands have been pushed by the ee, and how many of those the gs has finished
+    u64 submitted = 0;
+    std::atomic<u64> completed = 0;
+
+    std::array<u64, MAX_COMMAND_SIZE> command_data;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<bool> sleeping = false;
+    bool stopping = false;
+};
+
+} // namespace gs
\ No newline at end of file
@@ -13,6 +13,14 @@ void CDVD::Reset() {
     s_command = 0;
 }
 
+void CDVD::RegisterIO(common::IOMap& io) {
+    io.Map(0x1f402004, 0x1f402019, this, [](CDVD* cdvd, u32 paddr) {
+        return cdvd->ReadRegister(paddr);
+    }, [](CDVD* cdvd, u32 paddr, u32 value) {
+        cdvd->WriteRegister(paddr, value);
+    });
+}
+
 u32 CDVD::ReadRegister(u32 addr) {
     switch (addr) {
     case 0x1f402005:
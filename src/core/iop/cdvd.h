@@ -1,11 +1,13 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 
 namespace iop {
 
 struct CDVD {
     void Reset();
+    void RegisterIO(common::IOMap& io);
 
     u32 ReadRegister(u32 addr);
     void WriteRegister(u32 addr, u32 value);
@@ -5,7 +5,9 @@
 
 namespace iop {
 
-Context::Context(System& system) : dmac(system, sio2), intc(*this), timers(intc), sio2(intc), system(system), interpreter(*this) {}
+Context::Context(System& system) : dmac(system, sio2), intc(*this), timers(intc, system.scheduler), sio2(intc), system(system), interpreter(*this), io("iop::Context") {
+    MapIO();
+}
 
 void Context::Reset() {
     gpr.fill(0);
@@ -34,7 +36,6 @@ void Context::Reset() {
 void Context::Run(int cycles) {
     interpreter.Run(cycles);
     dmac.Run(cycles);
-    timers.run(cycles);
 }
 
 template u8 Context::Read(VirtualAddress vaddr);
@@ -46,7 +47,7 @@ T Context::Read(VirtualAddress vaddr) {
     if (pointer) {
         return common::Read<T>(pointer);
     } else {
-        return ReadIO(vaddr & 0x1fffffff);
+        return io.Read(vaddr & 0x1fffffff);
     }
 }
 
@@ -59,7 +60,7 @@ void Context::Write(VirtualAddress vaddr, T value) {
     if (pointer) {
         return common::Write<T>(pointer, value);
     } else {
-        WriteIO(vaddr & 0x1fffffff, value);
+        io.Write(vaddr & 0x1fffffff, value);
     }
 }
 
@@ -70,148 +71,47 @@ void Context::RaiseInterrupt(bool value) {
     } else {
         cop0.cause.data &= ~(1 << 10);
     }
+
+    cop0.UpdateInterrupts();
 }
 
-u32 Context::ReadIO(u32 paddr) {
-    if (paddr >= 0x1f402004 && paddr < 0x1f402019) {
-        return cdvd.ReadRegister(paddr);
-    } else if (paddr >= 0x1f801070 && paddr < 0x1f801079) {
-        return intc.ReadRegister(paddr);
-    } else if (paddr >= 0x1f801080 && paddr < 0x1f801100) {
-        return dmac.ReadRegister(paddr);
-    } else if (paddr >= 0x1f801100 && paddr < 0x1f801130) {
-        return timers.read(paddr);
-    } else if (paddr >= 0x1f801480 && paddr < 0x1f8014b0) {
-        return timers.read(paddr);
-    } else if (paddr >= 0x1f801500 && paddr < 0x1f80155f) {
-        return dmac.ReadRegister(paddr);
-    } else if (paddr >= 0x1f801570 && paddr < 0x1f80157f) {
-        return dmac.ReadRegister(paddr);
-    } else if ((paddr >> 24) == 0x1e) {
-        // not sure what this is
-        return 0;
-    } else if (paddr >= 0x1f900000 && paddr < 0x1f900400) {
-        return 0;
-    } else if (paddr >= 0x1f900760 && paddr < 0x1f900770) {
+void Context::MapIO() {
+    cdvd.RegisterIO(io);
+    intc.RegisterIO(io);
+    dmac.RegisterIO(io);
+    timers.RegisterIO(io);
+
+    // not sure what this is
+    io.MapRead(0x1e000000, 0x1f000000, this, [](Context*, u32) -> u32 {
         return 0;
-    } else if (paddr >= 0x1f900400 && paddr < 0x1f900800) {
-        return system.spu2.ReadRegister(paddr);
-    } else if (paddr >= 0x1f808200 && paddr < 0x1f808284) {
-        return sio2.ReadRegister(paddr);
-    }
+    });
+
+    // the second spu core is registered first, so that the first core's ranges take priority
+    system.spu2.RegisterIO(io, 1);
+    system.spu.RegisterIO(io, 0);
+    sio2.RegisterIO(io);
+    system.sif.RegisterIOPIO(io);
 
-    switch (paddr) {
-    case 0x1f80100c:
-    case 0x1f801400:
-    case 0x1f801010:
-    case 0x1f801450:
-    case 0x1ffe0130:
-    case 0x1f801414:
+    // undocumented registers which read back as zero and ignore writes
+    auto read_zero = [](Context*, u32) -> u32 {
         return 0;
-    case 0x1d000010:
-        return system.sif.ReadSMCOM();
-    case 0x1d000020:
-        return system.sif.ReadMSFLAG();
-    case 0x1d000030:
-        return system.sif.ReadSMFLAG();
-    case 0x1d000040:
-        return system.sif.ReadControl();
-    case 0x1d000060:
-        return system.sif.bd6;
-    default:
-        common::Log("[iop::Context] handle io read %08x", paddr);
-    }
+    };
 
-    return 0;
-}
+    auto ignore_write = [](Context*, u32, u32) {};
 
-void Context::WriteIO(u32 paddr, u32 value) {
-    if (paddr >= 0x1f801080 && paddr < 0x1f801100) {
-        dmac.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f801100 && paddr < 0x1f801130) {
-        timers.write(paddr, value);
-        return;
-    } else if (paddr >= 0x1f801480 && paddr < 0x1f8014b0) {
-        timers.write(paddr, value);
-        return;
-    } else if (paddr >= 0x1f801500 && paddr < 0x1f80155f) {
-        dmac.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f801570 && paddr < 0x1f80157f) {
-        dmac.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f402004 && paddr < 0x1f402019) {
-        cdvd.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f801070 && paddr < 0x1f801079) {
-        intc.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f900000 && paddr < 0x1f900400) {
-        system.spu.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f900760 && paddr < 0x1f900770) {
-        system.spu.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f900400 && paddr < 0x1f900800) {
-        system.spu2.WriteRegister(paddr, value);
-        return;
-    } else if (paddr >= 0x1f808200 && paddr < 0x1f808284) {
-        sio2.WriteRegister(paddr, value);
-        return;
+    for (u32 paddr : {0x1f80100c, 0x1f801400, 0x1f801010, 0x1f801450, 0x1ffe0130, 0x1f801414}) {
+        io.MapRead(paddr, this, read_zero);
     }
 
-    switch (paddr) {
-    case 0x1f801010:
-        // sif2/gpu ssbus
-        break;
-    case 0x1f801450:
-        // random config register
-        break;
-    case 0x1f801004:
-    case 0x1f80100c:
-    case 0x1f801014:
-    case 0x1f801018:
-    case 0x1f80101c:
-    case 0x1f801020:
-    case 0x1f801400:
-    case 0x1f801404:
-    case 0x1f801408:
-    case 0x1f80140c:
-    case 0x1f801410:
-    case 0x1f801414:
-    case 0x1f801418:
-    case 0x1f80141c:
-    case 0x1f801420:
-    case 0x1f802070:
-    case 0x1f801060:
-    case 0x1f801560:
-    case 0x1f801564:
-    case 0x1f801568:
-    case 0x1ffe0130:
-    case 0x1ffe0140:
-    case 0x1ffe0144:
-    case 0x1f8015f0:
-        // undocumented
-        break;
-    case 0x1d000010:
-        system.sif.WriteSMCOM(value);
-        break;
-    case 0x1d000020:
-        system.sif.ResetMSFLAG(value);
-        break;
-    case 0x1d000030:
-        system.sif.SetSMFLAG(value);
-        break;
-    case 0x1d000040:
-        system.sif.WriteIOPControl(value);
-        break;
-    case 0x1f900b60:
-    case 0x1f900b62:
-        // are these spu related?
-        break;
-    default:
-        common::Log("[iop::Context] handle io write %08x = %08x", paddr, value);
+    // 0x1f801010 is sif2/gpu ssbus, 0x1f801450 is a config register and 0x1f900b60/0x1f900b62 might be spu related
+    for (u32 paddr : {
+        0x1f801010, 0x1f801450, 0x1f801004, 0x1f80100c, 0x1f801014, 0x1f801018,
+        0x1f80101c, 0x1f801020, 0x1f801400, 0x1f801404, 0x1f801408, 0x1f80140c,
+        0x1f801410, 0x1f801414, 0x1f801418, 0x1f80141c, 0x1f801420, 0x1f802070,
+        0x1f801060, 0x1f801560, 0x1f801564, 0x1f801568, 0x1ffe0130, 0x1ffe0140,
+        0x1ffe0144, 0x1f8015f0, 0x1f900b60, 0x1f900b62,
+    }) {
+        io.MapWrite(paddr, this, ignore_write);
     }
 }
 
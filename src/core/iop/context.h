@@ -3,6 +3,7 @@
 #include <array>
 #include "common/types.h"
 #include "common/virtual_page_table.h"
+#include "common/io_map.h"
 #include "core/iop/cop0.h"
 #include "core/iop/cdvd.h"
 #include "core/iop/sio2.h"
@@ -20,6 +21,8 @@ struct Context {
     
     void Reset();
     void Run(int cycles);
+    bool IsIdle() { return interpreter.IsIdle(); }
+    u64 GetIdleCycles() { return interpreter.GetIdleCycles(); }
 
     u32 GetReg(int reg) {
         return gpr[reg];
@@ -39,6 +42,9 @@ struct Context {
 
     void RaiseInterrupt(bool value);
 
+    // whether an address is backed by memory rather than io
+    bool IsMemory(VirtualAddress vaddr) { return vtlb.Lookup<u8>(vaddr); }
+
     std::array<u32, 32> gpr;
     u32 pc;
     u32 npc;
@@ -54,11 +60,11 @@ struct Context {
     System& system;
     
 private:
-    u32 ReadIO(u32 paddr);
-    void WriteIO(u32 paddr, u32 value);
+    void MapIO();
 
     common::VirtualPageTable vtlb;
     Interpreter interpreter;
+    common::IOMap io;
 };
 
 } // namespace iop
\ No newline at end of file
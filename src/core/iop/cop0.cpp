@@ -8,6 +8,7 @@ void COP0::Reset() {
     cause.data = 0;
     epc = 0;
     prid = 0x1f;
+    interrupt_pending = false;
 }
 
 u32 COP0::GetReg(int reg) {
@@ -38,6 +39,7 @@ void COP0::SetReg(int reg, u32 value) {
         break;
     case 12:
         status.data = value;
+        UpdateInterrupts();
         break;
     case 13:
         common::Log("[iop::COP0] cause write %08x", value);
@@ -50,4 +52,8 @@ void COP0::SetReg(int reg, u32 value) {
     }
 }
 
+void COP0::UpdateInterrupts() {
+    interrupt_pending = status.iec && (status.im & cause.ip);
+}
+
 } // namespace iop
\ No newline at end of file
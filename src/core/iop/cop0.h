@@ -11,6 +11,9 @@ struct COP0 {
     u32 GetReg(int reg);
     void SetReg(int reg, u32 value);
 
+    // recomputes interrupt_pending, this must be called whenever status or cause change
+    void UpdateInterrupts();
+
     union Status {
         struct {
             bool iec : 1;
@@ -59,6 +62,9 @@ struct COP0 {
     Cause cause;
     u32 epc;
     u32 prid;
+
+    // set when an enabled interrupt is pending
+    bool interrupt_pending;
 };
 
 } // namespace iop
\ No newline at end of file
@@ -1,4 +1,4 @@
-#include "common/log.h"
+#include <algorithm>
 #include "common/log.h"
 #include "core/iop/dmac.h"
 #include "core/system.h"
@@ -25,6 +25,20 @@ void DMAC::Reset() {
     global_dma_interrupt_control = false;
 }
 
+void DMAC::RegisterIO(common::IOMap& io) {
+    auto read = [](DMAC* dmac, u32 paddr) {
+        return dmac->ReadRegister(paddr);
+    };
+
+    auto write = [](DMAC* dmac, u32 paddr, u32 value) {
+        dmac->WriteRegister(paddr, value);
+    };
+
+    io.Map(0x1f801080, 0x1f801100, this, read, write);
+    io.Map(0x1f801500, 0x1f80155f, this, read, write);
+    io.Map(0x1f801570, 0x1f80157f, this, read, write);
+}
+
 void DMAC::Run(int cycles) {
     for (int i = 7; i < 13; i++) {
         if (GetChannelEnable(i) && (channels[i].control & (1 << 24))) {
@@ -203,14 +217,16 @@ void DMAC::DoSIF0Transfer() {
     Channel& channel = channels[9];
 
     if (channel.block_count) {
-        // read data from iop ram and push to the sif0 fifo
-        system.sif.write_sif0_fifo(system.iop.Read<u32>(channel.address));
+        // push as much of the block from iop ram into the sif0 fifo as there is space for
+        u32 words = std::min<u32>(channel.block_count, system.sif.sif0_fifo.GetFree());
+        words = std::min(words, GetRAMWords(channel.address));
+        system.sif.sif0_fifo.PushSpan(std::span<const u32>(GetRAMPointer(channel.address), words));
 
-        channel.address += 4;
-        channel.block_count--;
+        channel.address += words * 4;
+        channel.block_count -= words;
     } else if (channel.end_transfer) {
         EndTransfer(9);
-    } else {
+    } else if (system.sif.sif0_fifo.GetFree() >= 2) {
         u32 data = system.iop.Read<u32>(channel.tag_address);
         u32 block_count = system.iop.Read<u32>(channel.tag_address + 4);
 
@@ -240,14 +256,13 @@ void DMAC::DoSIF1Transfer() {
     Channel& channel = channels[10];
 
     if (channel.block_count) {
-        // transfer data from the sif1 fifo to iop ram
-        if (system.sif.GetSIF1FIFOSize() > 0) {
-            u32 data = system.sif.ReadSIF1FIFO();
+        // transfer as much of the block as the ee has put in the sif1 fifo straight into iop ram
+        u32 words = std::min<u32>(channel.block_count, system.sif.sif1_fifo.GetLength());
+        words = std::min(words, GetRAMWords(channel.address));
+        system.sif.sif1_fifo.PopSpan(std::span<u32>(GetRAMPointer(channel.address), words));
 
-            system.iop.Write<u32>(channel.address, data);
-            channel.address += 4;
-            channel.block_count--;
-        }
+        channel.address += words * 4;
+        channel.block_count -= words;
     } else if (channel.end_transfer) {
         EndTransfer(10);
     } else {
@@ -324,6 +339,15 @@ void DMAC::DoSIO2OutTransfer() {
     common::Log("[iop::DMAC sio2out] end transfer flags %08x masks %08x", dicr2.flags, dicr2.masks);
 }
 
+u32* DMAC::GetRAMPointer(u32 addr) {
+    return reinterpret_cast<u32*>(system.iop_ram->data() + (addr & 0x1ffffc));
+}
+
+u32 DMAC::GetRAMWords(u32 addr) {
+    // blocks are split where they wrap around the end of iop ram
+    return (0x200000 - (addr & 0x1ffffc)) / 4;
+}
+
 void DMAC::EndTransfer(int index) {
     common::Log("[iop::DMAC %d] end transfer", index);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 #include "core/iop/sio2.h"
 
 struct System;
@@ -12,6 +13,7 @@ public:
     DMAC(System& system, SIO2& sio2);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
     void Run(int cycles);
     u32 ReadRegister(u32 addr);
     u32 ReadChannel(u32 addr);
@@ -75,6 +77,10 @@ public:
     bool global_dma_interrupt_control;
 
 private:
+    // sif transfers move blocks straight between the sif fifos and iop ram
+    u32* GetRAMPointer(u32 addr);
+    u32 GetRAMWords(u32 addr);
+
     System& system;
     SIO2& sio2;
 };
@@ -12,6 +12,14 @@ void INTC::Reset() {
     interrupt_control = 0;
 }
 
+void INTC::RegisterIO(common::IOMap& io) {
+    io.Map(0x1f801070, 0x1f801079, this, [](INTC* intc, u32 paddr) {
+        return intc->ReadRegister(paddr);
+    }, [](INTC* intc, u32 paddr, u32 value) {
+        intc->WriteRegister(paddr, value);
+    });
+}
+
 u32 INTC::ReadRegister(int offset) {
     switch (offset) {
     case 0x1f801070:
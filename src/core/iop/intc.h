@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 
 namespace iop {
 
@@ -33,6 +34,7 @@ public:
     INTC(Context& ctx);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
 
     u32 ReadRegister(int offset);
     void WriteRegister(int offset, u32 data);
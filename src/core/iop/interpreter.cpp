@@ -76,9 +76,18 @@ void Interpreter::Reset() {
     branch_delay = false;
     branch = false;
     inst.data = 0;
+    idle_loops.clear();
+    idle_loop_pc = 0;
+    idle = false;
+    idle_cycles = 0;
 }
 
 void Interpreter::Run(int cycles) {
+    // other components may have changed what an idle loop reads, so it must be seen
+    // to make no progress again in each slice
+    idle_loop_pc = 0;
+    idle = false;
+
     while (cycles--) {
         inst = Instruction{ctx.Read<u32>(ctx.pc)};
 
@@ -92,18 +101,221 @@ void Interpreter::Run(int cycles) {
 
         if (branch_delay) {
             if (branch) {
+                u32 branch_pc = ctx.pc - 8;
                 ctx.pc = ctx.npc;
                 branch_delay = false;
                 branch = false;
+
+                if (ctx.pc <= branch_pc && DetectIdleLoop(branch_pc) && !ctx.cop0.interrupt_pending) {
+                    idle_cycles += cycles;
+                    idle = true;
+                    return;
+                }
             } else {
                 branch = true;
             }
         }
 
-        CheckInterrupts();
+        if (ctx.cop0.interrupt_pending) {
+            CheckInterrupts();
+        }
+    }
+}
+
+bool Interpreter::DetectIdleLoop(u32 branch_pc) {
+    u32 start = ctx.pc;
+    if (!ctx.system.idle_loop_detection || branch_pc - start >= MAX_IDLE_LOOP_SIZE * 4) {
+        return false;
+    }
+
+    auto it = idle_loops.find(branch_pc);
+    if (it == idle_loops.end() || it->second.start != start) {
+        it = idle_loops.insert_or_assign(branch_pc, AnalyseIdleLoop(start, branch_pc + 4)).first;
+    }
+
+    IdleLoop& loop = it->second;
+    if (!loop.candidate) {
+        return false;
+    }
+
+    // the first iteration in a slice only records the registers to compare against
+    bool unchanged = idle_loop_pc == branch_pc;
+    idle_loop_pc = branch_pc;
+
+    for (int reg = 1; reg < 32; reg++) {
+        if ((loop.written_regs & (1u << reg)) && ctx.GetReg(reg) != idle_loop_regs[reg]) {
+            idle_loop_regs[reg] = ctx.GetReg(reg);
+            unchanged = false;
+        }
+    }
+
+    // code can be overwritten after it's analysed, such as when modules are loaded over each other,
+    // so only skip a loop which is still the same code
+    if (unchanged && !HasSameCode(loop, branch_pc + 4)) {
+        loop = AnalyseIdleLoop(start, branch_pc + 4);
+        idle_loop_pc = 0;
+        return false;
+    }
+
+    // the addresses of loads depend on the registers the loop was entered with, so they're
+    // checked each time instead of when the loop is analysed
+    return unchanged && HasOnlySafeLoads(loop, branch_pc + 4);
+}
+
+bool Interpreter::HasSameCode(const IdleLoop& loop, u32 end) {
+    for (u32 addr = loop.start; addr <= end; addr += 4) {
+        if (ctx.Read<u32>(addr) != loop.code[(addr - loop.start) / 4]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// io registers which can be polled without side effects
+static bool IsStatusRegister(u32 paddr) {
+    // dma channel registers, dpcr and dicr
+    if ((paddr >= 0x1f801080 && paddr < 0x1f801100) || (paddr >= 0x1f801500 && paddr < 0x1f801580)) {
+        return true;
+    }
+
+    // timer counts. reading a timer's mode clears its flags, so that isn't included
+    if (((paddr >= 0x1f801100 && paddr < 0x1f801130) || (paddr >= 0x1f801480 && paddr < 0x1f8014b0)) && (paddr & 0xf) == 0) {
+        return true;
+    }
+
+    switch (paddr) {
+    case 0x1d000000: // sif mscom
+    case 0x1d000010: // sif smcom
+    case 0x1d000020: // sif msflg
+    case 0x1d000030: // sif smflg
+    case 0x1d000040: // sif ctrl
+    case 0x1f801070: // i_stat
+    case 0x1f801074: // i_mask
+    case 0x1f801078: // i_ctrl
+    case 0x1f402005: // cdvd n command status
+    case 0x1f402017: // cdvd s command status
+        return true;
+    default:
+        return false;
     }
 }
 
+bool Interpreter::HasOnlySafeLoads(const IdleLoop& loop, u32 end) {
+    // registers which the loop doesn't write keep the value it was entered with, and registers
+    // set to a constant in the loop, like with lui, are followed until they're next written
+    std::array<bool, 32> known;
+    std::array<u32, 32> values;
+    for (int reg = 0; reg < 32; reg++) {
+        known[reg] = !(loop.written_regs & (1u << reg)) || reg == 0;
+        values[reg] = ctx.GetReg(reg);
+    }
+
+    for (u32 addr = loop.start; addr <= end; addr += 4) {
+        Instruction inst = Instruction{loop.code[(addr - loop.start) / 4]};
+
+        switch (inst.opcode) {
+        case 0x20: case 0x21: case 0x23: case 0x24: case 0x25: {
+            u32 vaddr = values[inst.rs] + inst.simm;
+            if (!known[inst.rs] || (!ctx.IsMemory(vaddr) && !IsStatusRegister(vaddr & 0x1fffffff))) {
+                return false;
+            }
+
+            break;
+        }
+        }
+
+        // work out the register the instruction writes, which the analysis already limited to
+        // these forms
+        int dest;
+        switch (inst.opcode) {
+        case 0x00:
+            dest = inst.rd;
+            break;
+        case 0x01: case 0x04: case 0x05: case 0x06: case 0x07:
+            continue;
+        default:
+            dest = inst.rt;
+            break;
+        }
+
+        if (dest == 0) {
+            continue;
+        }
+
+        switch (inst.opcode) {
+        case 0x09:
+            // addiu
+            known[dest] = known[inst.rs];
+            values[dest] = values[inst.rs] + inst.simm;
+            break;
+        case 0x0d:
+            // ori
+            known[dest] = known[inst.rs];
+            values[dest] = values[inst.rs] | inst.imm;
+            break;
+        case 0x0f:
+            // lui
+            known[dest] = true;
+            values[dest] = inst.imm << 16;
+            break;
+        default:
+            known[dest] = false;
+            break;
+        }
+    }
+
+    return true;
+}
+
+Interpreter::IdleLoop Interpreter::AnalyseIdleLoop(u32 start, u32 end) {
+    IdleLoop loop = {false, 0, start, {}};
+
+    for (u32 addr = start; addr <= end; addr += 4) {
+        Instruction inst = Instruction{ctx.Read<u32>(addr)};
+        loop.code[(addr - start) / 4] = inst.data;
+        int dest = -1;
+
+        switch (inst.opcode) {
+        case 0x00:
+            switch (inst.func) {
+            case 0x00: case 0x02: case 0x03: case 0x04: case 0x06: case 0x07:
+            case 0x21: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27:
+            case 0x2a: case 0x2b:
+                dest = inst.rd;
+                break;
+            }
+
+            break;
+        case 0x01: case 0x04: case 0x05: case 0x06: case 0x07: {
+            // branches can't link or leave the loop
+            u32 target = addr + (inst.simm << 2) + 4;
+            bool link = inst.opcode == 0x01 && (inst.rt & 0x1e) == 0x10;
+            if (!link && target >= start && target <= end) {
+                dest = 0;
+            }
+
+            break;
+        }
+        case 0x09: case 0x0a: case 0x0b: case 0x0c: case 0x0d: case 0x0e: case 0x0f:
+        case 0x20: case 0x21: case 0x23: case 0x24: case 0x25:
+            // alu instructions with an immediate and loads
+            dest = inst.rt;
+            break;
+        }
+
+        // anything else could store to memory or otherwise make progress
+        if (dest < 0) {
+            return loop;
+        }
+
+        loop.written_regs |= 1u << dest;
+    }
+
+    loop.candidate = true;
+    return loop;
+}
+
 void Interpreter::RegisterOpcode(InstructionHandler handler, int index, InstructionTable table) {
     if (table == InstructionTable::Primary) {
         primary_table[index] = handler;
@@ -138,6 +350,7 @@ void Interpreter::DoException(Exception exception) {
     u8 stack = ctx.cop0.status.data & 0x3f;
     ctx.cop0.status.data &= ~0x3f;
     ctx.cop0.status.data |= (stack << 2) & 0x3f;
+    ctx.cop0.UpdateInterrupts();
 
     // since we increment by 4 after each instruction we need to account for that
     // so that we can execute at the exception base on the next instruction
@@ -153,6 +366,8 @@ void Interpreter::RaiseInterrupt(bool value) {
     } else {
         ctx.cop0.cause.data &= ~(1 << 10);
     }
+
+    ctx.cop0.UpdateInterrupts();
 }
 
 void Interpreter::CheckInterrupts() {
@@ -527,6 +742,7 @@ void Interpreter::rfe() {
     u8 stack = ctx.cop0.status.data & 0x3f;
     ctx.cop0.status.data &= ~0xf;
     ctx.cop0.status.data |= stack >> 2;
+    ctx.cop0.UpdateInterrupts();
 }
 
 } // namespace iop
\ No newline at end of file
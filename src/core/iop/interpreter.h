@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <unordered_map>
 #include "common/types.h"
 #include "core/iop/instruction.h"
 #include "core/iop/executor.h"
@@ -27,6 +28,10 @@ public:
     void RaiseInterrupt(bool value);
     void CheckInterrupts();
 
+    // whether the last slice ended early in an idle loop, and the total cycles skipped that way
+    bool IsIdle() { return idle; }
+    u64 GetIdleCycles() { return idle_cycles; }
+
 private:
     typedef void (Interpreter::*InstructionHandler)();
     void RegisterOpcode(InstructionHandler handler, int index, InstructionTable table);
@@ -94,9 +99,37 @@ private:
     void IOPPuts();
 
 private:
+    static constexpr int MAX_IDLE_LOOP_SIZE = 16;
+
+    // a short backward loop which makes no progress once the registers it writes stop changing
+    struct IdleLoop {
+        bool candidate;
+        u32 written_regs;
+
+        // the instructions the loop was analysed from, including the delay slot
+        u32 start;
+        std::array<u32, MAX_IDLE_LOOP_SIZE + 1> code;
+    };
+
+    bool DetectIdleLoop(u32 branch_pc);
+    IdleLoop AnalyseIdleLoop(u32 start, u32 end);
+
+    // whether a loop is still made up of the instructions it was analysed from
+    bool HasSameCode(const IdleLoop& loop, u32 end);
+
+    // whether every load in a loop reads memory or a status register, rather than
+    // something like a fifo which changes when it's read
+    bool HasOnlySafeLoads(const IdleLoop& loop, u32 end);
+
     bool branch_delay;
     bool branch;
 
+    std::unordered_map<u32, IdleLoop> idle_loops;
+    u32 idle_loop_pc;
+    std::array<u32, 32> idle_loop_regs;
+    bool idle;
+    u64 idle_cycles;
+
     Instruction inst;
     Context& ctx;
 
@@ -16,12 +16,20 @@ void SIO2::Reset() {
     m_peripheral_type = PeripheralType::None;
 }
 
+void SIO2::RegisterIO(common::IOMap& io) {
+    io.Map(0x1f808200, 0x1f808284, this, [](SIO2* sio2, u32 paddr) {
+        return sio2->ReadRegister(paddr);
+    }, [](SIO2* sio2, u32 paddr, u32 value) {
+        sio2->WriteRegister(paddr, value);
+    });
+}
+
 u32 SIO2::ReadRegister(u32 addr) {
     switch (addr) {
     case 0x1f808264:
         // fifo out
         common::Log("[iop::SIO2] fifo read %08x", 0);
-        return fifo.Pop<u8>();
+        return fifo.Pop();
     case 0x1f808268:
         common::Log("[iop::SIO2] control read %08x", control);
         return control;
@@ -97,7 +105,7 @@ void SIO2::WriteRegister(u32 addr, u32 value) {
 }
 
 u8 SIO2::ReadDMA() {
-    u8 data = fifo.Pop<u8>();
+    u8 data = fifo.Pop();
     common::Log("[iop::SIO2] dma read %02x", data);
     return data;
 }
@@ -140,11 +148,11 @@ void SIO2::upload_command(u8 data) {
     switch (m_peripheral_type) {
     case PeripheralType::Controller:
         // Just stub reply for now.
-        fifo.Push<u8>(0x00);
+        fifo.Push(0x00);
         break;
     case PeripheralType::Memcard:
         // Just stub reply for now.
-        fifo.Push<u8>(0xff);
+        fifo.Push(0xff);
         break;
     default:
         common::Log("[iop::sio2] handle non-controller transfer"); 
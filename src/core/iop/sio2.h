@@ -2,6 +2,7 @@
 
 #include <array>
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/queue.h"
 #include "core/iop/intc.h"
 
@@ -11,6 +12,7 @@ struct SIO2 {
     SIO2(INTC& intc);
 
     void Reset();
+    void RegisterIO(common::IOMap& io);
 
     u32 ReadRegister(u32 addr);
     void WriteRegister(u32 addr, u32 value);
@@ -1,25 +1,36 @@
+#include <algorithm>
 #include "common/log.h"
 #include "core/iop/timers.h"
 
 namespace iop {
 
-Timers::Timers(INTC& intc) : m_intc(intc) {}
+Timers::Timers(INTC& intc, Scheduler& scheduler) : m_intc(intc), m_scheduler(scheduler) {
+    m_scheduler.RegisterEvent(EventType::IOPTimer, &timer_event);
+}
 
 void Timers::reset() {
     for (int i = 0; i < 6; i++) {
+        m_scheduler.Cancel(m_channels[i].event);
+
         m_channels[i].counter = 0;
-        m_channels[i].cycles = 0;
         m_channels[i].cycles_per_tick = 1;
+        m_channels[i].base_time = m_scheduler.GetCurrentTime();
         m_channels[i].mode.data = 0;
         m_channels[i].target = 0;
     }
 }
 
-// TODO: put timers on scheduler for performance
-void Timers::run(int cycles) {
-    for (int i = 0; i < 6; i++) {
-        run_channel(i, cycles);
-    }
+void Timers::RegisterIO(common::IOMap& io) {
+    auto read = [](Timers* timers, u32 paddr) {
+        return timers->read(paddr);
+    };
+
+    auto write = [](Timers* timers, u32 paddr, u32 value) {
+        timers->write(paddr, value);
+    };
+
+    io.Map(0x1f801100, 0x1f801130, this, read, write);
+    io.Map(0x1f801480, 0x1f8014b0, this, read, write);
 }
 
 u32 Timers::read(u32 addr) {
@@ -28,6 +39,7 @@ u32 Timers::read(u32 addr) {
 
     switch (addr & 0xf) {
     case 0x0:
+        sync_channel(index);
         common::Log("[iop::Timers] channel %d counter read %08x", index, static_cast<u32>(channel.counter));
         return channel.counter;
     case 0x4:
@@ -48,11 +60,15 @@ u32 Timers::read(u32 addr) {
 void Timers::write(u32 addr, u32 data) {
     int index = calculate_channel_index(addr);
     auto& channel = m_channels[index];
+
+    // Bring the counter up to date with the old settings before changing them.
+    sync_channel(index);
     
     switch (addr & 0xf) {
     case 0x0:
         common::Log("[iop::Timers] channel %d counter write %08x", index, data);
-        channel.counter = data;
+        channel.counter = data & (calculate_counter_range(index) - 1);
+        channel.base_time = m_scheduler.GetCurrentTime();
         break;
     case 0x4: {
         common::Log("[iop::Timers] channel %d mode write %08x", index, data);
@@ -67,6 +83,7 @@ void Timers::write(u32 addr, u32 data) {
 
         // Calculate clock source.
         // TODO: write hardware test for this later.
+        channel.cycles_per_tick = 1;
         if (channel.mode.use_external_signal) {
             switch (index) {
             case 0:
@@ -90,7 +107,7 @@ void Timers::write(u32 addr, u32 data) {
         common::Log("timer %d prescaler set to %d cycles per tick %d", index, prescaler, channel.cycles_per_tick);
 
         channel.counter = 0;
-        channel.cycles = 0;
+        channel.base_time = m_scheduler.GetCurrentTime();
         break;
     }
     case 0x8:
@@ -113,6 +130,8 @@ void Timers::write(u32 addr, u32 data) {
     default:
         LOG_TODO("unknown timer write %08x", addr);
     }
+
+    schedule_event(index);
 }
 
 int Timers::calculate_channel_index(u32 addr) {
@@ -147,64 +166,133 @@ u32 Timers::calculate_channel_prescaler(int index) {
     }
 }
 
-void Timers::run_channel(int index, int cycles) {
+void Timers::raise_irq(int index) {
     auto& channel = m_channels[index];
-    channel.cycles += cycles;
+    int irq = index < 3 ? 4 + index : 11 + index;
 
-    while (channel.cycles >= channel.cycles_per_tick) {
-        channel.cycles -= channel.cycles_per_tick;
-        channel.counter++;
+    m_intc.RequestInterrupt(static_cast<InterruptSource>(irq));
 
-        // Check for timer overflows.
-        if (overflow_occured(index) && channel.mode.overflow_irq && !channel.mode.overflow_irq_raised) {
-            common::Log("[iop::Timers] overflow irq occured for channel %d with counter %08x", index, static_cast<u32>(channel.counter));
-            raise_irq(index);
-            channel.mode.overflow_irq_raised = true;
-        }
+    if (!channel.mode.repeat_irq) {
+        common::Log("[iop::Timers] repeat irq disabled for channel %d, so disable irq", index);
+        channel.mode.irqs_enabled = false;
+    } else if (channel.mode.levl) {
+        common::Log("[iop::Timers] toggle irq enabled for channel %d, so toggle irq", index);
+        channel.mode.irqs_enabled ^= true;
+    }
+}
 
-        // Mask counter and check for compare interrupts.
-        if (index < 3) {
-            channel.counter &= 0xffff;
-        } else {
-            channel.counter &= 0xffffffff;
-        }
+void Timers::sync_channel(int index) {
+    auto& channel = m_channels[index];
+    u64 cycles_per_tick = channel.cycles_per_tick * EE_CYCLES_PER_IOP_CYCLE;
 
-        if (channel.counter == channel.target && channel.mode.compare_irq && !channel.mode.compare_irq_raised) {
-            common::Log("[iop::Timers] compare irq occured for channel %d with counter %08x", index, static_cast<u32>(channel.counter));
-            raise_irq(index);
-            channel.mode.compare_irq_raised = true;
+    // Only move the base time forward by whole ticks, so partial ticks carry over.
+    u64 ticks = (m_scheduler.GetCurrentTime() - channel.base_time) / cycles_per_tick;
+    channel.base_time += ticks * cycles_per_tick;
+    advance_channel(index, ticks);
+}
 
-            if (channel.mode.zero_return) {
-                channel.counter = 0;
+void Timers::advance_channel(int index, u64 ticks) {
+    auto& channel = m_channels[index];
+    u64 range = calculate_counter_range(index);
+    u64 counter = channel.counter + ticks;
+
+    if (channel.mode.zero_return && channel.target != 0) {
+        // The counter goes back to 0 when it reaches the target. If it's
+        // already past the target then it has to overflow first.
+        if (channel.counter >= channel.target) {
+            if (counter < range) {
+                channel.counter = counter;
+                return;
             }
+
+            counter -= range;
         }
+
+        channel.counter = counter % channel.target;
+    } else {
+        channel.counter = counter % range;
     }
 }
 
-bool Timers::overflow_occured(int index) {
+u64 Timers::calculate_counter_range(int index) {
+    // Channels 0..2 use 16-bit counter.
+    // Channels 3..5 use 32-bit counter.
+    return index < 3 ? 0x10000 : 0x100000000;
+}
+
+u64 Timers::ticks_until_target(int index) {
     auto& channel = m_channels[index];
-    if (index < 3) {
-        // Channels 0..2 use 16-bit counter.
-        return channel.counter > 0xffff;
-    } else {
-        // Channels 3..5 use 32-bit counter.
-        return channel.counter > 0xffffffff;
+    if (channel.counter < channel.target) {
+        return channel.target - channel.counter;
     }
+
+    return calculate_counter_range(index) - channel.counter + channel.target;
 }
 
-void Timers::raise_irq(int index) {
+u64 Timers::ticks_until_overflow(int index) {
     auto& channel = m_channels[index];
-    int irq = index < 3 ? 4 + index : 11 + index;
+    if (channel.mode.zero_return && channel.counter < channel.target) {
+        // The counter resets before it can overflow.
+        return NEVER;
+    }
 
-    m_intc.RequestInterrupt(static_cast<InterruptSource>(irq));
+    return calculate_counter_range(index) - channel.counter;
+}
 
-    if (!channel.mode.repeat_irq) {
-        common::Log("[iop::Timers] repeat irq disabled for channel %d, so disable irq", index);
-        channel.mode.irqs_enabled = false;
-    } else if (channel.mode.levl) {
-        common::Log("[iop::Timers] toggle irq enabled for channel %d, so toggle irq", index);
-        channel.mode.irqs_enabled ^= true;
+void Timers::schedule_event(int index) {
+    auto& channel = m_channels[index];
+    m_scheduler.Cancel(channel.event);
+
+    if (!channel.mode.compare_irq && !channel.mode.overflow_irq) {
+        return;
+    }
+
+    u64 ticks = NEVER;
+    if (channel.mode.compare_irq) {
+        ticks = ticks_until_target(index);
+    }
+
+    if (channel.mode.overflow_irq) {
+        ticks = std::min(ticks, ticks_until_overflow(index));
+    }
+
+    // With only the overflow interrupt enabled, the counter can return to 0 at the target before it ever overflows.
+    if (ticks == NEVER) {
+        return;
     }
+
+    // After a sync the base time is at most one partial tick behind the current time.
+    // The delay saturates so that it can never wrap around into the past.
+    u64 cycles_per_tick = channel.cycles_per_tick * EE_CYCLES_PER_IOP_CYCLE;
+    u64 cycles = ticks > MAX_DELAY / cycles_per_tick ? MAX_DELAY : ticks * cycles_per_tick;
+    u64 delay = cycles - (m_scheduler.GetCurrentTime() - channel.base_time);
+    channel.event = m_scheduler.Add(delay, EventType::IOPTimer, this, index);
+}
+
+void Timers::timer_event(void* context, u64 index) {
+    auto timers = reinterpret_cast<Timers*>(context);
+    auto& channel = timers->m_channels[index];
+
+    // Work out which conditions have been reached before the counter moves past them.
+    u64 cycles_per_tick = channel.cycles_per_tick * EE_CYCLES_PER_IOP_CYCLE;
+    u64 ticks = (timers->m_scheduler.GetCurrentTime() - channel.base_time) / cycles_per_tick;
+    bool overflow = timers->ticks_until_overflow(index) <= ticks;
+    bool target = timers->ticks_until_target(index) <= ticks;
+    timers->sync_channel(index);
+
+    if (overflow && channel.mode.overflow_irq && !channel.mode.overflow_irq_raised) {
+        common::Log("[iop::Timers] overflow irq occured for channel %d with counter %08x", static_cast<int>(index), static_cast<u32>(channel.counter));
+        timers->raise_irq(index);
+        channel.mode.overflow_irq_raised = true;
+    }
+
+    if (target && channel.mode.compare_irq && !channel.mode.compare_irq_raised) {
+        common::Log("[iop::Timers] compare irq occured for channel %d with counter %08x", static_cast<int>(index), static_cast<u32>(channel.counter));
+        timers->raise_irq(index);
+        channel.mode.compare_irq_raised = true;
+    }
+
+    timers->schedule_event(index);
 }
 
 } // namespace iop
\ No newline at end of file
@@ -1,31 +1,46 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 
 #include "core/iop/intc.h"
+#include "core/scheduler.h"
 
 namespace iop {
 
 class Timers {
 public:
-    Timers(INTC& intc);
+    Timers(INTC& intc, Scheduler& scheduler);
 
     void reset();
-    void run(int cycles);
+    void RegisterIO(common::IOMap& io);
     u32 read(u32 addr);
     void write(u32 addr, u32 data);
 
 private:
     int calculate_channel_index(u32 addr);
     u32 calculate_channel_prescaler(int index);
-    void run_channel(int index, int cycles);
-    bool overflow_occured(int index);
     void raise_irq(int index);
 
+    // Counters aren't incremented every cycle, instead they're brought up to date
+    // from the scheduler time whenever they're accessed, and the next compare or
+    // overflow irq is scheduled as an event.
+    void sync_channel(int index);
+    void advance_channel(int index, u64 ticks);
+    u64 calculate_counter_range(int index);
+    u64 ticks_until_target(int index);
+    u64 ticks_until_overflow(int index);
+    void schedule_event(int index);
+    static void timer_event(void* context, u64 index);
+
     struct Channel {
+        // Value of the counter at base_time.
         u64 counter;
-        u64 cycles;
+
+        // Measured in iop cycles.
         u64 cycles_per_tick;
+        u64 base_time;
+        EventHandle event;
 
         union Mode {
             struct {
@@ -61,9 +76,17 @@ private:
     } m_channels[6];
 
     INTC& m_intc;
+    Scheduler& m_scheduler;
 
     static constexpr u32 EE_CLOCK = 294912000;
     static constexpr u32 IOP_CLOCK = EE_CLOCK / 8;
+
+    // The scheduler counts ee cycles.
+    static constexpr u64 EE_CYCLES_PER_IOP_CYCLE = EE_CLOCK / IOP_CLOCK;
+    static constexpr u64 NEVER = 0xffffffffffffffff;
+
+    // Far enough away that adding it to the current time can't wrap.
+    static constexpr u64 MAX_DELAY = 1ull << 62;
 };
 
 } // namespace iop
\ No newline at end of file
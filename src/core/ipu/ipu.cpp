@@ -5,6 +5,18 @@ void IPU::Reset() {
     command = 0;
 }
 
+void IPU::RegisterIO(common::IOMap& io) {
+    io.MapWrite(0x10002000, this, [](IPU* ipu, u32, u32 value) {
+        ipu->WriteCommand(value);
+    });
+
+    io.Map(0x10002010, this, [](IPU* ipu, u32) {
+        return ipu->ReadControl();
+    }, [](IPU* ipu, u32, u32 value) {
+        ipu->WriteControl(value);
+    });
+}
+
 void IPU::SystemReset() {
     common::Log("[IPU] system reset");
 }
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <common/types.h>
+#include <common/io_map.h>
 #include <common/log.h>
 
 class IPU {
 public:
     void Reset();
+    void RegisterIO(common::IOMap& io);
     void SystemReset();
 
     void WriteControl(u32 data);
@@ -1,86 +1,165 @@
+#include <limits>
 #include <core/scheduler.h>
 
+Scheduler::Scheduler() {
+    callbacks.fill(nullptr);
+
+    for (Event& event : pool) {
+        // start at 1 so that a default constructed handle never refers to an event
+        event.generation = 1;
+        event.heap_index = -1;
+    }
+
+    Reset();
+}
+
 void Scheduler::Reset() {
-    events.clear();
+    // generations are kept across resets, so handles from before the reset stay stale
+    for (int i = 0; i < MAX_EVENTS; i++) {
+        if (pool[i].heap_index >= 0) {
+            pool[i].generation++;
+        }
 
+        pool[i].heap_index = -1;
+        free_slots[i] = MAX_EVENTS - 1 - i;
+    }
+
+    free_count = MAX_EVENTS;
+    heap_size = 0;
     current_time = 0;
+    sequence = 0;
 }
 
 void Scheduler::Tick(int cycles) {
     current_time += cycles;
 }
 
-void Scheduler::ResetCurrentTime() {
-    // this will be ran at the start of each frame
-    current_time = 0;
-}
-
 u64 Scheduler::GetCurrentTime() {
     return current_time;
 }
 
 u64 Scheduler::GetEventTime() {
-    return events[0].start_time;
-}
-
-int Scheduler::CalculateEventIndex(Event& new_event) {
-    int lower_bound = 0;
-    int upper_bound = events.size() - 1;
-   
-    while (lower_bound <= upper_bound) {
-        int mid = (lower_bound + upper_bound) / 2;
-        
-        if (new_event.start_time > events[mid].start_time) {
-            lower_bound = mid + 1;
-        } else {
-            upper_bound = mid - 1;
-        }
+    if (heap_size == 0) {
+        return std::numeric_limits<u64>::max();
     }
 
-    return lower_bound;
+    return pool[heap[0]].start_time;
 }
 
 void Scheduler::RunEvents() {
     // do any scheduler events that are meant to happen at the current moment
-    while (events[0].start_time <= GetCurrentTime() && events.size() > 0) {
-        // do the callback associated with that scheduler event
-        events[0].callback();
-        
-        // remove the event from the priority queue
-        events.erase(events.begin());
+    while (heap_size > 0 && pool[heap[0]].start_time <= GetCurrentTime()) {
+        // the event is removed before its callback runs, so the callback is free to add or cancel events
+        Event event = pool[heap[0]];
+        Remove(0);
+        callbacks[static_cast<int>(event.type)](event.context, event.payload);
     }
 }
 
-void Scheduler::Add(u64 delay, std::function<void()> callback) {
-    Event new_event;
-    new_event.callback = callback;
-    new_event.id = NoneEvent;
-    new_event.start_time = GetCurrentTime() + delay;
-    int index = CalculateEventIndex(new_event);
+void Scheduler::RegisterEvent(EventType type, Callback callback) {
+    callbacks[static_cast<int>(type)] = callback;
+}
+
+EventHandle Scheduler::Add(u64 delay, EventType type, void* context, u64 payload) {
+    if (free_count == 0) {
+        common::Error("[Scheduler] no free event slots");
+    }
 
-    events.insert(events.begin() + index, new_event);
+    int slot = free_slots[--free_count];
+    Event& event = pool[slot];
+    event.start_time = GetCurrentTime() + delay;
+    event.sequence = sequence++;
+    event.type = type;
+    event.context = context;
+    event.payload = payload;
+    event.heap_index = heap_size;
+
+    heap[heap_size++] = slot;
+    SiftUp(event.heap_index);
+    return EventHandle{static_cast<u16>(slot), event.generation};
 }
 
-void Scheduler::AddWithId(u64 delay, int id, std::function<void()> callback) {
-    Event new_event;
-    new_event.callback = callback;
-    new_event.id = id;
-    new_event.start_time = GetCurrentTime() + delay;
-    int index = CalculateEventIndex(new_event);
+void Scheduler::Cancel(EventHandle handle) {
+    Event& event = pool[handle.slot];
+    if (event.generation != handle.generation || event.heap_index < 0) {
+        return;
+    }
 
-    events.insert(events.begin() + index, new_event);
+    Remove(event.heap_index);
 }
 
-void Scheduler::Cancel(int id) {
-    for (u64 i = 0; i < events.size(); i++) {
-        if (events[i].id == id) {
-            events.erase(events.begin() + i);
+void Scheduler::SchedulerDebug() {
+    for (int i = 0; i < heap_size; i++) {
+        Event& event = pool[heap[i]];
+        printf("start time: %ld, type: %d\n", event.start_time, static_cast<int>(event.type));
+    }
+}
+
+bool Scheduler::Earlier(int a, int b) {
+    Event& first = pool[heap[a]];
+    Event& second = pool[heap[b]];
+    if (first.start_time != second.start_time) {
+        return first.start_time < second.start_time;
+    }
+
+    return first.sequence < second.sequence;
+}
+
+void Scheduler::Swap(int a, int b) {
+    std::swap(heap[a], heap[b]);
+    pool[heap[a]].heap_index = a;
+    pool[heap[b]].heap_index = b;
+}
+
+void Scheduler::SiftUp(int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!Earlier(index, parent)) {
+            break;
         }
+
+        Swap(index, parent);
+        index = parent;
     }
 }
 
-void Scheduler::SchedulerDebug() {
-    for (Event event : events) {
-        printf("start time: %ld, id: %d\n", event.start_time, event.id);
+void Scheduler::SiftDown(int index) {
+    while (true) {
+        int smallest = index;
+        int left = (index * 2) + 1;
+        int right = (index * 2) + 2;
+
+        if (left < heap_size && Earlier(left, smallest)) {
+            smallest = left;
+        }
+
+        if (right < heap_size && Earlier(right, smallest)) {
+            smallest = right;
+        }
+
+        if (smallest == index) {
+            break;
+        }
+
+        Swap(index, smallest);
+        index = smallest;
+    }
+}
+
+void Scheduler::Remove(int index) {
+    int slot = heap[index];
+    pool[slot].generation++;
+    pool[slot].heap_index = -1;
+    free_slots[free_count++] = slot;
+
+    heap_size--;
+    if (index != heap_size) {
+        int moved = heap[heap_size];
+        heap[index] = moved;
+        pool[moved].heap_index = index;
+
+        // the moved event could belong either above or below its new position
+        SiftUp(index);
+        SiftDown(pool[moved].heap_index);
     }
 }
\ No newline at end of file
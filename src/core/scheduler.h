@@ -1,37 +1,76 @@
 #pragma once
 
-#include <functional>
-#include <vector>
+#include <array>
 #include <stdio.h>
 #include "common/types.h"
 #include "common/log.h"
 
-enum EventId {
-    NoneEvent,
-    TimerEvent,
+enum class EventType : u8 {
+    VBlankStart,
+    VBlankFinish,
+    COP0Compare,
+    EETimer,
+    IOPTimer,
+    DMACTransferEnd,
+    Count,
 };
 
-struct Event {
-    u64 start_time;
-    int id;
-    std::function<void()> callback;
+// refers to a scheduled event. once the event has run or been cancelled the
+// generation no longer matches, so a stale handle can't touch a newer event
+struct EventHandle {
+    u16 slot = 0;
+    u32 generation = 0;
 };
 
+// a binary heap of events allocated from a fixed pool, so scheduling never allocates.
+// each event type has a single callback which gets the context and payload the event was added with
 class Scheduler {
 public:
+    using Callback = void (*)(void* context, u64 payload);
+
+    Scheduler();
+
     void Reset();
     void Tick(int cycles);
     u64 GetCurrentTime();
     u64 GetEventTime();
-    void ResetCurrentTime();
     void RunEvents();
-    void Add(u64 delay, std::function<void()> callback);
-    void AddWithId(u64 delay, int id, std::function<void()> callback);
-    void Cancel(int id);
-    int CalculateEventIndex(Event& new_event);
+    void RegisterEvent(EventType type, Callback callback);
+    EventHandle Add(u64 delay, EventType type, void* context, u64 payload = 0);
+    void Cancel(EventHandle handle);
     void SchedulerDebug();
 
 private:
+    struct Event {
+        u64 start_time;
+
+        // breaks ties between events at the same time, so they run in the order they were added
+        u64 sequence;
+        EventType type;
+        void* context;
+        u64 payload;
+        u32 generation;
+        int heap_index;
+    };
+
+    bool Earlier(int a, int b);
+    void Swap(int a, int b);
+    void SiftUp(int index);
+    void SiftDown(int index);
+    void Remove(int index);
+
+    static constexpr int MAX_EVENTS = 64;
+
     u64 current_time;
-    std::vector<Event> events;
+    u64 sequence;
+
+    std::array<Event, MAX_EVENTS> pool;
+    std::array<u16, MAX_EVENTS> free_slots;
+    int free_count;
+
+    // slots of the pending events, ordered as a min heap on start time
+    std::array<u16, MAX_EVENTS> heap;
+    int heap_size;
+
+    std::array<Callback, static_cast<int>(EventType::Count)> callbacks;
 };
\ No newline at end of file
@@ -8,11 +8,70 @@ void SIF::Reset() {
     smflag = 0;
     smcom = 0;
 
-    std::queue<u32> sif0_empty;
-    std::queue<u32> sif1_empty;
-    
-    sif0_fifo.swap(sif0_empty);
-    sif1_fifo.swap(sif1_empty);
+    sif0_fifo.Reset();
+    sif1_fifo.Reset();
+}
+
+void SIF::RegisterEEIO(common::IOMap& io) {
+    io.Map(0x1000f200, this, [](SIF* sif, u32) {
+        return sif->ReadMSCOM();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->WriteMSCOM(value);
+    });
+
+    io.MapRead(0x1000f210, this, [](SIF* sif, u32) {
+        return sif->ReadSMCOM();
+    });
+
+    io.Map(0x1000f220, this, [](SIF* sif, u32) {
+        return sif->ReadMSFLAG();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->SetMSFLAG(value);
+    });
+
+    io.Map(0x1000f230, this, [](SIF* sif, u32) {
+        return sif->ReadSMFLAG();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->SetSMFLAG(value);
+    });
+
+    io.MapWrite(0x1000f240, this, [](SIF* sif, u32, u32 value) {
+        sif->WriteEEControl(value);
+    });
+
+    io.MapWrite(0x1000f260, this, [](SIF* sif, u32, u32 value) {
+        sif->WriteBD6(value);
+    });
+}
+
+void SIF::RegisterIOPIO(common::IOMap& io) {
+    io.Map(0x1d000010, this, [](SIF* sif, u32) {
+        return sif->ReadSMCOM();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->WriteSMCOM(value);
+    });
+
+    io.Map(0x1d000020, this, [](SIF* sif, u32) {
+        return sif->ReadMSFLAG();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->ResetMSFLAG(value);
+    });
+
+    io.Map(0x1d000030, this, [](SIF* sif, u32) {
+        return sif->ReadSMFLAG();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->SetSMFLAG(value);
+    });
+
+    io.Map(0x1d000040, this, [](SIF* sif, u32) {
+        return sif->ReadControl();
+    }, [](SIF* sif, u32, u32 value) {
+        sif->WriteIOPControl(value);
+    });
+
+    io.MapRead(0x1d000060, this, [](SIF* sif, u32) {
+        return sif->bd6;
+    });
 }
 
 void SIF::WriteEEControl(u32 data) {
@@ -94,33 +153,21 @@ u32 SIF::ReadControl() {
 }
 
 void SIF::write_sif0_fifo(u32 data) {
-    sif0_fifo.push(data);
-}
-
-void SIF::write_sif1_fifo(u128 data) {
-    for (int i = 0; i < 4; i++) {
-        sif1_fifo.push(data.uw[i]);
-    }
+    sif0_fifo.Push(data);
 }
 
 u32 SIF::ReadSIF0FIFO() {
-    u32 data = sif0_fifo.front();
-    sif0_fifo.pop();
-
-    return data;
+    return sif0_fifo.Pop();
 }
 
 u32 SIF::ReadSIF1FIFO() {
-    u32 data = sif1_fifo.front();
-    sif1_fifo.pop();
-
-    return data;
+    return sif1_fifo.Pop();
 }
 
 int SIF::GetSIF0FIFOSize() {
-    return sif0_fifo.size();
+    return sif0_fifo.GetLength();
 }
 
 int SIF::GetSIF1FIFOSize() {
-    return sif1_fifo.size();
+    return sif1_fifo.GetLength();
 }
\ No newline at end of file
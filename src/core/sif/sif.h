@@ -1,13 +1,15 @@
 #pragma once
 
-#include <queue>
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/log.h"
 #include "common/queue.h"
 
 class SIF {
 public:
     void Reset();
+    void RegisterEEIO(common::IOMap& io);
+    void RegisterIOPIO(common::IOMap& io);
 
     void WriteEEControl(u32 data);
     void WriteIOPControl(u32 data);
@@ -38,14 +40,17 @@ public:
     u32 msflag;
     u32 smflag;
 
-    // TODO: do more research into sif dmas and sif fifo
-    std::queue<u32> sif0_fifo;
-    std::queue<u32> sif1_fifo;
+    // TODO: do more research into sif dmas and sif fifo.
+    // the real fifos are much smaller, but these are large enough that the dmacs
+    // on either side can move whole blocks through them at once
+    static constexpr u32 SIF_FIFO_SIZE = 0x4000;
+
+    common::Queue<u32, SIF_FIFO_SIZE, true> sif0_fifo;
+    common::Queue<u32, SIF_FIFO_SIZE, true> sif1_fifo;
 
     u32 ReadSIF0FIFO();
     u32 ReadSIF1FIFO();
     void write_sif0_fifo(u32 data);
-    void write_sif1_fifo(u128 data);
     int GetSIF0FIFOSize();
     int GetSIF1FIFOSize();
 };
\ No newline at end of file
@@ -6,6 +6,31 @@ void SPU::Reset() {
     status = 0;
 }
 
+void SPU::RegisterIO(common::IOMap& io, int core) {
+    if (core == 1) {
+        io.Map(0x1f900400, 0x1f900800, this, [](SPU* spu, u32 paddr) {
+            return spu->ReadRegister(paddr);
+        }, [](SPU* spu, u32 paddr, u32 value) {
+            spu->WriteRegister(paddr, value);
+        });
+
+        return;
+    }
+
+    // the first core reads back as zero for now. it has to be registered after the second core,
+    // as 0x1f900760 lies inside the second core's range
+    auto read_zero = [](SPU*, u32) -> u32 {
+        return 0;
+    };
+
+    auto write = [](SPU* spu, u32 paddr, u32 value) {
+        spu->WriteRegister(paddr, value);
+    };
+
+    io.Map(0x1f900000, 0x1f900400, this, read_zero, write);
+    io.Map(0x1f900760, 0x1f900770, this, read_zero, write);
+}
+
 u32 SPU::ReadRegister(u32 addr) {
     u32 return_value = 0;
 
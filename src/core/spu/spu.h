@@ -1,10 +1,12 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/io_map.h"
 
 class SPU {
 public:
     void Reset();
+    void RegisterIO(common::IOMap& io, int core);
 
     u32 ReadRegister(u32 addr);
     void WriteRegister(u32 addr, u32 data);
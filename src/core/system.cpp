@@ -1,10 +1,19 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
 #include <core/system.h>
 
-System::System() : ee(*this), iop(*this), gs(*this), gif(gs), elf_loader(*this) {
-    bios = std::make_unique<std::array<u8, 0x400000>>();
+System::System() : ee(*this), iop(*this), gs(*this), gs_thread(gs), gif(gs_thread), elf_loader(*this), bus_clock(2), iop_clock(8) {
+    bios = std::make_unique<common::SharedMemory>(0x400000);
     iop_ram = std::make_unique<std::array<u8, 0x200000>>();
-    VBlankStartEvent = std::bind(&System::VBlankStart, this);
-    VBlankFinishEvent = std::bind(&System::VBlankFinish, this);
+    scheduler.RegisterEvent(EventType::VBlankStart, [](void* system, u64) {
+        reinterpret_cast<System*>(system)->VBlankStart();
+    });
+
+    scheduler.RegisterEvent(EventType::VBlankFinish, [](void* system, u64) {
+        reinterpret_cast<System*>(system)->VBlankFinish();
+    });
 }
 
 // credit goes to pcsx2
@@ -19,11 +28,14 @@ System::System() : ee(*this), iop(*this), gs(*this), gif(gs), elf_loader(*this)
 #define BUS_CLOCK_SPEED EE_CLOCK_SPEED / 2
 #define IOP_CLOCK_SPEED EE_CLOCK_SPEED / 8
 
+// the most ee cycles which are skipped at once while both cpus are idle
+#define MAX_IDLE_CYCLES 2048
+
 void System::Reset() {
     scheduler.Reset();
     ee.Reset();
     iop.Reset();
-    gs.Reset();
+    gs_thread.Reset();
     gif.Reset();
     vu0.Reset();
     vu1.Reset();
@@ -33,9 +45,11 @@ void System::Reset() {
     sif.Reset();
     spu.Reset();
     spu2.Reset();
+    bus_clock.Reset();
+    iop_clock.Reset();
 
     iop_ram->fill(0);
-    bios->fill(0);
+    std::memset(bios->data(), 0, bios->size());
     LoadBIOS();
 
     fastboot_done = false;
@@ -43,18 +57,28 @@ void System::Reset() {
 
 void System::RunFrame() {
     u64 end_timestamp = scheduler.GetCurrentTime() + CYCLES_PER_FRAME;
-    int cycles = 32;
-    scheduler.Add(VBLANK_START_CYCLES, VBlankStartEvent);
-    scheduler.Add(CYCLES_PER_FRAME, VBlankFinishEvent);
+    scheduler.Add(VBLANK_START_CYCLES, EventType::VBlankStart, this);
+    scheduler.Add(CYCLES_PER_FRAME, EventType::VBlankFinish, this);
 
     while (scheduler.GetCurrentTime() < end_timestamp) {
+        // run up to the next event, but keep the components within a quantum of each other.
+        // when both cpus are spinning in idle loops nothing happens until the next event, so allow
+        // a longer slice. that is still capped since the dmac isn't driven by events
+        u64 quantum = sync_quantum;
+        if (ee.IsIdle() && iop.IsIdle()) {
+            quantum = std::max<u64>(quantum, MAX_IDLE_CYCLES);
+        }
+
+        u64 cycles_until_event = scheduler.GetEventTime() - scheduler.GetCurrentTime();
+        int cycles = std::clamp<u64>(cycles_until_event, 1, quantum);
+
         ee.Run(cycles);
 
         // these components run at bus speed (1 / 2 speed of ee)
-        gif.Run(cycles / 2);
+        gif.Run(bus_clock.Advance(cycles));
 
         // iop runs at 1 / 8 speed of the ee
-        iop.Run(cycles / 8);
+        iop.Run(iop_clock.Advance(cycles));
         
         scheduler.Tick(cycles);
         scheduler.RunEvents();
@@ -67,7 +91,7 @@ void System::SingleStep() {
 }
 
 void System::VBlankStart() {
-    gs.RenderCRTC();
+    gs_thread.RenderCRTC();
     ee.intc.RequestInterrupt(ee::InterruptSource::VBlankStart);
     iop.intc.RequestInterrupt(iop::InterruptSource::VBlankStart);
 }
@@ -83,6 +107,32 @@ void System::SetBootParameters(BootMode boot_mode, std::string path = "") {
     }
     
     this->boot_mode = boot_mode;
+    idle_loop_detection = !HasIdleLoopOverride(path);
+}
+
+bool System::HasIdleLoopOverride(std::string path) {
+    if (path.empty()) {
+        return false;
+    }
+
+    // each line of the overrides file is the file name of a title which
+    // shouldn't have its idle loops skipped. like the bios, it's found from the build directory
+    std::ifstream file("../idle_loop_overrides.txt");
+    std::string name = std::filesystem::path(path).filename();
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        if (line == name) {
+            common::Info("[System] idle loop detection is disabled for %s", name.c_str());
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void System::LoadBIOS() {
@@ -93,7 +143,7 @@ void System::LoadBIOS() {
     }
 
     file.unsetf(std::ios::skipws);
-    file.read(reinterpret_cast<char*>(bios.get()), 0x400000);
+    file.read(reinterpret_cast<char*>(bios->data()), 0x400000);
     file.close();
 
     common::Info("[System] bios was successfully loaded!");
@@ -3,10 +3,13 @@
 #include <array>
 #include <memory>
 #include "common/log.h"
+#include "common/fastmem.h"
+#include "common/clock_divider.h"
 #include "core/ee/context.h"
 #include "core/scheduler.h"
 #include "core/gif.h"
 #include "core/gs/context.h"
+#include "core/gs/thread.h"
 #include "core/vu/vu.h"
 #include "core/vif/vif.h"
 #include "core/ipu/ipu.h"
@@ -30,12 +33,14 @@ struct System {
     void VBlankFinish();
     void SetBootParameters(BootMode boot_mode, std::string path);
     void LoadBIOS();
+    bool HasIdleLoopOverride(std::string path);
 
     Scheduler scheduler;
 
     ee::Context ee;
     iop::Context iop;
     gs::Context gs;
+    gs::Thread gs_thread;
 
     GIF gif;
     VU vu0;
@@ -51,12 +56,18 @@ struct System {
     SPU spu2;
 
     // shared between ee and iop
-    std::unique_ptr<std::array<u8, 0x400000>> bios;
+    std::unique_ptr<common::SharedMemory> bios;
     std::unique_ptr<std::array<u8, 0x200000>> iop_ram;
 
-    std::function<void()> VBlankStartEvent;
-    std::function<void()> VBlankFinishEvent;
-
     BootMode boot_mode;
     bool fastboot_done;
+
+    // disabled for titles listed in the idle loop overrides file
+    bool idle_loop_detection = true;
+
+    // the most ee cycles which run before the other components catch up
+    int sync_quantum = 32;
+
+    common::ClockDivider bus_clock;
+    common::ClockDivider iop_clock;
 };
\ No newline at end of file
@@ -7,6 +7,31 @@ void VIF::Reset() {
     err = 0;
 }
 
+void VIF::RegisterIO(common::IOMap& io, int id) {
+    // only the registers which have been seen being written so far are mapped
+    if (id == 0) {
+        io.MapWrite(0x10003810, this, [](VIF* vif, u32, u32 value) {
+            vif->WriteFBRST(value);
+        });
+
+        io.MapWrite(0x10003820, this, [](VIF* vif, u32, u32 value) {
+            vif->WriteERR(value);
+        });
+
+        io.MapWrite(0x10003830, this, [](VIF* vif, u32, u32 value) {
+            vif->WriteMark(value);
+        });
+    } else {
+        io.MapWrite(0x10003c00, this, [](VIF* vif, u32, u32 value) {
+            vif->WriteStat(value);
+        });
+
+        io.MapWrite(0x10003c10, this, [](VIF* vif, u32, u32 value) {
+            vif->WriteFBRST(value);
+        });
+    }
+}
+
 void VIF::SystemReset() {
     common::Log("[VIF] system reset");
 }
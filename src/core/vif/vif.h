@@ -1,11 +1,13 @@
 #pragma once
 
 #include <common/types.h>
+#include <common/io_map.h>
 #include <common/log.h>
 
 class VIF {
 public:
     void Reset();
+    void RegisterIO(common::IOMap& io, int id);
     void SystemReset();
 
     void WriteStat(u32 data);
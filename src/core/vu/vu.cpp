@@ -3,4 +3,14 @@
 void VU::Reset() {
     data_memory.fill(0);
     code_memory.fill(0);
+}
+
+void VU::RegisterIO(common::IOMap& io, u32 code_base, u32 data_base, u32 size) {
+    io.MapWrite(code_base, code_base + size, this, [](VU* vu, u32 paddr, u32 value) {
+        vu->WriteCodeMemory(paddr, value);
+    });
+
+    io.MapWrite(data_base, data_base + size, this, [](VU* vu, u32 paddr, u32 value) {
+        vu->WriteDataMemory(paddr, value);
+    });
 }
\ No newline at end of file
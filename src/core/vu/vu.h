@@ -2,11 +2,13 @@
 
 #include <array>
 #include "common/types.h"
+#include "common/io_map.h"
 #include "common/log.h"
 
 class VU {
 public:
     void Reset();
+    void RegisterIO(common::IOMap& io, u32 code_base, u32 data_base, u32 size);
 
     template <typename T>
     void WriteDataMemory(u32 addr, T data) {
@@ -18,6 +20,9 @@ public:
         *(T*)&code_memory[addr & 0x3FFF] = data;
     }
 
+    u8* GetDataMemory() { return data_memory.data(); }
+    u8* GetCodeMemory() { return code_memory.data(); }
+
 private:
     std::array<u8, 0x4000> data_memory;
     std::array<u8, 0x4000> code_memory;
@@ -2,6 +2,7 @@
 #include "core/core.h"
 #include "core/ee/context.h"
 #include "core/ee/disassembler.h"
+#include "core/gs/context.h"
 #include "core/iop/context.h"
 #include "core/iop/disassembler.h"
 
@@ -20,6 +21,11 @@ void HostInterface::render_debugger_window() {
             ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("GS")) {
+            render_gs_debugger();
+            ImGui::EndTabItem();
+        }
+
         if (ImGui::BeginTabItem("Library")) {
             render_library_window();
             ImGui::EndTabItem();
@@ -81,6 +87,8 @@ void HostInterface::render_ee_debugger() {
     ImGui::SameLine(90);
     ImGui::Text("%016llx", ee.sa);
 
+    ImGui::Text("idle cycles skipped: %llu", ee.GetIdleCycles());
+
     ImGui::Separator();
 
     u32 pc = ee.pc;
@@ -104,6 +112,15 @@ void HostInterface::render_ee_debugger() {
     }
 }
 
+void HostInterface::render_gs_debugger() {
+    gs::Context& gs = core.system.gs;
+    gs::TextureCache::Stats stats = gs.GetTextureCacheStats();
+
+    ImGui::Text("texture cache hits: %llu", stats.hits);
+    ImGui::Text("texture cache misses: %llu", stats.misses);
+    ImGui::Text("texture cache invalidations: %llu", stats.invalidations);
+}
+
 void HostInterface::render_iop_debugger() {
     iop::Context& iop = core.system.iop;
 
@@ -127,6 +144,7 @@ void HostInterface::render_iop_debugger() {
     ImGui::Text("cause: %08x", iop.cop0.cause.data);
     ImGui::Text("epc: %08x", iop.cop0.epc);
     ImGui::Text("prid: %08x", iop.cop0.prid);
+    ImGui::Text("idle cycles skipped: %llu", iop.GetIdleCycles());
 
     ImGui::Separator();
 
@@ -164,6 +164,50 @@ void HostInterface::RenderMenubar() {
                 }
             }
 
+            if (ImGui::BeginMenu("EE Executor")) {
+                ee::ExecutorType executor_type = core.system.ee.GetExecutorType();
+
+                if (ImGui::MenuItem("Interpreter", nullptr, executor_type == ee::ExecutorType::Interpreter)) {
+                    core.SetExecutorType(ee::ExecutorType::Interpreter);
+                }
+
+                if (ImGui::MenuItem("Cached Interpreter", nullptr, executor_type == ee::ExecutorType::CachedInterpreter)) {
+                    core.SetExecutorType(ee::ExecutorType::CachedInterpreter);
+                }
+
+                if (ImGui::MenuItem("JIT", nullptr, executor_type == ee::ExecutorType::JIT)) {
+                    core.SetExecutorType(ee::ExecutorType::JIT);
+                }
+
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Sync Quantum")) {
+                for (int cycles : {32, 128, 512, 2048}) {
+                    std::string label = common::Format("%d cycles", cycles);
+                    if (ImGui::MenuItem(label.c_str(), nullptr, core.system.sync_quantum == cycles)) {
+                        core.SetSyncQuantum(cycles);
+                    }
+                }
+
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::BeginMenu("Renderer Threads")) {
+                for (int threads : {1, 2, 4, 8}) {
+                    std::string label = common::Format("%d", threads);
+                    if (ImGui::MenuItem(label.c_str(), nullptr, core.system.gs.GetRendererThreads() == threads)) {
+                        core.SetRendererThreads(threads);
+                    }
+                }
+
+                ImGui::EndMenu();
+            }
+
+            if (ImGui::MenuItem("GS Thread", nullptr, core.system.gs_thread.IsEnabled())) {
+                core.SetGSThread(!core.system.gs_thread.IsEnabled());
+            }
+
             ImGui::EndMenu();
         }
 
@@ -37,6 +37,7 @@ private:
     void render_debugger_window();
     void render_ee_debugger();
     void render_iop_debugger();
+    void render_gs_debugger();
 
     const char* glsl_version = "#version 330";
 
@@ -0,0 +1,327 @@
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "core/system.h"
+
+// runs the same randomly generated programs on every ee executor, and checks that they
+// all finish in exactly the same state. the programs mix alu, mmi, load, store and branch
+// instructions, with loops so that blocks get reused, and accesses to sif registers so that
+// the jit's fastmem accesses fault and fall back to the slow path
+static constexpr u32 PROGRAM_BASE = 0x80010000;
+static constexpr u32 DATA_BASE = 0x80020000;
+static constexpr u32 DATA_SIZE = 0x400;
+
+// the sif registers through kseg1, which have no fastmem mapping
+static constexpr u32 MMIO_BASE = 0xb000f200;
+
+static constexpr int DATA_REG = 20;
+static constexpr int MMIO_REG = 21;
+static constexpr int COUNTER_REG = 22;
+static constexpr int PROGRAMS = 64;
+static constexpr int MAX_CYCLES = 1000000;
+
+static u32 RType(u32 opcode, u32 rs, u32 rt, u32 rd, u32 sa, u32 func) {
+    return (opcode << 26) | (rs << 21) | (rt << 16) | (rd << 11) | (sa << 6) | func;
+}
+
+static u32 IType(u32 opcode, u32 rs, u32 rt, u32 imm) {
+    return (opcode << 26) | (rs << 21) | (rt << 16) | (imm & 0xffff);
+}
+
+struct Program {
+    std::vector<u32> code;
+    std::array<u128, 16> registers;
+    u32 halt;
+};
+
+struct State {
+    std::array<u128, 32> gpr;
+    u64 hi;
+    u64 lo;
+    u64 hi1;
+    u64 lo1;
+    std::array<u32, DATA_SIZE / 4> data;
+    u32 mscom;
+    u32 msflag;
+    bool halted;
+};
+
+class Generator {
+public:
+    Generator(u64 seed) : rng(seed) {}
+
+    Program Generate() {
+        Program program;
+        code.clear();
+
+        for (auto& reg : program.registers) {
+            reg.lo = rng();
+            reg.hi = rng();
+        }
+
+        int blocks = Random(4, 8);
+        std::vector<int> calls;
+
+        for (int block = 0; block < blocks; block++) {
+            // each block runs a few times, so that the executors which cache blocks reuse them
+            code.push_back(IType(0x09, 0, COUNTER_REG, Random(2, 5)));
+            int loop = code.size();
+
+            for (int i = Random(3, 20); i > 0; i--) {
+                EmitALU();
+            }
+
+            EmitMemory();
+
+            if (Random(0, 1)) {
+                EmitMMIO();
+            }
+
+            EmitForwardBranch();
+
+            if (Random(0, 3) == 0) {
+                // jal to the subroutine, which gets filled in once its address is known
+                calls.push_back(code.size());
+                code.push_back(0);
+                code.push_back(0);
+            }
+
+            code.push_back(IType(0x09, COUNTER_REG, COUNTER_REG, -1));
+            code.push_back(IType(0x05, COUNTER_REG, 0, loop - static_cast<int>(code.size()) - 1));
+            code.push_back(IType(0x09, 25, 25, 3));
+        }
+
+        // spin on a branch to itself once finished
+        program.halt = PROGRAM_BASE + code.size() * 4;
+        code.push_back(IType(0x04, 0, 0, -1));
+        code.push_back(0);
+
+        u32 subroutine = PROGRAM_BASE + code.size() * 4;
+        for (int i = Random(2, 8); i > 0; i--) {
+            EmitALU();
+        }
+
+        code.push_back(RType(0x00, 31, 0, 0, 0, 0x08));
+        code.push_back(IType(0x09, 26, 26, 1));
+
+        for (int call : calls) {
+            code[call] = (0x03 << 26) | ((subroutine >> 2) & 0x3ffffff);
+        }
+
+        program.code = code;
+        return program;
+    }
+
+private:
+    int Random(int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(rng);
+    }
+
+    template <typename T, size_t N>
+    T Pick(const T (&values)[N]) {
+        return values[Random(0, N - 1)];
+    }
+
+    int RandomReg() {
+        return Random(1, 15);
+    }
+
+    void EmitALU() {
+        // addu, subu, daddu, dsubu, and, or, xor, nor, slt, sltu, movz and movn
+        static const u32 alu[] = {0x21, 0x23, 0x2d, 0x2f, 0x24, 0x25, 0x26, 0x27, 0x2a, 0x2b, 0x0a, 0x0b};
+
+        // sll, srl, sra, dsll, dsrl, dsra, dsll32, dsrl32 and dsra32
+        static const u32 shift[] = {0x00, 0x02, 0x03, 0x38, 0x3a, 0x3b, 0x3c, 0x3e, 0x3f};
+
+        // sllv, srlv, srav, dsllv, dsrlv and dsrav
+        static const u32 variable_shift[] = {0x04, 0x06, 0x07, 0x14, 0x16, 0x17};
+
+        // addiu, daddiu, andi, ori, xori, slti and sltiu
+        static const u32 immediate[] = {0x09, 0x19, 0x0c, 0x0d, 0x0e, 0x0a, 0x0b};
+
+        static const u32 mmi0[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 16, 17, 20, 21, 24, 25};
+        static const u32 mmi1[] = {1, 2, 3, 4, 5, 6, 7, 10, 16, 17, 20, 21, 24, 25};
+        static const u32 mmi2[] = {14, 18, 19};
+        static const u32 mmi3[] = {14, 18, 19, 27};
+
+        int rd = RandomReg();
+        int rs = RandomReg();
+        int rt = RandomReg();
+
+        switch (Random(0, 9)) {
+        case 0: case 1: case 2:
+            code.push_back(RType(0x00, rs, rt, rd, 0, Pick(alu)));
+            break;
+        case 3:
+            code.push_back(RType(0x00, 0, rt, rd, Random(0, 31), Pick(shift)));
+            break;
+        case 4:
+            code.push_back(RType(0x00, rs, rt, rd, 0, Pick(variable_shift)));
+            break;
+        case 5:
+            code.push_back(Random(0, 3) ? IType(Pick(immediate), rs, rt, rng()) : IType(0x0f, 0, rt, rng()));
+            break;
+        case 6:
+            // mult or multu, then mfhi or mflo
+            code.push_back(RType(0x00, rs, rt, 0, 0, Random(0x18, 0x19)));
+            code.push_back(RType(0x00, 0, 0, rd, 0, Random(0, 1) ? 0x10 : 0x12));
+            break;
+        case 7:
+            code.push_back(RType(0x1c, rs, rt, rd, Pick(mmi0), 0x08));
+            break;
+        case 8:
+            code.push_back(RType(0x1c, rs, rt, rd, Pick(mmi1), 0x28));
+            break;
+        case 9:
+            code.push_back(Random(0, 1) ? RType(0x1c, rs, rt, rd, Pick(mmi2), 0x09) : RType(0x1c, rs, rt, rd, Pick(mmi3), 0x29));
+            break;
+        }
+    }
+
+    void EmitMemory() {
+        struct Access {
+            u32 opcode;
+            u32 size;
+        };
+
+        // sb, sh, sw, sd, sq, lb, lbu, lh, lhu, lw, lwu, ld and lq
+        static const Access accesses[] = {
+            {0x28, 1}, {0x29, 2}, {0x2b, 4}, {0x3f, 8}, {0x1f, 16},
+            {0x20, 1}, {0x24, 1}, {0x21, 2}, {0x25, 2}, {0x23, 4}, {0x27, 4}, {0x37, 8}, {0x1e, 16},
+        };
+
+        for (int i = Random(2, 6); i > 0; i--) {
+            Access access = Pick(accesses);
+            u32 offset = Random(0, DATA_SIZE / access.size - 1) * access.size;
+            code.push_back(IType(access.opcode, DATA_REG, RandomReg(), offset));
+        }
+    }
+
+    void EmitMMIO() {
+        // mscom, smcom and msflag, which read back what was written without side effects
+        static const u32 stores[] = {0x00, 0x20};
+        static const u32 loads[] = {0x00, 0x10, 0x20};
+
+        code.push_back(IType(0x2b, MMIO_REG, RandomReg(), Pick(stores)));
+        code.push_back(IType(Random(0, 1) ? 0x23 : 0x27, MMIO_REG, RandomReg(), Pick(loads)));
+    }
+
+    void EmitForwardBranch() {
+        // beq, bne, beql and bnel, which skip the instruction after the delay slot when taken
+        static const u32 branches[] = {0x04, 0x05, 0x14, 0x15};
+
+        code.push_back(IType(Pick(branches), RandomReg(), RandomReg(), 1));
+        code.push_back(IType(0x09, 23, 23, 1));
+        code.push_back(IType(0x09, 24, 24, 1));
+    }
+
+    std::mt19937_64 rng;
+    std::vector<u32> code;
+};
+
+static bool Halted(const Program& program, ee::Context& ctx) {
+    return ctx.pc == program.halt || ctx.pc == program.halt + 4;
+}
+
+static State Run(const Program& program, ee::ExecutorType type) {
+    auto system = std::make_unique<System>();
+    ee::Context& ctx = system->ee;
+
+    system->scheduler.Reset();
+    ctx.Reset();
+    system->gs_thread.Reset();
+    system->gif.Reset();
+    system->sif.Reset();
+    ctx.SetExecutorType(type);
+
+    for (u32 i = 0; i < program.code.size(); i++) {
+        ctx.write<u32>(PROGRAM_BASE + i * 4, program.code[i]);
+    }
+
+    for (int reg = 1; reg < 16; reg++) {
+        ctx.SetReg<u128>(reg, program.registers[reg]);
+    }
+
+    ctx.SetReg<u64>(DATA_REG, static_cast<s32>(DATA_BASE));
+    ctx.SetReg<u64>(MMIO_REG, static_cast<s32>(MMIO_BASE));
+    ctx.pc = PROGRAM_BASE;
+
+    // the halting loop may be left part way through, so the pc isn't compared
+    for (int cycles = 0; cycles < MAX_CYCLES && !Halted(program, ctx); cycles += 64) {
+        ctx.Run(64);
+    }
+
+    State state;
+    for (int reg = 0; reg < 32; reg++) {
+        state.gpr[reg] = ctx.GetReg<u128>(reg);
+    }
+
+    state.hi = ctx.hi;
+    state.lo = ctx.lo;
+    state.hi1 = ctx.hi1;
+    state.lo1 = ctx.lo1;
+
+    for (u32 i = 0; i < state.data.size(); i++) {
+        state.data[i] = ctx.read<u32>(DATA_BASE + i * 4);
+    }
+
+    state.mscom = system->sif.ReadMSCOM();
+    state.msflag = system->sif.ReadMSFLAG();
+    state.halted = Halted(program, ctx);
+    return state;
+}
+
+static int Compare(const char* name, const State& expected, const State& result) {
+    int mismatches = 0;
+    auto report = [&](const char* what, int index, u64 expected_value, u64 result_value) {
+        if (expected_value != result_value && mismatches++ < 4) {
+            printf("    %s: %s[%d] expected %016llx got %016llx\n", name, what, index,
+                static_cast<unsigned long long>(expected_value), static_cast<unsigned long long>(result_value));
+        }
+    };
+
+    for (int reg = 0; reg < 32; reg++) {
+        report("gpr lo", reg, expected.gpr[reg].lo, result.gpr[reg].lo);
+        report("gpr hi", reg, expected.gpr[reg].hi, result.gpr[reg].hi);
+    }
+
+    report("hi", 0, expected.hi, result.hi);
+    report("lo", 0, expected.lo, result.lo);
+    report("hi1", 0, expected.hi1, result.hi1);
+    report("lo1", 0, expected.lo1, result.lo1);
+
+    for (u32 i = 0; i < expected.data.size(); i++) {
+        report("data", i, expected.data[i], result.data[i]);
+    }
+
+    report("mscom", 0, expected.mscom, result.mscom);
+    report("msflag", 0, expected.msflag, result.msflag);
+    report("halted", 0, expected.halted, result.halted);
+    return mismatches;
+}
+
+int main() {
+    Generator generator(0x65786563);
+    int failures = 0;
+
+    for (int n = 0; n < PROGRAMS; n++) {
+        Program program = generator.Generate();
+        State expected = Run(program, ee::ExecutorType::Interpreter);
+
+        if (!expected.halted) {
+            printf("program %d: interpreter didn't finish\n", n);
+            failures++;
+            continue;
+        }
+
+        int mismatches = Compare("cached interpreter", expected, Run(program, ee::ExecutorType::CachedInterpreter));
+        mismatches += Compare("jit", expected, Run(program, ee::ExecutorType::JIT));
+
+        printf("program %-3d %s\n", n, mismatches ? "failed" : "passed");
+        failures += mismatches;
+    }
+
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,493 @@
+#include <array>
+#include <cstdio>
+#include <random>
+#include "core/system.h"
+
+// the lane by lane handlers which the vectorised mmi handlers replaced. every rewritten
+// handler has to give exactly the same result as these
+namespace reference {
+
+void pcpyld(ee::Context& ctx, ee::Instruction inst) {
+    u64 lower = ctx.GetReg<u64>(inst.rt);
+    u64 upper = ctx.GetReg<u64>(inst.rs);
+    ctx.SetReg<u64>(inst.rd, lower);
+    ctx.SetReg<u64>(inst.rd, upper, 1);
+}
+
+void pnor(ee::Context& ctx, ee::Instruction inst) {
+    ctx.SetReg<u128>(inst.rd, ~(ctx.GetReg<u128>(inst.rs) | ctx.GetReg<u128>(inst.rt)));
+}
+
+void pand(ee::Context& ctx, ee::Instruction inst) {
+    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) & ctx.GetReg<u128>(inst.rt));
+}
+
+void pxor(ee::Context& ctx, ee::Instruction inst) {
+    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) ^ ctx.GetReg<u128>(inst.rt));
+}
+
+void por(ee::Context& ctx, ee::Instruction inst) {
+    ctx.SetReg<u128>(inst.rd, ctx.GetReg<u128>(inst.rs) | ctx.GetReg<u128>(inst.rt));
+}
+
+void pcpyud(ee::Context& ctx, ee::Instruction inst) {
+    ctx.SetReg<u64>(inst.rd, ctx.GetReg<u64>(inst.rs, 1));
+    ctx.SetReg<u64>(inst.rd, ctx.GetReg<u64>(inst.rt, 1), 1);
+}
+
+void pcpyh(ee::Context& ctx, ee::Instruction inst) {
+    u16 lower = ctx.GetReg<u16>(inst.rt);
+    u16 upper = ctx.GetReg<u16>(inst.rt, 4);
+    for (int i = 0; i < 4; i++) {
+        ctx.SetReg<u16>(inst.rd, lower, i);
+        ctx.SetReg<u16>(inst.rd, upper, 4 + i);
+    }
+}
+
+void pabsh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        s16 signed_data = ctx.GetReg<s16>(inst.rt, i);
+        u16 data = ctx.GetReg<u16>(inst.rt, i);
+        if (data == 0x8000) {
+            ctx.SetReg<u16>(inst.rd, 0x7fff, i);
+        } else if (signed_data < 0) {
+            ctx.SetReg<u16>(inst.rd, -signed_data, i);
+        } else {
+            ctx.SetReg<u16>(inst.rd, data, i);
+        }
+    }
+}
+
+void pabsw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        s32 signed_data = ctx.GetReg<s32>(inst.rt, i);
+        u32 data = ctx.GetReg<u32>(inst.rt, i);
+        if (data == 0x80000000) {
+            ctx.SetReg<u32>(inst.rd, 0x7fffffff, i);
+        } else if (signed_data < 0) {
+            ctx.SetReg<u32>(inst.rd, -signed_data, i);
+        } else {
+            ctx.SetReg<u32>(inst.rd, data, i);
+        }
+    }
+}
+
+void paddb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        ctx.SetReg<s8>(inst.rd, ctx.GetReg<s8>(inst.rs, i) + ctx.GetReg<s8>(inst.rt, i), i);
+    }
+}
+
+void paddh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) + ctx.GetReg<s16>(inst.rt, i), i);
+    }
+}
+
+void paddsb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        s16 result = static_cast<s16>(ctx.GetReg<s8>(inst.rs, i)) + static_cast<s16>(ctx.GetReg<s8>(inst.rt, i));
+        if (result > 0x7f) {
+            result = 0x7f;
+        } else if (result < -0x80) {
+            result = -0x80;
+        }
+        ctx.SetReg<s8>(inst.rd, result & 0xff, i);
+    }
+}
+
+void paddsh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        s32 result = static_cast<s32>(ctx.GetReg<s16>(inst.rs, i)) + static_cast<s32>(ctx.GetReg<s16>(inst.rt, i));
+        if (result > 0x7fff) {
+            result = 0x7fff;
+        } else if (result < -0x8000) {
+            result = -0x8000;
+        }
+        ctx.SetReg<s16>(inst.rd, result & 0xffff, i);
+    }
+}
+
+void paddsw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        s64 result = static_cast<s64>(ctx.GetReg<s32>(inst.rs, i)) + static_cast<s64>(ctx.GetReg<s32>(inst.rt, i));
+        if (result > 0x7fffffff) {
+            result = 0x7fffffff;
+        } else if (result < static_cast<s32>(0x80000000)) {
+            result = static_cast<s32>(0x80000000);
+        }
+        ctx.SetReg<s32>(inst.rd, static_cast<s32>(result), i);
+    }
+}
+
+void paddub(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        u16 result = static_cast<u16>(ctx.GetReg<u8>(inst.rs, i)) + static_cast<u16>(ctx.GetReg<u8>(inst.rt, i));
+        if (result > 0xff) {
+            result = 0xff;
+        }
+        ctx.SetReg<u8>(inst.rd, result & 0xff, i);
+    }
+}
+
+void padduh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        u32 result = static_cast<u32>(ctx.GetReg<u16>(inst.rs, i)) + static_cast<u32>(ctx.GetReg<u16>(inst.rt, i));
+        if (result > 0xffff) {
+            result = 0xffff;
+        }
+        ctx.SetReg<u16>(inst.rd, result & 0xffff, i);
+    }
+}
+
+void padduw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        u64 result = static_cast<u64>(ctx.GetReg<u32>(inst.rs, i)) + static_cast<u64>(ctx.GetReg<u32>(inst.rt, i));
+        if (result > 0xffffffff) {
+            result = 0xffffffff;
+        }
+        ctx.SetReg<u32>(inst.rd, result & 0xffffffff, i);
+    }
+}
+
+void paddw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i) + ctx.GetReg<s32>(inst.rt, i), i);
+    }
+}
+
+void padsbh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) - ctx.GetReg<s16>(inst.rt, i), i);
+        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i + 4) + ctx.GetReg<s16>(inst.rt, i + 4), i + 4);
+    }
+}
+
+void pmaxh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
+            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i), i);
+        } else {
+            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rt, i), i);
+        }
+    }
+}
+
+void pmaxw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
+            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i), i);
+        } else {
+            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rt, i), i);
+        }
+    }
+}
+
+void pminh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
+            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rt, i), i);
+        } else {
+            ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i), i);
+        }
+    }
+}
+
+void pminw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
+            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rt, i), i);
+        } else {
+            ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i), i);
+        }
+    }
+}
+
+void psubb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        ctx.SetReg<s8>(inst.rd, ctx.GetReg<s8>(inst.rs, i) - ctx.GetReg<s8>(inst.rt, i), i);
+    }
+}
+
+void psubh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        ctx.SetReg<s16>(inst.rd, ctx.GetReg<s16>(inst.rs, i) - ctx.GetReg<s16>(inst.rt, i), i);
+    }
+}
+
+void psubsb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        s16 result = static_cast<s16>(ctx.GetReg<s8>(inst.rs, i)) - static_cast<s16>(ctx.GetReg<s8>(inst.rt, i));
+        if (result > 0x7f) {
+            result = 0x7f;
+        } else if (result < -0x80) {
+            result = -0x80;
+        }
+        ctx.SetReg<s8>(inst.rd, result & 0xff, i);
+    }
+}
+
+void psubsh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        s32 result = static_cast<s32>(ctx.GetReg<s16>(inst.rs, i)) - static_cast<s32>(ctx.GetReg<s16>(inst.rt, i));
+        if (result > 0x7fff) {
+            result = 0x7fff;
+        } else if (result < -0x8000) {
+            result = -0x8000;
+        }
+        ctx.SetReg<s16>(inst.rd, result & 0xffff, i);
+    }
+}
+
+void psubsw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        s64 result = static_cast<s64>(ctx.GetReg<s32>(inst.rs, i)) - static_cast<s64>(ctx.GetReg<s32>(inst.rt, i));
+        if (result > 0x7fffffff) {
+            result = 0x7fffffff;
+        } else if (result < static_cast<s32>(0x80000000)) {
+            result = static_cast<s32>(0x80000000);
+        }
+        ctx.SetReg<s32>(inst.rd, static_cast<s32>(result), i);
+    }
+}
+
+void psubub(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        u16 result = static_cast<u16>(ctx.GetReg<u8>(inst.rs, i)) - static_cast<u16>(ctx.GetReg<u8>(inst.rt, i));
+        if (result > 0xff) {
+            result = 0;
+        }
+        ctx.SetReg<u8>(inst.rd, result & 0xff, i);
+    }
+}
+
+void psubuh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        u32 result = static_cast<u32>(ctx.GetReg<u16>(inst.rs, i)) - static_cast<u32>(ctx.GetReg<u16>(inst.rt, i));
+        if (result > 0xffff) {
+            result = 0;
+        }
+        ctx.SetReg<u16>(inst.rd, result & 0xffff, i);
+    }
+}
+
+void psubuw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        u64 result = static_cast<u64>(ctx.GetReg<u32>(inst.rs, i)) - static_cast<u64>(ctx.GetReg<u32>(inst.rt, i));
+        if (result > 0xffffffff) {
+            result = 0;
+        }
+        ctx.SetReg<u32>(inst.rd, result & 0xffffffff, i);
+    }
+}
+
+void psubw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        ctx.SetReg<s32>(inst.rd, ctx.GetReg<s32>(inst.rs, i) - ctx.GetReg<s32>(inst.rt, i), i);
+    }
+}
+
+void pceqb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        if (ctx.GetReg<u8>(inst.rs, i) == ctx.GetReg<u8>(inst.rt, i)) {
+            ctx.SetReg<u8>(inst.rd, 0xff, i);
+        } else {
+            ctx.SetReg<u8>(inst.rd, 0, i);
+        }
+    }
+}
+
+void pceqh(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        if (ctx.GetReg<u16>(inst.rs, i) == ctx.GetReg<u16>(inst.rt, i)) {
+            ctx.SetReg<u16>(inst.rd, 0xffff, i);
+        } else {
+            ctx.SetReg<u16>(inst.rd, 0, i);
+        }
+    }
+}
+
+void pceqw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        if (ctx.GetReg<u32>(inst.rs, i) == ctx.GetReg<u32>(inst.rt, i)) {
+            ctx.SetReg<u32>(inst.rd, 0xffffffff, i);
+        } else {
+            ctx.SetReg<u32>(inst.rd, 0, i);
+        }
+    }
+}
+
+void pcgtb(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 16; i++) {
+        if (ctx.GetReg<s8>(inst.rs, i) > ctx.GetReg<s8>(inst.rt, i)) {
+            ctx.SetReg<u8>(inst.rd, 0xff, i);
+        } else {
+            ctx.SetReg<u8>(inst.rd, 0, i);
+        }
+    }
+}
+
+void pcgth(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 8; i++) {
+        if (ctx.GetReg<s16>(inst.rs, i) > ctx.GetReg<s16>(inst.rt, i)) {
+            ctx.SetReg<u16>(inst.rd, 0xffff, i);
+        } else {
+            ctx.SetReg<u16>(inst.rd, 0, i);
+        }
+    }
+}
+
+void pcgtw(ee::Context& ctx, ee::Instruction inst) {
+    for (int i = 0; i < 4; i++) {
+        if (ctx.GetReg<s32>(inst.rs, i) > ctx.GetReg<s32>(inst.rt, i)) {
+            ctx.SetReg<u32>(inst.rd, 0xffffffff, i);
+        } else {
+            ctx.SetReg<u32>(inst.rd, 0, i);
+        }
+    }
+}
+
+} // namespace reference
+
+// lets the test pick the instruction which is executed
+struct TestInterpreter : ee::Interpreter {
+    using ee::Interpreter::Interpreter;
+
+    void SetInstruction(ee::Instruction instruction) {
+        inst = instruction;
+    }
+};
+
+struct Op {
+    const char* name;
+    void (ee::Interpreter::*handler)();
+    void (*reference)(ee::Context& ctx, ee::Instruction inst);
+};
+
+#define OP(name) {#name, &ee::Interpreter::name, reference::name}
+
+static const Op ops[] = {
+    OP(pcpyld),
+    OP(pnor),
+    OP(pand),
+    OP(pxor),
+    OP(por),
+    OP(pcpyud),
+    OP(pcpyh),
+    OP(pabsh),
+    OP(pabsw),
+    OP(paddb),
+    OP(paddh),
+    OP(paddsb),
+    OP(paddsh),
+    OP(paddsw),
+    OP(paddub),
+    OP(padduh),
+    OP(padduw),
+    OP(paddw),
+    OP(padsbh),
+    OP(pmaxh),
+    OP(pmaxw),
+    OP(pminh),
+    OP(pminw),
+    OP(psubb),
+    OP(psubh),
+    OP(psubsb),
+    OP(psubsh),
+    OP(psubsw),
+    OP(psubub),
+    OP(psubuh),
+    OP(psubuw),
+    OP(psubw),
+    OP(pceqb),
+    OP(pceqh),
+    OP(pceqw),
+    OP(pcgtb),
+    OP(pcgth),
+    OP(pcgtw),
+};
+
+// lanes on either side of each saturation limit, along with the values that have no positive counterpart
+static const u32 edges[] = {
+    0x00000000, 0x00000001, 0x0000007f, 0x00000080, 0x000000ff, 0x00007fff, 0x00008000, 0x0000ffff,
+    0x7fffffff, 0x80000000, 0xffffffff, 0x80808080, 0x7f7f7f7f, 0x80008000, 0x7fff7fff, 0xfffefffe,
+    0x81818181, 0x7ffe7ffe, 0x80000001, 0x7ffffffe, 0xff80ff80, 0x807f807f, 0x01010101, 0xfefefefe,
+};
+
+static constexpr int REGISTERS = 4;
+static constexpr int ITERATIONS = 20000;
+
+using Registers = std::array<std::array<u32, 4>, REGISTERS>;
+
+static Registers GetRegisters(ee::Context& ctx) {
+    Registers registers;
+    for (int reg = 0; reg < REGISTERS; reg++) {
+        for (int i = 0; i < 4; i++) {
+            registers[reg][i] = ctx.GetReg<u32>(reg, i);
+        }
+    }
+
+    return registers;
+}
+
+static void SetRegisters(ee::Context& ctx, const Registers& registers) {
+    for (int reg = 1; reg < REGISTERS; reg++) {
+        for (int i = 0; i < 4; i++) {
+            ctx.SetReg<u32>(reg, registers[reg][i], i);
+        }
+    }
+}
+
+static void PrintRegister(const char* name, const std::array<u32, 4>& reg) {
+    printf("    %s: %08x %08x %08x %08x\n", name, reg[3], reg[2], reg[1], reg[0]);
+}
+
+int main() {
+    System* system = new System;
+    ee::Context& ctx = system->ee;
+    TestInterpreter interpreter(ctx);
+    std::mt19937_64 rng(0x6d6d69);
+    int failures = 0;
+
+    for (const Op& op : ops) {
+        int op_failures = 0;
+        for (int n = 0; n < ITERATIONS; n++) {
+            // each lane is either random or an edge case
+            Registers input;
+            for (int reg = 0; reg < REGISTERS; reg++) {
+                for (int i = 0; i < 4; i++) {
+                    input[reg][i] = reg == 0 ? 0 : (rng() & 1) ? edges[rng() % std::size(edges)] : static_cast<u32>(rng());
+                }
+            }
+
+            // rs is 1 and rt is 2, and rd also covers $zero and both sources
+            int rd = n % REGISTERS;
+            ee::Instruction inst((1 << 21) | (2 << 16) | (rd << 11));
+
+            SetRegisters(ctx, input);
+            op.reference(ctx, inst);
+            Registers expected = GetRegisters(ctx);
+
+            SetRegisters(ctx, input);
+            interpreter.SetInstruction(inst);
+            (interpreter.*op.handler)();
+            Registers result = GetRegisters(ctx);
+
+            if (result != expected) {
+                if (op_failures++ < 4) {
+                    printf("%s: mismatch with rd %d\n", op.name, rd);
+                    PrintRegister("rs", input[1]);
+                    PrintRegister("rt", input[2]);
+                    PrintRegister("expected", expected[rd]);
+                    PrintRegister("result", result[rd]);
+                }
+            }
+        }
+
+        printf("%-8s %s\n", op.name, op_failures ? "failed" : "passed");
+        failures += op_failures;
+    }
+
+    delete system;
+    return failures ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "core/gs/rasterizer.h"
+
+// draws the same randomly generated primitives with 1 thread and with several, and checks that
+// vram ends up exactly the same. the draw states cover every stage of the pixel pipeline, so
+// both the specialised and the generic row functions are drawn with. then checks that textures
+// are decoded again after they're uploaded over, and after they're drawn into
+using namespace gs;
+
+static constexpr u32 FRAME_BASE = 0x0;
+static constexpr u32 Z_BASE = 0x800;
+static constexpr u32 TEXTURE_BASE = 0x1000;
+static constexpr u32 CLUT_BASE = 0x1800;
+static constexpr u32 BUFFER_WIDTH = 4;
+static constexpr int BATCHES = 32;
+static constexpr int PRIMITIVES = 64;
+
+using Vertex = Rasterizer::Vertex;
+
+class Generator {
+public:
+    Generator(u64 seed) : rng(seed) {}
+
+    void Fill(std::vector<u8>& vram) {
+        for (auto& byte : vram) {
+            byte = rng();
+        }
+    }
+
+    DrawState GenerateState() {
+        static const PixelFormat frame_formats[] = {PixelFormat::PSMCT32, PixelFormat::PSMCT24, PixelFormat::PSMCT16, PixelFormat::PSMCT16S};
+        static const PixelFormat z_formats[] = {PixelFormat::PSMZ32, PixelFormat::PSMZ24, PixelFormat::PSMZ16, PixelFormat::PSMZ16S};
+        static const PixelFormat texture_formats[] = {PixelFormat::PSMCT32, PixelFormat::PSMCT16, PixelFormat::PSMT8, PixelFormat::PSMT4};
+
+        DrawState state = {};
+        state.frame_format = Pick(frame_formats);
+        state.frame_base = FRAME_BASE;
+        state.frame_width = BUFFER_WIDTH;
+        state.frame_mask = Random(0, 3) ? 0 : static_cast<u32>(rng());
+
+        state.z_format = Pick(z_formats);
+        state.z_base = Z_BASE;
+        state.z_test = Random(0, 1);
+        state.z_method = static_cast<ZTest>(Random(1, 3));
+        state.z_mask = Random(0, 1);
+
+        state.scissor_x0 = Random(0, 16);
+        state.scissor_y0 = Random(0, 16);
+        state.scissor_x1 = Random(200, 255);
+        state.scissor_y1 = Random(200, 255);
+        state.gouraud = Random(0, 1);
+
+        state.texture_mapping = Random(0, 2) != 0;
+        if (state.texture_mapping) {
+            TextureState& texture = state.texture;
+            texture.format = Pick(texture_formats);
+
+            // render to texture now and then, by sampling the frame buffer
+            texture.base = Random(0, 7) ? TEXTURE_BASE : FRAME_BASE;
+            texture.width = 1;
+            texture.width_log2 = Random(3, 6);
+            texture.height_log2 = Random(3, 6);
+            texture.uv = Random(0, 1);
+            texture.function = static_cast<TextureFunction>(Random(0, 3));
+            texture.alpha = Random(0, 1);
+            texture.clut_format = PixelFormat::PSMCT32;
+            texture.clut_base = CLUT_BASE;
+            texture.clut_offset = texture.format == PixelFormat::PSMT4 ? Random(0, 15) * 16 : 0;
+            texture.wrap_u = static_cast<WrapMode>(Random(0, 3));
+            texture.wrap_v = static_cast<WrapMode>(Random(0, 3));
+            texture.min_u = Random(0, 31);
+            texture.max_u = Random(0, 63);
+            texture.min_v = Random(0, 31);
+            texture.max_v = Random(0, 63);
+            texture.alpha0 = rng();
+            texture.alpha1 = rng();
+            texture.transparent_black = Random(0, 1);
+        }
+
+        state.fog = Random(0, 3) == 0;
+        state.fog_colour = rng();
+
+        state.alpha_test = Random(0, 1);
+        state.alpha_method = static_cast<AlphaTest>(Random(0, 7));
+        state.alpha_reference = rng();
+        state.alpha_fail = static_cast<AlphaFail>(Random(0, 3));
+
+        state.destination_alpha_test = Random(0, 3) == 0;
+        state.destination_alpha_mode = Random(0, 1);
+
+        state.blend = Random(0, 1);
+        state.blend_a = Random(0, 3);
+        state.blend_b = Random(0, 3);
+        state.blend_c = Random(0, 3);
+        state.blend_d = Random(0, 3);
+        state.blend_fix = rng();
+        state.blend_alpha_only = Random(0, 3) == 0;
+
+        state.frame_alpha = Random(0, 3) == 0;
+        state.dither = Random(0, 1);
+        for (auto& row : state.dither_matrix) {
+            for (auto& value : row) {
+                value = Random(-4, 3);
+            }
+        }
+
+        state.colour_clamp = Random(0, 1);
+        return state;
+    }
+
+    Vertex GenerateVertex() {
+        Vertex vertex;
+        vertex.x = Random(-256, 256 * 16 + 256);
+        vertex.y = Random(-256, 256 * 16 + 256);
+        vertex.z = rng();
+        vertex.r = rng();
+        vertex.g = rng();
+        vertex.b = rng();
+        vertex.a = rng();
+        vertex.fog = rng();
+        vertex.u = Random(0, 128 * 16);
+        vertex.v = Random(0, 128 * 16);
+        vertex.q = std::uniform_real_distribution<f32>(0.25f, 2.0f)(rng);
+        vertex.s = std::uniform_real_distribution<f32>(-0.5f, 1.5f)(rng) * vertex.q;
+        vertex.t = std::uniform_real_distribution<f32>(-0.5f, 1.5f)(rng) * vertex.q;
+        return vertex;
+    }
+
+    void Draw(Rasterizer& rasterizer, const DrawState& state) {
+        Vertex v0 = GenerateVertex();
+        Vertex v1 = GenerateVertex();
+        Vertex v2 = GenerateVertex();
+
+        switch (Random(0, 5)) {
+        case 0:
+            rasterizer.DrawPoint(state, v0);
+            break;
+        case 1:
+            rasterizer.DrawLine(state, v0, v1);
+            break;
+        case 2:
+            rasterizer.DrawSprite(state, v0, v1);
+            break;
+        default:
+            rasterizer.DrawTriangle(state, v0, v1, v2);
+            break;
+        }
+    }
+
+private:
+    int Random(int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(rng);
+    }
+
+    template <typename T, size_t N>
+    T Pick(const T (&values)[N]) {
+        return values[Random(0, N - 1)];
+    }
+
+    std::mt19937_64 rng;
+};
+
+static std::vector<u8> DrawStream(int threads) {
+    std::vector<u8> vram(VRAM_SIZE);
+    Rasterizer rasterizer(vram.data());
+    rasterizer.SetThreadCount(threads);
+
+    Generator generator(0x72617374);
+    generator.Fill(vram);
+
+    for (int batch = 0; batch < BATCHES; batch++) {
+        for (int i = 0; i < PRIMITIVES; i++) {
+            generator.Draw(rasterizer, generator.GenerateState());
+        }
+
+        rasterizer.Flush();
+    }
+
+    return vram;
+}
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what) {
+    if (!condition) {
+        printf("%s failed\n", what);
+        failures++;
+    }
+}
+
+static Vertex GetVertex(int x, int y, u32 colour, int u = 0, int v = 0) {
+    Vertex vertex = {};
+    vertex.x = x * 16;
+    vertex.y = y * 16;
+    vertex.r = colour;
+    vertex.g = colour >> 8;
+    vertex.b = colour >> 16;
+    vertex.a = colour >> 24;
+    vertex.u = u * 16;
+    vertex.v = v * 16;
+    vertex.q = 1;
+    return vertex;
+}
+
+// checks that every pixel of a 64x64 area of the frame buffer holds what expected gives for it
+template <typename Expected>
+static bool CheckFrame(const std::vector<u8>& vram, Expected expected) {
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (Page<PixelFormat::PSMCT32>::Read(vram.data(), x, y, FRAME_BASE, BUFFER_WIDTH) != expected(x, y)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void TestTextureCache(int threads) {
+    std::vector<u8> vram(VRAM_SIZE);
+    Rasterizer rasterizer(vram.data());
+    rasterizer.SetThreadCount(threads);
+
+    DrawState state = {};
+    state.frame_format = PixelFormat::PSMCT32;
+    state.frame_base = FRAME_BASE;
+    state.frame_width = BUFFER_WIDTH;
+    state.scissor_x1 = 255;
+    state.scissor_y1 = 255;
+    state.texture_mapping = true;
+    state.texture.format = PixelFormat::PSMCT32;
+    state.texture.base = TEXTURE_BASE;
+    state.texture.width = 1;
+    state.texture.width_log2 = 6;
+    state.texture.height_log2 = 6;
+    state.texture.uv = true;
+    state.texture.function = TextureFunction::Decal;
+    state.texture.alpha = true;
+
+    auto texel = [](int x, int y, u32 seed) {
+        return static_cast<u32>(x | (y << 8) | (seed << 16) | 0x80000000);
+    };
+
+    auto upload = [&](u32 seed) {
+        for (int y = 0; y < 64; y++) {
+            for (int x = 0; x < 64; x++) {
+                Page<PixelFormat::PSMCT32>::Write(vram.data(), x, y, TEXTURE_BASE, 1, texel(x, y, seed));
+            }
+        }
+
+        rasterizer.InvalidateTextures(PixelFormat::PSMCT32, TEXTURE_BASE, 1, 0, 0, 63, 63);
+    };
+
+    // uploading over a texture which was drawn with means it's decoded again
+    for (u32 seed = 1; seed <= 2; seed++) {
+        upload(seed);
+        rasterizer.DrawSprite(state, GetVertex(0, 0, 0), GetVertex(64, 64, 0, 64, 64));
+        rasterizer.Flush();
+        Check(CheckFrame(vram, [&](int x, int y) { return texel(x, y, seed); }), "upload");
+    }
+
+    // writes to other pages leave it alone
+    TextureCache::Stats before = rasterizer.GetTextureCacheStats();
+    rasterizer.InvalidateTextures(PixelFormat::PSMCT32, TEXTURE_BASE + 0x400, 1, 0, 0, 63, 63);
+    rasterizer.DrawSprite(state, GetVertex(0, 0, 0), GetVertex(64, 64, 0, 64, 64));
+    rasterizer.Flush();
+    TextureCache::Stats after = rasterizer.GetTextureCacheStats();
+    Check(after.hits == before.hits + 1 && after.invalidations == before.invalidations, "unrelated upload");
+
+    // drawing into the texture and then sampling it in the same batch sees what was drawn
+    DrawState target = state;
+    target.texture_mapping = false;
+    target.frame_base = TEXTURE_BASE;
+    target.frame_width = 1;
+    target.scissor_x1 = 63;
+    target.scissor_y1 = 63;
+
+    for (u32 colour : {0x80102030u, 0x80405060u}) {
+        rasterizer.DrawSprite(target, GetVertex(0, 0, colour), GetVertex(64, 64, colour));
+        rasterizer.DrawSprite(state, GetVertex(0, 0, 0), GetVertex(64, 64, 0, 64, 64));
+        rasterizer.Flush();
+        Check(CheckFrame(vram, [&](int, int) { return colour; }), "render to texture");
+    }
+}
+
+int main() {
+    std::vector<u8> expected = DrawStream(1);
+    for (int threads : {2, 4}) {
+        Check(std::memcmp(expected.data(), DrawStream(threads).data(), VRAM_SIZE) == 0, threads == 2 ? "2 threads" : "4 threads");
+    }
+
+    for (int threads : {1, 4}) {
+        TestTextureCache(threads);
+    }
+
+    printf("%s\n", failures ? "failed" : "passed");
+    return failures ? 1 : 0;
+}
\ No newline at end of file